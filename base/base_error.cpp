@@ -22,7 +22,8 @@ static const char* ErrorMessages[] =
     "Property is read only",
     "Pixel format is not supported",
     "Parameters of images don't match",
-    "Failed image encoding"
+    "Failed image encoding",
+    "Failed image decoding"
 };
 
 
@@ -0,0 +1,362 @@
+#include "base_metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+NAMESPACE_START
+
+/* 线程第一次写指标时分配分片，之后一直使用同一个分片 */
+static std::atomic<uint32_t> gNextShard(0);
+
+static inline uint32_t ThreadShard()
+{
+    static thread_local uint32_t shard = gNextShard.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARD_COUNT;
+    return shard;
+}
+
+/* 分片按照缓存行对齐，使用 posix_memalign 分配 */
+static void *AllocateAligned(size_t size)
+{
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, METRICS_CACHE_LINE, size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+MetricCounter::MetricCounter()
+{
+    for (size_t i = 0; i < METRICS_SHARD_COUNT; i++)
+    {
+        mShards[i].Value = 0;
+    }
+}
+
+void MetricCounter::Add(uint64_t value)
+{
+    mShards[ThreadShard()].Value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricCounter::Value() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < METRICS_SHARD_COUNT; i++)
+    {
+        total += mShards[i].Value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void *MetricCounter::operator new(size_t size)
+{
+    return AllocateAligned(size);
+}
+
+void MetricCounter::operator delete(void *ptr)
+{
+    free(ptr);
+}
+
+MetricHistogram::MetricHistogram(const std::vector<uint64_t> &bounds, double scale) : mBounds(bounds), mScale(scale)
+{
+    if (mBounds.size() > METRICS_MAX_BUCKETS)
+    {
+        mBounds.resize(METRICS_MAX_BUCKETS);
+    }
+    for (size_t i = 0; i < METRICS_SHARD_COUNT; i++)
+    {
+        for (size_t j = 0; j <= METRICS_MAX_BUCKETS; j++)
+        {
+            mShards[i].Buckets[j] = 0;
+        }
+        mShards[i].Sum = 0;
+    }
+}
+
+// 分桶数量很少，顺序查找比二分查找更快
+void MetricHistogram::Observe(uint64_t value)
+{
+    Shard &shard = mShards[ThreadShard()];
+    size_t bucket = 0;
+
+    while ((bucket < mBounds.size()) && (value > mBounds[bucket]))
+    {
+        bucket++;
+    }
+    shard.Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.Sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::Snapshot(std::vector<uint64_t> *buckets, uint64_t *sum) const
+{
+    uint64_t count = 0;
+
+    buckets->assign(mBounds.size() + 1, 0);
+    *sum = 0;
+    for (size_t i = 0; i < METRICS_SHARD_COUNT; i++)
+    {
+        for (size_t j = 0; j <= mBounds.size(); j++)
+        {
+            uint64_t value = mShards[i].Buckets[j].load(std::memory_order_relaxed);
+            (*buckets)[j] += value;
+            count += value;
+        }
+        *sum += mShards[i].Sum.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void *MetricHistogram::operator new(size_t size)
+{
+    return AllocateAligned(size);
+}
+
+void MetricHistogram::operator delete(void *ptr)
+{
+    free(ptr);
+}
+
+std::vector<uint64_t> MetricLatencyBuckets()
+{
+    static const uint64_t bounds[] = {50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+    return std::vector<uint64_t>(bounds, bounds + sizeof(bounds) / sizeof(bounds[0]));
+}
+
+std::vector<uint64_t> MetricSizeBuckets()
+{
+    static const uint64_t bounds[] = {1024, 4096, 16384, 65536, 131072, 262144, 524288, 1048576, 2097152, 4194304};
+    return std::vector<uint64_t>(bounds, bounds + sizeof(bounds) / sizeof(bounds[0]));
+}
+
+MetricsRegistry &MetricsRegistry::Instance()
+{
+    // 不析构，其它静态对象析构时仍然可以访问
+    static MetricsRegistry *registry = new MetricsRegistry();
+    return *registry;
+}
+
+std::string MetricsRegistry::Label(const std::string &name, const std::string &value)
+{
+    std::string label = name + "=\"";
+    for (size_t i = 0; i < value.length(); i++)
+    {
+        if ((value[i] == '\\') || (value[i] == '"'))
+        {
+            label += '\\';
+            label += value[i];
+        }
+        else if (value[i] == '\n')
+        {
+            label += "\\n";
+        }
+        else
+        {
+            label += value[i];
+        }
+    }
+    label += '"';
+    return label;
+}
+
+MetricsRegistry::MetricSeries *MetricsRegistry::Find(const std::string &name, const std::string &help, MetricType type,
+                                                     const std::string &labels, bool *created)
+{
+    std::map<std::string, MetricFamily>::iterator it = mFamilies.find(name);
+
+    *created = false;
+    if (it == mFamilies.end())
+    {
+        it = mFamilies.insert(std::make_pair(name, MetricFamily())).first;
+        it->second.Type = type;
+        it->second.Help = help;
+    }
+    else if (it->second.Type != type)
+    {
+        return nullptr;
+    }
+
+    std::vector<std::unique_ptr<MetricSeries> > &series = it->second.Series;
+    for (size_t i = 0; i < series.size(); i++)
+    {
+        if (series[i]->Labels == labels)
+        {
+            return series[i].get();
+        }
+    }
+    series.emplace_back(new MetricSeries());
+    series.back()->Labels = labels;
+    series.back()->Owner = nullptr;
+    *created = true;
+    return series.back().get();
+}
+
+MetricCounter *MetricsRegistry::Counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    bool created = false;
+    MetricSeries *series = Find(name, help, MetricType::Counter, labels, &created);
+
+    if (series == nullptr)
+    {
+        return nullptr;
+    }
+    if (created)
+    {
+        series->Counter.reset(new MetricCounter());
+    }
+    return series->Counter.get();
+}
+
+MetricGauge *MetricsRegistry::Gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    bool created = false;
+    MetricSeries *series = Find(name, help, MetricType::Gauge, labels, &created);
+
+    if (series == nullptr)
+    {
+        return nullptr;
+    }
+    if (created)
+    {
+        series->Gauge.reset(new MetricGauge());
+    }
+    return series->Gauge.get();
+}
+
+MetricHistogram *MetricsRegistry::Histogram(const std::string &name, const std::string &help, const std::vector<uint64_t> &bounds,
+                                            double scale, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    bool created = false;
+    MetricSeries *series = Find(name, help, MetricType::Histogram, labels, &created);
+
+    if (series == nullptr)
+    {
+        return nullptr;
+    }
+    if (created)
+    {
+        series->Histogram.reset(new MetricHistogram(bounds, scale));
+    }
+    return series->Histogram.get();
+}
+
+bool MetricsRegistry::AddCallback(const std::string &name, const std::string &help, const std::string &labels,
+                                  const std::function<double()> &callback, const void *owner)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    bool created = false;
+    MetricSeries *series = Find(name, help, MetricType::Callback, labels, &created);
+
+    if (series == nullptr)
+    {
+        return false;
+    }
+    // 相同标签时替换之前的计算函数
+    series->Callback = callback;
+    series->Owner = owner;
+    return true;
+}
+
+void MetricsRegistry::RemoveCallbacks(const void *owner)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+
+    for (std::map<std::string, MetricFamily>::iterator it = mFamilies.begin(); it != mFamilies.end(); ++it)
+    {
+        std::vector<std::unique_ptr<MetricSeries> > &series = it->second.Series;
+        for (size_t i = 0; i < series.size();)
+        {
+            if ((series[i]->Callback) && (series[i]->Owner == owner))
+            {
+                series.erase(series.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
+
+/* 输出一行指标，extra 为附加的标签(例如 le) */
+static void AppendSample(std::string *output, const std::string &name, const std::string &labels, const char *extra, double value)
+{
+    char text[64];
+
+    *output += name;
+    if ((!labels.empty()) || (extra != nullptr))
+    {
+        *output += '{';
+        *output += labels;
+        if (extra != nullptr)
+        {
+            if (!labels.empty())
+            {
+                *output += ',';
+            }
+            *output += extra;
+        }
+        *output += '}';
+    }
+    snprintf(text, sizeof(text), " %.15g\n", value);
+    *output += text;
+}
+
+void MetricsRegistry::Expose(std::string *output)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    std::vector<uint64_t> buckets;
+    char bound[64];
+
+    for (std::map<std::string, MetricFamily>::iterator it = mFamilies.begin(); it != mFamilies.end(); ++it)
+    {
+        const std::string &name = it->first;
+        const MetricFamily &family = it->second;
+        static const char *typeNames[] = {"counter", "gauge", "histogram", "gauge"};
+
+        if (family.Series.empty())
+        {
+            continue;
+        }
+        *output += "# HELP " + name + " " + family.Help + "\n";
+        *output += "# TYPE " + name + " " + typeNames[static_cast<int>(family.Type)] + "\n";
+        for (size_t i = 0; i < family.Series.size(); i++)
+        {
+            const MetricSeries &series = *family.Series[i];
+            switch (family.Type)
+            {
+            case MetricType::Counter:
+                AppendSample(output, name, series.Labels, nullptr, static_cast<double>(series.Counter->Value()));
+                break;
+            case MetricType::Gauge:
+                AppendSample(output, name, series.Labels, nullptr, static_cast<double>(series.Gauge->Value()));
+                break;
+            case MetricType::Callback:
+                AppendSample(output, name, series.Labels, nullptr, series.Callback());
+                break;
+            case MetricType::Histogram:
+            {
+                const MetricHistogram &histogram = *series.Histogram;
+                uint64_t sum = 0;
+                uint64_t count = histogram.Snapshot(&buckets, &sum);
+                uint64_t cumulative = 0;
+                for (size_t j = 0; j < histogram.Bounds().size(); j++)
+                {
+                    cumulative += buckets[j];
+                    snprintf(bound, sizeof(bound), "le=\"%.9g\"", histogram.Bounds()[j] * histogram.Scale());
+                    AppendSample(output, name + "_bucket", series.Labels, bound, static_cast<double>(cumulative));
+                }
+                AppendSample(output, name + "_bucket", series.Labels, "le=\"+Inf\"", static_cast<double>(count));
+                AppendSample(output, name + "_sum", series.Labels, nullptr, sum * histogram.Scale());
+                AppendSample(output, name + "_count", series.Labels, nullptr, static_cast<double>(count));
+                break;
+            }
+            }
+        }
+    }
+}
+
+NAMESPACE_END
@@ -0,0 +1,257 @@
+/**
+ * @file base_metrics.h
+ * @brief 运行指标统计，计数器、数值和固定分桶的直方图
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 20:03:41
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 20:03:41 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 添加指标注册表和Prometheus文本格式输出 </td>
+ * </tr>
+ * </table>
+ * @details
+ *  计数器和直方图按照线程分片，每个线程只写自己分片所在的缓存行，热点路径上只有一次无竞争的原子加法；
+ *  读取时再把所有分片相加。指标对象在注册表中创建，之后一直有效，调用者保存指针，热点路径上不查找注册表。
+ */
+#ifndef BASE_METRICS_H
+#define BASE_METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base_define.h"
+#include "uncopyable.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 计数器和直方图的分片数量，线程按照创建顺序轮流使用分片
+ */
+#define METRICS_SHARD_COUNT (16)
+/**
+ * @brief 分片对齐的缓存行大小
+ */
+#define METRICS_CACHE_LINE (64)
+/**
+ * @brief 直方图最多的分桶数量(不包括 +Inf)
+ */
+#define METRICS_MAX_BUCKETS (16)
+
+/**
+ * @brief 只增加的计数器
+ */
+class MetricCounter : private Uncopyable
+{
+public:
+    MetricCounter();
+    /**
+     * @brief 增加计数，只写当前线程的分片
+     * @param  value            增加的数值
+     */
+    void Add(uint64_t value = 1);
+    /**
+     * @brief  所有分片的和
+     * @return uint64_t         计数值
+     */
+    uint64_t Value() const;
+    /**
+     * @brief 按照缓存行对齐分配，C++11 的 new 不保证分片需要的对齐
+     */
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr);
+
+private:
+    struct alignas(METRICS_CACHE_LINE) Shard
+    {
+        std::atomic<uint64_t> Value; ///< 分片计数
+    };
+    Shard mShards[METRICS_SHARD_COUNT]; ///< 线程分片
+};
+
+/**
+ * @brief 可以增加和减少的数值，例如当前连接数
+ */
+class MetricGauge : private Uncopyable
+{
+public:
+    MetricGauge() : mValue(0) {}
+    inline void Set(int64_t value) { mValue.store(value, std::memory_order_relaxed); }
+    inline void Add(int64_t value) { mValue.fetch_add(value, std::memory_order_relaxed); }
+    inline int64_t Value() const { return mValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> mValue; ///< 当前值
+};
+
+/**
+ * @brief 固定分桶的直方图
+ * @details 记录整数值(例如微秒、字节)，输出时乘以 scale 转换为Prometheus的基本单位(例如秒)
+ */
+class MetricHistogram : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Metric Histogram object
+     * @param  bounds           每个分桶的上限(包含)，递增，超出 METRICS_MAX_BUCKETS 的部分被忽略
+     * @param  scale            输出时的单位换算
+     */
+    MetricHistogram(const std::vector<uint64_t> &bounds, double scale);
+    /**
+     * @brief 记录一个值，只写当前线程的分片
+     * @param  value            记录的值
+     */
+    void Observe(uint64_t value);
+    /**
+     * @brief  汇总所有分片
+     * @param  buckets          每个分桶的数量(非累计)，最后一个为 +Inf
+     * @param  sum              所有值的和
+     * @return uint64_t         记录的数量
+     */
+    uint64_t Snapshot(std::vector<uint64_t> *buckets, uint64_t *sum) const;
+    inline const std::vector<uint64_t> &Bounds() const { return mBounds; }
+    inline double Scale() const { return mScale; }
+    /**
+     * @brief 按照缓存行对齐分配，C++11 的 new 不保证分片需要的对齐
+     */
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr);
+
+private:
+    struct alignas(METRICS_CACHE_LINE) Shard
+    {
+        std::atomic<uint64_t> Buckets[METRICS_MAX_BUCKETS + 1]; ///< 分桶计数
+        std::atomic<uint64_t> Sum;                              ///< 值的和
+    };
+    std::vector<uint64_t> mBounds;      ///< 分桶上限
+    double mScale;                      ///< 单位换算
+    Shard mShards[METRICS_SHARD_COUNT]; ///< 线程分片
+};
+
+/**
+ * @brief 耗时直方图的默认分桶，单位微秒，输出为秒
+ */
+std::vector<uint64_t> MetricLatencyBuckets();
+/**
+ * @brief 数据大小直方图的默认分桶，单位字节
+ */
+std::vector<uint64_t> MetricSizeBuckets();
+
+/**
+ * @brief 全局指标注册表
+ * @details
+ *  相同名称和标签的指标只创建一次，重复获取返回同一个对象；同一个名称只能是一种类型，类型不同时返回nullptr。
+ *  标签为Prometheus格式的 name="value" 列表，使用 Label 生成。
+ */
+class MetricsRegistry : private Uncopyable
+{
+public:
+    /**
+     * @brief  获取全局注册表
+     * @return MetricsRegistry& 注册表
+     */
+    static MetricsRegistry &Instance();
+    /**
+     * @brief  生成单个标签，对值进行转义
+     * @param  name             标签名称
+     * @param  value            标签值
+     * @return std::string      name="value"
+     */
+    static std::string Label(const std::string &name, const std::string &value);
+
+    MetricCounter *Counter(const std::string &name, const std::string &help, const std::string &labels = "");
+    MetricGauge *Gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    /**
+     * @brief  获取直方图，已经存在时忽略分桶参数
+     * @param  name             指标名称
+     * @param  help             说明
+     * @param  bounds           分桶上限
+     * @param  scale            输出时的单位换算
+     * @param  labels           标签
+     * @return MetricHistogram* 直方图
+     */
+    MetricHistogram *Histogram(const std::string &name, const std::string &help, const std::vector<uint64_t> &bounds,
+                               double scale, const std::string &labels = "");
+    /**
+     * @brief  添加输出时才计算的数值，例如队列长度
+     * @param  name             指标名称
+     * @param  help             说明
+     * @param  labels           标签
+     * @param  callback         计算函数，在输出指标的线程中调用
+     * @param  owner            所有者，销毁之前通过 RemoveCallbacks 移除
+     * @return true             添加成功
+     * @return false            名称已经是其它类型
+     */
+    bool AddCallback(const std::string &name, const std::string &help, const std::string &labels,
+                     const std::function<double()> &callback, const void *owner);
+    /**
+     * @brief 移除所有者添加的计算函数
+     * @param  owner            所有者
+     */
+    void RemoveCallbacks(const void *owner);
+    /**
+     * @brief 按照Prometheus文本格式输出所有指标，按名称排序
+     * @param  output           输出文本
+     */
+    void Expose(std::string *output);
+
+private:
+    enum class MetricType
+    {
+        Counter,
+        Gauge,
+        Histogram,
+        Callback
+    };
+    struct MetricSeries
+    {
+        std::string Labels;                         ///< 标签
+        std::unique_ptr<MetricCounter> Counter;     ///< 计数器
+        std::unique_ptr<MetricGauge> Gauge;         ///< 数值
+        std::unique_ptr<MetricHistogram> Histogram; ///< 直方图
+        std::function<double()> Callback;           ///< 计算函数
+        const void *Owner;                          ///< 计算函数的所有者
+    };
+    struct MetricFamily
+    {
+        MetricType Type;                                    ///< 类型
+        std::string Help;                                   ///< 说明
+        std::vector<std::unique_ptr<MetricSeries> > Series; ///< 不同标签的指标
+    };
+
+    MetricsRegistry() {}
+    /**
+     * @brief  查找或者创建指标，需要持有锁
+     * @param  name             指标名称
+     * @param  help             说明
+     * @param  type             类型
+     * @param  labels           标签
+     * @param  created          是否新创建
+     * @return MetricSeries*    指标，类型不同时为nullptr
+     */
+    MetricSeries *Find(const std::string &name, const std::string &help, MetricType type, const std::string &labels, bool *created);
+
+    std::mutex mGuard;                             ///< 注册和输出的锁，热点路径上不使用
+    std::map<std::string, MetricFamily> mFamilies; ///< 按名称排序的指标
+};
+
+NAMESPACE_END
+
+#endif
@@ -257,7 +257,7 @@ private:
  * @return true             是2的幂
  * @return false            不是2的幂
  */
-static bool is_power_of_2(unsigned int n)
+static inline bool is_power_of_2(unsigned int n)
 {
     return (n != 0 && ((n & (n - 1)) == 0));
 }
@@ -267,7 +267,7 @@ static bool is_power_of_2(unsigned int n)
  * @param  a                输入数字
  * @return uint32_t         输出向上取整结果
  */
-static uint32_t roundup_power_of_2(uint32_t a)
+static inline uint32_t roundup_power_of_2(uint32_t a)
 {
     if (a == 0)
     {
@@ -0,0 +1,205 @@
+#include "base_trace.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+NAMESPACE_START
+
+std::atomic<bool> FrameTrace::sEnabled(false);
+
+/**
+ * @brief 单个事件
+ */
+struct TraceEvent
+{
+    const char *Name;    ///< 事件名称
+    const char *ArgName; ///< 附加参数名称
+    int64_t ArgValue;    ///< 附加参数值
+    uint64_t FrameId;    ///< 帧编号
+    int64_t Begin;       ///< 开始时间(微秒)
+    int64_t Duration;    ///< 持续时间(微秒)
+};
+
+/**
+ * @brief 单个线程的事件缓冲区，只有所属线程写入
+ * @details 写入事件之后再发布写入总数；读取时按照前后两次读到的总数丢弃可能被覆盖的事件
+ */
+struct TraceThreadBuffer
+{
+    int Tid;                                 ///< 线程ID
+    std::string ThreadName;                  ///< 线程名称
+    TraceEvent Events[TRACE_BUFFER_EVENTS];  ///< 环形缓冲区
+    std::atomic<uint64_t> Written;           ///< 写入的事件总数
+};
+
+static std::mutex gBufferGuard;                      ///< 只在线程第一次记录和导出时使用
+static std::vector<TraceThreadBuffer *> gBuffers;    ///< 所有线程的缓冲区，线程退出之后保留
+static std::atomic<uint64_t> gNextFrameId(0);        ///< 帧编号
+static std::atomic<int64_t> gEnabledAt(0);           ///< 最近一次开启的时间，更早的事件不再导出
+
+/* 线程第一次记录时创建缓冲区，超过线程数量上限时返回nullptr */
+static TraceThreadBuffer *CreateThreadBuffer()
+{
+    std::lock_guard<std::mutex> lock(gBufferGuard);
+    char name[32] = {0};
+
+    if (gBuffers.size() >= TRACE_MAX_THREADS)
+    {
+        return nullptr;
+    }
+    TraceThreadBuffer *buffer = new TraceThreadBuffer();
+    buffer->Tid = static_cast<int>(::syscall(SYS_gettid));
+    if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0)
+    {
+        buffer->ThreadName = name;
+    }
+    buffer->Written = 0;
+    gBuffers.push_back(buffer);
+    return buffer;
+}
+
+static TraceThreadBuffer *ThreadBuffer()
+{
+    static thread_local TraceThreadBuffer *buffer = CreateThreadBuffer();
+    return buffer;
+}
+
+void FrameTrace::SetEnabled(bool enable)
+{
+    if (enable)
+    {
+        gEnabledAt = Now();
+    }
+    sEnabled = enable;
+}
+
+uint64_t FrameTrace::NextFrameId()
+{
+    return gNextFrameId.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+int64_t FrameTrace::Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameTrace::Record(const char *name, uint64_t frameId, int64_t begin, int64_t end, const char *argName, int64_t argValue)
+{
+    TraceThreadBuffer *buffer = ThreadBuffer();
+
+    if (buffer == nullptr)
+    {
+        return;
+    }
+    uint64_t index = buffer->Written.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer->Events[index & (TRACE_BUFFER_EVENTS - 1)];
+    event.Name = name;
+    event.ArgName = argName;
+    event.ArgValue = argValue;
+    event.FrameId = frameId;
+    event.Begin = begin;
+    event.Duration = end - begin;
+    buffer->Written.store(index + 1, std::memory_order_release);
+}
+
+/* 复制缓冲区中没有被覆盖的事件 */
+static void SnapshotBuffer(TraceThreadBuffer *buffer, std::vector<TraceEvent> *events)
+{
+    uint64_t end = buffer->Written.load(std::memory_order_acquire);
+    uint64_t start = (end > TRACE_BUFFER_EVENTS) ? end - TRACE_BUFFER_EVENTS : 0;
+
+    events->clear();
+    for (uint64_t i = start; i < end; i++)
+    {
+        events->push_back(buffer->Events[i & (TRACE_BUFFER_EVENTS - 1)]);
+    }
+    // 复制期间写入线程可能覆盖了最旧的事件，以及正在写入下一个位置
+    uint64_t written = buffer->Written.load(std::memory_order_acquire);
+    uint64_t valid = (written + 1 > TRACE_BUFFER_EVENTS) ? written + 1 - TRACE_BUFFER_EVENTS : 0;
+    if (valid > start)
+    {
+        events->erase(events->begin(), events->begin() + static_cast<size_t>(std::min(valid - start, end - start)));
+    }
+}
+
+/* json字符串转义，线程名称可能包含任意字符 */
+static void AppendJsonString(std::string *output, const std::string &text)
+{
+    *output += '"';
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if ((c == '"') || (c == '\\'))
+        {
+            *output += '\\';
+            *output += static_cast<char>(c);
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            *output += escaped;
+        }
+        else
+        {
+            *output += static_cast<char>(c);
+        }
+    }
+    *output += '"';
+}
+
+void FrameTrace::ExportChromeTrace(std::string *output)
+{
+    std::vector<TraceThreadBuffer *> buffers;
+    std::vector<TraceEvent> events;
+    int64_t enabledAt = gEnabledAt;
+    int pid = static_cast<int>(getpid());
+    bool first = true;
+    char item[256];
+
+    {
+        std::lock_guard<std::mutex> lock(gBufferGuard);
+        buffers = gBuffers;
+    }
+
+    *output += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        snprintf(item, sizeof(item), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                 first ? "" : ",", pid, buffers[i]->Tid);
+        *output += item;
+        AppendJsonString(output, buffers[i]->ThreadName);
+        *output += "}}";
+        first = false;
+
+        SnapshotBuffer(buffers[i], &events);
+        for (size_t j = 0; j < events.size(); j++)
+        {
+            const TraceEvent &event = events[j];
+            if (event.Begin < enabledAt)
+            {
+                continue;
+            }
+            int length = snprintf(item, sizeof(item), ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"frame\":%llu",
+                                  event.Name, static_cast<long long>(event.Begin), static_cast<long long>(event.Duration), pid, buffers[i]->Tid,
+                                  static_cast<unsigned long long>(event.FrameId));
+            output->append(item, static_cast<size_t>(std::min<int>(length, sizeof(item) - 1)));
+            if (event.ArgName != nullptr)
+            {
+                snprintf(item, sizeof(item), ",\"%s\":%lld", event.ArgName, static_cast<long long>(event.ArgValue));
+                *output += item;
+            }
+            *output += "}}";
+        }
+    }
+    *output += "\n]}\n";
+}
+
+NAMESPACE_END
@@ -0,0 +1,132 @@
+/**
+ * @file base_trace.h
+ * @brief 逐帧流水线跟踪，导出Chrome trace_event格式
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 20:41:17
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 20:41:17 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 添加帧编号、线程独立的事件缓冲区和Chrome trace导出 </td>
+ * </tr>
+ * </table>
+ * @details
+ *  每一帧在采集时分配编号，之后采集、转换、编码和发送的耗时都以该编号记录为一段事件。
+ *  每个线程写入自己的环形缓冲区，写入不加锁；缓冲区满时覆盖最旧的事件。
+ *  默认关闭，关闭时每段事件只有一次读取开关和一次分支。
+ *  导出的json可以在 chrome://tracing 或者 Perfetto 中打开，args.frame 为帧编号。
+ */
+#ifndef BASE_TRACE_H
+#define BASE_TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include "base_define.h"
+#include "uncopyable.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 每个线程缓冲区保存的事件数量，必须为2的幂
+ */
+#define TRACE_BUFFER_EVENTS (8192)
+/**
+ * @brief 最多记录事件的线程数量，超出之后新线程的事件被丢弃
+ */
+#define TRACE_MAX_THREADS (64)
+
+/**
+ * @brief 逐帧跟踪的全局开关和导出
+ */
+class FrameTrace
+{
+public:
+    /**
+     * @brief  是否开启跟踪
+     * @return true  开启
+     * @return false 关闭
+     */
+    static inline bool IsEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+    /**
+     * @brief 开启或者关闭跟踪，开启时清除之前的事件
+     * @param  enable           是否开启
+     */
+    static void SetEnabled(bool enable);
+    /**
+     * @brief  分配新的帧编号，从1开始，0 表示没有编号
+     * @return uint64_t         帧编号
+     */
+    static uint64_t NextFrameId();
+    /**
+     * @brief  单调时钟的当前时间
+     * @return int64_t          微秒
+     */
+    static int64_t Now();
+    /**
+     * @brief  事件开始时间
+     * @return int64_t          开启时为当前时间，关闭时为0
+     */
+    static inline int64_t Begin() { return IsEnabled() ? Now() : 0; }
+    /**
+     * @brief 记录一段事件，写入当前线程的缓冲区
+     * @param  name             事件名称，必须是静态字符串
+     * @param  frameId          帧编号
+     * @param  begin            开始时间(微秒)
+     * @param  end              结束时间(微秒)
+     * @param  argName          附加参数名称，静态字符串，为空时没有附加参数
+     * @param  argValue         附加参数值
+     */
+    static void Record(const char *name, uint64_t frameId, int64_t begin, int64_t end,
+                       const char *argName = nullptr, int64_t argValue = 0);
+    /**
+     * @brief 按照Chrome trace_event格式输出所有线程缓冲区中的事件
+     * @param  output           输出json
+     */
+    static void ExportChromeTrace(std::string *output);
+
+private:
+    static std::atomic<bool> sEnabled; ///< 跟踪开关
+};
+
+/**
+ * @brief 作用域内的一段事件，析构时记录
+ */
+class TraceSpan : private Uncopyable
+{
+public:
+    TraceSpan(const char *name, uint64_t frameId, const char *argName = nullptr, int64_t argValue = 0)
+        : mName(name), mArgName(argName), mArgValue(argValue), mFrameId(frameId), mBegin(FrameTrace::Begin())
+    {
+    }
+    ~TraceSpan()
+    {
+        if (mBegin != 0)
+        {
+            FrameTrace::Record(mName, mFrameId, mBegin, FrameTrace::Now(), mArgName, mArgValue);
+        }
+    }
+
+private:
+    const char *mName;    ///< 事件名称
+    const char *mArgName; ///< 附加参数名称
+    int64_t mArgValue;    ///< 附加参数值
+    uint64_t mFrameId;    ///< 帧编号
+    int64_t mBegin;       ///< 开始时间，0 表示跟踪关闭
+};
+
+NAMESPACE_END
+
+#endif
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_metrics.h"
+#include "test_check.h"
+
+using namespace MY_NAME_SPACE;
+
+static bool Contains(const std::string &text, const std::string &line)
+{
+    return text.find(line) != std::string::npos;
+}
+
+/* 多个线程同时累加，分片之和等于总数 */
+void TestCounter()
+{
+    MetricCounter *counter = MetricsRegistry::Instance().Counter("test_events_total", "Test events", MetricsRegistry::Label("kind", "a"));
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 32; i++)
+    {
+        threads.push_back(std::thread([counter]() {
+            for (int j = 0; j < 100000; j++)
+            {
+                counter->Add();
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    Check(counter->Value() == 3200000, "counter sums all shards");
+    Check(reinterpret_cast<uintptr_t>(counter) % METRICS_CACHE_LINE == 0, "counter shards are cache line aligned");
+    Check(MetricsRegistry::Instance().Counter("test_events_total", "Test events", "kind=\"a\"") == counter, "same labels return the same counter");
+    Check(MetricsRegistry::Instance().Gauge("test_events_total", "Test events") == nullptr, "type mismatch returns nullptr");
+}
+
+void TestHistogram()
+{
+    std::vector<uint64_t> bounds;
+    bounds.push_back(10);
+    bounds.push_back(100);
+    MetricHistogram *histogram = MetricsRegistry::Instance().Histogram("test_latency_seconds", "Test latency", bounds, 1e-3);
+    std::vector<uint64_t> buckets;
+    uint64_t sum = 0;
+
+    histogram->Observe(5);
+    histogram->Observe(10);
+    histogram->Observe(50);
+    histogram->Observe(1000);
+    Check(histogram->Snapshot(&buckets, &sum) == 4, "histogram count");
+    Check((buckets.size() == 3) && (buckets[0] == 2) && (buckets[1] == 1) && (buckets[2] == 1), "histogram buckets");
+    Check(sum == 1065, "histogram sum");
+    Check(reinterpret_cast<uintptr_t>(histogram) % METRICS_CACHE_LINE == 0, "histogram shards are cache line aligned");
+}
+
+void TestExpose()
+{
+    MetricsRegistry &registry = MetricsRegistry::Instance();
+    int owner = 0;
+    std::string text;
+
+    registry.Gauge("test_connections", "Test connections", registry.Label("loop", "0"))->Set(3);
+    registry.AddCallback("test_queue_size", "Test queue", registry.Label("name", "q\"1"), []() { return 7.0; }, &owner);
+    registry.Expose(&text);
+    std::cout << text;
+
+    Check(Contains(text, "# TYPE test_events_total counter\ntest_events_total{kind=\"a\"} 3200000\n"), "counter exposition");
+    Check(Contains(text, "# TYPE test_connections gauge\ntest_connections{loop=\"0\"} 3\n"), "gauge exposition");
+    Check(Contains(text, "test_queue_size{name=\"q\\\"1\"} 7\n"), "callback exposition with escaped label");
+    Check(Contains(text, "test_latency_seconds_bucket{le=\"0.01\"} 2\n"), "first bucket is cumulative and scaled");
+    Check(Contains(text, "test_latency_seconds_bucket{le=\"0.1\"} 3\n"), "second bucket is cumulative");
+    Check(Contains(text, "test_latency_seconds_bucket{le=\"+Inf\"} 4\n"), "+Inf bucket");
+    Check(Contains(text, "test_latency_seconds_sum 1.065"), "sum is scaled");
+    Check(Contains(text, "test_latency_seconds_count 4\n"), "histogram count");
+
+    registry.RemoveCallbacks(&owner);
+    text.clear();
+    registry.Expose(&text);
+    Check(!Contains(text, "test_queue_size"), "removed callbacks are not exposed");
+}
+
+int main(int argc, char *argv[])
+{
+    TestCounter();
+    TestHistogram();
+    TestExpose();
+
+    return TestResult();
+}
@@ -0,0 +1,65 @@
+/**
+ * @file test_check.h
+ * @brief 单元测试共用的检查函数
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 23:48:16
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 23:48:16 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 合并各个测试中重复的检查函数 </td>
+ * </tr>
+ * </table>
+ * @details 每个测试是单独的可执行文件，失败时输出说明并继续执行，main 返回 TestResult() 的结果
+ */
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+/**
+ * @brief  失败的检查数量
+ * @return int& 计数
+ */
+inline int &TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+/**
+ * @brief  检查条件，失败时输出说明并计数
+ * @param  condition        条件
+ * @param  message          条件的说明
+ */
+inline void Check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        TestFailures()++;
+        std::cout << "FAILED: " << message << std::endl;
+    }
+}
+
+/**
+ * @brief  输出测试结果
+ * @return int              全部通过时返回0，作为 main 的返回值
+ */
+inline int TestResult()
+{
+    std::cout << ((TestFailures() == 0) ? "all tests passed" : "tests failed") << std::endl;
+    return (TestFailures() == 0) ? 0 : 1;
+}
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,93 @@
+#include <pthread.h>
+#include <string>
+#include <thread>
+
+#include "base_trace.h"
+#include "test_check.h"
+
+using namespace MY_NAME_SPACE;
+
+static bool Contains(const std::string &text, const std::string &line)
+{
+    return text.find(line) != std::string::npos;
+}
+
+static size_t CountOf(const std::string &text, const std::string &item)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(item); pos != std::string::npos; pos = text.find(item, pos + item.length()))
+    {
+        count++;
+    }
+    return count;
+}
+
+/* 关闭时不记录，开启之后只导出开启之后的事件 */
+void TestEnable()
+{
+    std::string text;
+
+    Check(!FrameTrace::IsEnabled(), "disabled by default");
+    {
+        TraceSpan span("before_enable", 1);
+    }
+    FrameTrace::SetEnabled(true);
+    {
+        TraceSpan span("after_enable", 2, "tier", 3);
+    }
+    FrameTrace::SetEnabled(false);
+    {
+        TraceSpan span("after_disable", 4);
+    }
+    FrameTrace::ExportChromeTrace(&text);
+
+    Check(!Contains(text, "before_enable"), "spans are not recorded while disabled");
+    Check(!Contains(text, "after_disable"), "spans are not recorded after disable");
+    Check(Contains(text, "\"name\":\"after_enable\",\"cat\":\"frame\",\"ph\":\"X\""), "complete event exported");
+    Check(Contains(text, "\"args\":{\"frame\":2,\"tier\":3}"), "frame id and argument exported");
+}
+
+/* 每个线程独立的缓冲区，缓冲区满之后只保留最近的事件 */
+void TestThreads()
+{
+    std::string text;
+
+    FrameTrace::SetEnabled(true);
+    std::thread worker([]() {
+        pthread_setname_np(pthread_self(), "trace\"worker");
+        for (int i = 0; i < TRACE_BUFFER_EVENTS + 100; i++)
+        {
+            int64_t now = FrameTrace::Now();
+            FrameTrace::Record("worker", static_cast<uint64_t>(i), now, now);
+        }
+    });
+    worker.join();
+    FrameTrace::Record("main", 7, FrameTrace::Now(), FrameTrace::Now());
+    FrameTrace::ExportChromeTrace(&text);
+    FrameTrace::SetEnabled(false);
+
+    Check(Contains(text, "\"args\":{\"name\":\"trace\\\"worker\"}"), "thread name is escaped");
+    // 导出时丢弃可能正在写入的下一个位置，满的缓冲区少一个事件
+    Check(CountOf(text, "\"name\":\"worker\"") == TRACE_BUFFER_EVENTS - 1, "ring buffer keeps the newest events");
+    Check(Contains(text, "\"frame\":" + std::to_string(TRACE_BUFFER_EVENTS + 99) + "}"), "newest worker event exported");
+    Check(!Contains(text, "\"frame\":99}"), "oldest worker events overwritten");
+    Check(CountOf(text, "\"name\":\"main\"") == 1, "main thread event exported");
+}
+
+void TestFrameId()
+{
+    uint64_t first = FrameTrace::NextFrameId();
+    uint64_t second = FrameTrace::NextFrameId();
+
+    Check(first != 0, "frame ids start from 1");
+    Check(second == first + 1, "frame ids increase");
+}
+
+int main(int argc, char *argv[])
+{
+    TestEnable();
+    TestThreads();
+    TestFrameId();
+
+    return TestResult();
+}
@@ -0,0 +1,635 @@
+/**
+ * @file micro_bench.cpp
+ * @brief 热点函数和基础数据结构的微基准测试
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 19:12:08
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 19:12:08 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 颜色转换、编码、拷贝、绘制、HTTP解析、Buffer、环形队列、定时器和异步日志 </td>
+ * </tr>
+ * </table>
+ * @details
+ *  每个用例先按照 --min-time 估计迭代次数，再重复 --repeat 次，输出每次操作耗时的中位数和最小值。
+ *  用例的顺序、名称和参数固定，json结果可以直接在不同提交之间比较；--filter 只运行名称包含指定字符串的用例。
+ *
+ *  用法: micro_bench [--filter=jpeg] [--min-time=0.2] [--repeat=5] [--output=result.json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_ring_buffer.h"
+#include "image.h"
+#include "image_drawer.h"
+#include "image_scaler.h"
+#include "jpeg_decoder.h"
+#include "image_memory.h"
+#include "jpeg_encoder.h"
+#include "jpeg_overlay.h"
+#include "overlay_tile.h"
+#include "v4l2_tools.h"
+#include "async_logging.h"
+#include "logging.h"
+#include "net_buffer.h"
+#include "net_event_loop.h"
+#include "net_http_context.h"
+
+using namespace MY_NAME_SPACE;
+using namespace MY_NAME_SPACE::net;
+
+/**
+ * @brief 命令行参数
+ */
+struct BenchOptions
+{
+    std::string Filter;     ///< 只运行名称包含该字符串的用例
+    double MinTime = 0.2;   ///< 每次测量的最短时间(秒)
+    uint32_t Repeat = 5;    ///< 测量次数
+    std::string Output;     ///< 结果文件，为空时输出到标准输出
+};
+
+/**
+ * @brief 单个用例的结果
+ */
+struct BenchResult
+{
+    std::string Name;        ///< 用例名称
+    std::string Params;      ///< 参数，json对象
+    uint64_t Iterations;     ///< 每次测量的迭代次数
+    double MedianNs;         ///< 每次操作耗时的中位数(纳秒)
+    double MinNs;            ///< 每次操作耗时的最小值(纳秒)
+    double BytesPerOp;       ///< 每次操作处理的字节数，0 表示不统计
+};
+
+static BenchOptions gOptions;
+static std::vector<BenchResult> gResults;
+
+/* 防止编译器优化掉结果 */
+static volatile uint64_t gSink = 0;
+
+/**
+ * @brief 运行一个用例
+ * @param  name             用例名称
+ * @param  params           参数，json对象
+ * @param  bytesPerOp       每次操作处理的字节数
+ * @param  body             执行 n 次操作
+ */
+static void Run(const std::string &name, const std::string &params, double bytesPerOp,
+                const std::function<void(uint64_t)> &body)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    if ((!gOptions.Filter.empty()) && (name.find(gOptions.Filter) == std::string::npos))
+    {
+        return;
+    }
+
+    // 预热并估计迭代次数，每次翻倍直到超过最短时间的十分之一
+    uint64_t iterations = 1;
+    while (true)
+    {
+        Clock::time_point start = Clock::now();
+        body(iterations);
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= gOptions.MinTime / 10)
+        {
+            iterations = std::max<uint64_t>(1, static_cast<uint64_t>(iterations * gOptions.MinTime / elapsed));
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < gOptions.Repeat; i++)
+    {
+        Clock::time_point start = Clock::now();
+        body(iterations);
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.Name = name;
+    result.Params = params;
+    result.Iterations = iterations;
+    result.MedianNs = samples[samples.size() / 2];
+    result.MinNs = samples.front();
+    result.BytesPerOp = bytesPerOp;
+    gResults.push_back(result);
+    std::cerr << name << " " << params << ": " << result.MedianNs << " ns/op" << std::endl;
+}
+
+static std::string SizeParams(int32_t width, int32_t height)
+{
+    return "{\"width\":" + std::to_string(width) + ",\"height\":" + std::to_string(height) + "}";
+}
+
+/* 生成带有噪声的渐变图像，接近摄像头画面的压缩率 */
+static void FillImage(const std::shared_ptr<Image> &image)
+{
+    uint32_t seed = 1;
+    int32_t lineSize = image->Width() * static_cast<int32_t>(ImageBitsPerPixel(image->Format()) / 8);
+
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            row[x] = static_cast<uint8_t>(((x / 3 + y) & 0xFF) + ((seed >> 16) & 0x0F));
+        }
+    }
+}
+
+static void BenchYuyvToRgb()
+{
+    const int32_t sizes[][2] = {{640, 480}, {1280, 720}, {1920, 1080}};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        int32_t width = sizes[i][0], height = sizes[i][1];
+        std::vector<uint8_t> yuyv(width * height * 2);
+        std::shared_ptr<Image> rgb = Image::Allocate(width, height, PixelFormat::RGB24);
+        for (size_t j = 0; j < yuyv.size(); j++)
+        {
+            yuyv[j] = static_cast<uint8_t>(j * 7);
+        }
+        Run("yuyv_to_rgb", SizeParams(width, height), static_cast<double>(yuyv.size()), [&](uint64_t n) {
+            for (uint64_t k = 0; k < n; k++)
+            {
+                DecodeYuyvToRgb(&yuyv[0], rgb->Data(), width, height, rgb->Stride());
+            }
+        });
+    }
+}
+
+static void BenchJpegEncode()
+{
+    const int32_t sizes[][2] = {{320, 180}, {640, 480}, {1280, 720}, {1920, 1080}};
+    const uint16_t qualities[] = {50, 85};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        int32_t width = sizes[i][0], height = sizes[i][1];
+        std::shared_ptr<Image> image = Image::Allocate(width, height, PixelFormat::RGB24);
+        FillImage(image);
+        for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++)
+        {
+            JpegEncoder encoder(qualities[q]);
+            uint32_t capacity = static_cast<uint32_t>(width * height * 3);
+            uint8_t *buffer = static_cast<uint8_t *>(malloc(capacity));
+            std::string params = "{\"width\":" + std::to_string(width) + ",\"height\":" + std::to_string(height) +
+                                 ",\"quality\":" + std::to_string(qualities[q]) + "}";
+            Run("jpeg_encode", params, static_cast<double>(width * height * 3), [&](uint64_t n) {
+                for (uint64_t k = 0; k < n; k++)
+                {
+                    uint32_t size = capacity;
+                    encoder.EncodeToMemory(image, &buffer, &size);
+                    gSink += size;
+                }
+            });
+            free(buffer);
+        }
+    }
+}
+
+/* MJPEG帧叠加时间戳：有重启标记时只重新编码时间戳所在的MCU行，没有时完整解码和编码 */
+static void BenchJpegOverlay()
+{
+    std::shared_ptr<Image> image = Image::Allocate(1280, 720, PixelFormat::RGB24);
+    std::string text = "26/10/19 22:31:05";
+    Argb color, background;
+    ImagePool pool(8);
+
+    FillImage(image);
+    color.argb = 0xFFFFFFFF;
+    background.argb = 0xFF000000;
+    for (int restart = 1; restart >= 0; restart--)
+    {
+        JpegEncoder encoder(85);
+        JpegOverlay overlay(85);
+        std::shared_ptr<EncodedFrame> source;
+
+        encoder.SetRestartRows(static_cast<uint16_t>(restart));
+        encoder.EncodeToFrame(image, pool, source);
+        Run("jpeg_overlay", std::string("{\"width\":1280,\"height\":720,\"restart_rows\":") + std::to_string(restart) + "}",
+            static_cast<double>(source->Size()), [&](uint64_t n) {
+                for (uint64_t k = 0; k < n; k++)
+                {
+                    std::shared_ptr<EncodedFrame> output;
+                    overlay.Apply(source, text, color, background, 0, 0, pool, output);
+                    gSink += output->Size();
+                }
+            });
+    }
+}
+
+/* MJPEG摄像头生成缩略图：在IDCT中缩小解码，1/8 时每个块只计算直流分量 */
+static void BenchJpegDecode()
+{
+    std::shared_ptr<Image> image = Image::Allocate(1280, 720, PixelFormat::RGB24);
+    JpegEncoder encoder(85);
+    std::shared_ptr<EncodedFrame> frame;
+    ImagePool pool(8);
+    const uint32_t scales[] = {1, 2, 4, 8};
+
+    FillImage(image);
+    encoder.EncodeToFrame(image, pool, frame);
+    for (size_t i = 0; i < sizeof(scales) / sizeof(scales[0]); i++)
+    {
+        JpegDecoder decoder(scales[i]);
+        std::shared_ptr<Image> decoded;
+        Run("jpeg_decode", "{\"width\":1280,\"height\":720,\"scale\":" + std::to_string(scales[i]) + "}",
+            static_cast<double>(frame->Size()), [&](uint64_t n) {
+                for (uint64_t k = 0; k < n; k++)
+                {
+                    decoder.DecodeFrame(frame, pool, decoded);
+                    gSink += decoded->Width();
+                }
+            });
+    }
+}
+
+/* 预览和裁剪流的缩放：2/4倍均值缩小，以及均值缩小之后双线性缩放到任意宽度 */
+static void BenchImageScale()
+{
+    std::shared_ptr<Image> image = Image::Allocate(1280, 720, PixelFormat::RGB24);
+    FillImage(image);
+    const uint32_t factors[] = {2, 4};
+
+    for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++)
+    {
+        uint32_t factor = factors[i];
+        std::shared_ptr<Image> scaled = Image::Allocate(1280 / factor, 720 / factor, PixelFormat::RGB24);
+        Run("image_downscale", "{\"width\":1280,\"height\":720,\"factor\":" + std::to_string(factor) + "}", 1280.0 * 720 * 3,
+            [&](uint64_t n) {
+                for (uint64_t k = 0; k < n; k++)
+                {
+                    ImageScaler::Downscale(image, scaled, factor);
+                }
+            });
+    }
+
+    std::shared_ptr<Image> box = Image::Allocate(640, 360, PixelFormat::RGB24);
+    std::shared_ptr<Image> resized = Image::Allocate(500, 281, PixelFormat::RGB24);
+    Run("image_resize", "{\"width\":1280,\"height\":720,\"target_width\":500}", 1280.0 * 720 * 3, [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k++)
+        {
+            ImageScaler::Downscale(image, box, 2);
+            ImageScaler::Resize(box, resized);
+        }
+    });
+}
+
+/* 普通内存和大页内存的拷贝，大页减少TLB缺失 */
+static void BenchImageCopy()
+{
+    const int32_t sizes[][2] = {{1280, 720}, {1920, 1080}};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        int32_t width = sizes[i][0], height = sizes[i][1];
+        for (int hugePages = 0; hugePages < 2; hugePages++)
+        {
+            ImageMemoryOptions memory(hugePages != 0);
+            std::shared_ptr<Image> src = Image::Allocate(width, height, PixelFormat::RGB24, false, memory);
+            std::shared_ptr<Image> dst = Image::Allocate(width, height, PixelFormat::RGB24, false, memory);
+            FillImage(src);
+            FillImage(dst);
+            std::string params = "{\"width\":" + std::to_string(width) + ",\"height\":" + std::to_string(height) +
+                                 ",\"huge_pages\":" + (hugePages ? "true" : "false") + "}";
+            Run("image_copy", params, static_cast<double>(width * height * 3), [&](uint64_t n) {
+                for (uint64_t k = 0; k < n; k++)
+                {
+                    src->CopyData(dst);
+                }
+            });
+        }
+    }
+}
+
+static void BenchPutText()
+{
+    std::shared_ptr<Image> image = Image::Allocate(1280, 720, PixelFormat::RGB24, true);
+    std::string text = "2026-10-19 19:12:08 CAM0 30.0 fps";
+    Argb color, background;
+
+    color.argb = 0xFFFFFFFF;
+    background.argb = 0xFF000000;
+    Run("put_text", "{\"width\":1280,\"height\":720,\"chars\":" + std::to_string(text.size()) + "}", 0, [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k++)
+        {
+            ImageDrawer::PutText(image, text, 0, 0, color, background);
+        }
+    });
+
+    OverlayTile tile;
+    tile.Render(text, color, background, image->Format());
+    Run("overlay_blend", "{\"width\":1280,\"height\":720,\"chars\":" + std::to_string(text.size()) + "}", 0, [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k++)
+        {
+            tile.Blend(image, 0, 0);
+        }
+    });
+}
+
+static void BenchHttpParse()
+{
+    const std::string request =
+        "GET /camera/mjpeg?fps=15 HTTP/1.1\r\n"
+        "Host: 192.168.58.143:8000\r\n"
+        "Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/85.0.4183.83 Safari/537.36\r\n"
+        "Accept: image/avif,image/webp,image/apng,image/*,*/*;q=0.8\r\n"
+        "Referer: http://192.168.58.143:8000/index.html\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: en-US,en;q=0.9,zh-CN;q=0.8,zh;q=0.7\r\n"
+        "\r\n";
+    HttpContext context;
+    Buffer buf;
+    Timestamp now = Timestamp::now();
+
+    Run("http_parse_request", "{\"bytes\":" + std::to_string(request.size()) + "}", static_cast<double>(request.size()), [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k++)
+        {
+            buf.append(request.data(), request.size());
+            context.parseRequest(&buf, now);
+            gSink += context.gotAll();
+            context.reset();
+            buf.retrieveAll();
+        }
+    });
+}
+
+static void BenchBuffer()
+{
+    const size_t chunk = 1024;
+    const size_t chunks = 16;
+    std::vector<char> data(chunk, 'x');
+    Buffer buf;
+
+    Run("buffer_append_retrieve", "{\"chunk\":1024,\"chunks\":16}", static_cast<double>(chunk * chunks), [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k++)
+        {
+            for (size_t c = 0; c < chunks; c++)
+            {
+                buf.append(&data[0], chunk);
+            }
+            for (size_t c = 0; c < chunks; c++)
+            {
+                buf.retrieve(chunk);
+            }
+        }
+    });
+
+    // 包括对端 write 的系统调用开销
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        return;
+    }
+    const size_t payload = 16 * 1024;
+    std::vector<char> out(payload, 'y');
+    Buffer input;
+    Run("buffer_read_fd", "{\"bytes\":16384}", static_cast<double>(payload), [&](uint64_t n) {
+        int savedErrno = 0;
+        for (uint64_t k = 0; k < n; k++)
+        {
+            gSink += static_cast<uint64_t>(write(fds[0], &out[0], payload));
+            size_t received = 0;
+            while (received < payload)
+            {
+                ssize_t bytes = input.readFd(fds[1], &savedErrno);
+                if (bytes <= 0)
+                {
+                    break;
+                }
+                received += static_cast<size_t>(bytes);
+            }
+            input.retrieveAll();
+        }
+    });
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void BenchRingBuffer()
+{
+    static BaseSimpleRingBuffer<uint64_t, 1024> ring;
+
+    Run("ring_buffer_push_pop", "{\"capacity\":1024,\"threads\":1}", 0, [&](uint64_t n) {
+        uint64_t value = 0;
+        for (uint64_t k = 0; k < n; k++)
+        {
+            ring.push(k);
+            ring.pop(value);
+        }
+        gSink += value;
+    });
+
+    // 单生产者单消费者，每次操作为一个元素经过队列
+    Run("ring_buffer_spsc", "{\"capacity\":1024,\"threads\":2}", 0, [&](uint64_t n) {
+        std::thread consumer([n]() {
+            uint64_t value = 0;
+            for (uint64_t received = 0; received < n;)
+            {
+                if (ring.pop(value))
+                {
+                    received++;
+                }
+            }
+            gSink += value;
+        });
+        for (uint64_t k = 0; k < n;)
+        {
+            if (ring.push(k))
+            {
+                k++;
+            }
+        }
+        consumer.join();
+    });
+}
+
+/* 在事件循环线程中添加和取消定时器，不运行事件循环 */
+static void BenchTimerQueue()
+{
+    EventLoop loop;
+    std::vector<TimerId> timers;
+
+    Run("timer_add_cancel", "{\"pending\":1000}", 0, [&](uint64_t n) {
+        for (uint64_t k = 0; k < n; k++)
+        {
+            timers.push_back(loop.runAfter(60 + (k % 1000) * 0.001, []() {}));
+            if (timers.size() >= 1000)
+            {
+                for (size_t t = 0; t < timers.size(); t++)
+                {
+                    loop.cancel(timers[t]);
+                }
+                timers.clear();
+            }
+        }
+    });
+    for (size_t t = 0; t < timers.size(); t++)
+    {
+        loop.cancel(timers[t]);
+    }
+}
+
+static void RemoveDirectory(const std::string &path)
+{
+    DIR *dir = opendir(path.c_str());
+    if (dir != nullptr)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            if (entry->d_name[0] != '.')
+            {
+                unlink((path + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+}
+
+/* 前端写入的吞吐，后端线程把日志写入临时目录 */
+static void BenchAsyncLogging()
+{
+    char dir[] = "/tmp/micro_bench_XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+    {
+        return;
+    }
+    // LogFile 只接受文件名，日志写入当前目录
+    char cwd[4096];
+    if ((getcwd(cwd, sizeof(cwd)) == nullptr) || (chdir(dir) != 0))
+    {
+        rmdir(dir);
+        return;
+    }
+    std::string line(100, 'l');
+    line += '\n';
+    {
+        AsyncLogging logging("micro_bench", 64 * 1024 * 1024);
+        logging.start();
+        Run("async_logging_append", "{\"line_bytes\":101}", static_cast<double>(line.size()), [&](uint64_t n) {
+            for (uint64_t k = 0; k < n; k++)
+            {
+                logging.append(line.data(), static_cast<int>(line.size()));
+            }
+        });
+        logging.stop();
+    }
+    if (chdir(cwd) != 0)
+    {
+        std::cerr << "failed to restore working directory" << std::endl;
+    }
+    RemoveDirectory(dir);
+}
+
+static bool ParseArguments(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--filter=", 9) == 0)
+        {
+            gOptions.Filter = arg + 9;
+        }
+        else if (strncmp(arg, "--min-time=", 11) == 0)
+        {
+            gOptions.MinTime = atof(arg + 11);
+        }
+        else if (strncmp(arg, "--repeat=", 9) == 0)
+        {
+            gOptions.Repeat = static_cast<uint32_t>(std::max(1, atoi(arg + 9)));
+        }
+        else if (strncmp(arg, "--output=", 9) == 0)
+        {
+            gOptions.Output = arg + 9;
+        }
+        else
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return gOptions.MinTime > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!ParseArguments(argc, argv))
+    {
+        return 2;
+    }
+    Logger::setLogLevel(Logger::ERROR);
+
+    BenchYuyvToRgb();
+    BenchJpegEncode();
+    BenchJpegOverlay();
+    BenchJpegDecode();
+    BenchImageScale();
+    BenchImageCopy();
+    BenchPutText();
+    BenchHttpParse();
+    BenchBuffer();
+    BenchRingBuffer();
+    BenchTimerQueue();
+    BenchAsyncLogging();
+
+    std::string result = "{\n  \"benchmark\":\"micro_bench\",\n  \"min_time\":" + std::to_string(gOptions.MinTime) +
+                         ",\n  \"repeat\":" + std::to_string(gOptions.Repeat) + ",\n  \"results\":[";
+    char item[512];
+    for (size_t i = 0; i < gResults.size(); i++)
+    {
+        const BenchResult &r = gResults[i];
+        double opsPerSecond = 1e9 / r.MedianNs;
+        snprintf(item, sizeof(item), "%s\n    {\"name\":\"%s\",\"params\":%s,\"iterations\":%llu,\"ns_per_op\":%.1f,\"ns_per_op_min\":%.1f,\"ops_per_second\":%.1f,\"bytes_per_second\":%.0f}",
+                 (i == 0) ? "" : ",", r.Name.c_str(), r.Params.c_str(), static_cast<unsigned long long>(r.Iterations),
+                 r.MedianNs, r.MinNs, opsPerSecond, r.BytesPerOp * opsPerSecond);
+        result += item;
+    }
+    result += "\n  ]\n}\n";
+
+    if (gOptions.Output.empty())
+    {
+        std::cout << result;
+    }
+    else
+    {
+        std::ofstream file(gOptions.Output.c_str());
+        file << result;
+    }
+    return 0;
+}
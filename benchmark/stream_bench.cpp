@@ -0,0 +1,681 @@
+/**
+ * @file stream_bench.cpp
+ * @brief 端到端推流压力测试，统计每个客户端的帧率、延迟、流量和服务器CPU
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 18:40:26
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 18:40:26 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> mjpeg/jpeg 多客户端压力测试 </td>
+ * </tr>
+ * </table>
+ * @details
+ *  默认在进程内启动服务器，视频源为 SyntheticVideoSource；指定 --server 时测试外部服务器，
+ *  --pid 指定外部服务器的进程号用于统计CPU。客户端基于 TcpClient，分布在 --client-threads 个事件循环中。
+ *  延迟为收到完整帧的时间减去帧头部 X-Timestamp 中的采集时间，只在服务器和客户端时钟一致时有意义。
+ *  结果以json格式输出到标准输出或者 --output 指定的文件。
+ *
+ *  用法: stream_bench [--mode=mjpeg|jpeg] [--clients=10] [--seconds=10] [--warmup=2]
+ *                     [--server=host:port] [--pid=PID] [--path=/camera/mjpeg]
+ *                     [--width=640] [--height=480] [--fps=30] [--format=rgb|yuyv|jpeg|nv12|i420|grey] [--quality=70]
+ *                     [--encoder-threads=1] [--server-threads=2] [--client-threads=2] [--port=18080]
+ *                     [--output=result.json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logging.h"
+#include "time_stamp.h"
+#include "net_buffer.h"
+#include "net_event_loop.h"
+#include "net_event_loop_threadpool.h"
+#include "net_inet_address.h"
+#include "net_tcp_client.h"
+#include "net_tcp_connection.h"
+#include "synthetic_video_source.h"
+#include "video_source_to_web.h"
+#include "web_camera_server.h"
+
+using namespace MY_NAME_SPACE;
+using namespace MY_NAME_SPACE::net;
+
+/**
+ * @brief 命令行参数
+ */
+struct BenchOptions
+{
+    std::string Mode = "mjpeg";       ///< mjpeg：持续的视频流；jpeg：循环请求单张图片
+    uint32_t Clients = 10;            ///< 并发客户端数量
+    uint32_t Seconds = 10;            ///< 统计时长(秒)
+    uint32_t Warmup = 2;              ///< 预热时长(秒)，期间收到的帧不计入结果
+    std::string Host = "127.0.0.1";   ///< 服务器地址
+    uint16_t Port = 18080;            ///< 服务器端口
+    bool External = false;            ///< 是否测试外部服务器
+    pid_t ServerPid = 0;              ///< 外部服务器的进程号
+    std::string Path;                 ///< 请求路径，默认 /camera/{mode}
+    uint32_t Width = 640;             ///< 合成图像宽度
+    uint32_t Height = 480;            ///< 合成图像高度
+    uint32_t FrameRate = 30;          ///< 合成图像帧率，0 表示不限速
+    std::string Format = "rgb";       ///< 合成图像格式
+    uint16_t Quality = 70;            ///< jpeg压缩质量
+    uint32_t EncoderThreads = 1;      ///< 服务器编码线程数量
+    uint32_t ServerThreads = 2;       ///< 服务器IO线程数量
+    uint32_t ClientThreads = 2;       ///< 客户端事件循环数量
+    std::string Output;               ///< 结果文件，为空时输出到标准输出
+};
+
+/**
+ * @brief 单个客户端的统计
+ */
+struct ClientStats
+{
+    uint64_t Frames = 0;                ///< 统计区间内收到的不同帧数
+    uint64_t Responses = 0;             ///< 统计区间内收到的图片数，包括重复的帧
+    uint64_t Bytes = 0;                 ///< 统计区间内收到的jpeg字节数
+    uint64_t Retries = 0;               ///< 503等非200响应的次数
+    uint32_t Connects = 0;              ///< 建立连接的次数
+    uint32_t Disconnects = 0;           ///< 意外断开的次数
+    std::vector<double> Latencies;      ///< 每一帧的延迟(毫秒)
+};
+
+static int64_t NowMicroseconds()
+{
+    return Timestamp::now().microSecondsSinceEpoch();
+}
+
+/* 在头部中查找字段，名称不区分大小写 */
+static std::string HeaderValue(const std::string &headers, const char *name)
+{
+    size_t nameLength = strlen(name);
+    size_t pos = 0;
+
+    while ((pos = headers.find("\r\n", pos)) != std::string::npos)
+    {
+        pos += 2;
+        if ((strncasecmp(headers.c_str() + pos, name, nameLength) == 0) && (headers[pos + nameLength] == ':'))
+        {
+            size_t begin = headers.find_first_not_of(' ', pos + nameLength + 1);
+            size_t end = headers.find("\r\n", pos);
+            if ((begin == std::string::npos) || (begin > end))
+            {
+                return std::string();
+            }
+            return headers.substr(begin, end - begin);
+        }
+    }
+    return std::string();
+}
+
+/**
+ * @brief 压力测试客户端
+ * @details 所有回调都在所属的事件循环线程中，统计数据用锁保护以便主线程读取
+ */
+class BenchClient
+{
+public:
+    BenchClient(EventLoop *loop, const InetAddress &address, int id, const BenchOptions &options,
+                const std::atomic<int64_t> &measureStart)
+        : mLoop(loop),
+          mClient(loop, address, "BenchClient" + std::to_string(id)),
+          mOptions(options),
+          mMeasureStart(measureStart),
+          mState(State::ResponseHeader),
+          mBodyLength(0),
+          mStatus(0),
+          mTimestamp(0),
+          mLastTimestamp(0),
+          mStopping(false),
+          mSync(),
+          mStats()
+    {
+        mClient.setConnectionCallback(std::bind(&BenchClient::OnConnection, this, _1));
+        mClient.setMessageCallback(std::bind(&BenchClient::OnMessage, this, _1, _2, _3));
+    }
+
+    void Start()
+    {
+        mClient.connect();
+    }
+
+    void Stop()
+    {
+        mStopping = true;
+        TcpConnectionPtr conn = mClient.connection();
+        if (conn)
+        {
+            conn->forceClose();
+        }
+    }
+
+    ClientStats Snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mSync);
+        return mStats;
+    }
+
+private:
+    enum class State
+    {
+        ResponseHeader, ///< 等待HTTP响应头部
+        PartHeader,     ///< 等待multipart分段头部
+        Body,           ///< 等待jpeg数据
+    };
+
+    void OnConnection(const TcpConnectionPtr &conn)
+    {
+        std::lock_guard<std::mutex> lock(mSync);
+        if (conn->connected())
+        {
+            mStats.Connects++;
+            mState = State::ResponseHeader;
+            SendRequest(conn);
+        }
+        else
+        {
+            if (!mStopping)
+            {
+                mStats.Disconnects++;
+            }
+            // TcpConnection::handleClose 不会调用关闭回调，需要自己把连接从事件循环中移除，否则析构时断言失败
+            mLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        }
+    }
+
+    void SendRequest(const TcpConnectionPtr &conn)
+    {
+        conn->send("GET " + mOptions.Path + " HTTP/1.1\r\nHost: " + mOptions.Host + "\r\nConnection: Keep-Alive\r\n\r\n");
+    }
+
+    void OnMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+    {
+        std::lock_guard<std::mutex> lock(mSync);
+
+        while (true)
+        {
+            if (mState == State::Body)
+            {
+                if (buf->readableBytes() < mBodyLength)
+                {
+                    return;
+                }
+                buf->retrieve(mBodyLength);
+                OnBody(conn, receiveTime);
+                continue;
+            }
+
+            const char *begin = buf->peek();
+            const char *end = begin + buf->readableBytes();
+            const char *crlf2 = std::search(begin, end, "\r\n\r\n", "\r\n\r\n" + 4);
+            if (crlf2 == end)
+            {
+                return;
+            }
+            // 分段头部之前有上一帧结尾的换行，保留 "\r\n" 前缀方便查找字段
+            std::string headers = "\r\n" + std::string(begin, crlf2 + 2);
+            buf->retrieveUntil(crlf2 + 4);
+
+            if (mState == State::ResponseHeader)
+            {
+                size_t space = headers.find(' ');
+                mStatus = (space == std::string::npos) ? 0 : atoi(headers.c_str() + space + 1);
+                if ((mOptions.Mode == "mjpeg") && (mStatus == 200))
+                {
+                    mState = State::PartHeader;
+                    continue;
+                }
+            }
+            mBodyLength = static_cast<size_t>(atoll(HeaderValue(headers, "Content-Length").c_str()));
+            std::string timestamp = HeaderValue(headers, "X-Timestamp");
+            mTimestamp = timestamp.empty() ? 0 : static_cast<int64_t>(atof(timestamp.c_str()) * 1000);
+            mState = State::Body;
+        }
+    }
+
+    void OnBody(const TcpConnectionPtr &conn, Timestamp receiveTime)
+    {
+        int64_t now = receiveTime.microSecondsSinceEpoch();
+        bool measuring = (mMeasureStart > 0) && (now >= mMeasureStart);
+
+        // 单张图片模式会多次收到同一帧，按照采集时间只统计新的帧，延迟为第一次收到的时间
+        if ((mStatus == 200) && (measuring))
+        {
+            mStats.Responses++;
+            mStats.Bytes += mBodyLength;
+            if ((mTimestamp == 0) || (mTimestamp != mLastTimestamp))
+            {
+                mStats.Frames++;
+                if (mTimestamp > 0)
+                {
+                    mStats.Latencies.push_back((now - mTimestamp) / 1000.0);
+                }
+            }
+        }
+        else if (measuring)
+        {
+            mStats.Retries++;
+        }
+        if (mStatus == 200)
+        {
+            mLastTimestamp = mTimestamp;
+        }
+
+        if (mOptions.Mode == "mjpeg")
+        {
+            mState = (mStatus == 200) ? State::PartHeader : State::ResponseHeader;
+            return;
+        }
+        // 单张图片模式收到响应之后立即发送下一个请求，服务器还没有图像时稍后重试
+        mState = State::ResponseHeader;
+        if (mStatus == 200)
+        {
+            SendRequest(conn);
+        }
+        else
+        {
+            std::weak_ptr<TcpConnection> weakConn(conn);
+            mLoop->runAfter(0.01, [this, weakConn]() {
+                TcpConnectionPtr conn = weakConn.lock();
+                if ((conn) && (conn->connected()))
+                {
+                    SendRequest(conn);
+                }
+            });
+        }
+    }
+
+private:
+    EventLoop *mLoop;                           ///< 所属的事件循环
+    TcpClient mClient;                          ///< 连接
+    const BenchOptions &mOptions;               ///< 命令行参数
+    const std::atomic<int64_t> &mMeasureStart;  ///< 开始统计的时间(微秒)，0 表示预热中
+    State mState;                               ///< 解析状态
+    size_t mBodyLength;                         ///< 当前数据长度
+    int mStatus;                                ///< 当前响应的状态码
+    int64_t mTimestamp;                         ///< 当前帧的采集时间(微秒)
+    int64_t mLastTimestamp;                     ///< 上一帧的采集时间(微秒)
+    std::atomic<bool> mStopping;                ///< 是否正在停止
+    std::mutex mSync;                           ///< 统计数据锁
+    ClientStats mStats;                         ///< 统计数据
+};
+
+/* 进程的CPU时间(秒)，pid为0时为当前进程 */
+static double ProcessCpuSeconds(pid_t pid)
+{
+    if (pid == 0)
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+    // /proc/[pid]/stat 的第14、15项为用户态和内核态时间，进程名中可能有空格，从最后一个')'之后开始解析
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t pos = content.rfind(')');
+    unsigned long utime = 0, stime = 0;
+    if ((pos == std::string::npos) ||
+        (sscanf(content.c_str() + pos + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2))
+    {
+        return 0;
+    }
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+/* 线程的CPU时间(秒) */
+static double ThreadCpuSeconds(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0)
+    {
+        return 0;
+    }
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double Percentile(const std::vector<double> &sorted, double percent)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(percent / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/* 运行客户端并输出结果，在独立的线程中运行，进程内服务器使用主线程 */
+static int RunClients(const BenchOptions &options)
+{
+    EventLoop baseLoop;
+    EventLoopThreadPool pool(&baseLoop, "BenchClient");
+    std::mutex clocksGuard;
+    std::vector<clockid_t> clientClocks;
+    std::atomic<int64_t> measureStart(0);
+    std::vector<std::unique_ptr<BenchClient> > clients;
+    InetAddress address(options.Host, options.Port);
+
+    // 记录客户端线程的CPU时钟，进程内测试时从进程CPU时间中扣除
+    pool.setThreadNum(static_cast<int>(std::max<uint32_t>(options.ClientThreads, 1)));
+    pool.start([&clocksGuard, &clientClocks](EventLoop *) {
+        clockid_t clock;
+        if (pthread_getcpuclockid(pthread_self(), &clock) == 0)
+        {
+            std::lock_guard<std::mutex> lock(clocksGuard);
+            clientClocks.push_back(clock);
+        }
+    });
+    for (uint32_t i = 0; i < options.Clients; i++)
+    {
+        clients.emplace_back(new BenchClient(pool.getNextLoop(), address, static_cast<int>(i), options, measureStart));
+        clients.back()->Start();
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.Warmup));
+
+    auto cpuUsed = [&]() {
+        double cpu = ProcessCpuSeconds(options.ServerPid);
+        if (!options.External)
+        {
+            std::lock_guard<std::mutex> lock(clocksGuard);
+            for (size_t i = 0; i < clientClocks.size(); i++)
+            {
+                cpu -= ThreadCpuSeconds(clientClocks[i]);
+            }
+        }
+        return cpu;
+    };
+    double cpuStart = cpuUsed();
+    int64_t start = NowMicroseconds();
+    measureStart = start;
+    std::this_thread::sleep_for(std::chrono::seconds(options.Seconds));
+    double cpuEnd = cpuUsed();
+    double elapsed = (NowMicroseconds() - start) / 1e6;
+
+    std::vector<ClientStats> stats;
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        stats.push_back(clients[i]->Snapshot());
+        clients[i]->Stop();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    clients.clear();
+
+    // 汇总
+    std::vector<double> latencies;
+    std::vector<double> clientFps;
+    uint64_t totalFrames = 0, totalResponses = 0, totalBytes = 0, totalRetries = 0;
+    uint32_t disconnects = 0;
+    std::string perClient;
+    char item[256];
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const ClientStats &s = stats[i];
+        double fps = s.Frames / elapsed;
+        double latencySum = 0;
+        for (size_t j = 0; j < s.Latencies.size(); j++)
+        {
+            latencySum += s.Latencies[j];
+        }
+        latencies.insert(latencies.end(), s.Latencies.begin(), s.Latencies.end());
+        clientFps.push_back(fps);
+        totalFrames += s.Frames;
+        totalResponses += s.Responses;
+        totalBytes += s.Bytes;
+        totalRetries += s.Retries;
+        disconnects += s.Disconnects;
+        snprintf(item, sizeof(item), "%s\n    {\"id\":%zu,\"frames\":%llu,\"fps\":%.2f,\"responses_per_second\":%.2f,\"bytes_per_second\":%.0f,\"latency_avg_ms\":%.3f,\"retries\":%llu,\"disconnects\":%u}",
+                 (i == 0) ? "" : ",", i, static_cast<unsigned long long>(s.Frames), fps, s.Responses / elapsed, s.Bytes / elapsed,
+                 s.Latencies.empty() ? 0.0 : latencySum / s.Latencies.size(), static_cast<unsigned long long>(s.Retries), s.Disconnects);
+        perClient += item;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(clientFps.begin(), clientFps.end());
+    double latencyAvg = 0;
+    for (size_t i = 0; i < latencies.size(); i++)
+    {
+        latencyAvg += latencies[i];
+    }
+    latencyAvg = latencies.empty() ? 0 : latencyAvg / latencies.size();
+
+    char summary[2048];
+    snprintf(summary, sizeof(summary),
+             "{\n"
+             "  \"benchmark\":\"stream_bench\",\n"
+             "  \"mode\":\"%s\",\"path\":\"%s\",\"server\":\"%s\",\n"
+             "  \"clients\":%u,\"seconds\":%.3f,\n"
+             "  \"source\":{\"width\":%u,\"height\":%u,\"fps\":%u,\"format\":\"%s\",\"quality\":%u,\"encoder_threads\":%u,\"server_threads\":%u},\n"
+             "  \"fps\":{\"min\":%.2f,\"avg\":%.2f,\"max\":%.2f,\"total\":%.2f},\n"
+             "  \"latency_ms\":{\"samples\":%zu,\"avg\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f},\n"
+             "  \"responses_per_second\":%.2f,\"bytes_per_second\":%.0f,\n"
+             "  \"server_cpu_percent\":%.1f,\n"
+             "  \"retries\":%llu,\"disconnects\":%u,\n"
+             "  \"per_client\":[",
+             options.Mode.c_str(), options.Path.c_str(), options.External ? "external" : "in-process",
+             options.Clients, elapsed,
+             options.Width, options.Height, options.FrameRate, options.Format.c_str(), options.Quality, options.EncoderThreads, options.ServerThreads,
+             clientFps.empty() ? 0.0 : clientFps.front(), clientFps.empty() ? 0.0 : totalFrames / elapsed / clientFps.size(),
+             clientFps.empty() ? 0.0 : clientFps.back(), totalFrames / elapsed,
+             latencies.size(), latencyAvg, Percentile(latencies, 50), Percentile(latencies, 95), Percentile(latencies, 99),
+             latencies.empty() ? 0.0 : latencies.back(),
+             totalResponses / elapsed, totalBytes / elapsed,
+             (cpuEnd - cpuStart) / elapsed * 100,
+             static_cast<unsigned long long>(totalRetries), disconnects);
+    std::string result = std::string(summary) + perClient + "\n  ]\n}\n";
+
+    if (options.Output.empty())
+    {
+        std::cout << result;
+    }
+    else
+    {
+        std::ofstream file(options.Output.c_str());
+        file << result;
+    }
+    return (totalFrames > 0) ? 0 : 1;
+}
+
+static bool ParseOption(const char *arg, const char *name, std::string *value)
+{
+    size_t length = strlen(name);
+    if ((strncmp(arg, name, length) != 0) || (arg[length] != '='))
+    {
+        return false;
+    }
+    *value = arg + length + 1;
+    return true;
+}
+
+static bool ParseArguments(int argc, char *argv[], BenchOptions *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string value;
+        if (ParseOption(argv[i], "--mode", &value))
+        {
+            options->Mode = value;
+        }
+        else if (ParseOption(argv[i], "--clients", &value))
+        {
+            options->Clients = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--seconds", &value))
+        {
+            options->Seconds = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--warmup", &value))
+        {
+            options->Warmup = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--server", &value))
+        {
+            size_t colon = value.rfind(':');
+            options->External = true;
+            options->Host = value.substr(0, colon);
+            if (colon != std::string::npos)
+            {
+                options->Port = static_cast<uint16_t>(atoi(value.c_str() + colon + 1));
+            }
+        }
+        else if (ParseOption(argv[i], "--port", &value))
+        {
+            options->Port = static_cast<uint16_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--pid", &value))
+        {
+            options->ServerPid = static_cast<pid_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--path", &value))
+        {
+            options->Path = value;
+        }
+        else if (ParseOption(argv[i], "--width", &value))
+        {
+            options->Width = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--height", &value))
+        {
+            options->Height = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--fps", &value))
+        {
+            options->FrameRate = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--format", &value))
+        {
+            options->Format = value;
+        }
+        else if (ParseOption(argv[i], "--quality", &value))
+        {
+            options->Quality = static_cast<uint16_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--encoder-threads", &value))
+        {
+            options->EncoderThreads = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--server-threads", &value))
+        {
+            options->ServerThreads = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--client-threads", &value))
+        {
+            options->ClientThreads = static_cast<uint32_t>(atoi(value.c_str()));
+        }
+        else if (ParseOption(argv[i], "--output", &value))
+        {
+            options->Output = value;
+        }
+        else
+        {
+            std::cerr << "unknown option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    if ((options->Mode != "mjpeg") && (options->Mode != "jpeg"))
+    {
+        std::cerr << "mode must be mjpeg or jpeg" << std::endl;
+        return false;
+    }
+    if (options->Path.empty())
+    {
+        options->Path = "/camera/" + options->Mode;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+
+    if (!ParseArguments(argc, argv, &options))
+    {
+        return 2;
+    }
+    // 日志输出到标准错误，标准输出只有json结果
+    Logger::setLogLevel(Logger::WARN);
+    Logger::setOutput([](const char *msg, int len) { fwrite(msg, 1, static_cast<size_t>(len), stderr); });
+
+    if (options.External)
+    {
+        return RunClients(options);
+    }
+
+    // 进程内服务器：合成视频源 -> VideoSourceToWeb -> WebCameraServer，事件循环在主线程中
+    SyntheticFormat format = SyntheticFormat::RGB24;
+    if (options.Format == "yuyv")
+    {
+        format = SyntheticFormat::YUYV;
+    }
+    else if (options.Format == "jpeg")
+    {
+        format = SyntheticFormat::JPEG;
+    }
+    else if (options.Format == "nv12")
+    {
+        format = SyntheticFormat::NV12;
+    }
+    else if (options.Format == "i420")
+    {
+        format = SyntheticFormat::I420;
+    }
+    else if (options.Format == "grey")
+    {
+        format = SyntheticFormat::Grayscale;
+    }
+    std::shared_ptr<SyntheticVideoSource> source = SyntheticVideoSource::Create();
+    VideoSourceToWeb web(options.Quality, options.EncoderThreads);
+    source->SetVideoSize(options.Width, options.Height);
+    source->SetOutputFormat(format);
+    source->SetJpegQuality(options.Quality);
+    source->SetFrameRate(options.FrameRate);
+    source->SetListener(web.VideoSourceListener());
+
+    WebCameraServer server("web", options.Port, "stream_bench", options.ServerThreads);
+    // 不限速的视频源推流时按照60帧发送
+    uint32_t streamRate = (options.FrameRate == 0) ? 60 : options.FrameRate;
+    // 路径中可以带请求参数(例如 ?fps=5)，处理函数只注册路径部分
+    std::string uri = options.Path.substr(0, options.Path.find('?'));
+    server.AddHandler(uri, (options.Mode == "mjpeg") ? web.CreateMjpegHandler(uri, streamRate)
+                                                     : web.CreateJpegHandler(uri));
+    source->Start();
+
+    int result = 1;
+    std::thread bench([&]() {
+        result = RunClients(options);
+        server.Stop();
+    });
+    server.Start();
+    bench.join();
+
+    source->SignalToStop();
+    source->WaitForStop();
+    source->SetListener(nullptr);
+    return result;
+}
@@ -1,3 +1,6 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <algorithm>
 #include "v4l2_camera.h"
 
 NAMESPACE_START
@@ -6,6 +9,58 @@ const std::shared_ptr<V4L2Camera> V4L2Camera::Create( )
     return std::shared_ptr<V4L2Camera>( new V4L2Camera);
 }
 
+// Find all V4L2 devices which are able to capture video
+std::vector<std::string> V4L2Camera::ListDevices( )
+{
+    std::vector<std::pair<uint32_t, std::string> > found;
+    DIR* dir = opendir( "/dev" );
+
+    if ( dir == nullptr )
+    {
+        return std::vector<std::string>( );
+    }
+    for ( struct dirent* entry = readdir( dir ); entry != nullptr; entry = readdir( dir ) )
+    {
+        uint32_t index = 0;
+        char     tail  = 0;
+
+        // 只匹配 videoN
+        if ( sscanf( entry->d_name, "video%u%c", &index, &tail ) != 1 )
+        {
+            continue;
+        }
+
+        std::string name = std::string( "/dev/" ) + entry->d_name;
+        int         fd   = open( name.c_str( ), O_RDWR | O_NONBLOCK | O_CLOEXEC );
+        if ( fd < 0 )
+        {
+            continue;
+        }
+
+        v4l2_capability capability;
+        memset( &capability, 0, sizeof( capability ) );
+        if ( ioctl( fd, VIDIOC_QUERYCAP, &capability ) == 0 )
+        {
+            uint32_t caps = ( capability.capabilities & V4L2_CAP_DEVICE_CAPS ) ? capability.device_caps : capability.capabilities;
+            if ( ( caps & V4L2_CAP_VIDEO_CAPTURE ) && ( caps & V4L2_CAP_STREAMING ) )
+            {
+                found.push_back( std::make_pair( index, name ) );
+            }
+        }
+        close( fd );
+    }
+    closedir( dir );
+
+    std::sort( found.begin( ), found.end( ) );
+    std::vector<std::string> devices;
+    devices.reserve( found.size( ) );
+    for ( size_t i = 0; i < found.size( ); i++ )
+    {
+        devices.push_back( found[i].second );
+    }
+    return devices;
+}
+
 V4L2Camera::V4L2Camera( ):
     mData( new V4L2CameraData( ) )
 {
@@ -99,13 +154,63 @@ void V4L2Camera::SetFrameRate( uint32_t frameRate )
 // Enable/Disable JPEG encoding
 bool V4L2Camera::IsJpegEncodingEnabled( ) const
 {
-    return mData->JpegEncoding;
+    return mData->OutputFormat == PixelFormat::JPEG;
 }
 void V4L2Camera::EnableJpegEncoding( bool enable )
 {
     mData->EnableJpegEncoding( enable );
 }
 
+// Get/Set format of delivered frames
+PixelFormat V4L2Camera::OutputFormat( ) const
+{
+    return mData->OutputFormat;
+}
+void V4L2Camera::SetOutputFormat( PixelFormat format )
+{
+    mData->SetOutputFormat( format );
+}
+PixelFormat V4L2Camera::CaptureFormat( ) const
+{
+    return mData->CaptureFormat;
+}
+
+// Set directory of the capability cache, get capabilities and selected mode
+void V4L2Camera::SetCapabilityCacheDirectory( const std::string& directory )
+{
+    mData->SetCapabilityCacheDirectory( directory );
+}
+std::shared_ptr<const V4L2DeviceCapabilities> V4L2Camera::Capabilities( ) const
+{
+    return mData->GetCapabilities( );
+}
+V4L2CaptureMode V4L2Camera::CaptureMode( ) const
+{
+    return mData->GetCaptureMode( );
+}
+
+// Set how decoded frames are allocated
+void V4L2Camera::SetFrameMemory( bool hugePages, int numaNode )
+{
+    mData->SetFrameMemory( ImageMemoryOptions( hugePages, numaNode ) );
+}
+
+// Set CPUs the capture thread is bound to
+void V4L2Camera::SetCpuAffinity( const std::vector<uint32_t>& cpus )
+{
+    mData->SetCpuAffinity( cpus );
+}
+
+// Pause/Resume streaming while keeping the device open
+void V4L2Camera::SetStreamingPaused( bool paused )
+{
+    mData->SetStreamingPaused( paused );
+}
+bool V4L2Camera::IsStreamingPaused( ) const
+{
+    return mData->IsStreamingPaused( );
+}
+
 // Set the specified video property
 Error V4L2Camera::SetVideoProperty( VideoProperty property, int32_t value )
 {
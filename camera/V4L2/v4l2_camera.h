@@ -51,6 +51,12 @@ public:
      * @return const std::shared_ptr<V4L2Camera>
      */
     static const std::shared_ptr<V4L2Camera> Create();
+    /**
+     * @brief  查找系统中所有支持视频采集的设备
+     * @details UVC摄像头会同时创建元数据设备节点，这些节点不支持视频采集，会被跳过
+     * @return std::vector<std::string> 设备名称，按照设备编号排列，如：/dev/video0
+     */
+    static std::vector<std::string> ListDevices();
 
     /**
      * @brief  相机开始工作
@@ -148,6 +154,65 @@ public:
      * @param  enable           My Param doc
      */
     void EnableJpegEncoding(bool enable);
+    /**
+     * @brief  采集之后输出的格式
+     * @return PixelFormat JPEG 为直接输出MJPEG，Unknown 为自动选择
+     */
+    PixelFormat OutputFormat() const;
+    /**
+     * @brief 设置采集之后输出的格式，需要在启动之前设置
+     * @details
+     *  打开设备时按照设备能力选择满足尺寸和帧率、转换代价最小的模式：JPEG 优先使用MJPEG；
+     *  Unknown 时NV12/I420/灰度直接输出，YUYV 转换为I420；其他格式按照 ImageConverter::ConversionCost 选择
+     * @param  format           JPEG/RGB24/Grayscale8/NV12/I420/Unknown
+     */
+    void SetOutputFormat(PixelFormat format);
+    /**
+     * @brief  协商之后设备输出的格式
+     * @return PixelFormat 设备打开之前为 Unknown
+     */
+    PixelFormat CaptureFormat() const;
+    /**
+     * @brief 设置设备能力的磁盘缓存目录，需要在启动之前设置
+     * @details 设备能力第一次打开时枚举，之后从内存或者磁盘缓存中读取，不再枚举
+     * @param  directory        目录，为空时只使用内存缓存
+     */
+    void SetCapabilityCacheDirectory(const std::string &directory);
+    /**
+     * @brief  设备能力(格式 x 尺寸 x 帧率)
+     * @return std::shared_ptr<const V4L2DeviceCapabilities> 设备打开之前为空
+     */
+    std::shared_ptr<const V4L2DeviceCapabilities> Capabilities() const;
+    /**
+     * @brief  打开设备时选择的采集模式
+     * @return V4L2CaptureMode  请求的格式、尺寸和帧间隔
+     */
+    V4L2CaptureMode CaptureMode() const;
+    /**
+     * @brief 设置YUYV解码之后RGB图像的内存分配方式，需要在启动之前设置
+     * @param  hugePages        是否使用大页
+     * @param  numaNode         NUMA节点，-1 表示不绑定
+     */
+    void SetFrameMemory(bool hugePages, int numaNode = -1);
+    /**
+     * @brief 设置采集线程绑定的CPU，需要在启动之前设置
+     * @param  cpus             CPU编号，为空时不绑定
+     */
+    void SetCpuAffinity(const std::vector<uint32_t> &cpus);
+    /**
+     * @brief 暂停/恢复采集，运行时可以调用
+     * @details
+     *  暂停时设备保持打开并保留所有配置，只关闭视频流(VIDIOC_STREAMOFF)，采集线程不再读取和转换数据；
+     *  恢复时重新开启视频流，比重新打开设备快得多。启动之前设置时只打开设备，直到恢复才开始采集
+     * @param  paused           是否暂停
+     */
+    void SetStreamingPaused(bool paused);
+    /**
+     * @brief  是否暂停采集
+     * @return true  已暂停
+     * @return false 正常采集
+     */
+    bool IsStreamingPaused() const;
 
 public:
     /**
@@ -1,4 +1,6 @@
 #include "v4l2_camera_data.h"
+#include "base_metrics.h"
+#include "base_trace.h"
 #include <iostream>
 NAMESPACE_START
 
@@ -99,6 +101,21 @@ void V4L2CameraData::NotifyNewImage(const std::shared_ptr<const Image> &image)
     }
 }
 
+// 将一帧压缩数据放入监听结果中
+void V4L2CameraData::NotifyNewEncodedFrame(const std::shared_ptr<const EncodedFrame> &frame)
+{
+    VideoSourceListenerInterface *myListener;
+    {
+        lock_guard<recursive_mutex> lock(Sync);
+        myListener = Listener;
+    }
+
+    if (myListener != nullptr)
+    {
+        myListener->OnNewEncodedFrame(frame);
+    }
+}
+
 // 发射错误信息
 void V4L2CameraData::NotifyError(const string &errorMessage, bool fatal)
 {
@@ -173,34 +190,48 @@ bool V4L2CameraData::Init()
         }
     }
 
-    // 设置视频格式
+    // 设置视频格式：设备能力来自缓存时不再枚举，从中选择满足尺寸和帧率的代价最小的模式
     if (ret)
     {
-        v4l2_format videoFormat = {0}, queryFormat = {0};
-        uint32_t pixelFormat = (JpegEncoding) ? V4L2_PIX_FMT_MJPEG : V4L2_PIX_FMT_YUYV;
+        bool cached = false;
+        std::shared_ptr<const V4L2DeviceCapabilities> capabilities = V4L2CapabilityCache::Get(VideoFd, CapabilityCacheDirectory, &cached);
+        V4L2CaptureMode mode;
+        Error ecodeFormat = (capabilities) ? SetCaptureMode(*capabilities, &mode) : Error(Error::DeviceNotReady);
 
-        videoFormat.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        videoFormat.fmt.pix.width = FrameWidth;
-        videoFormat.fmt.pix.height = FrameHeight;
-        videoFormat.fmt.pix.pixelformat = pixelFormat;
-        videoFormat.fmt.pix.field = V4L2_FIELD_ANY;
-        /* 设置视频格式 */
-        ecode = ioctl(VideoFd, VIDIOC_S_FMT, &videoFormat);
-        if (ecode < 0)
+        // 缓存的能力与设备不一致(例如固件升级之后)时重新枚举一次
+        if ((ecodeFormat != Error::Success) && (cached))
         {
-            NotifyError("Failed setting video format", true);
+            V4L2CapabilityCache::Invalidate(capabilities->Key(), CapabilityCacheDirectory);
+            capabilities = V4L2CapabilityCache::Get(VideoFd, CapabilityCacheDirectory);
+            ecodeFormat = (capabilities) ? SetCaptureMode(*capabilities, &mode) : Error(Error::DeviceNotReady);
+        }
+
+        if (ecodeFormat == Error::DeviceNotReady)
+        {
+            NotifyError("Failed enumerating video formats of the device", true);
             ret = false;
         }
-        else if (videoFormat.fmt.pix.pixelformat != pixelFormat)
+        else if (ecodeFormat == Error::UnsupportedPixelFormat)
         {
-            NotifyError(string("The camera does not support requested format: ") + ((JpegEncoding) ? "MJPEG" : "YUYV") + ("\n") + ("Please Use:") + (V4L2pixelFormatToStr(videoFormat.fmt.pix.pixelformat)), true);
-            std::string result = "";
-            // 显式支持的格式
-            V4L2GetSuportFormat(VideoFd, result);
+            NotifyError(std::string("The camera does not offer a format convertible to the requested output: ") + capabilities->ToJson(), true);
             ret = false;
         }
-        FrameWidth = videoFormat.fmt.pix.width;
-        FrameHeight = videoFormat.fmt.pix.height;
+        else if (ecodeFormat == Error::ConfigurationNotSupported)
+        {
+            NotifyError(std::string("The camera does not support requested format: ") + V4L2pixelFormatToStr(PixelFormatToV4L2(mode.Format)), true);
+            ret = false;
+        }
+        else if (ecodeFormat != Error::Success)
+        {
+            NotifyError("Failed setting video format", true);
+            ret = false;
+        }
+        else
+        {
+            lock_guard<recursive_mutex> lock(Sync);
+            Capabilities = capabilities;
+            CaptureMode = mode;
+        }
         // 输出最终的大小
         std::cout << FrameWidth << ";" << FrameHeight << std::endl;
     }
@@ -265,44 +296,10 @@ bool V4L2CameraData::Init()
         }
     }
 
-    // 和Driver交换buffer；获取摄像头图像缓冲--将图像写入缓冲区
-    if (ret)
+    // 和Driver交换buffer并开始以流发方式，发送数据；暂停状态下启动时只打开设备
+    if ((ret) && (!StreamingPaused))
     {
-        v4l2_buffer videoBuffer;
-
-        for (int i = 0; i < BUFFER_COUNT; i++)
-        {
-            memset(&videoBuffer, 0, sizeof(videoBuffer));
-
-            videoBuffer.index = i;
-            videoBuffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            videoBuffer.memory = V4L2_MEMORY_MMAP;
-
-            ecode = ioctl(VideoFd, VIDIOC_QBUF, &videoBuffer);
-
-            if (ecode < 0)
-            {
-                NotifyError("Unable to enqueue capture buffer", true);
-                ret = false;
-            }
-        }
-    }
-
-    // 开始以流发方式，发送数据
-    if (ret)
-    {
-        int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-
-        ecode = ioctl(VideoFd, VIDIOC_STREAMON, &type);
-        if (ecode < 0)
-        {
-            NotifyError("Failed starting video streaming", true);
-            ret = false;
-        }
-        else
-        {
-            VideoStreamingActive = true;
-        }
+        ret = StartStreaming();
     }
 
     // 确认所有设置的内能力值
@@ -325,12 +322,95 @@ bool V4L2CameraData::Init()
     return ret;
 }
 
-// 停止摄像头并，清除队列
-void V4L2CameraData::Cleanup()
+// 选择采集模式并设置格式和帧间隔
+Error V4L2CameraData::SetCaptureMode(const V4L2DeviceCapabilities &capabilities, V4L2CaptureMode *mode)
 {
-    lock_guard<recursive_mutex> lock(ConfigSync);
+    Error ecode = capabilities.SelectMode(OutputFormat, FrameWidth, FrameHeight, FrameRate, mode);
+    if (ecode != Error::Success)
+    {
+        return ecode;
+    }
 
-    // disable vide streaming
+    v4l2_format videoFormat = {0};
+    uint32_t pixelFormat = PixelFormatToV4L2(mode->Format);
+    videoFormat.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    videoFormat.fmt.pix.width = mode->Width;
+    videoFormat.fmt.pix.height = mode->Height;
+    videoFormat.fmt.pix.pixelformat = pixelFormat;
+    videoFormat.fmt.pix.field = V4L2_FIELD_ANY;
+    /* 设置视频格式 */
+    if (ioctl(VideoFd, VIDIOC_S_FMT, &videoFormat) < 0)
+    {
+        return Error::IOError;
+    }
+    if (videoFormat.fmt.pix.pixelformat != pixelFormat)
+    {
+        return Error::ConfigurationNotSupported;
+    }
+
+    CaptureFormat = mode->Format;
+    ConvertedFormat = mode->Converted;
+    FrameWidth = videoFormat.fmt.pix.width;
+    FrameHeight = videoFormat.fmt.pix.height;
+    BytesPerLine = videoFormat.fmt.pix.bytesperline;
+    if (BytesPerLine == 0)
+    {
+        BytesPerLine = ImageBytesPerLine(FrameWidth * ImageBitsPerPixel(CaptureFormat));
+    }
+
+    // 驱动支持时设置帧间隔，否则使用驱动默认的帧率
+    v4l2_streamparm streamParam = {0};
+    streamParam.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if ((mode->Interval.Numerator != 0) && (ioctl(VideoFd, VIDIOC_G_PARM, &streamParam) == 0) &&
+        ((streamParam.parm.capture.capability & V4L2_CAP_TIMEPERFRAME) != 0))
+    {
+        streamParam.parm.capture.timeperframe.numerator = mode->Interval.Numerator;
+        streamParam.parm.capture.timeperframe.denominator = mode->Interval.Denominator;
+        if (ioctl(VideoFd, VIDIOC_S_PARM, &streamParam) < 0)
+        {
+            NotifyError("Failed setting frame interval");
+        }
+    }
+    return Error::Success;
+}
+
+// 将所有缓冲区交给驱动并开启视频流
+bool V4L2CameraData::StartStreaming()
+{
+    v4l2_buffer videoBuffer;
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    int ecode;
+
+    // 和Driver交换buffer；获取摄像头图像缓冲--将图像写入缓冲区
+    for (int i = 0; i < BUFFER_COUNT; i++)
+    {
+        memset(&videoBuffer, 0, sizeof(videoBuffer));
+
+        videoBuffer.index = i;
+        videoBuffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        videoBuffer.memory = V4L2_MEMORY_MMAP;
+
+        ecode = ioctl(VideoFd, VIDIOC_QBUF, &videoBuffer);
+        if (ecode < 0)
+        {
+            NotifyError("Unable to enqueue capture buffer", true);
+            return false;
+        }
+    }
+
+    ecode = ioctl(VideoFd, VIDIOC_STREAMON, &type);
+    if (ecode < 0)
+    {
+        NotifyError("Failed starting video streaming", true);
+        return false;
+    }
+    VideoStreamingActive = true;
+    return true;
+}
+
+// 关闭视频流，所有缓冲区回到用户空间
+void V4L2CameraData::StopStreaming()
+{
     if (VideoStreamingActive)
     {
         int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -338,6 +418,15 @@ void V4L2CameraData::Cleanup()
         ioctl(VideoFd, VIDIOC_STREAMOFF, &type);
         VideoStreamingActive = false;
     }
+}
+
+// 停止摄像头并，清除队列
+void V4L2CameraData::Cleanup()
+{
+    lock_guard<recursive_mutex> lock(ConfigSync);
+
+    // disable vide streaming
+    StopStreaming();
 
     // unmap capture buffers
     for (int i = 0; i < BUFFER_COUNT; i++)
@@ -365,16 +454,56 @@ void V4L2CameraData::VideoCaptureLoop()
     uint32_t frameTime = 1000 / FrameRate;
     uint32_t handlingTime;
     int ecode;
-
-    // If JPEG encoding is used, client is notified with an image wrapping a mapped buffer.
-    // If not used howver, we decode YUYV data into RGB.
-    shared_ptr<Image> rgbImage;
-    //非jpeg编码，就直接进行拷贝。
-    if (!JpegEncoding)
+    // 相邻两帧驱动时间戳的间隔与帧率周期之差，暂停之后重新开始计算
+    int64_t lastCaptureTime = 0;
+    int64_t framePeriod = 1000000 / FrameRate;
+
+    MetricsRegistry &registry = MetricsRegistry::Instance();
+    std::string labels = MetricsRegistry::Label("device", VideoDeviceName);
+    MetricCounter *framesMetric = registry.Counter("camera_frames_total", "Frames dequeued from the camera", labels);
+    MetricHistogram *jitterMetric = registry.Histogram("camera_capture_jitter_seconds", "Deviation of the capture interval from the frame period",
+                                                       MetricLatencyBuckets(), 1e-6, labels);
+    MetricHistogram *convertMetric = registry.Histogram("camera_convert_seconds", "Captured frame conversion time",
+                                                        MetricLatencyBuckets(), 1e-6, labels);
+    MetricHistogram *notifyMetric = registry.Histogram("camera_dequeue_to_notify_seconds", "Time from buffer dequeue to listener notification",
+                                                       MetricLatencyBuckets(), 1e-6, labels);
+
+    // If JPEG encoding is used, client is notified with an encoded frame wrapping a mapped buffer.
+    // If not used howver, captured data is converted into the negotiated output format.
+    shared_ptr<Image> outputImage;
+    // jpeg编码时为每个映射缓冲区创建一次压缩帧，之后只更新数据大小，避免每帧的内存分配
+    shared_ptr<EncodedFrame> mappedFrames[BUFFER_COUNT];
+    // 原始格式时每个映射缓冲区对应一个只读的图像，转换时作为源图像
+    shared_ptr<Image> mappedImages[BUFFER_COUNT];
+    bool jpegEncoding = (CaptureFormat == PixelFormat::JPEG);
+    if (jpegEncoding)
     {
-        rgbImage = Image::Allocate(FrameWidth, FrameHeight, PixelFormat::RGB24);
+        for (int i = 0; i < BUFFER_COUNT; i++)
+        {
+            mappedFrames[i] = EncodedFrame::Create(MappedBuffers[i], MappedBufferLength[i], FrameCodec::JPEG);
+            if (!mappedFrames[i])
+            {
+                NotifyError("Failed allocating an image", true);
+                return;
+            }
+            mappedFrames[i]->SetKeyFrame(true);
+        }
+    }
+    //非jpeg编码，转换到输出格式；格式相同时只拷贝，映射缓冲区需要立即归还给驱动，而且下一级会原地叠加文字
+    else
+    {
+        for (int i = 0; i < BUFFER_COUNT; i++)
+        {
+            mappedImages[i] = Image::Create(MappedBuffers[i], FrameWidth, FrameHeight, BytesPerLine, CaptureFormat);
+            if ((!mappedImages[i]) || (static_cast<uint32_t>(mappedImages[i]->Size()) > MappedBufferLength[i]))
+            {
+                NotifyError("Capture buffer is smaller than the negotiated frame", true);
+                return;
+            }
+        }
+        outputImage = Image::Allocate(FrameWidth, FrameHeight, ConvertedFormat, false, FrameMemory);
 
-        if (!rgbImage)
+        if (!outputImage)
         {
             NotifyError("Failed allocating an image", true);
             return;
@@ -384,6 +513,19 @@ void V4L2CameraData::VideoCaptureLoop()
     // 等待一段时间再进行数据的读取
     while (!NeedToStop.Wait(sleepTime))
     {
+        // 暂停时关闭视频流，设备保持打开，恢复时不需要重新初始化
+        if (StreamingPaused)
+        {
+            StopStreaming();
+            sleepTime = STREAMING_PAUSE_POLL_INTERVAL;
+            lastCaptureTime = 0;
+            continue;
+        }
+        if ((!VideoStreamingActive) && (!StartStreaming()))
+        {
+            break;
+        }
+
         // 获取当前的系统时间
         std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
@@ -392,6 +534,7 @@ void V4L2CameraData::VideoCaptureLoop()
 
         videoBuffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         videoBuffer.memory = V4L2_MEMORY_MMAP;
+        int64_t traceBegin = FrameTrace::Begin();
         // 在这里进行数据的拷贝
         ecode = ioctl( VideoFd, VIDIOC_DQBUF, &videoBuffer );
         if ( ecode < 0 )
@@ -400,29 +543,55 @@ void V4L2CameraData::VideoCaptureLoop()
         }
         else
         {
-            // 创建临时指针
-            shared_ptr<Image> image;
-            FramesReceived++;
-            if (JpegEncoding)
+            std::chrono::steady_clock::time_point dequeueTime = std::chrono::steady_clock::now();
+            // 帧编号从这里开始跟随图像经过转换、编码和发送
+            uint64_t frameId = FrameTrace::NextFrameId();
+            if (traceBegin != 0)
             {
-                //注意这里创建的时候，指针指向的是v4l2_buffer 结构体,直接使用buffer大小和1计算它的总长度
-                image = Image::Create(MappedBuffers[videoBuffer.index], videoBuffer.bytesused, 1, videoBuffer.bytesused, PixelFormat::JPEG);
+                FrameTrace::Record("dequeue", frameId, traceBegin, FrameTrace::Now(), "buffer", videoBuffer.index);
             }
-            else
+            int64_t captureTime = static_cast<int64_t>(videoBuffer.timestamp.tv_sec) * 1000000 + videoBuffer.timestamp.tv_usec;
+            FramesReceived++;
+            framesMetric->Add();
+            if (lastCaptureTime != 0)
             {
-                // 将数据转换为rgb数据
-                DecodeYuyvToRgb(MappedBuffers[videoBuffer.index], rgbImage->Data(), FrameWidth, FrameHeight, rgbImage->Stride());
-                image = rgbImage;
+                int64_t interval = captureTime - lastCaptureTime;
+                jitterMetric->Observe(static_cast<uint64_t>((interval > framePeriod) ? interval - framePeriod : framePeriod - interval));
             }
-            image->UpdateTimeStamp(videoBuffer.timestamp);
-            if (image)
+            lastCaptureTime = captureTime;
+            if (jpegEncoding)
             {
-                //分发全部的image指针，主要是调用监听者的对应监听函数
-                NotifyNewImage(image);
+                //注意这里指针指向的是v4l2_buffer 映射的内存，只更新数据大小和帧信息
+                const shared_ptr<EncodedFrame> &frame = mappedFrames[videoBuffer.index];
+                frame->SetSize(videoBuffer.bytesused);
+                frame->SetTimeStamp(videoBuffer.timestamp);
+                frame->SetSequence(frameId);
+                notifyMetric->Observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - dequeueTime).count()));
+                TraceSpan span("notify", frameId);
+                NotifyNewEncodedFrame(frame);
             }
             else
             {
-                NotifyError("Failed allocating an image");
+                // 转换为输出格式
+                Error convertResult;
+                {
+                    TraceSpan span("convert", frameId);
+                    convertResult = ImageConverter::Convert(mappedImages[videoBuffer.index], outputImage);
+                }
+                convertMetric->Observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - dequeueTime).count()));
+                if (convertResult != Error::Success)
+                {
+                    NotifyError("Failed converting captured frame");
+                }
+                else
+                {
+                    outputImage->UpdateTimeStamp(videoBuffer.timestamp);
+                    outputImage->SetFrameId(frameId);
+                    notifyMetric->Observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - dequeueTime).count()));
+                    //分发全部的image指针，主要是调用监听者的对应监听函数
+                    TraceSpan span("notify", frameId);
+                    NotifyNewImage(outputImage);
+                }
             }
 
             // 再次查询buffer
@@ -442,6 +611,11 @@ void V4L2CameraData::VideoCaptureLoop()
 // Background control thread - performs camera init/clean-up and runs video loop
 void V4L2CameraData::ControlThreadHandler(V4L2CameraData *me)
 {
+    // 多个摄像头时每个采集线程固定在自己的CPU上，减少互相抢占和缓存失效
+    if (!me->CpuAffinity.empty())
+    {
+        ImageMemory::RunOnCpus(me->CpuAffinity.data(), me->CpuAffinity.size());
+    }
     // 进行初始化并开始摄像头线程
     if (me->Init())
     {
@@ -497,6 +671,29 @@ void V4L2CameraData::SetFrameRate(uint32_t frameRate)
     }
 }
 
+// 设置设备能力的磁盘缓存目录
+void V4L2CameraData::SetCapabilityCacheDirectory(const std::string &directory)
+{
+    lock_guard<recursive_mutex> lock(Sync);
+
+    if (!IsRunning())
+    {
+        CapabilityCacheDirectory = directory;
+    }
+}
+
+// 最近一次打开设备时的能力和采集模式
+std::shared_ptr<const V4L2DeviceCapabilities> V4L2CameraData::GetCapabilities() const
+{
+    lock_guard<recursive_mutex> lock(Sync);
+    return Capabilities;
+}
+V4L2CaptureMode V4L2CameraData::GetCaptureMode() const
+{
+    lock_guard<recursive_mutex> lock(Sync);
+    return CaptureMode;
+}
+
 // 开启jpeg编码
 void V4L2CameraData::EnableJpegEncoding(bool enable)
 {
@@ -504,10 +701,49 @@ void V4L2CameraData::EnableJpegEncoding(bool enable)
 
     if (!IsRunning())
     {
-        JpegEncoding = enable;
+        OutputFormat = (enable) ? PixelFormat::JPEG : PixelFormat::RGB24;
+    }
+}
+
+// 设置输出格式
+void V4L2CameraData::SetOutputFormat(PixelFormat format)
+{
+    lock_guard<recursive_mutex> lock(Sync);
+
+    if (!IsRunning())
+    {
+        OutputFormat = format;
+    }
+}
+
+// 设置解码图像的内存分配方式
+void V4L2CameraData::SetFrameMemory(const ImageMemoryOptions &options)
+{
+    lock_guard<recursive_mutex> lock(Sync);
+
+    if (!IsRunning())
+    {
+        FrameMemory = options;
     }
 }
 
+// 设置采集线程绑定的CPU
+void V4L2CameraData::SetCpuAffinity(const std::vector<uint32_t> &cpus)
+{
+    lock_guard<recursive_mutex> lock(Sync);
+
+    if (!IsRunning())
+    {
+        CpuAffinity = cpus;
+    }
+}
+
+// 暂停/恢复采集，由采集线程在下一次循环时切换视频流
+void V4L2CameraData::SetStreamingPaused(bool paused)
+{
+    StreamingPaused = paused;
+}
+
 // 设置属性
 Error V4L2CameraData::SetVideoProperty(VideoProperty property, int32_t value)
 {
@@ -30,6 +30,7 @@
 #include <vector>
 #include <mutex>
 #include <thread>
+#include <atomic>
 #include <chrono>
 /*===== C++  header end ======*/
 
@@ -38,6 +39,7 @@
 #include "base_manual_reset_event.h"
 #include "uncopyable.h"
 #include "v4l2_tools.h"
+#include "v4l2_capabilities.h"
 
 /*===== project  header end ======*/
 
@@ -64,6 +66,8 @@ typedef BaseVideoProperty VideoProperty;
 
 /* v4l2 用户缓冲buffer大小 默认为4  */
 #define BUFFER_COUNT (4)
+/* 暂停采集时检查恢复和停止信号的间隔(毫秒) */
+#define STREAMING_PAUSE_POLL_INTERVAL (50)
 /**
  * @brief V4l2数据对象封装类
  */
@@ -73,10 +77,11 @@ public:
     /**
      * @brief Construct a new V4L2CameraData object
      */
-    V4L2CameraData() : Sync(), ConfigSync(), ControlThread(), NeedToStop(), Listener(nullptr), Running(false),
+    V4L2CameraData() : Sync(), ConfigSync(), ControlThread(), NeedToStop(), Listener(nullptr), Running(false), StreamingPaused(false),
                        VideoFd(-1), VideoStreamingActive(false), MappedBuffers(), MappedBufferLength(), PropertiesToSet(),
-                       VideoDeviceIndex(0),
-                       FramesReceived(0), FrameWidth(640), FrameHeight(480), FrameRate(30), JpegEncoding(true)
+                       Capabilities(), CaptureMode(), VideoDeviceIndex(0),
+                       FramesReceived(0), FrameWidth(640), FrameHeight(480), FrameRate(30), OutputFormat(PixelFormat::JPEG),
+                       CaptureFormat(PixelFormat::Unknown), ConvertedFormat(PixelFormat::Unknown), BytesPerLine(0)
     {
     }
     /* ===== 信号管理函数 ===== */
@@ -115,6 +120,11 @@ public:
      * @param  image     图片数据共享指针
      */
     void NotifyNewImage(const std::shared_ptr<const Image> &image);
+    /**
+     * @brief  发送压缩帧函数
+     * @param  frame     压缩帧共享指针
+     */
+    void NotifyNewEncodedFrame(const std::shared_ptr<const EncodedFrame> &frame);
     /**
      * @brief  异常抛出信号函数
      * @param  errorMessage     异常信息
@@ -154,10 +164,52 @@ public:
      */
     void SetFrameRate(uint32_t frameRate);
     /**
-     * @brief 是否使用JPEG，默认为true,否则直接输出YUV格式的数据
+     * @brief 是否使用JPEG，默认为true,否则输出RGB24；与 SetOutputFormat(JPEG/RGB24) 相同
      * @param  enable
      */
     void EnableJpegEncoding(bool enable);
+    /**
+     * @brief 设置采集之后输出的格式，摄像头运行时无效
+     * @details 打开设备时从 V4L2CapabilityCache 获取设备能力，用 V4L2DeviceCapabilities::SelectMode 选择采集模式
+     * @param  format           JPEG/RGB24/Grayscale8/NV12/I420，Unknown 为自动选择
+     */
+    void SetOutputFormat(PixelFormat format);
+    /**
+     * @brief 设置设备能力的磁盘缓存目录，摄像头运行时无效
+     * @param  directory        目录，为空时只使用内存缓存
+     */
+    void SetCapabilityCacheDirectory(const std::string &directory);
+    /**
+     * @brief  最近一次打开设备时的设备能力
+     * @return std::shared_ptr<const V4L2DeviceCapabilities> 没有打开过设备时为空
+     */
+    std::shared_ptr<const V4L2DeviceCapabilities> GetCapabilities() const;
+    /**
+     * @brief  最近一次打开设备时选择的采集模式
+     * @return V4L2CaptureMode  采集模式
+     */
+    V4L2CaptureMode GetCaptureMode() const;
+    /**
+     * @brief 设置解码之后RGB图像的内存分配方式，摄像头运行时无效
+     * @param  options          内存分配选项
+     */
+    void SetFrameMemory(const ImageMemoryOptions &options);
+    /**
+     * @brief 设置采集线程绑定的CPU，摄像头运行时无效
+     * @param  cpus             CPU编号，为空时不绑定
+     */
+    void SetCpuAffinity(const std::vector<uint32_t> &cpus);
+    /**
+     * @brief 暂停/恢复采集，暂停时设备保持打开，停止视频流(VIDIOC_STREAMOFF)并且不再读取数据
+     * @param  paused           是否暂停
+     */
+    void SetStreamingPaused(bool paused);
+    /**
+     * @brief  是否暂停采集
+     * @return true  已暂停
+     * @return false 正常采集
+     */
+    inline bool IsStreamingPaused() const { return StreamingPaused; }
     /**
      * @brief 设置摄像头属性
      * @param  property         属性名称
@@ -191,6 +243,24 @@ private:
      * @return false  初始化失败
      */
     bool Init();
+    /**
+     * @brief  将所有缓冲区放入驱动队列并开启视频流
+     * @return true  成功
+     * @return false 失败
+     */
+    bool StartStreaming();
+    /**
+     * @brief  选择采集模式，设置视频格式和帧间隔
+     * @param  capabilities     设备能力
+     * @param  mode             选择的模式
+     * @return Error            没有可用的格式返回 UnsupportedPixelFormat，VIDIOC_S_FMT 失败返回 IOError，
+     *                          驱动改变了像素格式返回 ConfigurationNotSupported
+     */
+    Error SetCaptureMode(const V4L2DeviceCapabilities &capabilities, V4L2CaptureMode *mode);
+    /**
+     * @brief 关闭视频流，驱动同时清空缓冲区队列
+     */
+    void StopStreaming();
     /**
      * @brief 开启摄像头数据读取线程循环
      */
@@ -207,11 +277,14 @@ private:
     ManualResetEvent NeedToStop;                      ///< 事件控制器
     VideoSourceListenerInterface *Listener;           ///< 监听接口指针
     bool Running;                                     ///< 是否正在运行
+    std::atomic<bool> StreamingPaused;                ///< 是否暂停采集
     int VideoFd;                                      ///< 摄像头文件句柄
     bool VideoStreamingActive;                        ///< 是否使用stream流的方式读取数据
     uint8_t *MappedBuffers[BUFFER_COUNT];             ///<  8bit映射缓冲区--灰度
     uint32_t MappedBufferLength[BUFFER_COUNT];        ///< 32bit映射缓冲区--rgba
     std::map<VideoProperty, int32_t> PropertiesToSet; ///< 属性值
+    std::shared_ptr<const V4L2DeviceCapabilities> Capabilities; ///< 设备能力
+    V4L2CaptureMode CaptureMode;                      ///< 选择的采集模式
 
 public:
     uint32_t VideoDeviceIndex;                   /** 摄像头index,方便快速查找摄像头 */
@@ -220,7 +293,13 @@ public:
     uint32_t FrameWidth = 0;                     /** 图片宽度 */
     uint32_t FrameHeight = 0;                    /** 图片高度 */
     uint32_t FrameRate;                          /** 帧率 */
-    bool JpegEncoding;                           /** 是否为Jpeg编码 */
+    PixelFormat OutputFormat;                    /** 需要输出的格式，JPEG 为直接输出MJPEG，Unknown 为自动选择 */
+    PixelFormat CaptureFormat;                   /** 协商之后设备输出的格式 */
+    PixelFormat ConvertedFormat;                 /** 采集之后转换到的格式，JPEG 表示直接输出压缩帧 */
+    uint32_t BytesPerLine;                       /** 设备输出的每行字节数，平面格式为Y平面 */
+    std::string CapabilityCacheDirectory;        /** 设备能力的磁盘缓存目录，为空时只使用内存缓存 */
+    ImageMemoryOptions FrameMemory;              /** 解码图像的内存分配选项，大分辨率时可以使用大页 */
+    std::vector<uint32_t> CpuAffinity;           /** 采集和解码线程绑定的CPU，为空时不绑定 */
     std::vector<std::string> SupportVideoFormat; /** 支持的视频格式 */
     // v4l2_buffer MyVideoBuffer;                   /** 视频阵缓冲指针，永远指向最新的值，使用拷贝与内存同步 */
 };
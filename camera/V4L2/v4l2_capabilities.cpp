@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include <map>
+#include <mutex>
+#include "base_str_tools.h"
+#include "v4l2_capabilities.h"
+
+NAMESPACE_START
+
+/* 磁盘缓存文件的第一行，格式改变时增加版本号 */
+static const char *kCacheHeader = "v4l2-capabilities 1";
+
+/* 读取驱动、设备名称、总线位置和驱动版本 */
+static Error QueryIdentity(int fd, V4L2DeviceCapabilities &capabilities)
+{
+    struct v4l2_capability cap;
+
+    memset(&cap, 0, sizeof(cap));
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) < 0)
+    {
+        return Error::DeviceNotReady;
+    }
+    capabilities.Driver = std::string(reinterpret_cast<const char *>(cap.driver), strnlen(reinterpret_cast<const char *>(cap.driver), sizeof(cap.driver)));
+    capabilities.Card = std::string(reinterpret_cast<const char *>(cap.card), strnlen(reinterpret_cast<const char *>(cap.card), sizeof(cap.card)));
+    capabilities.BusInfo = std::string(reinterpret_cast<const char *>(cap.bus_info), strnlen(reinterpret_cast<const char *>(cap.bus_info), sizeof(cap.bus_info)));
+    capabilities.Version = cap.version;
+    return Error::Success;
+}
+
+/* 枚举一个尺寸的帧间隔，步进和连续的间隔只有一项 */
+static void EnumFrameIntervals(int fd, uint32_t fourcc, V4L2FrameSize &size)
+{
+    struct v4l2_frmivalenum fival;
+
+    memset(&fival, 0, sizeof(fival));
+    fival.pixel_format = fourcc;
+    fival.width = size.Width;
+    fival.height = size.Height;
+    while (ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &fival) == 0)
+    {
+        if (fival.type == V4L2_FRMIVAL_TYPE_DISCRETE)
+        {
+            size.Intervals.push_back(V4L2FrameInterval(fival.discrete.numerator, fival.discrete.denominator));
+            fival.index++;
+            continue;
+        }
+        size.IntervalRange = true;
+        size.Intervals.push_back(V4L2FrameInterval(fival.stepwise.min.numerator, fival.stepwise.min.denominator));
+        size.Intervals.push_back(V4L2FrameInterval(fival.stepwise.max.numerator, fival.stepwise.max.denominator));
+        break;
+    }
+}
+
+/* 枚举一种格式的尺寸，步进和连续的尺寸只有一项 */
+static void EnumFrameSizes(int fd, uint32_t fourcc, std::vector<V4L2FrameSize> &sizes)
+{
+    struct v4l2_frmsizeenum fsize;
+
+    memset(&fsize, 0, sizeof(fsize));
+    fsize.pixel_format = fourcc;
+    while (ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &fsize) == 0)
+    {
+        V4L2FrameSize size;
+        if (fsize.type == V4L2_FRMSIZE_TYPE_DISCRETE)
+        {
+            size.Width = size.MinWidth = fsize.discrete.width;
+            size.Height = size.MinHeight = fsize.discrete.height;
+        }
+        else
+        {
+            size.Width = fsize.stepwise.max_width;
+            size.Height = fsize.stepwise.max_height;
+            size.MinWidth = fsize.stepwise.min_width;
+            size.MinHeight = fsize.stepwise.min_height;
+            size.StepWidth = ((fsize.type == V4L2_FRMSIZE_TYPE_CONTINUOUS) || (fsize.stepwise.step_width == 0)) ? 1 : fsize.stepwise.step_width;
+            size.StepHeight = ((fsize.type == V4L2_FRMSIZE_TYPE_CONTINUOUS) || (fsize.stepwise.step_height == 0)) ? 1 : fsize.stepwise.step_height;
+        }
+        EnumFrameIntervals(fd, fourcc, size);
+        sizes.push_back(size);
+        if (fsize.type != V4L2_FRMSIZE_TYPE_DISCRETE)
+        {
+            break;
+        }
+        fsize.index++;
+    }
+}
+
+/* 帧间隔对应的帧率，单位为千分之一帧，间隔无效时为0 */
+static uint64_t MilliFrameRate(const V4L2FrameInterval &interval)
+{
+    return (interval.Numerator == 0) ? 0 : static_cast<uint64_t>(interval.Denominator) * 1000 / interval.Numerator;
+}
+
+/* 步进尺寸中不小于请求的最小尺寸，请求为0或者超过最大值时为最大尺寸 */
+static uint32_t FitDimension(uint32_t requested, uint32_t minimum, uint32_t maximum, uint32_t step)
+{
+    if ((step == 0) || (requested == 0) || (requested >= maximum))
+    {
+        return maximum;
+    }
+    if (requested <= minimum)
+    {
+        return minimum;
+    }
+    uint32_t fitted = minimum + (requested - minimum + step - 1) / step * step;
+    return (fitted > maximum) ? maximum : fitted;
+}
+
+static uint64_t Distance(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a - b : b - a;
+}
+
+/* 候选模式的排序键，按字典序比较，越小越好 */
+struct ModeScore
+{
+    uint64_t Keys[5];
+
+    bool operator<(const ModeScore &other) const
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            if (Keys[i] != other.Keys[i])
+            {
+                return Keys[i] < other.Keys[i];
+            }
+        }
+        return false;
+    }
+};
+
+/* milliFps 为0表示驱动没有提供帧率，认为满足请求 */
+static ModeScore ScoreMode(uint32_t tier, uint32_t cost, uint32_t width, uint32_t height, uint64_t milliFps,
+                           uint32_t requestedWidth, uint32_t requestedHeight, uint32_t requestedFps)
+{
+    ModeScore score;
+    uint64_t area = static_cast<uint64_t>(width) * height;
+    uint64_t requestedMilliFps = static_cast<uint64_t>(requestedFps) * 1000;
+    bool anySize = (requestedWidth == 0) || (requestedHeight == 0);
+    bool sizeMet = anySize || ((width >= requestedWidth) && (height >= requestedHeight));
+    bool fpsMet = (milliFps == 0) || (milliFps >= requestedMilliFps);
+
+    score.Keys[0] = ((sizeMet) ? 0 : 1) + ((fpsMet) ? 0 : 1);
+    score.Keys[1] = tier;
+    score.Keys[2] = (anySize) ? UINT64_MAX - area : Distance(area, static_cast<uint64_t>(requestedWidth) * requestedHeight);
+    score.Keys[3] = cost;
+    score.Keys[4] = (milliFps == 0) ? 0 : (requestedFps == 0) ? UINT64_MAX - milliFps : Distance(milliFps, requestedMilliFps);
+    return score;
+}
+
+Error V4L2DeviceCapabilities::Enumerate(int fd, V4L2DeviceCapabilities &capabilities)
+{
+    Error ret = QueryIdentity(fd, capabilities);
+    if (ret != Error::Success)
+    {
+        return ret;
+    }
+
+    struct v4l2_fmtdesc fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    capabilities.Formats.clear();
+    while (ioctl(fd, VIDIOC_ENUM_FMT, &fmt) == 0)
+    {
+        V4L2FormatCapability format;
+        format.FourCC = fmt.pixelformat;
+        format.Format = V4L2ToPixelFormat(fmt.pixelformat);
+        fmt.index++;
+        if (format.Format == PixelFormat::Unknown)
+        {
+            continue;
+        }
+        EnumFrameSizes(fd, format.FourCC, format.Sizes);
+        capabilities.Formats.push_back(format);
+    }
+    return Error::Success;
+}
+
+Error V4L2DeviceCapabilities::QueryKey(int fd, std::string &key)
+{
+    V4L2DeviceCapabilities identity;
+    Error ret = QueryIdentity(fd, identity);
+    if (ret == Error::Success)
+    {
+        key = identity.Key();
+    }
+    return ret;
+}
+
+std::string V4L2DeviceCapabilities::Key() const
+{
+    return Driver + "/" + Card + "/" + BusInfo + "/" + std::to_string(Version);
+}
+
+std::vector<PixelFormat> V4L2DeviceCapabilities::PixelFormats() const
+{
+    std::vector<PixelFormat> formats;
+    for (size_t i = 0; i < Formats.size(); i++)
+    {
+        formats.push_back(Formats[i].Format);
+    }
+    return formats;
+}
+
+Error V4L2DeviceCapabilities::SelectMode(PixelFormat output, uint32_t width, uint32_t height, uint32_t frameRate, V4L2CaptureMode *mode) const
+{
+    bool found = false;
+    ModeScore best = ModeScore();
+
+    for (size_t i = 0; i < Formats.size(); i++)
+    {
+        const V4L2FormatCapability &format = Formats[i];
+        uint32_t tier, cost;
+        PixelFormat converted;
+        if (!V4L2FormatRank(format.Format, output, &tier, &cost, &converted))
+        {
+            continue;
+        }
+
+        // 每个候选为 尺寸 x 帧间隔，驱动不能枚举尺寸时使用请求的尺寸并且不设置帧间隔
+        std::vector<V4L2FrameSize> sizes = format.Sizes;
+        if (sizes.empty())
+        {
+            sizes.push_back(V4L2FrameSize());
+            sizes.back().Width = sizes.back().MinWidth = width;
+            sizes.back().Height = sizes.back().MinHeight = height;
+        }
+        for (size_t j = 0; j < sizes.size(); j++)
+        {
+            const V4L2FrameSize &size = sizes[j];
+            uint32_t fittedWidth = FitDimension(width, size.MinWidth, size.Width, size.StepWidth);
+            uint32_t fittedHeight = FitDimension(height, size.MinHeight, size.Height, size.StepHeight);
+
+            std::vector<V4L2FrameInterval> intervals;
+            if ((size.IntervalRange) && (size.Intervals.size() == 2))
+            {
+                // 连续范围：请求的帧率在范围内时使用请求的帧率，否则使用最接近的一端
+                uint64_t fastest = MilliFrameRate(size.Intervals[0]);
+                uint64_t slowest = MilliFrameRate(size.Intervals[1]);
+                uint64_t requested = static_cast<uint64_t>(frameRate) * 1000;
+                intervals.push_back(((frameRate == 0) || (requested >= fastest)) ? size.Intervals[0]
+                                    : (requested <= slowest)                     ? size.Intervals[1]
+                                                                                 : V4L2FrameInterval(1, frameRate));
+            }
+            else
+            {
+                intervals = size.Intervals;
+            }
+            if (intervals.empty())
+            {
+                intervals.push_back(V4L2FrameInterval());
+            }
+
+            for (size_t k = 0; k < intervals.size(); k++)
+            {
+                ModeScore score = ScoreMode(tier, cost, fittedWidth, fittedHeight, MilliFrameRate(intervals[k]), width, height, frameRate);
+                if ((!found) || (score < best))
+                {
+                    found = true;
+                    best = score;
+                    mode->Format = format.Format;
+                    mode->Converted = converted;
+                    mode->Width = fittedWidth;
+                    mode->Height = fittedHeight;
+                    mode->Interval = (MilliFrameRate(intervals[k]) == 0) ? V4L2FrameInterval() : intervals[k];
+                }
+            }
+        }
+    }
+    return (found) ? Error::Success : Error::UnsupportedPixelFormat;
+}
+
+static std::string JsonString(std::string value)
+{
+    StringReplace(value, "\\", "\\\\");
+    StringReplace(value, "\"", "\\\"");
+    return "\"" + value + "\"";
+}
+
+static std::string JsonFrameRate(const V4L2FrameInterval &interval)
+{
+    char text[32];
+    uint64_t milliFps = MilliFrameRate(interval);
+    snprintf(text, sizeof(text), "%g", static_cast<double>(milliFps) / 1000.0);
+    return text;
+}
+
+std::string V4L2DeviceCapabilities::ToJson() const
+{
+    std::string json = "{\"driver\":" + JsonString(Driver) + ",\"card\":" + JsonString(Card) + ",\"bus\":" + JsonString(BusInfo) +
+                       ",\"version\":" + std::to_string(Version) + ",\"formats\":[";
+
+    for (size_t i = 0; i < Formats.size(); i++)
+    {
+        const V4L2FormatCapability &format = Formats[i];
+        json += (i == 0) ? "{" : ",{";
+        json += "\"fourcc\":" + JsonString(V4L2pixelFormatToStr(format.FourCC)) + ",\"sizes\":[";
+        for (size_t j = 0; j < format.Sizes.size(); j++)
+        {
+            const V4L2FrameSize &size = format.Sizes[j];
+            json += (j == 0) ? "{" : ",{";
+            if (size.StepWidth == 0)
+            {
+                json += "\"width\":" + std::to_string(size.Width) + ",\"height\":" + std::to_string(size.Height);
+            }
+            else
+            {
+                json += "\"min_width\":" + std::to_string(size.MinWidth) + ",\"min_height\":" + std::to_string(size.MinHeight) +
+                        ",\"max_width\":" + std::to_string(size.Width) + ",\"max_height\":" + std::to_string(size.Height) +
+                        ",\"step_width\":" + std::to_string(size.StepWidth) + ",\"step_height\":" + std::to_string(size.StepHeight);
+            }
+            if ((size.IntervalRange) && (size.Intervals.size() == 2))
+            {
+                json += ",\"min_fps\":" + JsonFrameRate(size.Intervals[1]) + ",\"max_fps\":" + JsonFrameRate(size.Intervals[0]);
+            }
+            else
+            {
+                json += ",\"fps\":[";
+                for (size_t k = 0; k < size.Intervals.size(); k++)
+                {
+                    json += ((k == 0) ? "" : ",") + JsonFrameRate(size.Intervals[k]);
+                }
+                json += "]";
+            }
+            json += "}";
+        }
+        json += "]}";
+    }
+    json += "]}";
+    return json;
+}
+
+// 每行一条记录：标识各占一行，format 之后的 size 行属于该格式，帧间隔跟在尺寸之后
+Error V4L2DeviceCapabilities::Save(const std::string &fileName) const
+{
+    // 先写入临时文件再改名，多个进程同时写入时不会读到一半的文件
+    std::string temporary = fileName + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "w");
+    if (file == nullptr)
+    {
+        return Error::IOError;
+    }
+
+    fprintf(file, "%s\ndriver %s\ncard %s\nbus %s\nversion %u\n", kCacheHeader, Driver.c_str(), Card.c_str(), BusInfo.c_str(), Version);
+    for (size_t i = 0; i < Formats.size(); i++)
+    {
+        fprintf(file, "format %u\n", Formats[i].FourCC);
+        for (size_t j = 0; j < Formats[i].Sizes.size(); j++)
+        {
+            const V4L2FrameSize &size = Formats[i].Sizes[j];
+            fprintf(file, "size %u %u %u %u %u %u %d %u", size.Width, size.Height, size.MinWidth, size.MinHeight,
+                    size.StepWidth, size.StepHeight, (size.IntervalRange) ? 1 : 0, static_cast<uint32_t>(size.Intervals.size()));
+            for (size_t k = 0; k < size.Intervals.size(); k++)
+            {
+                fprintf(file, " %u %u", size.Intervals[k].Numerator, size.Intervals[k].Denominator);
+            }
+            fprintf(file, "\n");
+        }
+    }
+
+    bool written = (ferror(file) == 0);
+    written = (fclose(file) == 0) && (written);
+    if ((!written) || (rename(temporary.c_str(), fileName.c_str()) != 0))
+    {
+        remove(temporary.c_str());
+        return Error::IOError;
+    }
+    return Error::Success;
+}
+
+Error V4L2DeviceCapabilities::Load(const std::string &fileName)
+{
+    FILE *file = fopen(fileName.c_str(), "r");
+    if (file == nullptr)
+    {
+        return Error::IOError;
+    }
+
+    V4L2DeviceCapabilities loaded;
+    std::string line;
+    char buffer[256];
+    bool valid = true;
+    bool header = false;
+
+    while ((valid) && (fgets(buffer, sizeof(buffer), file)))
+    {
+        // 超过缓冲区的长行分多次读取
+        line += buffer;
+        if ((line.empty()) || (line.back() != '\n'))
+        {
+            continue;
+        }
+        line.pop_back();
+
+        if (!header)
+        {
+            valid = header = (line == kCacheHeader);
+        }
+        else if (line.compare(0, 7, "driver ") == 0)
+        {
+            loaded.Driver = line.substr(7);
+        }
+        else if (line.compare(0, 5, "card ") == 0)
+        {
+            loaded.Card = line.substr(5);
+        }
+        else if (line.compare(0, 4, "bus ") == 0)
+        {
+            loaded.BusInfo = line.substr(4);
+        }
+        else if (line.compare(0, 8, "version ") == 0)
+        {
+            valid = (sscanf(line.c_str() + 8, "%u", &loaded.Version) == 1);
+        }
+        else if (line.compare(0, 7, "format ") == 0)
+        {
+            V4L2FormatCapability format;
+            valid = (sscanf(line.c_str() + 7, "%u", &format.FourCC) == 1);
+            format.Format = V4L2ToPixelFormat(format.FourCC);
+            valid = (valid) && (format.Format != PixelFormat::Unknown);
+            loaded.Formats.push_back(format);
+        }
+        else if ((line.compare(0, 5, "size ") == 0) && (!loaded.Formats.empty()))
+        {
+            V4L2FrameSize size;
+            int range = 0, offset = 0;
+            uint32_t count = 0;
+            valid = (sscanf(line.c_str(), "size %u %u %u %u %u %u %d %u%n", &size.Width, &size.Height, &size.MinWidth, &size.MinHeight,
+                            &size.StepWidth, &size.StepHeight, &range, &count, &offset) == 8);
+            size.IntervalRange = (range != 0);
+            const char *next = line.c_str() + offset;
+            for (uint32_t k = 0; (valid) && (k < count); k++)
+            {
+                V4L2FrameInterval interval;
+                int used = 0;
+                valid = (sscanf(next, " %u %u%n", &interval.Numerator, &interval.Denominator, &used) == 2);
+                size.Intervals.push_back(interval);
+                next += used;
+            }
+            loaded.Formats.back().Sizes.push_back(size);
+        }
+        else
+        {
+            valid = false;
+        }
+        line.clear();
+    }
+    fclose(file);
+
+    // 最后一行没有换行符说明文件没有写完
+    if ((!valid) || (!header) || (!line.empty()))
+    {
+        return Error::Failed;
+    }
+    *this = loaded;
+    return Error::Success;
+}
+
+/* 内存缓存，函数内的静态变量避免全局对象的初始化顺序问题 */
+static std::mutex &CacheSync()
+{
+    static std::mutex sync;
+    return sync;
+}
+static std::map<std::string, std::shared_ptr<const V4L2DeviceCapabilities>> &CacheEntries()
+{
+    static std::map<std::string, std::shared_ptr<const V4L2DeviceCapabilities>> entries;
+    return entries;
+}
+
+std::shared_ptr<const V4L2DeviceCapabilities> V4L2CapabilityCache::Get(int fd, const std::string &directory, bool *cached)
+{
+    std::string key;
+    if (V4L2DeviceCapabilities::QueryKey(fd, key) != Error::Success)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<const V4L2DeviceCapabilities> capabilities = Lookup(key, directory);
+    if (cached != nullptr)
+    {
+        *cached = static_cast<bool>(capabilities);
+    }
+    if (capabilities)
+    {
+        return capabilities;
+    }
+
+    std::shared_ptr<V4L2DeviceCapabilities> enumerated = std::make_shared<V4L2DeviceCapabilities>();
+    if (V4L2DeviceCapabilities::Enumerate(fd, *enumerated) != Error::Success)
+    {
+        return nullptr;
+    }
+    Store(enumerated, directory);
+    return enumerated;
+}
+
+std::shared_ptr<const V4L2DeviceCapabilities> V4L2CapabilityCache::Lookup(const std::string &key, const std::string &directory)
+{
+    {
+        std::lock_guard<std::mutex> lock(CacheSync());
+        auto found = CacheEntries().find(key);
+        if (found != CacheEntries().end())
+        {
+            return found->second;
+        }
+    }
+    if (directory.empty())
+    {
+        return nullptr;
+    }
+
+    // 文件名中的字符被替换过，读取之后再比较完整的标识
+    std::shared_ptr<V4L2DeviceCapabilities> loaded = std::make_shared<V4L2DeviceCapabilities>();
+    if ((loaded->Load(FileName(key, directory)) != Error::Success) || (loaded->Key() != key))
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(CacheSync());
+    CacheEntries()[key] = loaded;
+    return loaded;
+}
+
+void V4L2CapabilityCache::Store(const std::shared_ptr<const V4L2DeviceCapabilities> &capabilities, const std::string &directory)
+{
+    if (!capabilities)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(CacheSync());
+        CacheEntries()[capabilities->Key()] = capabilities;
+    }
+    // 磁盘缓存只是加速，写入失败时下一次启动重新枚举
+    if (!directory.empty())
+    {
+        mkdir(directory.c_str(), 0755);
+        capabilities->Save(FileName(capabilities->Key(), directory));
+    }
+}
+
+void V4L2CapabilityCache::Invalidate(const std::string &key, const std::string &directory)
+{
+    {
+        std::lock_guard<std::mutex> lock(CacheSync());
+        CacheEntries().erase(key);
+    }
+    if (!directory.empty())
+    {
+        remove(FileName(key, directory).c_str());
+    }
+}
+
+std::string V4L2CapabilityCache::FileName(const std::string &key, const std::string &directory)
+{
+    std::string name = key;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        char c = name[i];
+        if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '.')))
+        {
+            name[i] = '_';
+        }
+    }
+    return directory + "/" + name + ".caps";
+}
+
+NAMESPACE_END
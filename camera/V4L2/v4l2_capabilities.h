@@ -0,0 +1,219 @@
+/**
+ * @file v4l2_capabilities.h
+ * @brief 摄像头支持的格式、尺寸和帧率，以及内存和磁盘缓存
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 23:58:37
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 23:58:37 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 设备能力模型和缓存，自动选择采集模式 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef V4L2_CAPABILITIES_H
+#define V4L2_CAPABILITIES_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "base_error.h"
+#include "v4l2_tools.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 帧间隔(秒)，numerator/denominator，帧率为其倒数
+ */
+struct V4L2FrameInterval
+{
+    V4L2FrameInterval(uint32_t numerator = 0, uint32_t denominator = 0) : Numerator(numerator), Denominator(denominator) {}
+
+    uint32_t Numerator;   ///< 分子
+    uint32_t Denominator; ///< 分母
+};
+
+/**
+ * @brief 一种格式下的一个帧尺寸以及该尺寸支持的帧间隔
+ * @details 步进或者连续的尺寸用最小值、最大值和步长表示，帧间隔按照最大尺寸枚举，
+ *          大尺寸的帧率通常更低，因此对范围内的尺寸是保守的
+ */
+struct V4L2FrameSize
+{
+    V4L2FrameSize() : Width(0), Height(0), MinWidth(0), MinHeight(0), StepWidth(0), StepHeight(0), IntervalRange(false) {}
+
+    uint32_t Width;                           ///< 宽度，步进尺寸为最大宽度
+    uint32_t Height;                          ///< 高度，步进尺寸为最大高度
+    uint32_t MinWidth;                        ///< 步进尺寸的最小宽度，离散尺寸与 Width 相同
+    uint32_t MinHeight;                       ///< 步进尺寸的最小高度，离散尺寸与 Height 相同
+    uint32_t StepWidth;                       ///< 宽度步长，离散尺寸为0
+    uint32_t StepHeight;                      ///< 高度步长，离散尺寸为0
+    bool IntervalRange;                       ///< Intervals 是否为[最小间隔, 最大间隔]的连续范围
+    std::vector<V4L2FrameInterval> Intervals; ///< 离散的帧间隔，为空表示驱动不支持枚举
+};
+
+/**
+ * @brief 设备输出的一种像素格式
+ */
+struct V4L2FormatCapability
+{
+    V4L2FormatCapability() : FourCC(0), Format(PixelFormat::Unknown) {}
+
+    uint32_t FourCC;                  ///< v4l2像素格式
+    PixelFormat Format;               ///< 对应的图像格式
+    std::vector<V4L2FrameSize> Sizes; ///< 支持的尺寸，为空表示驱动不支持枚举
+};
+
+/**
+ * @brief 选择的采集模式
+ */
+struct V4L2CaptureMode
+{
+    V4L2CaptureMode() : Format(PixelFormat::Unknown), Converted(PixelFormat::Unknown), Width(0), Height(0), Interval() {}
+
+    PixelFormat Format;         ///< 采集格式
+    PixelFormat Converted;      ///< 采集之后转换到的格式，JPEG 表示直接输出压缩帧
+    uint32_t Width;             ///< 请求的宽度
+    uint32_t Height;            ///< 请求的高度
+    V4L2FrameInterval Interval; ///< 请求的帧间隔，为0表示不设置
+};
+
+/**
+ * @brief 一个设备的能力：格式 x 尺寸 x 帧间隔
+ * @details
+ *  Enumerate 通过 VIDIOC_ENUM_FMT/VIDIOC_ENUM_FRAMESIZES/VIDIOC_ENUM_FRAMEINTERVALS 构建，
+ *  只保留 V4L2ToPixelFormat 能够处理的格式。Key 由驱动、设备名称、总线位置和驱动版本组成，
+ *  同一个USB口上的同一个型号可以直接使用缓存的能力。
+ *  SelectMode 在所有 格式 x 尺寸 x 帧率 中选择满足请求的代价最小的模式
+ */
+class V4L2DeviceCapabilities
+{
+public:
+    V4L2DeviceCapabilities() : Version(0) {}
+    /**
+     * @brief  枚举设备的能力
+     * @param  fd               已经打开的设备
+     * @param  capabilities     枚举的结果
+     * @return Error            VIDIOC_QUERYCAP 失败时返回 DeviceNotReady
+     */
+    static Error Enumerate(int fd, V4L2DeviceCapabilities &capabilities);
+    /**
+     * @brief  读取设备的标识
+     * @param  fd               已经打开的设备
+     * @param  key              标识，同一个位置上的同一个设备相同
+     * @return Error            VIDIOC_QUERYCAP 失败时返回 DeviceNotReady
+     */
+    static Error QueryKey(int fd, std::string &key);
+    /**
+     * @brief  设备标识
+     * @return std::string      驱动/设备名称/总线位置/驱动版本
+     */
+    std::string Key() const;
+    /**
+     * @brief  设备输出的图像格式，按照驱动枚举的顺序
+     * @return std::vector<PixelFormat> 格式列表
+     */
+    std::vector<PixelFormat> PixelFormats() const;
+    /**
+     * @brief  选择采集模式
+     * @details
+     *  格式的优先级与 V4L2FormatRank 相同；依次比较：没有满足的条件(尺寸、帧率)的数量，格式的优先级，
+     *  尺寸与请求的差距，格式转换的代价，帧率与请求的差距。满足请求时选择不小于请求的最小尺寸和最低帧率，
+     *  不满足时选择最接近的。宽高为0时选择最大尺寸，帧率为0时选择最高帧率；驱动不能枚举尺寸时使用请求的尺寸
+     * @param  output           需要输出的格式，与 V4L2CameraData::OutputFormat 相同
+     * @param  width            请求的宽度
+     * @param  height           请求的高度
+     * @param  frameRate        请求的帧率
+     * @param  mode             选择的模式
+     * @return Error            没有可以转换到输出格式的采集格式时返回 UnsupportedPixelFormat
+     */
+    Error SelectMode(PixelFormat output, uint32_t width, uint32_t height, uint32_t frameRate, V4L2CaptureMode *mode) const;
+    /**
+     * @brief  输出为json，用于摄像头信息接口
+     * @return std::string      json对象
+     */
+    std::string ToJson() const;
+    /**
+     * @brief  保存到文件，每行一条记录
+     * @param  fileName         文件名
+     * @return Error            不能写入时返回 IOError
+     */
+    Error Save(const std::string &fileName) const;
+    /**
+     * @brief  从 Save 保存的文件中读取
+     * @param  fileName         文件名
+     * @return Error            文件不存在返回 IOError，版本或者内容不正确返回 Failed
+     */
+    Error Load(const std::string &fileName);
+
+public:
+    std::string Driver;                         ///< 驱动名称
+    std::string Card;                           ///< 设备名称
+    std::string BusInfo;                        ///< 总线位置
+    uint32_t Version;                           ///< 驱动版本
+    std::vector<V4L2FormatCapability> Formats;  ///< 支持的格式
+};
+
+/**
+ * @brief 设备能力缓存
+ * @details
+ *  内存中按照设备标识缓存，同一个进程中重新打开设备(冷备恢复、多个管理对象)时不再枚举；
+ *  指定目录时同时写入磁盘，每个设备一个文件，进程重启之后打开已知的设备只需要一次 VIDIOC_QUERYCAP。
+ *  缓存的模式设置失败时调用 Invalidate 重新枚举。所有函数线程安全
+ */
+class V4L2CapabilityCache
+{
+public:
+    V4L2CapabilityCache() = delete;
+
+public:
+    /**
+     * @brief  获取设备能力，依次查找内存、磁盘，都没有时枚举并写入缓存
+     * @param  fd               已经打开的设备
+     * @param  directory        磁盘缓存目录，为空时只使用内存缓存
+     * @param  cached           是否来自缓存，可以为空
+     * @return std::shared_ptr<const V4L2DeviceCapabilities> 设备能力，设备不可用时为空
+     */
+    static std::shared_ptr<const V4L2DeviceCapabilities> Get(int fd, const std::string &directory, bool *cached = nullptr);
+    /**
+     * @brief  只从缓存中查找
+     * @param  key              设备标识
+     * @param  directory        磁盘缓存目录，为空时只查找内存
+     * @return std::shared_ptr<const V4L2DeviceCapabilities> 没有缓存时为空
+     */
+    static std::shared_ptr<const V4L2DeviceCapabilities> Lookup(const std::string &key, const std::string &directory);
+    /**
+     * @brief  写入缓存
+     * @param  capabilities     设备能力
+     * @param  directory        磁盘缓存目录，为空时只写入内存；目录不存在时创建
+     */
+    static void Store(const std::shared_ptr<const V4L2DeviceCapabilities> &capabilities, const std::string &directory);
+    /**
+     * @brief  删除内存和磁盘中的缓存
+     * @param  key              设备标识
+     * @param  directory        磁盘缓存目录
+     */
+    static void Invalidate(const std::string &key, const std::string &directory);
+    /**
+     * @brief  磁盘缓存的文件名，标识中的非字母数字字符替换为下划线
+     * @param  key              设备标识
+     * @param  directory        磁盘缓存目录
+     * @return std::string      文件名
+     */
+    static std::string FileName(const std::string &key, const std::string &directory);
+};
+
+NAMESPACE_END
+
+#endif // V4L2_CAPABILITIES_H
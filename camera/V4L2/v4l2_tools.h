@@ -36,8 +36,10 @@
 #include <linux/videodev2.h>
 /*===== Linux header end ======*/
 
+#include <vector>
 #include "base_tool.h"
 #include "img_tools.h"
+#include "image_converter.h"
 
 NAMESPACE_START
 
@@ -96,168 +98,107 @@ inline void DecodeYuyvToRgb(const uint8_t *yuyvPtr,
     }
 };
 /**
- * @brief  将v4l2的fromat转换为string 
- * @param  fromat           基础格式
- * @return std::string      格式字符串
+ * @brief  v4l2的像素格式转换为图像格式
+ * @param  fourcc           v4l2像素格式
+ * @return PixelFormat      图像格式，不支持时为 Unknown
  */
-inline std::string V4L2pixelFormatToStr(__u32 fromat)
+inline PixelFormat V4L2ToPixelFormat(__u32 fourcc)
 {
-    std::string result = "";
-    int count = 4;
-    while (count)
+    switch (fourcc)
     {
-        char temp = (char)(fromat & 0xFF);
-        result += temp;
-        fromat >>= 8;
-        --count;
+    case V4L2_PIX_FMT_MJPEG:
+        return PixelFormat::JPEG;
+    case V4L2_PIX_FMT_YUYV:
+        return PixelFormat::YUYV;
+    case V4L2_PIX_FMT_NV12:
+        return PixelFormat::NV12;
+    case V4L2_PIX_FMT_YUV420:
+        return PixelFormat::I420;
+    case V4L2_PIX_FMT_GREY:
+        return PixelFormat::Grayscale8;
+    default:
+        return PixelFormat::Unknown;
     }
-    return result;
 }
 /**
- * @brief  枚举设备支持的帧率
- * @param  dev              设备编号
- * @param  pixfmt           格式数据
- * @param  width            宽度
- * @param  height           高度
- * @return int              错误具柄信息
+ * @brief  图像格式转换为v4l2的像素格式
+ * @param  format           图像格式
+ * @return __u32            v4l2像素格式，不支持时为0
  */
-inline int enum_frame_intervals(int dev, __u32 pixfmt, __u32 width, __u32 height)
+inline __u32 PixelFormatToV4L2(PixelFormat format)
 {
-    int ret;
-    struct v4l2_frmivalenum fival;
-
-    memset(&fival, 0, sizeof(fival));
-    fival.index = 0;
-    fival.pixel_format = pixfmt;
-    fival.width = width;
-    fival.height = height;
-    printf("\tTime interval between frame: ");
-    while ((ret = ioctl(dev, VIDIOC_ENUM_FRAMEINTERVALS, &fival)) == 0)
+    switch (format)
     {
-        if (fival.type == V4L2_FRMIVAL_TYPE_DISCRETE)
-        {
-            printf("%u/%u, ",
-                   fival.discrete.numerator, fival.discrete.denominator); //输出分数
-        }
-        else if (fival.type == V4L2_FRMIVAL_TYPE_CONTINUOUS)
-        {
-            printf("{min { %u/%u } .. max { %u/%u } }, ",
-                   fival.stepwise.min.numerator, fival.stepwise.min.numerator,
-                   fival.stepwise.max.denominator, fival.stepwise.max.denominator);
-            break;
-        }
-        else if (fival.type == V4L2_FRMIVAL_TYPE_STEPWISE)
-        {
-            printf("{min { %u/%u } .. max { %u/%u } / "
-                   "stepsize { %u/%u } }, ",
-                   fival.stepwise.min.numerator, fival.stepwise.min.denominator,
-                   fival.stepwise.max.numerator, fival.stepwise.max.denominator,
-                   fival.stepwise.step.numerator, fival.stepwise.step.denominator);
-            break;
-        }
-        fival.index++;
+    case PixelFormat::JPEG:
+        return V4L2_PIX_FMT_MJPEG;
+    case PixelFormat::YUYV:
+        return V4L2_PIX_FMT_YUYV;
+    case PixelFormat::NV12:
+        return V4L2_PIX_FMT_NV12;
+    case PixelFormat::I420:
+        return V4L2_PIX_FMT_YUV420;
+    case PixelFormat::Grayscale8:
+        return V4L2_PIX_FMT_GREY;
+    default:
+        return 0;
     }
-    printf("\n");
-    if (ret != 0 && errno != EINVAL)
-    {
-        printf("ERROR enumerating frame intervals: %d\n", errno);
-        return errno;
-    }
-
-    return 0;
-};
+}
 /**
- * @brief  输出格式支持的帧大小
- * @param  dev              设备文件符号编号
- * @param  pixfmt           图片格式
- * @return int              是否正常
+ * @brief  采集格式对于输出格式的优先级
+ * @details
+ *  - output 为JPEG时MJPEG的优先级最高，直接转发压缩帧；其他格式按照自动选择处理
+ *  - output 为 Unknown 时自动选择：NV12/I420/灰度直接输出，JpegEncoder 可以直接编码；
+ *    YUYV 转换为I420，比转换为RGB再由libjpeg转换回YCbCr少一半以上的计算；MJPEG的优先级最低
+ *  - 其他格式只能使用可以转换的原始格式
+ * @param  capture          采集格式
+ * @param  output           需要输出的格式
+ * @param  tier             优先级，越小越好
+ * @param  cost             同一优先级中 ImageConverter::ConversionCost 的转换代价
+ * @param  converted        采集之后输出的格式，JPEG 表示直接输出压缩帧
+ * @return true             可以使用
+ * @return false            不能转换到输出格式
  */
-inline int enum_frame_sizes(int dev, __u32 pixfmt)
+inline bool V4L2FormatRank(PixelFormat capture, PixelFormat output, uint32_t *tier, uint32_t *cost, PixelFormat *converted)
 {
-    int ret;
-    struct v4l2_frmsizeenum fsize;
+    bool automatic = (output == PixelFormat::JPEG) || (output == PixelFormat::Unknown);
 
-    memset(&fsize, 0, sizeof(fsize));
-    fsize.index = 0;
-    fsize.pixel_format = pixfmt;
-    while ((ret = ioctl(dev, VIDIOC_ENUM_FRAMESIZES, &fsize)) == 0)
+    if (capture == PixelFormat::JPEG)
     {
-        if (fsize.type == V4L2_FRMSIZE_TYPE_DISCRETE)
-        {
-            printf("{ discrete: width = %u, height = %u }\n",
-                   fsize.discrete.width, fsize.discrete.height);
-            ret = enum_frame_intervals(dev, pixfmt,
-                                       fsize.discrete.width, 
-                                       fsize.discrete.height); //查找设备支持的 帧的间隔时间
-            if (ret != 0)
-                printf("  Unable to enumerate frame sizes.\n");
-        }
-        else if (fsize.type == V4L2_FRMSIZE_TYPE_CONTINUOUS)
-        {
-            printf("{ continuous: min { width = %u, height = %u } .. "
-                   "max { width = %u, height = %u } }\n",
-                   fsize.stepwise.min_width, fsize.stepwise.min_height,
-                   fsize.stepwise.max_width, fsize.stepwise.max_height);
-            printf("  Refusing to enumerate frame intervals.\n");
-            break;
-        }
-        else if (fsize.type == V4L2_FRMSIZE_TYPE_STEPWISE)
-        {
-            printf("{ stepwise: min { width = %u, height = %u } .. "
-                   "max { width = %u, height = %u } / "
-                   "stepsize { width = %u, height = %u } }\n",
-                   fsize.stepwise.min_width, fsize.stepwise.min_height,
-                   fsize.stepwise.max_width, fsize.stepwise.max_height,
-                   fsize.stepwise.step_width, fsize.stepwise.step_height);
-            printf("  Refusing to enumerate frame intervals.\n");
-            break;
-        }
-        fsize.index++;
+        *tier = (output == PixelFormat::JPEG) ? 0 : 1;
+        *cost = 0;
+        *converted = PixelFormat::JPEG;
+        return automatic;
     }
-    if (ret != 0 && errno != EINVAL)
+
+    // 按照转换到I420的代价：I420 < NV12 < YUYV < 灰度
+    uint32_t conversion = ImageConverter::ConversionCost(capture, (automatic) ? PixelFormat::I420 : output);
+    if (conversion == IMAGE_CONVERSION_UNSUPPORTED)
     {
-        printf("ERROR enumerating frame sizes: %d\n", errno);
-        return errno;
+        return false;
     }
-
-    return 0;
-};
+    *tier = (output == PixelFormat::JPEG) ? 1 : 0;
+    *cost = conversion;
+    *converted = (!automatic) ? output : (capture == PixelFormat::YUYV) ? PixelFormat::I420 : capture;
+    return true;
+}
 /**
- * @brief  获取v4l2支持的图片格式
- * @param  fd               设备文件描述符编号
- * @param  result           支持的图片结果
- * @return int              是否执行成功
+ * @brief  将v4l2的fromat转换为string 
+ * @param  fromat           基础格式
+ * @return std::string      格式字符串
  */
-inline int V4L2GetSuportFormat(int fd, std::string &result)
+inline std::string V4L2pixelFormatToStr(__u32 fromat)
 {
-    int ret = 0;
-    /* 查询摄像头可捕捉的图片类型，VIDIOC_ENUM_FMT: 枚举摄像头帧格式 */
-    struct v4l2_fmtdesc fmt;
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.index = 0;
-    // 指定需要枚举的类型
-    while ((ret = ioctl(fd, VIDIOC_ENUM_FMT, &fmt)) == 0) // 有可能摄像头支持的图片格式不止一种
-    {
-        fmt.index++;
-        /* 打印摄像头图片格式 */
-        printf("pixelformat = '%c%c%c%c', description = '%s' \n",
-               fmt.pixelformat & 0xFF, (fmt.pixelformat >> 8) & 0xFF,
-               (fmt.pixelformat >> 16) & 0xFF, (fmt.pixelformat >> 24) & 0xFF,
-               fmt.description);
-        /* 查询支持的分辨率 */
-        ret = enum_frame_sizes(fd, fmt.pixelformat); // 列举该格式下的帧大小
-        if (ret != 0)
-        {
-            printf("  Unable to enumerate frame sizes.\n");
-        }
-    }
-    if (errno != EINVAL)
+    std::string result = "";
+    int count = 4;
+    while (count)
     {
-        printf("ERROR enumerating frame formats: %d\n", errno);
-        return errno;
+        char temp = (char)(fromat & 0xFF);
+        result += temp;
+        fromat >>= 8;
+        --count;
     }
-    return 0;
-};
+    return result;
+}
 
 NAMESPACE_END
 #endif // V4L2_TOOLS_H
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "file_video_source.h"
+#include "base_trace.h"
+
+NAMESPACE_START
+
+namespace
+{
+inline uint32_t GetU32(const uint8_t *ptr)
+{
+    return static_cast<uint32_t>(ptr[0]) | (static_cast<uint32_t>(ptr[1]) << 8) |
+           (static_cast<uint32_t>(ptr[2]) << 16) | (static_cast<uint32_t>(ptr[3]) << 24);
+}
+
+inline bool IsFourCC(const uint8_t *ptr, const char *fourcc)
+{
+    return memcmp(ptr, fourcc, 4) == 0;
+}
+
+bool HasSuffix(const std::string &str, const char *suffix)
+{
+    size_t length = strlen(suffix);
+    return (str.size() >= length) && (strcasecmp(str.c_str() + str.size() - length, suffix) == 0);
+}
+} // namespace
+
+FileVideoSource::FileVideoSource() : ThreadedVideoSource(),
+                                     mFileName(),
+                                     mLoop(true),
+                                     mUseFileFrameRate(true),
+                                     mMapped(nullptr),
+                                     mMappedSize(0),
+                                     mFileFrameInterval(0),
+                                     mJpegFrames(),
+                                     mFrames(),
+                                     mFrameCount(0),
+                                     mPosition(0)
+{
+}
+
+FileVideoSource::~FileVideoSource()
+{
+    WaitForStop();
+}
+
+const std::shared_ptr<FileVideoSource> FileVideoSource::Create()
+{
+    return std::shared_ptr<FileVideoSource>(new FileVideoSource);
+}
+
+void FileVideoSource::SetFileName(const std::string &fileName)
+{
+    mFileName = fileName;
+}
+
+void FileVideoSource::SetLoop(bool loop)
+{
+    mLoop = loop;
+}
+
+void FileVideoSource::SetUseFileFrameRate(bool useFileFrameRate)
+{
+    mUseFileFrameRate = useFileFrameRate;
+}
+
+uint32_t FileVideoSource::FrameCount() const
+{
+    return mFrameCount;
+}
+
+bool FileVideoSource::OpenSource()
+{
+    struct stat fileStat;
+    int fd = open(mFileName.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+    {
+        NotifyError("Failed opening file " + mFileName, true);
+        return false;
+    }
+    if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size == 0))
+    {
+        close(fd);
+        NotifyError("Failed reading file " + mFileName, true);
+        return false;
+    }
+
+    mMappedSize = static_cast<size_t>(fileStat.st_size);
+    void *mapped = mmap(nullptr, mMappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        mMappedSize = 0;
+        NotifyError("Failed mapping file " + mFileName, true);
+        return false;
+    }
+    mMapped = static_cast<uint8_t *>(mapped);
+    // 顺序回放，让内核提前读取
+    madvise(mMapped, mMappedSize, MADV_SEQUENTIAL);
+
+    mFileFrameInterval = 0;
+    mPosition = 0;
+    bool parsed = HasSuffix(mFileName, ".avi") ? ParseAvi() : ParseMjpeg();
+    mFrameCount = static_cast<uint32_t>(mFrames.size());
+    if ((!parsed) || (mFrames.empty()))
+    {
+        NotifyError("No video frames found in " + mFileName, true);
+        return false;
+    }
+    if ((mUseFileFrameRate) && (mFileFrameInterval > 0))
+    {
+        SetFrameRate((1000000 + mFileFrameInterval / 2) / mFileFrameInterval);
+    }
+    return true;
+}
+
+bool FileVideoSource::NextFrame(std::shared_ptr<const Image> & /* image */, std::shared_ptr<const EncodedFrame> &frame)
+{
+    struct timeval now;
+
+    if (mPosition >= mFrames.size())
+    {
+        if (!mLoop)
+        {
+            return false;
+        }
+        mPosition = 0;
+    }
+
+    const std::shared_ptr<EncodedFrame> &jpeg = mJpegFrames[mFrames[mPosition++]];
+    gettimeofday(&now, nullptr);
+    jpeg->SetTimeStamp(now);
+    jpeg->SetSequence(FrameTrace::NextFrameId());
+    frame = jpeg;
+    return true;
+}
+
+void FileVideoSource::CloseSource()
+{
+    // 压缩帧直接引用映射的内存，先释放压缩帧
+    mJpegFrames.clear();
+    mFrames.clear();
+    if (mMapped != nullptr)
+    {
+        munmap(mMapped, mMappedSize);
+        mMapped = nullptr;
+        mMappedSize = 0;
+    }
+}
+
+void FileVideoSource::AddFrame(uint8_t *data, uint32_t size)
+{
+    if (size == 0)
+    {
+        if (!mJpegFrames.empty())
+        {
+            mFrames.push_back(static_cast<uint32_t>(mJpegFrames.size() - 1));
+        }
+        return;
+    }
+
+    std::shared_ptr<EncodedFrame> jpeg = EncodedFrame::Create(data, size, FrameCodec::JPEG);
+    if ((jpeg) && (jpeg->SetSize(size) == Error::Success))
+    {
+        jpeg->SetKeyFrame(true);
+        mJpegFrames.push_back(jpeg);
+        mFrames.push_back(static_cast<uint32_t>(mJpegFrames.size() - 1));
+    }
+}
+
+// 顺序遍历所有数据块，进入每一个LIST；录制中断的文件头部大小不正确，只以文件大小为界
+bool FileVideoSource::ParseAvi()
+{
+    size_t pos = 12;
+
+    if ((mMappedSize < pos) || (!IsFourCC(mMapped, "RIFF")) || (!IsFourCC(mMapped + 8, "AVI ")))
+    {
+        return false;
+    }
+
+    while (pos + 8 <= mMappedSize)
+    {
+        const uint8_t *chunk = mMapped + pos;
+        uint32_t size = GetU32(chunk + 4);
+
+        if (IsFourCC(chunk, "LIST"))
+        {
+            pos += 12;
+            continue;
+        }
+        if (pos + 8 + size > mMappedSize)
+        {
+            break;
+        }
+        if ((IsFourCC(chunk, "avih")) && (size >= 4))
+        {
+            mFileFrameInterval = GetU32(chunk + 8);
+        }
+        else if ((chunk[2] == 'd') && ((chunk[3] == 'c') || (chunk[3] == 'b')))
+        {
+            AddFrame(mMapped + pos + 8, size);
+        }
+        else if ((chunk[0] == 0) && (size == 0))
+        {
+            // 预分配但没有写入的区域
+            break;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return true;
+}
+
+bool FileVideoSource::ParseMjpeg()
+{
+    size_t pos = 0;
+
+    while (pos + 4 <= mMappedSize)
+    {
+        uint8_t *start = static_cast<uint8_t *>(memmem(mMapped + pos, mMappedSize - pos, "\xFF\xD8\xFF", 3));
+        if (start == nullptr)
+        {
+            break;
+        }
+        size_t begin = start - mMapped;
+        uint8_t *end = static_cast<uint8_t *>(memmem(start + 2, mMappedSize - begin - 2, "\xFF\xD9", 2));
+        if (end == nullptr)
+        {
+            break;
+        }
+        size_t finish = end - mMapped + 2;
+        AddFrame(start, static_cast<uint32_t>(finish - begin));
+        pos = finish;
+    }
+    return true;
+}
+
+NAMESPACE_END
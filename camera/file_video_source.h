@@ -0,0 +1,108 @@
+/**
+ * @file file_video_source.h
+ * @brief 回放录像文件的视频源，用于没有摄像头时的压力测试
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 18:06:12
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 18:06:12 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 回放 MJPEG/AVI 录像 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef FILE_VIDEO_SOURCE_H
+#define FILE_VIDEO_SOURCE_H
+
+#include <vector>
+#include "threaded_video_source.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 录像文件视频源
+ * @details
+ *  支持 FrameRecorder 录制的AVI文件(包括没有正常结束、缺少索引的文件)和连续jpeg组成的MJPEG文件，
+ *  MJPEG文件中jpeg之间的其它数据(如 multipart 的分隔符)会被忽略。
+ *  文件通过 mmap 映射，每一帧直接包装映射的内存，回放时没有拷贝和解码，输出格式与摄像头的jpeg模式相同。
+ *  AVI中的空数据块表示重复上一帧
+ */
+class FileVideoSource : public ThreadedVideoSource
+{
+protected:
+    FileVideoSource();
+
+public:
+    ~FileVideoSource();
+    /**
+     * @brief  创建文件视频源
+     * @return const std::shared_ptr<FileVideoSource> 视频源
+     */
+    static const std::shared_ptr<FileVideoSource> Create();
+    /**
+     * @brief 设置文件名称，启动之前设置
+     * @param  fileName         文件名称，.avi 结尾的文件按照AVI解析，否则按照MJPEG解析
+     */
+    void SetFileName(const std::string &fileName);
+    /**
+     * @brief 设置是否循环播放，默认循环
+     * @param  loop             到达文件末尾时是否从头开始
+     */
+    void SetLoop(bool loop);
+    /**
+     * @brief 设置是否使用AVI文件中的帧率，默认使用；MJPEG文件没有帧率，总是使用 SetFrameRate 设置的帧率
+     * @param  useFileFrameRate 是否使用文件中的帧率
+     */
+    void SetUseFileFrameRate(bool useFileFrameRate);
+    /**
+     * @brief  文件中的帧数，启动之后有效
+     * @return uint32_t 帧数，包括重复帧
+     */
+    uint32_t FrameCount() const;
+
+protected:
+    bool OpenSource();
+    bool NextFrame(std::shared_ptr<const Image> &image, std::shared_ptr<const EncodedFrame> &frame);
+    void CloseSource();
+
+private:
+    /**
+     * @brief 解析AVI文件的数据块
+     */
+    bool ParseAvi();
+    /**
+     * @brief 按照SOI/EOI标记查找所有的jpeg
+     */
+    bool ParseMjpeg();
+    /**
+     * @brief 添加一帧，size为0时重复上一帧
+     */
+    void AddFrame(uint8_t *data, uint32_t size);
+
+private:
+    std::string mFileName;                              ///< 文件名称
+    bool mLoop;                                         ///< 是否循环播放
+    bool mUseFileFrameRate;                             ///< 是否使用文件中的帧率
+    uint8_t *mMapped;                                   ///< 映射的文件内存
+    size_t mMappedSize;                                 ///< 映射的大小
+    uint32_t mFileFrameInterval;                        ///< 文件中的帧间隔(微秒)，0 表示没有
+    std::vector<std::shared_ptr<EncodedFrame> > mJpegFrames; ///< 不重复的帧
+    std::vector<uint32_t> mFrames;                      ///< 播放顺序，为 mJpegFrames 的下标
+    std::atomic<uint32_t> mFrameCount;                  ///< 帧数
+    size_t mPosition;                                   ///< 下一帧在 mFrames 中的位置
+};
+
+NAMESPACE_END
+
+#endif // FILE_VIDEO_SOURCE_H
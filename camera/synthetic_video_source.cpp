@@ -0,0 +1,347 @@
+#include <string.h>
+#include <sys/time.h>
+#include "synthetic_video_source.h"
+#include "jpeg_encoder.h"
+#include "image_converter.h"
+#include "img_tools.h"
+#include "v4l2_tools.h"
+#include "base_trace.h"
+
+NAMESPACE_START
+
+namespace
+{
+// 彩条颜色：白、黄、青、绿、品红、红、蓝、黑
+const uint8_t BAR_COLORS[8][3] = {
+    {235, 235, 235}, {235, 235, 16}, {16, 235, 235}, {16, 235, 16},
+    {235, 16, 235}, {235, 16, 16}, {16, 16, 235}, {16, 16, 16}};
+// 帧序号条纹的位数和高度
+const uint32_t COUNTER_BITS = 32;
+const uint32_t COUNTER_HEIGHT = 8;
+
+inline uint8_t ClampToByte(int value)
+{
+    return static_cast<uint8_t>((value > 255) ? 255 : ((value < 0) ? 0 : value));
+}
+
+// 与 DecodeYuyvToRgb 使用相同的全范围系数，往返转换之后颜色基本不变
+inline void RgbToYuv(const uint8_t *rgb, int &y, int &u, int &v)
+{
+    int r = rgb[RedIndex], g = rgb[GreenIndex], b = rgb[BlueIndex];
+
+    y = (77 * r + 150 * g + 29 * b) >> 8;
+    u = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+    v = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+}
+} // namespace
+
+SyntheticVideoSource::SyntheticVideoSource() : ThreadedVideoSource(),
+                                               mWidth(640),
+                                               mHeight(480),
+                                               mFormat(SyntheticFormat::RGB24),
+                                               mJpegQuality(85),
+                                               mFrameIndex(0),
+                                               mBackground(),
+                                               mYuyvFrame(),
+                                               mPlanarBackground(),
+                                               mImage(),
+                                               mPool(),
+                                               mJpegFrames()
+{
+}
+
+SyntheticVideoSource::~SyntheticVideoSource()
+{
+    WaitForStop();
+}
+
+const std::shared_ptr<SyntheticVideoSource> SyntheticVideoSource::Create()
+{
+    return std::shared_ptr<SyntheticVideoSource>(new SyntheticVideoSource);
+}
+
+void SyntheticVideoSource::SetVideoSize(uint32_t width, uint32_t height)
+{
+    mWidth = (width + 1) & ~1u;
+    mHeight = height;
+}
+
+void SyntheticVideoSource::SetOutputFormat(SyntheticFormat format)
+{
+    mFormat = format;
+}
+
+void SyntheticVideoSource::SetJpegQuality(uint16_t quality)
+{
+    mJpegQuality = quality;
+}
+
+uint32_t SyntheticVideoSource::Width() const
+{
+    return mWidth;
+}
+
+uint32_t SyntheticVideoSource::Height() const
+{
+    return mHeight;
+}
+
+bool SyntheticVideoSource::OpenSource()
+{
+    if ((mWidth < 2 * COUNTER_BITS) || (mHeight < 4 * COUNTER_HEIGHT))
+    {
+        NotifyError("Video size is too small", true);
+        return false;
+    }
+
+    // 上面是彩条，下面是灰度渐变
+    std::vector<uint8_t> rgb(mWidth * mHeight * 3);
+    uint32_t barHeight = mHeight * 2 / 3;
+    for (uint32_t y = 0; y < mHeight; y++)
+    {
+        uint8_t *row = &rgb[y * mWidth * 3];
+        for (uint32_t x = 0; x < mWidth; x++, row += 3)
+        {
+            if (y < barHeight)
+            {
+                const uint8_t *color = BAR_COLORS[x * 8 / mWidth];
+                row[RedIndex] = color[0];
+                row[GreenIndex] = color[1];
+                row[BlueIndex] = color[2];
+            }
+            else
+            {
+                row[RedIndex] = row[GreenIndex] = row[BlueIndex] = static_cast<uint8_t>(x * 255 / (mWidth - 1));
+            }
+        }
+    }
+
+    mFrameIndex = 0;
+    mJpegFrames.clear();
+    PixelFormat format = (mFormat == SyntheticFormat::NV12) ? PixelFormat::NV12
+                         : (mFormat == SyntheticFormat::I420) ? PixelFormat::I420
+                         : (mFormat == SyntheticFormat::Grayscale) ? PixelFormat::Grayscale8
+                                                                   : PixelFormat::RGB24;
+    mImage = Image::Allocate(mWidth, mHeight, format);
+    if (!mImage)
+    {
+        NotifyError("Failed allocating an image", true);
+        return false;
+    }
+
+    if (mFormat != SyntheticFormat::RGB24 && mFormat != SyntheticFormat::JPEG)
+    {
+        // 背景保存为YUYV，YUYV格式每一帧在YUYV上绘制，再转换为RGB
+        mBackground.resize(mWidth * mHeight * 2);
+        for (size_t i = 0; i < mWidth * mHeight; i += 2)
+        {
+            int y0, u0, v0, y1, u1, v1;
+            RgbToYuv(&rgb[i * 3], y0, u0, v0);
+            RgbToYuv(&rgb[i * 3 + 3], y1, u1, v1);
+            mBackground[i * 2] = ClampToByte(y0);
+            mBackground[i * 2 + 1] = ClampToByte((u0 + u1) / 2);
+            mBackground[i * 2 + 2] = ClampToByte(y1);
+            mBackground[i * 2 + 3] = ClampToByte((v0 + v1) / 2);
+        }
+        if (mFormat == SyntheticFormat::YUYV)
+        {
+            mYuyvFrame.resize(mBackground.size());
+            return true;
+        }
+
+        // 平面格式的背景由YUYV背景转换一次，每一帧直接在输出图像上绘制
+        std::shared_ptr<Image> yuyv = Image::Create(&mBackground[0], mWidth, mHeight, mWidth * 2, PixelFormat::YUYV);
+        mPlanarBackground = Image::Allocate(mWidth, mHeight, format);
+        if ((!yuyv) || (!mPlanarBackground) || (ImageConverter::Convert(yuyv, mPlanarBackground) != Error::Success))
+        {
+            NotifyError("Failed allocating an image", true);
+            return false;
+        }
+        std::vector<uint8_t>().swap(mBackground);
+        return true;
+    }
+
+    mBackground.swap(rgb);
+    if (mFormat == SyntheticFormat::JPEG)
+    {
+        // 编码开销不计入视频源，预先编码一组帧循环发送，与摄像头直接输出jpeg时相同
+        JpegEncoder encoder(mJpegQuality);
+        // 与多数MJPEG摄像头相同，每行MCU之后插入重启标记
+        encoder.SetRestartRows(1);
+        for (uint32_t i = 0; i < SYNTHETIC_JPEG_FRAMES; i++)
+        {
+            std::shared_ptr<EncodedFrame> jpeg;
+            DrawRgbFrame(mImage->Data(), mImage->Stride(), i);
+            if (encoder.EncodeToFrame(mImage, mPool, jpeg) != Error::Success)
+            {
+                NotifyError("Failed encoding test pattern", true);
+                return false;
+            }
+            mJpegFrames.push_back(jpeg);
+        }
+        mImage.reset();
+    }
+    return true;
+}
+
+bool SyntheticVideoSource::NextFrame(std::shared_ptr<const Image> &image, std::shared_ptr<const EncodedFrame> &frame)
+{
+    struct timeval now;
+
+    gettimeofday(&now, nullptr);
+    if (mFormat == SyntheticFormat::JPEG)
+    {
+        const std::shared_ptr<EncodedFrame> &jpeg = mJpegFrames[mFrameIndex % mJpegFrames.size()];
+        jpeg->SetTimeStamp(now);
+        jpeg->SetSequence(FrameTrace::NextFrameId());
+        frame = jpeg;
+    }
+    else
+    {
+        if (mFormat == SyntheticFormat::YUYV)
+        {
+            DrawYuyvFrame(&mYuyvFrame[0], mFrameIndex);
+            DecodeYuyvToRgb(&mYuyvFrame[0], mImage->Data(), mWidth, mHeight, mImage->Stride());
+        }
+        else if (mPlanarBackground)
+        {
+            DrawPlanarFrame(mImage, mFrameIndex);
+        }
+        else
+        {
+            DrawRgbFrame(mImage->Data(), mImage->Stride(), mFrameIndex);
+        }
+        mImage->UpdateTimeStamp(now);
+        mImage->SetFrameId(FrameTrace::NextFrameId());
+        image = mImage;
+    }
+
+    mFrameIndex++;
+    return true;
+}
+
+void SyntheticVideoSource::CloseSource()
+{
+    mImage.reset();
+    mPlanarBackground.reset();
+    mJpegFrames.clear();
+    std::vector<uint8_t>().swap(mBackground);
+    std::vector<uint8_t>().swap(mYuyvFrame);
+}
+
+// 方块每帧水平移动4个像素，顶部条纹为帧序号的二进制，白色为1
+void SyntheticVideoSource::DrawRgbFrame(uint8_t *rgb, int32_t stride, uint64_t index) const
+{
+    uint32_t rowSize = mWidth * 3;
+    uint32_t boxSize = mHeight / 4;
+    uint32_t boxX = static_cast<uint32_t>((index * 4) % (mWidth - boxSize));
+    uint32_t boxY = (mHeight - boxSize) / 2;
+    uint32_t bitWidth = mWidth / COUNTER_BITS;
+
+    for (uint32_t y = 0; y < mHeight; y++)
+    {
+        uint8_t *row = rgb + y * stride;
+        memcpy(row, &mBackground[y * rowSize], rowSize);
+        if (y < COUNTER_HEIGHT)
+        {
+            for (uint32_t bit = 0; bit < COUNTER_BITS; bit++)
+            {
+                uint8_t value = ((index >> (COUNTER_BITS - 1 - bit)) & 1) ? 255 : 0;
+                memset(row + bit * bitWidth * 3, value, bitWidth * 3);
+            }
+        }
+        else if ((y >= boxY) && (y < boxY + boxSize))
+        {
+            memset(row + boxX * 3, 255, boxSize * 3);
+        }
+    }
+}
+
+void SyntheticVideoSource::DrawYuyvFrame(uint8_t *yuyv, uint64_t index) const
+{
+    uint32_t rowSize = mWidth * 2;
+    uint32_t boxSize = (mHeight / 4) & ~1u;
+    uint32_t boxX = static_cast<uint32_t>((index * 4) % (mWidth - boxSize)) & ~1u;
+    uint32_t boxY = (mHeight - boxSize) / 2;
+    uint32_t bitWidth = (mWidth / COUNTER_BITS) & ~1u;
+
+    memcpy(yuyv, &mBackground[0], mBackground.size());
+    for (uint32_t y = 0; y < mHeight; y++)
+    {
+        uint8_t *row = yuyv + y * rowSize;
+        uint32_t start = 0, end = 0;
+        uint8_t luma = 255;
+
+        if (y < COUNTER_HEIGHT)
+        {
+            for (uint32_t bit = 0; bit < COUNTER_BITS; bit++)
+            {
+                luma = ((index >> (COUNTER_BITS - 1 - bit)) & 1) ? 255 : 0;
+                for (uint32_t x = bit * bitWidth; x < (bit + 1) * bitWidth; x += 2)
+                {
+                    row[x * 2] = row[x * 2 + 2] = luma;
+                    row[x * 2 + 1] = row[x * 2 + 3] = 128;
+                }
+            }
+            continue;
+        }
+        if ((y >= boxY) && (y < boxY + boxSize))
+        {
+            start = boxX;
+            end = boxX + boxSize;
+        }
+        for (uint32_t x = start; x < end; x += 2)
+        {
+            row[x * 2] = row[x * 2 + 2] = luma;
+            row[x * 2 + 1] = row[x * 2 + 3] = 128;
+        }
+    }
+}
+
+// 与YUYV相同的图案，Y平面写入亮度，条纹和方块覆盖的色度为中性值
+void SyntheticVideoSource::DrawPlanarFrame(const std::shared_ptr<Image> &image, uint64_t index) const
+{
+    uint32_t boxSize = (mHeight / 4) & ~1u;
+    uint32_t boxX = static_cast<uint32_t>((index * 4) % (mWidth - boxSize)) & ~1u;
+    uint32_t boxY = ((mHeight - boxSize) / 2) & ~1u;
+    uint32_t bitWidth = (mWidth / COUNTER_BITS) & ~1u;
+    bool nv12 = (image->Format() == PixelFormat::NV12);
+    int32_t chromaPlanes = (image->Format() == PixelFormat::Grayscale8) ? 0 : (nv12) ? 1 : 2;
+
+    mPlanarBackground->CopyData(image);
+    for (uint32_t y = 0; y < mHeight; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        if (y < COUNTER_HEIGHT)
+        {
+            for (uint32_t bit = 0; bit < COUNTER_BITS; bit++)
+            {
+                memset(row + bit * bitWidth, ((index >> (COUNTER_BITS - 1 - bit)) & 1) ? 255 : 0, bitWidth);
+            }
+        }
+        else if ((y >= boxY) && (y < boxY + boxSize))
+        {
+            memset(row + boxX, 255, boxSize);
+        }
+    }
+
+    // 条纹和方块的坐标都是偶数，对应的色度区域为一半
+    for (int32_t plane = 1; plane <= chromaPlanes; plane++)
+    {
+        uint32_t scale = (nv12) ? 2 : 1;
+        for (uint32_t y = 0; y < mHeight / 2; y++)
+        {
+            uint8_t *row = image->Plane(plane) + y * image->PlaneStride(plane);
+            if (y < COUNTER_HEIGHT / 2)
+            {
+                memset(row, 128, COUNTER_BITS * bitWidth / 2 * scale);
+            }
+            else if ((y >= boxY / 2) && (y < (boxY + boxSize) / 2))
+            {
+                memset(row + boxX / 2 * scale, 128, boxSize / 2 * scale);
+            }
+        }
+    }
+}
+
+NAMESPACE_END
@@ -0,0 +1,132 @@
+/**
+ * @file synthetic_video_source.h
+ * @brief 产生运动测试图案的视频源，用于没有摄像头时的压力测试
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 17:52:40
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 17:52:40 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> RGB24/YUYV/JPEG 测试图案 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef SYNTHETIC_VIDEO_SOURCE_H
+#define SYNTHETIC_VIDEO_SOURCE_H
+
+#include <vector>
+#include "threaded_video_source.h"
+#include "image_pool.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 预先编码的JPEG帧数量，循环发送
+ */
+#define SYNTHETIC_JPEG_FRAMES (60)
+
+/**
+ * @brief 合成视频源的输出格式，模拟摄像头的不同工作方式
+ */
+enum class SyntheticFormat
+{
+    RGB24,     ///< 直接输出RGB图像
+    YUYV,      ///< 生成YUYV数据并在采集线程中转换为RGB，与 V4L2Camera 输出RGB24时的开销相同
+    JPEG,      ///< 输出预先编码的jpeg数据，与 V4L2Camera 的jpeg模式相同
+    NV12,      ///< 直接输出NV12图像，与输出NV12的摄像头自动选择格式时相同
+    I420,      ///< 直接输出I420图像
+    Grayscale, ///< 直接输出灰度图像
+};
+
+/**
+ * @brief 合成视频源
+ * @details
+ *  图案为彩条背景、水平移动的方块和按照帧序号变化的二进制条纹，每一帧的内容都不同。
+ *  背景在启动时生成一次，每一帧只复制背景并绘制运动部分，图案本身的开销远小于颜色转换和编码
+ */
+class SyntheticVideoSource : public ThreadedVideoSource
+{
+protected:
+    SyntheticVideoSource();
+
+public:
+    ~SyntheticVideoSource();
+    /**
+     * @brief  创建合成视频源
+     * @return const std::shared_ptr<SyntheticVideoSource> 视频源
+     */
+    static const std::shared_ptr<SyntheticVideoSource> Create();
+    /**
+     * @brief 设置图像尺寸，启动之前设置
+     * @param  width            宽度，按照2对齐
+     * @param  height           高度
+     */
+    void SetVideoSize(uint32_t width, uint32_t height);
+    /**
+     * @brief 设置输出格式，启动之前设置
+     * @param  format           输出格式
+     */
+    void SetOutputFormat(SyntheticFormat format);
+    /**
+     * @brief 设置JPEG格式的压缩质量，启动之前设置
+     * @param  quality          压缩质量
+     */
+    void SetJpegQuality(uint16_t quality);
+    /**
+     * @brief  图像宽度
+     * @return uint32_t 宽度
+     */
+    uint32_t Width() const;
+    /**
+     * @brief  图像高度
+     * @return uint32_t 高度
+     */
+    uint32_t Height() const;
+
+protected:
+    bool OpenSource();
+    bool NextFrame(std::shared_ptr<const Image> &image, std::shared_ptr<const EncodedFrame> &frame);
+    void CloseSource();
+
+private:
+    /**
+     * @brief 在RGB图像上绘制第index帧的运动部分
+     */
+    void DrawRgbFrame(uint8_t *rgb, int32_t stride, uint64_t index) const;
+    /**
+     * @brief 在YUYV数据上绘制第index帧的运动部分
+     */
+    void DrawYuyvFrame(uint8_t *yuyv, uint64_t index) const;
+    /**
+     * @brief 在NV12/I420/灰度图像上绘制第index帧的运动部分，背景从 mPlanarBackground 拷贝
+     */
+    void DrawPlanarFrame(const std::shared_ptr<Image> &image, uint64_t index) const;
+
+private:
+    uint32_t mWidth;                                      ///< 图像宽度
+    uint32_t mHeight;                                     ///< 图像高度
+    SyntheticFormat mFormat;                              ///< 输出格式
+    uint16_t mJpegQuality;                                ///< JPEG压缩质量
+    uint64_t mFrameIndex;                                 ///< 帧序号
+    std::vector<uint8_t> mBackground;                     ///< 背景，RGB24或者YUYV
+    std::vector<uint8_t> mYuyvFrame;                      ///< YUYV帧缓冲区
+    std::shared_ptr<Image> mPlanarBackground;             ///< NV12/I420/灰度格式的背景
+    std::shared_ptr<Image> mImage;                        ///< 输出的图像
+    ImagePool mPool;                                      ///< 预先编码的JPEG缓冲区
+    std::vector<std::shared_ptr<EncodedFrame> > mJpegFrames; ///< 预先编码的JPEG帧
+};
+
+NAMESPACE_END
+
+#endif // SYNTHETIC_VIDEO_SOURCE_H
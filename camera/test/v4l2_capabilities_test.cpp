@@ -0,0 +1,247 @@
+#include "v4l2_capabilities.h"
+#include "test_check.h"
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace MY_NAME_SPACE;
+
+static V4L2FrameSize DiscreteSize(uint32_t width, uint32_t height, uint32_t fps1, uint32_t fps2 = 0)
+{
+    V4L2FrameSize size;
+    size.Width = size.MinWidth = width;
+    size.Height = size.MinHeight = height;
+    size.Intervals.push_back(V4L2FrameInterval(1, fps1));
+    if (fps2 != 0)
+    {
+        size.Intervals.push_back(V4L2FrameInterval(1, fps2));
+    }
+    return size;
+}
+
+static V4L2FormatCapability Format(uint32_t fourcc, const V4L2FrameSize &size)
+{
+    V4L2FormatCapability format;
+    format.FourCC = fourcc;
+    format.Format = V4L2ToPixelFormat(fourcc);
+    format.Sizes.push_back(size);
+    return format;
+}
+
+static V4L2DeviceCapabilities Device(const std::string &card)
+{
+    V4L2DeviceCapabilities caps;
+    caps.Driver = "uvcvideo";
+    caps.Card = card;
+    caps.BusInfo = "usb-0000:00:14.0-1";
+    caps.Version = 330000;
+    return caps;
+}
+
+/* 满足请求时按照格式的优先级和转换代价选择 */
+void TestFormatPreference()
+{
+    V4L2DeviceCapabilities caps = Device("camera");
+    caps.Formats.push_back(Format(V4L2_PIX_FMT_MJPEG, DiscreteSize(640, 480, 30)));
+    caps.Formats.push_back(Format(V4L2_PIX_FMT_YUYV, DiscreteSize(640, 480, 30)));
+    caps.Formats.push_back(Format(V4L2_PIX_FMT_NV12, DiscreteSize(640, 480, 30)));
+
+    V4L2CaptureMode mode;
+    Check(caps.SelectMode(PixelFormat::Unknown, 640, 480, 30, &mode) == Error::Success, "select automatic");
+    Check((mode.Format == PixelFormat::NV12) && (mode.Converted == PixelFormat::NV12), "nv12 cheaper than yuyv and mjpeg");
+    Check((mode.Width == 640) && (mode.Height == 480) && (mode.Interval.Numerator == 1) && (mode.Interval.Denominator == 30), "mode size and interval");
+
+    Check(caps.SelectMode(PixelFormat::JPEG, 640, 480, 30, &mode) == Error::Success, "select jpeg");
+    Check((mode.Format == PixelFormat::JPEG) && (mode.Converted == PixelFormat::JPEG), "mjpeg preferred for jpeg output");
+
+    Check(caps.SelectMode(PixelFormat::RGB24, 640, 480, 30, &mode) == Error::Success, "select rgb");
+    Check((mode.Format != PixelFormat::JPEG) && (mode.Converted == PixelFormat::RGB24), "rgb output excludes mjpeg");
+
+    caps.Formats.erase(caps.Formats.begin() + 2);
+    Check(caps.SelectMode(PixelFormat::Unknown, 640, 480, 30, &mode) == Error::Success, "select yuyv");
+    Check((mode.Format == PixelFormat::YUYV) && (mode.Converted == PixelFormat::I420), "yuyv converted to i420");
+
+    caps.Formats.erase(caps.Formats.begin() + 1);
+    Check(caps.SelectMode(PixelFormat::RGB24, 640, 480, 30, &mode) == Error::UnsupportedPixelFormat, "mjpeg only cannot output rgb");
+    caps.Formats.clear();
+    Check(caps.SelectMode(PixelFormat::Unknown, 640, 480, 30, &mode) == Error::UnsupportedPixelFormat, "no formats");
+}
+
+/* 未满足的条件优先于格式：原始格式帧率不够时选择MJPEG */
+void TestConstraints()
+{
+    V4L2DeviceCapabilities caps = Device("camera");
+    V4L2FormatCapability yuyv = Format(V4L2_PIX_FMT_YUYV, DiscreteSize(640, 480, 30));
+    yuyv.Sizes.push_back(DiscreteSize(1280, 720, 10, 5));
+    caps.Formats.push_back(yuyv);
+    caps.Formats.push_back(Format(V4L2_PIX_FMT_MJPEG, DiscreteSize(1280, 720, 30, 15)));
+
+    V4L2CaptureMode mode;
+    Check(caps.SelectMode(PixelFormat::Unknown, 1280, 720, 25, &mode) == Error::Success, "select 720p");
+    Check((mode.Format == PixelFormat::JPEG) && (mode.Interval.Denominator == 30), "mjpeg meets the frame rate");
+    Check(caps.SelectMode(PixelFormat::Unknown, 1280, 720, 10, &mode) == Error::Success, "select 720p at 10");
+    Check((mode.Format == PixelFormat::YUYV) && (mode.Width == 1280) && (mode.Interval.Denominator == 10), "yuyv meets the lower frame rate");
+    Check(caps.SelectMode(PixelFormat::Unknown, 600, 400, 20, &mode) == Error::Success, "select small");
+    Check((mode.Format == PixelFormat::YUYV) && (mode.Width == 640) && (mode.Height == 480), "smallest size not below the request");
+
+    // 都不满足时选择最接近的
+    Check(caps.SelectMode(PixelFormat::RGB24, 1920, 1080, 60, &mode) == Error::Success, "select unmet");
+    Check((mode.Width == 1280) && (mode.Height == 720) && (mode.Interval.Denominator == 10), "closest size and frame rate");
+    // 不限制时选择最大尺寸和最高帧率
+    Check(caps.SelectMode(PixelFormat::JPEG, 0, 0, 0, &mode) == Error::Success, "select any");
+    Check((mode.Width == 1280) && (mode.Interval.Denominator == 30), "largest size and highest frame rate");
+}
+
+/* 步进尺寸、连续帧率以及驱动不能枚举尺寸 */
+void TestStepwise()
+{
+    V4L2DeviceCapabilities caps = Device("camera");
+    V4L2FrameSize size;
+    size.MinWidth = 160;
+    size.MinHeight = 120;
+    size.Width = 1920;
+    size.Height = 1080;
+    size.StepWidth = 16;
+    size.StepHeight = 8;
+    size.IntervalRange = true;
+    size.Intervals.push_back(V4L2FrameInterval(1, 60));
+    size.Intervals.push_back(V4L2FrameInterval(1, 5));
+    caps.Formats.push_back(Format(V4L2_PIX_FMT_YUV420, size));
+
+    V4L2CaptureMode mode;
+    Check(caps.SelectMode(PixelFormat::Unknown, 650, 481, 25, &mode) == Error::Success, "select stepwise");
+    Check((mode.Width == 656) && (mode.Height == 488), "size rounded up to the step");
+    Check((mode.Interval.Numerator == 1) && (mode.Interval.Denominator == 25), "requested rate inside the range");
+    Check(caps.SelectMode(PixelFormat::Unknown, 4000, 100, 100, &mode) == Error::Success, "select beyond range");
+    Check((mode.Width == 1920) && (mode.Height == 120) && (mode.Interval.Denominator == 60), "clamped to the range");
+    Check(caps.SelectMode(PixelFormat::Unknown, 640, 480, 2, &mode) == Error::Success, "select slow");
+    Check(mode.Interval.Denominator == 5, "slowest end of the range");
+
+    caps.Formats[0].Sizes.clear();
+    Check(caps.SelectMode(PixelFormat::Unknown, 800, 600, 30, &mode) == Error::Success, "select without sizes");
+    Check((mode.Width == 800) && (mode.Height == 600) && (mode.Interval.Numerator == 0), "requested size and no interval");
+}
+
+static V4L2DeviceCapabilities Sample(const std::string &card)
+{
+    V4L2DeviceCapabilities caps = Device(card);
+    V4L2FormatCapability mjpeg = Format(V4L2_PIX_FMT_MJPEG, DiscreteSize(640, 480, 30, 15));
+    mjpeg.Sizes.push_back(DiscreteSize(1280, 720, 30));
+    mjpeg.Sizes.push_back(V4L2FrameSize());
+    mjpeg.Sizes.back().Width = mjpeg.Sizes.back().MinWidth = 320;
+    mjpeg.Sizes.back().Height = mjpeg.Sizes.back().MinHeight = 240;
+    caps.Formats.push_back(mjpeg);
+
+    V4L2FrameSize stepwise;
+    stepwise.MinWidth = 48;
+    stepwise.MinHeight = 32;
+    stepwise.Width = 1280;
+    stepwise.Height = 960;
+    stepwise.StepWidth = 16;
+    stepwise.StepHeight = 16;
+    stepwise.IntervalRange = true;
+    stepwise.Intervals.push_back(V4L2FrameInterval(1, 30));
+    stepwise.Intervals.push_back(V4L2FrameInterval(2, 15));
+    caps.Formats.push_back(Format(V4L2_PIX_FMT_YUYV, stepwise));
+    caps.Formats.push_back(V4L2FormatCapability());
+    caps.Formats.back().FourCC = V4L2_PIX_FMT_GREY;
+    caps.Formats.back().Format = PixelFormat::Grayscale8;
+    return caps;
+}
+
+void TestJson()
+{
+    std::string json = Sample("HD \"USB\" Camera").ToJson();
+    Check(json.find("\"card\":\"HD \\\"USB\\\" Camera\"") != std::string::npos, "card escaped");
+    Check(json.find("\"version\":330000") != std::string::npos, "version");
+    Check(json.find("{\"fourcc\":\"MJPG\",\"sizes\":[{\"width\":640,\"height\":480,\"fps\":[30,15]}") != std::string::npos, "discrete size");
+    Check(json.find("{\"width\":320,\"height\":240,\"fps\":[]}") != std::string::npos, "size without intervals");
+    Check(json.find("\"min_width\":48,\"min_height\":32,\"max_width\":1280,\"max_height\":960,\"step_width\":16,\"step_height\":16,"
+                    "\"min_fps\":7.5,\"max_fps\":30") != std::string::npos,
+          "stepwise size and frame rate range");
+    Check(json.find("{\"fourcc\":\"GREY\",\"sizes\":[]}]}") != std::string::npos, "format without sizes");
+}
+
+void TestSaveLoad(const std::string &directory)
+{
+    std::string fileName = directory + "/sample.caps";
+    V4L2DeviceCapabilities caps = Sample("HD Camera");
+    V4L2DeviceCapabilities loaded;
+    Check(caps.Save(fileName) == Error::Success, "save");
+    Check(loaded.Load(fileName) == Error::Success, "load");
+    Check((loaded.Key() == caps.Key()) && (loaded.ToJson() == caps.ToJson()), "round trip");
+    Check((loaded.Formats.size() == 3) && (loaded.Formats[1].Sizes[0].IntervalRange) && (!loaded.Formats[0].Sizes[0].IntervalRange),
+          "interval range kept");
+
+    // 很长的名称超过读取缓冲区
+    caps.Card = std::string(600, 'c');
+    Check((caps.Save(fileName) == Error::Success) && (loaded.Load(fileName) == Error::Success) && (loaded.Card == caps.Card), "long line");
+
+    Check(loaded.Load(directory + "/missing.caps") == Error::IOError, "missing file");
+    FILE *file = fopen(fileName.c_str(), "w");
+    fputs("v4l2-capabilities 0\ndriver uvcvideo\n", file);
+    fclose(file);
+    Check(loaded.Load(fileName) == Error::Failed, "wrong version");
+    file = fopen(fileName.c_str(), "w");
+    fputs("v4l2-capabilities 1\ndriver uvcvideo\nformat 1196444237\nsize 640 480 640 480 0 0 0 2 1 30", file);
+    fclose(file);
+    Check(loaded.Load(fileName) == Error::Failed, "truncated file");
+    Check(loaded.Card == caps.Card, "failed load keeps the previous content");
+    remove(fileName.c_str());
+}
+
+void TestCache(const std::string &directory)
+{
+    std::shared_ptr<V4L2DeviceCapabilities> caps = std::make_shared<V4L2DeviceCapabilities>(Sample("Cache Camera"));
+    std::string key = caps->Key();
+    std::string fileName = V4L2CapabilityCache::FileName(key, directory);
+    Check(fileName == directory + "/uvcvideo_Cache_Camera_usb-0000_00_14.0-1_330000.caps", "file name sanitized");
+
+    Check(!V4L2CapabilityCache::Lookup(key, directory), "empty cache");
+    // 只有磁盘中有时读取文件
+    Check(caps->Save(fileName) == Error::Success, "save to cache directory");
+    std::shared_ptr<const V4L2DeviceCapabilities> found = V4L2CapabilityCache::Lookup(key, directory);
+    Check(found && (found->ToJson() == caps->ToJson()), "loaded from disk");
+    Check(V4L2CapabilityCache::Lookup(key, "") == found, "kept in memory");
+
+    V4L2CapabilityCache::Invalidate(key, directory);
+    Check(!V4L2CapabilityCache::Lookup(key, directory), "invalidated");
+    Check(access(fileName.c_str(), F_OK) != 0, "file removed");
+
+    // 写入时创建目录
+    std::string nested = directory + "/nested";
+    V4L2CapabilityCache::Store(caps, nested);
+    Check(V4L2CapabilityCache::Lookup(key, "") == caps, "stored in memory");
+    Check(access(V4L2CapabilityCache::FileName(key, nested).c_str(), F_OK) == 0, "stored on disk");
+    V4L2CapabilityCache::Invalidate(key, nested);
+    rmdir(nested.c_str());
+
+    // 文件内容属于其他设备时不使用
+    V4L2DeviceCapabilities other = Sample("Cache:Camera");
+    Check(other.Save(fileName) == Error::Success, "save other device");
+    Check(!V4L2CapabilityCache::Lookup(key, directory), "key mismatch ignored");
+    remove(fileName.c_str());
+}
+
+int main()
+{
+    char directory[] = "/tmp/v4l2_capabilities_testXXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        std::cout << "cannot create temporary directory" << std::endl;
+        return 1;
+    }
+
+    TestFormatPreference();
+    TestConstraints();
+    TestStepwise();
+    TestJson();
+    TestSaveLoad(directory);
+    TestCache(directory);
+    rmdir(directory);
+
+    return TestResult();
+}
@@ -0,0 +1,310 @@
+#include "synthetic_video_source.h"
+#include "file_video_source.h"
+#include "avi_writer.h"
+#include "video_frame_decorator.h"
+#include "test_check.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+using namespace MY_NAME_SPACE;
+
+/* 记录收到的帧，保存jpeg数据和相邻帧是否不同 */
+class RecordingListener : public VideoSourceListenerInterface
+{
+public:
+    RecordingListener() : Frames(0), ChangedFrames(0), Errors(0), Width(0), Height(0), Format(PixelFormat::Unknown),
+                          Codec(FrameCodec::Unknown), KeyFrames(0), LastSequence(0), SequenceErrors(0), KeepJpeg(false) {}
+
+    void OnNewImage(const std::shared_ptr<const Image> &image)
+    {
+        std::lock_guard<std::mutex> lock(Guard);
+        Record(std::string(reinterpret_cast<const char *>(image->Data()), image->Height() * image->Stride()));
+        Width = image->Width();
+        Height = image->Height();
+        Format = image->Format();
+    }
+
+    void OnNewEncodedFrame(const std::shared_ptr<const EncodedFrame> &frame)
+    {
+        std::lock_guard<std::mutex> lock(Guard);
+        std::string data(reinterpret_cast<const char *>(frame->Data()), frame->Size());
+
+        if (KeepJpeg)
+        {
+            Jpegs.push_back(data);
+        }
+        Record(data);
+        Codec = frame->Codec();
+        KeyFrames += (frame->IsKeyFrame()) ? 1 : 0;
+        // 序号在采集时分配，必须递增
+        if (frame->Sequence() <= LastSequence)
+        {
+            SequenceErrors++;
+        }
+        LastSequence = frame->Sequence();
+    }
+
+    void Record(std::string data)
+    {
+        if ((Frames > 0) && (data != Last))
+        {
+            ChangedFrames++;
+        }
+        Last.swap(data);
+        Frames++;
+    }
+
+    void OnError(const std::string &errorMessage, bool fatal)
+    {
+        std::lock_guard<std::mutex> lock(Guard);
+        std::cout << "source error: " << errorMessage << std::endl;
+        Errors++;
+    }
+
+    std::mutex Guard;
+    uint32_t Frames;
+    uint32_t ChangedFrames;
+    uint32_t Errors;
+    int32_t Width;
+    int32_t Height;
+    PixelFormat Format;
+    FrameCodec Codec;
+    uint32_t KeyFrames;
+    uint64_t LastSequence;
+    uint32_t SequenceErrors;
+    bool KeepJpeg;
+    std::string Last;
+    std::vector<std::string> Jpegs;
+};
+
+/* 不限速运行一段时间，检查格式和每一帧的内容都在变化，YUYV在视频源中转换为RGB */
+void TestSynthetic(SyntheticFormat format, const char *name, PixelFormat expected = PixelFormat::RGB24)
+{
+    std::shared_ptr<SyntheticVideoSource> source = SyntheticVideoSource::Create();
+    RecordingListener listener;
+
+    source->SetVideoSize(320, 240);
+    source->SetOutputFormat(format);
+    source->SetFrameRate(0);
+    source->SetListener(&listener);
+    Check(source->Start(), "synthetic source starts");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    source->SignalToStop();
+    source->WaitForStop();
+
+    std::cout << name << " unthrottled: " << listener.Frames << " frames in 300 ms" << std::endl;
+    Check(listener.Errors == 0, "synthetic source has no errors");
+    Check(listener.Frames > 10, "unthrottled source produces frames");
+    Check(listener.ChangedFrames + 1 >= listener.Frames, "every frame differs from the previous one");
+    if (format == SyntheticFormat::JPEG)
+    {
+        Check((listener.Codec == FrameCodec::JPEG) && (listener.Format == PixelFormat::Unknown), "jpeg frames are encoded frames");
+        Check(listener.KeyFrames == listener.Frames, "every jpeg frame is a key frame");
+        Check(listener.SequenceErrors == 0, "sequence numbers increase");
+        Check((listener.Last.size() > 2) && (static_cast<uint8_t>(listener.Last[0]) == 0xFF) &&
+                  (static_cast<uint8_t>(listener.Last[1]) == 0xD8),
+              "jpeg starts with SOI");
+    }
+    else
+    {
+        Check(listener.Format == expected, "image format");
+        Check((listener.Width == 320) && (listener.Height == 240), "image size");
+    }
+}
+
+/* 水印作为处理环节：图像原地修改，JPEG帧叠加之后转发 */
+void TestDecorator(SyntheticFormat format, const char *name)
+{
+    std::shared_ptr<SyntheticVideoSource> source = SyntheticVideoSource::Create();
+    VideoFrameDecorator decorator;
+    RecordingListener listener;
+
+    decorator.SetTimestampOverlay(true);
+    decorator.SetListener(&listener);
+    source->SetVideoSize(320, 240);
+    source->SetOutputFormat(format);
+    source->SetFrameRate(0);
+    source->SetListener(&decorator);
+    Check(source->Start(), "decorated source starts");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    source->SignalToStop();
+    source->WaitForStop();
+
+    std::cout << name << " decorated: " << listener.Frames << " frames in 300 ms" << std::endl;
+    Check(listener.Errors == 0, "decorated source has no errors");
+    Check(listener.Frames > 10, "decorated frames are forwarded");
+    if (format == SyntheticFormat::JPEG)
+    {
+        Check((listener.Codec == FrameCodec::JPEG) && (listener.KeyFrames == listener.Frames), "decorated jpeg frames");
+        Check(listener.SequenceErrors == 0, "decorated frames keep sequence numbers");
+        Check((listener.Last.size() > 2) && (static_cast<uint8_t>(listener.Last[0]) == 0xFF) &&
+                  (static_cast<uint8_t>(listener.Last[1]) == 0xD8),
+              "decorated jpeg starts with SOI");
+    }
+    else
+    {
+        // 左上角是白色背景的边框，平面格式为Y平面
+        Check((listener.Last.size() > 3) && (static_cast<uint8_t>(listener.Last[0]) == 255) &&
+                  (static_cast<uint8_t>(listener.Last[1]) == 255) && (static_cast<uint8_t>(listener.Last[2]) == 255),
+              "timestamp is drawn on image");
+    }
+}
+
+/* 按照帧率发送，处理时间不累积 */
+void TestFrameRate()
+{
+    std::shared_ptr<SyntheticVideoSource> source = SyntheticVideoSource::Create();
+    RecordingListener listener;
+
+    source->SetVideoSize(320, 240);
+    source->SetFrameRate(50);
+    source->SetListener(&listener);
+    source->Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    source->SignalToStop();
+    source->WaitForStop();
+
+    std::cout << "50 fps: " << listener.Frames << " frames in 1000 ms" << std::endl;
+    Check((listener.Frames >= 45) && (listener.Frames <= 55), "source follows frame rate");
+}
+
+/* 写入AVI文件，最后一帧为重复帧 */
+static void WriteAvi(const std::string &fileName, const std::vector<std::string> &jpegs, uint32_t interval)
+{
+    AviWriter writer;
+    uint8_t header[AVI_HEADER_SIZE];
+    uint8_t chunkHeader[AVI_CHUNK_HEADER_SIZE];
+    std::string body;
+
+    writer.Reset(320, 240, interval);
+    for (size_t i = 0; i <= jpegs.size(); i++)
+    {
+        const std::string empty;
+        const std::string &jpeg = (i < jpegs.size()) ? jpegs[i] : empty;
+        uint32_t padding = writer.AddFrame(static_cast<uint32_t>(jpeg.size()), chunkHeader);
+        body.append(reinterpret_cast<const char *>(chunkHeader), AVI_CHUNK_HEADER_SIZE);
+        body += jpeg;
+        body.append(padding, '\0');
+    }
+    writer.BuildIndex(&body);
+    writer.BuildHeader(header);
+
+    std::ofstream file(fileName.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(header), AVI_HEADER_SIZE);
+    file.write(body.data(), body.size());
+}
+
+/* 写入 multipart 格式的MJPEG文件 */
+static void WriteMjpeg(const std::string &fileName, const std::vector<std::string> &jpegs)
+{
+    std::ofstream file(fileName.c_str(), std::ios::binary);
+
+    for (size_t i = 0; i < jpegs.size(); i++)
+    {
+        file << "--boundary\r\nContent-Type: image/jpeg\r\nContent-Length: " << jpegs[i].size() << "\r\n\r\n";
+        file.write(jpegs[i].data(), jpegs[i].size());
+        file << "\r\n";
+    }
+}
+
+/* 回放文件，不循环时发送完所有帧之后停止 */
+static void PlayFile(const std::string &fileName, uint32_t expectedFrames, uint32_t expectedFrameRate,
+                     const std::vector<std::string> &jpegs)
+{
+    std::shared_ptr<FileVideoSource> source = FileVideoSource::Create();
+    RecordingListener listener;
+
+    listener.KeepJpeg = true;
+    source->SetFileName(fileName);
+    source->SetLoop(false);
+    source->SetFrameRate(0);
+    source->SetListener(&listener);
+    source->Start();
+    for (int i = 0; (i < 200) && (source->IsRunning()); i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    Check(!source->IsRunning(), "source stops at end of file");
+    source->WaitForStop();
+
+    std::cout << fileName << ": " << listener.Frames << " frames, " << source->FrameRate() << " fps" << std::endl;
+    Check(listener.Errors == 0, "file source has no errors");
+    Check(source->FrameCount() == expectedFrames, "file frame count");
+    Check(listener.Frames == expectedFrames, "all frames replayed");
+    Check(source->FrameRate() == expectedFrameRate, "file frame rate");
+    for (size_t i = 0; i < jpegs.size(); i++)
+    {
+        Check((i < listener.Jpegs.size()) && (listener.Jpegs[i] == jpegs[i]), "replayed jpeg matches");
+    }
+}
+
+void TestFileReplay()
+{
+    std::shared_ptr<SyntheticVideoSource> source = SyntheticVideoSource::Create();
+    RecordingListener listener;
+    char fileName[64];
+
+    listener.KeepJpeg = true;
+    source->SetVideoSize(320, 240);
+    source->SetOutputFormat(SyntheticFormat::JPEG);
+    source->SetFrameRate(0);
+    source->SetListener(&listener);
+    source->Start();
+    while (source->FramesReceived() < 10)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    source->SignalToStop();
+    source->WaitForStop();
+    listener.Jpegs.resize(10);
+
+    snprintf(fileName, sizeof(fileName), "/tmp/video_source_test_%d", static_cast<int>(getpid()));
+    std::string avi = std::string(fileName) + ".avi";
+    std::string mjpeg = std::string(fileName) + ".mjpeg";
+
+    // 25 fps，最后的空数据块重复上一帧
+    WriteAvi(avi, listener.Jpegs, 40000);
+    PlayFile(avi, 11, 25, listener.Jpegs);
+    // MJPEG没有帧率信息，使用设置的帧率
+    WriteMjpeg(mjpeg, listener.Jpegs);
+    PlayFile(mjpeg, 10, 0, listener.Jpegs);
+
+    unlink(avi.c_str());
+    unlink(mjpeg.c_str());
+
+    // 不存在的文件
+    std::shared_ptr<FileVideoSource> missing = FileVideoSource::Create();
+    RecordingListener missingListener;
+    missing->SetFileName(std::string(fileName) + ".missing");
+    missing->SetListener(&missingListener);
+    missing->Start();
+    missing->WaitForStop();
+    Check(missingListener.Errors == 1, "missing file reports an error");
+}
+
+int main(int argc, char *argv[])
+{
+    TestSynthetic(SyntheticFormat::RGB24, "RGB24");
+    TestSynthetic(SyntheticFormat::YUYV, "YUYV");
+    TestSynthetic(SyntheticFormat::JPEG, "JPEG");
+    TestSynthetic(SyntheticFormat::NV12, "NV12", PixelFormat::NV12);
+    TestSynthetic(SyntheticFormat::I420, "I420", PixelFormat::I420);
+    TestSynthetic(SyntheticFormat::Grayscale, "GREY", PixelFormat::Grayscale8);
+    TestDecorator(SyntheticFormat::RGB24, "RGB24");
+    TestDecorator(SyntheticFormat::JPEG, "JPEG");
+    TestDecorator(SyntheticFormat::I420, "I420");
+    TestDecorator(SyntheticFormat::NV12, "NV12");
+    TestFrameRate();
+    TestFileReplay();
+
+    return TestResult();
+}
@@ -0,0 +1,179 @@
+#include <chrono>
+#include "threaded_video_source.h"
+#include "base_trace.h"
+
+NAMESPACE_START
+
+ThreadedVideoSource::ThreadedVideoSource() : mSync(),
+                                             mControlThread(),
+                                             mNeedToStop(),
+                                             mListener(nullptr),
+                                             mRunning(false),
+                                             mFramesReceived(0),
+                                             mFrameRate(30)
+{
+}
+
+ThreadedVideoSource::~ThreadedVideoSource()
+{
+    // 派生类的虚函数在这里已经不可用，派生类析构时应该已经停止
+    WaitForStop();
+}
+
+bool ThreadedVideoSource::Start()
+{
+    std::lock_guard<std::recursive_mutex> lock(mSync);
+
+    if (IsRunning())
+    {
+        return false;
+    }
+    mNeedToStop.Reset();
+    mRunning = true;
+    mFramesReceived = 0;
+    mControlThread = std::thread(ControlThreadHandler, this);
+    return true;
+}
+
+void ThreadedVideoSource::SignalToStop()
+{
+    std::lock_guard<std::recursive_mutex> lock(mSync);
+
+    if (IsRunning())
+    {
+        mNeedToStop.Signal();
+    }
+}
+
+void ThreadedVideoSource::WaitForStop()
+{
+    SignalToStop();
+
+    if (mControlThread.joinable())
+    {
+        mControlThread.join();
+    }
+}
+
+bool ThreadedVideoSource::IsRunning()
+{
+    std::lock_guard<std::recursive_mutex> lock(mSync);
+
+    if ((!mRunning) && (mControlThread.joinable()))
+    {
+        mControlThread.join();
+    }
+    return mRunning;
+}
+
+uint32_t ThreadedVideoSource::FramesReceived()
+{
+    return mFramesReceived;
+}
+
+VideoSourceListenerInterface *ThreadedVideoSource::SetListener(VideoSourceListenerInterface *listener)
+{
+    std::lock_guard<std::recursive_mutex> lock(mSync);
+    VideoSourceListenerInterface *oldListener = mListener;
+
+    mListener = listener;
+    return oldListener;
+}
+
+uint32_t ThreadedVideoSource::FrameRate() const
+{
+    return mFrameRate;
+}
+
+void ThreadedVideoSource::SetFrameRate(uint32_t frameRate)
+{
+    mFrameRate = frameRate;
+}
+
+void ThreadedVideoSource::NotifyError(const std::string &errorMessage, bool fatal)
+{
+    VideoSourceListenerInterface *myListener;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mSync);
+        myListener = mListener;
+    }
+
+    if (myListener != nullptr)
+    {
+        myListener->OnError(errorMessage, fatal);
+    }
+}
+
+void ThreadedVideoSource::ControlThreadHandler(ThreadedVideoSource *me)
+{
+    if (me->OpenSource())
+    {
+        me->FrameLoop();
+    }
+    me->CloseSource();
+    {
+        std::lock_guard<std::recursive_mutex> lock(me->mSync);
+        me->mRunning = false;
+    }
+}
+
+// 按照绝对时间点发送，落后时从当前时间重新计算，不会连续补发
+void ThreadedVideoSource::FrameLoop()
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+
+    while (!mNeedToStop.IsSignaled())
+    {
+        int64_t traceBegin = FrameTrace::Begin();
+        std::shared_ptr<const Image> image;
+        std::shared_ptr<const EncodedFrame> frame;
+        if ((!NextFrame(image, frame)) || ((!image) && (!frame)))
+        {
+            break;
+        }
+        uint64_t frameId = (image) ? image->FrameId() : frame->Sequence();
+        if (traceBegin != 0)
+        {
+            FrameTrace::Record("generate", frameId, traceBegin, FrameTrace::Now());
+        }
+
+        VideoSourceListenerInterface *myListener;
+        {
+            std::lock_guard<std::recursive_mutex> lock(mSync);
+            myListener = mListener;
+        }
+        mFramesReceived++;
+        if (myListener != nullptr)
+        {
+            TraceSpan span("notify", frameId);
+            if (image)
+            {
+                myListener->OnNewImage(image);
+            }
+            else
+            {
+                myListener->OnNewEncodedFrame(frame);
+            }
+        }
+
+        uint32_t frameRate = mFrameRate;
+        if (frameRate == 0)
+        {
+            continue;
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        deadline += std::chrono::microseconds(1000000 / frameRate);
+        if (deadline <= now)
+        {
+            deadline = now;
+            continue;
+        }
+        uint32_t waitTime = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+        if ((waitTime > 0) && (mNeedToStop.Wait(waitTime)))
+        {
+            break;
+        }
+    }
+}
+
+NAMESPACE_END
@@ -0,0 +1,144 @@
+/**
+ * @file threaded_video_source.h
+ * @brief 在独立线程中按照帧率产生图像的视频源基类
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 17:48:03
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 17:48:03 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 合成图像和文件回放视频源的公共部分 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef THREADED_VIDEO_SOURCE_H
+#define THREADED_VIDEO_SOURCE_H
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <string>
+#include "video_source_interface.h"
+#include "base_manual_reset_event.h"
+#include "uncopyable.h"
+#include "image.h"
+#include "encoded_frame.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 软件视频源基类
+ * @details
+ *  Start 之后在控制线程中依次调用 OpenSource、NextFrame 和 CloseSource，
+ *  按照帧率的绝对时间点发送图像，处理时间不会累积成帧率误差；处理跟不上时不补发。
+ *  帧率为0时不限速，用于测试编码和网络的最大吞吐。派生类析构时需要先调用 WaitForStop
+ */
+class ThreadedVideoSource : public VideoSourceInterface, private Uncopyable
+{
+public:
+    virtual ~ThreadedVideoSource();
+    /**
+     * @brief  启动控制线程
+     * @return true  成功
+     * @return false 已经在运行
+     */
+    bool Start();
+    /**
+     * @brief 发送停止信号
+     */
+    void SignalToStop();
+    /**
+     * @brief 等待控制线程退出
+     */
+    void WaitForStop();
+    /**
+     * @brief  是否正在运行
+     * @return true  正在运行
+     * @return false 已经停止
+     */
+    bool IsRunning();
+    /**
+     * @brief  启动之后发送的帧数
+     * @return uint32_t 帧数
+     */
+    uint32_t FramesReceived();
+    /**
+     * @brief Set the Listener object
+     * @param  listener         监听者
+     * @return VideoSourceListenerInterface* 之前的监听者
+     */
+    VideoSourceListenerInterface *SetListener(VideoSourceListenerInterface *listener);
+    /**
+     * @brief  帧率
+     * @return uint32_t 帧率，0 表示不限速
+     */
+    uint32_t FrameRate() const;
+    /**
+     * @brief 设置帧率，运行时可以修改
+     * @param  frameRate        帧率，0 表示不限速
+     */
+    void SetFrameRate(uint32_t frameRate);
+
+protected:
+    ThreadedVideoSource();
+    /**
+     * @brief  在控制线程中打开视频源
+     * @return true  成功
+     * @return false 失败，需要通过 NotifyError 说明原因
+     */
+    virtual bool OpenSource() = 0;
+    /**
+     * @brief  在控制线程中获取下一帧
+     * @details 输出图像的视频源设置 image，输出压缩数据的视频源设置 frame，只设置其中一个
+     * @param  image            输出的图像
+     * @param  frame            输出的压缩帧
+     * @return true  成功
+     * @return false 视频源结束
+     */
+    virtual bool NextFrame(std::shared_ptr<const Image> &image, std::shared_ptr<const EncodedFrame> &frame) = 0;
+    /**
+     * @brief 在控制线程中关闭视频源
+     */
+    virtual void CloseSource() = 0;
+    /**
+     * @brief  通知监听者错误
+     * @param  errorMessage     错误信息
+     * @param  fatal            是否为致命错误
+     */
+    void NotifyError(const std::string &errorMessage, bool fatal = false);
+
+private:
+    /**
+     * @brief 控制线程
+     */
+    static void ControlThreadHandler(ThreadedVideoSource *me);
+    /**
+     * @brief 按照帧率发送图像，直到收到停止信号或者视频源结束
+     */
+    void FrameLoop();
+
+private:
+    mutable std::recursive_mutex mSync;      ///< 同步递归锁
+    std::thread mControlThread;              ///< 控制线程
+    ManualResetEvent mNeedToStop;            ///< 停止信号
+    VideoSourceListenerInterface *mListener; ///< 监听者
+    bool mRunning;                           ///< 是否正在运行
+    std::atomic<uint32_t> mFramesReceived;   ///< 发送的帧数
+    std::atomic<uint32_t> mFrameRate;        ///< 帧率，0 表示不限速
+};
+
+NAMESPACE_END
+
+#endif // THREADED_VIDEO_SOURCE_H
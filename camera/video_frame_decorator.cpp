@@ -1,6 +1,6 @@
 #include <ctime>
 #include "video_frame_decorator.h"
-#include "image_drawer.h"
+#include "overlay_tile.h"
 
 NAMESPACE_START
 
@@ -11,92 +11,192 @@ VideoFrameDecorator::VideoFrameDecorator( ) :
     addTimestampOverlay( false ),
     addCameraTitleOverlay( false ),
     overlayTextColor( { 0xFF000000 } ),
-    overlayBackgroundColor( { 0xFFFFFFFF } )
+    overlayBackgroundColor( { 0xFFFFFFFF } ),
+    settingsSync( ),
+    overlayTile( ),
+    overlayText( ),
+    overlayTime( 0 ),
+    overlayDirty( true ),
+    listener( nullptr ),
+    framePool( 4 ),
+    jpegOverlay( )
 {
 
 }
 
-// 处理image图片对象
-void VideoFrameDecorator::OnNewImage( const shared_ptr<const Image>& image )
+// 秒数或设置变化时重新生成水印文字，调用者持有 settingsSync
+void VideoFrameDecorator::UpdateOverlayText( )
 {
-    string  overlay;
+    std::time_t time = std::time( 0 );
+
+    if ( ( !overlayDirty ) && ( ( !addTimestampOverlay ) || ( time == overlayTime ) ) )
+    {
+        return;
+    }
+
+    overlayText.clear( );
 
     if ( addTimestampOverlay )
     {
-        std::time_t time = std::time( 0 );
-        std::tm*    now = std::localtime( &time );
-        char        buffer[32];
+        std::tm now;
+        char    buffer[32];
 
-        sprintf( buffer, "%02d/%02d/%02d %02d:%02d:%02d", now->tm_year - 100, now->tm_mon + 1, now->tm_mday,
-                                                          now->tm_hour, now->tm_min, now->tm_sec );
+        localtime_r( &time, &now );
+        strftime( buffer, sizeof( buffer ), "%y/%m/%d %H:%M:%S", &now );
 
-        overlay = buffer;
+        overlayText = buffer;
     }
 
     if ( ( addCameraTitleOverlay ) && ( !cameraTitle.empty( ) ) )
     {
-        if ( !overlay.empty( ) )
+        if ( !overlayText.empty( ) )
+        {
+            overlayText += " :: ";
+        }
+
+        overlayText += cameraTitle;
+    }
+
+    overlayTime  = time;
+    overlayDirty = false;
+}
+
+// 处理image图片对象，文字不变时只混合缓存的图块
+void VideoFrameDecorator::OnNewImage( const shared_ptr<const Image>& image )
+{
+    if ( !image )
+    {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock( settingsSync );
+
+        UpdateOverlayText( );
+
+        if ( ( !overlayText.empty( ) ) &&
+             ( overlayTile.Render( overlayText, overlayTextColor, overlayBackgroundColor, image->Format( ) ) == Error::Success ) )
+        {
+            overlayTile.Blend( image, 0, 0 );
+        }
+    }
+
+    if ( listener != nullptr )
+    {
+        listener->OnNewImage( image );
+    }
+}
+
+// 处理压缩帧，JPEG帧只重新编码文字覆盖的MCU行
+void VideoFrameDecorator::OnNewEncodedFrame( const shared_ptr<const EncodedFrame>& frame )
+{
+    // 压缩帧无法原地修改，没有下一级时直接忽略
+    if ( ( !frame ) || ( listener == nullptr ) )
+    {
+        return;
+    }
+
+    shared_ptr<EncodedFrame> decorated;
+    {
+        lock_guard<mutex> lock( settingsSync );
+
+        UpdateOverlayText( );
+
+        if ( ( !overlayText.empty( ) ) && ( frame->Codec( ) == FrameCodec::JPEG ) &&
+             ( jpegOverlay.Apply( frame, overlayText, overlayTextColor, overlayBackgroundColor, 0, 0, framePool, decorated ) != Error::Success ) )
         {
-            overlay += " :: ";
+            decorated.reset( );
         }
+    }
 
-        overlay += cameraTitle;
+    if ( decorated )
+    {
+        listener->OnNewEncodedFrame( decorated );
+    }
+    else
+    {
+        listener->OnNewEncodedFrame( frame );
     }
+}
 
-    if ( !overlay.empty( ) )
+// 转发错误信息
+void VideoFrameDecorator::OnError( const string& errorMessage, bool fatal )
+{
+    if ( listener != nullptr )
     {
-        ImageDrawer::PutText( image, overlay, 0, 0, overlayTextColor, overlayBackgroundColor );
+        listener->OnError( errorMessage, fatal );
     }
 }
 
+// Set the listener receiving decorated frames
+void VideoFrameDecorator::SetListener( VideoSourceListenerInterface* nextListener )
+{
+    listener = nextListener;
+}
+
 // Get/Set camera title
 string VideoFrameDecorator::CameraTitle( ) const
 {
+    lock_guard<mutex> lock( settingsSync );
     return cameraTitle;
 }
 void VideoFrameDecorator::SetCameraTitle( const string& title )
 {
+    lock_guard<mutex> lock( settingsSync );
     cameraTitle = title;
+    overlayDirty = true;
 }
 
 // Get/Set if timestamp should be overlayed on camera images
 bool VideoFrameDecorator::TimestampOverlay( ) const
 {
+    lock_guard<mutex> lock( settingsSync );
     return addTimestampOverlay;
 }
 void VideoFrameDecorator::SetTimestampOverlay( bool enabled )
 {
+    lock_guard<mutex> lock( settingsSync );
     addTimestampOverlay = enabled;
+    overlayDirty = true;
 }
 
 // Get/Set if camera's title should be overlayed on its images
 bool VideoFrameDecorator::CameraTitleOverlay( ) const
 {
+    lock_guard<mutex> lock( settingsSync );
     return addCameraTitleOverlay;
 }
 void VideoFrameDecorator::SetCameraTitleOverlay( bool enabled )
 {
+    lock_guard<mutex> lock( settingsSync );
     addCameraTitleOverlay = enabled;
+    overlayDirty = true;
 }
 
 // Get/Set overlay text color
 Argb VideoFrameDecorator::OverlayTextColor( ) const
 {
+    lock_guard<mutex> lock( settingsSync );
     return overlayTextColor;
 }
 void VideoFrameDecorator::SetOverlayTextColor( Argb color )
 {
+    lock_guard<mutex> lock( settingsSync );
     overlayTextColor = color;
+    overlayDirty = true;
 }
 
 // Get/Set overlay background color
 Argb VideoFrameDecorator::OverlayBackgroundColor( ) const
 {
+    lock_guard<mutex> lock( settingsSync );
     return overlayBackgroundColor;
 }
 void VideoFrameDecorator::SetOverlayBackgroundColor( Argb color )
 {
+    lock_guard<mutex> lock( settingsSync );
     overlayBackgroundColor = color;
+    overlayDirty = true;
 }
 
 NAMESPACE_END
@@ -24,12 +24,21 @@
 #ifndef VIDEO_FRAME_DECORATOR_H
 #define VIDEO_FRAME_DECORATOR_H
 
+#include <ctime>
+#include <mutex>
 #include "base_tool.h"
 #include "video_source_listener_interface.h"
+#include "overlay_tile.h"
+#include "jpeg_overlay.h"
+#include "image_pool.h"
 
 NAMESPACE_START
 /**
  * @brief 图片帧装饰器类，主要用来进行图片添加水印
+ * @details 水印预先渲染到 OverlayTile 中，只有文字变化(时间戳每秒一次)或设置改变时才重新渲染，
+ *  其余的帧只进行整数alpha混合。图像原地修改，可以放在监听者链中；
+ *  设置下一级监听者之后作为处理环节使用，JPEG压缩帧通过 JpegOverlay 只重新编码文字覆盖的MCU行，
+ *  叠加之后的帧转发给下一级
  */
 class VideoFrameDecorator : public VideoSourceListenerInterface
 {
@@ -45,9 +54,19 @@ public:
      */
     void OnNewImage( const std::shared_ptr<const Image>& image ) override;
     /**
-     * @brief 发射错误信息
+     * @brief  新压缩帧处理槽函数，叠加之后转发给下一级，没有下一级时忽略
+     * @param  frame            压缩帧共享指针
      */
-    void OnError( const std::string& /* errorMessage */, bool /* fatal */ ) override { }
+    void OnNewEncodedFrame( const std::shared_ptr<const EncodedFrame>& frame ) override;
+    /**
+     * @brief 转发错误信息给下一级
+     */
+    void OnError( const std::string& errorMessage, bool fatal ) override;
+    /**
+     * @brief 设置接收叠加之后数据的下一级监听者，需要在启动视频源之前设置
+     * @param  nextListener     下一级监听者，nullptr 表示只原地修改图像
+     */
+    void SetListener( VideoSourceListenerInterface* nextListener );
 
     /**
      * @brief  获取摄像头标题
@@ -105,12 +124,26 @@ public:
      */
     void SetOverlayBackgroundColor( Argb color );
 
+private:
+    /**
+     * @brief 秒数或设置变化时重新生成水印文字
+     */
+    void UpdateOverlayText( );
+
 private:
     std::string cameraTitle;                    ///< 摄像机标题
     bool        addTimestampOverlay;            ///< 是否添加时间戳
     bool        addCameraTitleOverlay;          ///< 是否添加标题
     Argb       overlayTextColor;                ///< 设置色彩颜色
     Argb       overlayBackgroundColor;          ///< 设置背景颜色
+    mutable std::mutex settingsSync;            ///< 设置与渲染的互斥锁
+    OverlayTile overlayTile;                    ///< 缓存的水印图块
+    std::string overlayText;                    ///< 当前的水印文字
+    std::time_t overlayTime;                    ///< 水印时间戳对应的秒
+    bool        overlayDirty;                   ///< 设置改变，需要重新生成水印文字
+    VideoSourceListenerInterface* listener;     ///< 下一级监听者
+    ImagePool   framePool;                      ///< 叠加之后的压缩帧
+    JpegOverlay jpegOverlay;                    ///< JPEG局部重新编码
 };
 
 NAMESPACE_END
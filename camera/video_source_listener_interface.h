@@ -30,6 +30,7 @@
 
 #include "base_tool.h"
 #include "image.h"
+#include "encoded_frame.h"
 
 NAMESPACE_START
 
@@ -48,6 +49,12 @@ public:
      * @param  image            接受图片数据指针
      */
     virtual void OnNewImage(const std::shared_ptr<const Image> &image) = 0;
+    /**
+     * @brief  接受压缩帧的处理信号函数
+     * @details 视频源直接输出压缩数据(如摄像头的MJPEG模式)时调用，默认忽略
+     * @param  frame            压缩帧指针，只在调用期间有效，需要保留时拷贝数据
+     */
+    virtual void OnNewEncodedFrame(const std::shared_ptr<const EncodedFrame> & /* frame */) {}
     /**
      * @brief  错误信息接受处理接口
      * @param  errorMessage     错误消息
@@ -74,6 +81,18 @@ public:
         }
     }
 
+    /**
+     * @brief  接受压缩帧的处理信号函数
+     * @param  frame            压缩帧指针
+     */
+    virtual void OnNewEncodedFrame(const std::shared_ptr<const EncodedFrame> &frame)
+    {
+        for (auto listener : chain)
+        {
+            listener->OnNewEncodedFrame(frame);
+        }
+    }
+
     /**
      * @brief  错误信息接受处理接口
      * @param  errorMessage     错误消息
@@ -0,0 +1,216 @@
+#include <string.h>
+#include "avi_writer.h"
+
+NAMESPACE_START
+
+/* AVI 标志 */
+static const uint32_t kAviHasIndex = 0x10;
+static const uint32_t kAviKeyFrame = 0x10;
+/* 索引项大小 */
+static const uint32_t kAviIndexEntrySize = 16;
+/* movi 标识在文件中的偏移，索引中的偏移相对该位置 */
+static const uint32_t kAviMoviOffset = AVI_HEADER_SIZE - 4;
+
+/* 按照小端格式写入 */
+static uint8_t *PutU32(uint8_t *ptr, uint32_t value)
+{
+    ptr[0] = static_cast<uint8_t>(value);
+    ptr[1] = static_cast<uint8_t>(value >> 8);
+    ptr[2] = static_cast<uint8_t>(value >> 16);
+    ptr[3] = static_cast<uint8_t>(value >> 24);
+    return ptr + 4;
+}
+
+static uint8_t *PutU16(uint8_t *ptr, uint16_t value)
+{
+    ptr[0] = static_cast<uint8_t>(value);
+    ptr[1] = static_cast<uint8_t>(value >> 8);
+    return ptr + 2;
+}
+
+static uint8_t *PutFourCC(uint8_t *ptr, const char *fourcc)
+{
+    memcpy(ptr, fourcc, 4);
+    return ptr + 4;
+}
+
+AviWriter::AviWriter() : mWidth(0),
+                         mHeight(0),
+                         mFrameInterval(0),
+                         mMoviSize(0),
+                         mMaxFrameSize(0),
+                         mIndex()
+{
+}
+
+void AviWriter::Reset(int32_t width, int32_t height, uint32_t frameInterval)
+{
+    mWidth = width;
+    mHeight = height;
+    mFrameInterval = frameInterval;
+    mMoviSize = 0;
+    mMaxFrameSize = 0;
+    // 保留容量，连续写入多个文件时不重新分配
+    mIndex.clear();
+}
+
+uint32_t AviWriter::AddFrame(uint32_t size, uint8_t chunkHeader[AVI_CHUNK_HEADER_SIZE])
+{
+    uint32_t padding = size & 1;
+    IndexEntry entry;
+
+    entry.Offset = mMoviSize + 4;
+    entry.Size = size;
+    mIndex.push_back(entry);
+
+    PutU32(PutFourCC(chunkHeader, "00dc"), size);
+    mMoviSize += AVI_CHUNK_HEADER_SIZE + size + padding;
+    if (size > mMaxFrameSize)
+    {
+        mMaxFrameSize = size;
+    }
+    return padding;
+}
+
+void AviWriter::SetFrameInterval(uint32_t frameInterval)
+{
+    mFrameInterval = frameInterval;
+}
+
+void AviWriter::BuildHeader(uint8_t header[AVI_HEADER_SIZE]) const
+{
+    const uint32_t frames = static_cast<uint32_t>(mIndex.size());
+    const uint32_t interval = (mFrameInterval == 0) ? 1 : mFrameInterval;
+    const uint32_t bufferSize = mMaxFrameSize + AVI_CHUNK_HEADER_SIZE;
+    const uint32_t bytesPerSecond = static_cast<uint32_t>(static_cast<uint64_t>(bufferSize) * 1000000 / interval);
+    uint8_t *ptr = header;
+
+    memset(header, 0, AVI_HEADER_SIZE);
+    ptr = PutFourCC(ptr, "RIFF");
+    ptr = PutU32(ptr, static_cast<uint32_t>(FileSize() - 8));
+    ptr = PutFourCC(ptr, "AVI ");
+
+    ptr = PutFourCC(ptr, "LIST");
+    ptr = PutU32(ptr, 192);
+    ptr = PutFourCC(ptr, "hdrl");
+
+    // MainAVIHeader
+    ptr = PutFourCC(ptr, "avih");
+    ptr = PutU32(ptr, 56);
+    ptr = PutU32(ptr, interval);
+    ptr = PutU32(ptr, bytesPerSecond);
+    ptr = PutU32(ptr, 0);
+    ptr = PutU32(ptr, kAviHasIndex);
+    ptr = PutU32(ptr, frames);
+    ptr = PutU32(ptr, 0);
+    ptr = PutU32(ptr, 1);
+    ptr = PutU32(ptr, bufferSize);
+    ptr = PutU32(ptr, static_cast<uint32_t>(mWidth));
+    ptr = PutU32(ptr, static_cast<uint32_t>(mHeight));
+    ptr += 16;
+
+    ptr = PutFourCC(ptr, "LIST");
+    ptr = PutU32(ptr, 116);
+    ptr = PutFourCC(ptr, "strl");
+
+    // AVIStreamHeader，帧率为 1000000 / interval
+    ptr = PutFourCC(ptr, "strh");
+    ptr = PutU32(ptr, 56);
+    ptr = PutFourCC(ptr, "vids");
+    ptr = PutFourCC(ptr, "MJPG");
+    ptr = PutU32(ptr, 0);
+    ptr = PutU16(ptr, 0);
+    ptr = PutU16(ptr, 0);
+    ptr = PutU32(ptr, 0);
+    ptr = PutU32(ptr, interval);
+    ptr = PutU32(ptr, 1000000);
+    ptr = PutU32(ptr, 0);
+    ptr = PutU32(ptr, frames);
+    ptr = PutU32(ptr, bufferSize);
+    ptr = PutU32(ptr, 0xFFFFFFFF);
+    ptr = PutU32(ptr, 0);
+    ptr = PutU16(ptr, 0);
+    ptr = PutU16(ptr, 0);
+    ptr = PutU16(ptr, static_cast<uint16_t>(mWidth));
+    ptr = PutU16(ptr, static_cast<uint16_t>(mHeight));
+
+    // BITMAPINFOHEADER
+    ptr = PutFourCC(ptr, "strf");
+    ptr = PutU32(ptr, 40);
+    ptr = PutU32(ptr, 40);
+    ptr = PutU32(ptr, static_cast<uint32_t>(mWidth));
+    ptr = PutU32(ptr, static_cast<uint32_t>(mHeight));
+    ptr = PutU16(ptr, 1);
+    ptr = PutU16(ptr, 24);
+    ptr = PutFourCC(ptr, "MJPG");
+    ptr = PutU32(ptr, static_cast<uint32_t>(mWidth * mHeight * 3));
+    ptr += 16;
+
+    ptr = PutFourCC(ptr, "LIST");
+    ptr = PutU32(ptr, mMoviSize + 4);
+    PutFourCC(ptr, "movi");
+}
+
+void AviWriter::BuildIndex(std::string *out) const
+{
+    uint8_t entry[kAviIndexEntrySize];
+
+    out->reserve(out->size() + AVI_CHUNK_HEADER_SIZE + mIndex.size() * kAviIndexEntrySize);
+    PutU32(PutFourCC(entry, "idx1"), static_cast<uint32_t>(mIndex.size() * kAviIndexEntrySize));
+    out->append(reinterpret_cast<const char *>(entry), AVI_CHUNK_HEADER_SIZE);
+
+    for (size_t i = 0; i < mIndex.size(); i++)
+    {
+        uint8_t *ptr = PutFourCC(entry, "00dc");
+        ptr = PutU32(ptr, kAviKeyFrame);
+        ptr = PutU32(ptr, mIndex[i].Offset);
+        PutU32(ptr, mIndex[i].Size);
+        out->append(reinterpret_cast<const char *>(entry), kAviIndexEntrySize);
+    }
+}
+
+uint32_t AviWriter::FrameCount() const
+{
+    return static_cast<uint32_t>(mIndex.size());
+}
+
+uint64_t AviWriter::FileSize() const
+{
+    return static_cast<uint64_t>(kAviMoviOffset) + 4 + mMoviSize + AVI_CHUNK_HEADER_SIZE + mIndex.size() * kAviIndexEntrySize;
+}
+
+bool AviWriter::JpegImageSize(const uint8_t *data, uint32_t size, int32_t *width, int32_t *height)
+{
+    uint32_t pos = 2;
+
+    if ((size < 4) || (data[0] != 0xFF) || (data[1] != 0xD8))
+    {
+        return false;
+    }
+
+    // 依次跳过各个段，直到找到 SOF0 - SOF15 (不包括 DHT/JPG/DAC)
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+        {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        uint32_t length = (static_cast<uint32_t>(data[pos + 2]) << 8) | data[pos + 3];
+
+        if ((marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC))
+        {
+            if (pos + 9 > size)
+            {
+                return false;
+            }
+            *height = (static_cast<int32_t>(data[pos + 5]) << 8) | data[pos + 6];
+            *width = (static_cast<int32_t>(data[pos + 7]) << 8) | data[pos + 8];
+            return true;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+NAMESPACE_END
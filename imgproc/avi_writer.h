@@ -0,0 +1,126 @@
+/**
+ * @file avi_writer.h
+ * @brief MJPEG AVI文件格式的封装
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 15:12:08
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 15:12:08 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 生成AVI头部、数据块头部和索引 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef AVI_WRITER_H
+#define AVI_WRITER_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "base_tool.h"
+#include "uncopyable.h"
+
+NAMESPACE_START
+
+/**
+ * @brief AVI文件头部大小，包括 movi 列表的头部
+ */
+#define AVI_HEADER_SIZE (224)
+/**
+ * @brief 每个数据块的头部大小
+ */
+#define AVI_CHUNK_HEADER_SIZE (8)
+
+/**
+ * @brief MJPEG AVI 封装
+ * @details
+ *  只生成格式数据，不进行IO：调用者先预留 AVI_HEADER_SIZE 字节的头部，
+ *  每一帧写入 AddFrame 生成的块头部、jpeg数据和对齐填充，最后写入索引并回写头部。
+ *  可以用于内存中的导出，也可以用于文件写入
+ */
+class AviWriter : private Uncopyable
+{
+public:
+    AviWriter();
+    /**
+     * @brief 开始新的文件
+     * @param  width            图像宽度
+     * @param  height           图像高度
+     * @param  frameInterval    帧间隔(微秒)
+     */
+    void Reset(int32_t width, int32_t height, uint32_t frameInterval);
+    /**
+     * @brief  添加一帧
+     * @param  size             jpeg数据大小
+     * @param  chunkHeader      输出块头部
+     * @return uint32_t         数据之后需要填充的字节数(0 或 1)
+     */
+    uint32_t AddFrame(uint32_t size, uint8_t chunkHeader[AVI_CHUNK_HEADER_SIZE]);
+    /**
+     * @brief 设置帧间隔，写入头部之前调用
+     * @param  frameInterval    帧间隔(微秒)
+     */
+    void SetFrameInterval(uint32_t frameInterval);
+    /**
+     * @brief 根据已经添加的帧生成文件头部
+     * @param  header           输出头部
+     */
+    void BuildHeader(uint8_t header[AVI_HEADER_SIZE]) const;
+    /**
+     * @brief 生成 idx1 索引，追加到out
+     * @param  out              输出缓冲区
+     */
+    void BuildIndex(std::string *out) const;
+    /**
+     * @brief  已经添加的帧数量
+     * @return uint32_t 帧数量
+     */
+    uint32_t FrameCount() const;
+    /**
+     * @brief  写入索引之后的文件大小
+     * @return uint64_t 文件大小
+     */
+    uint64_t FileSize() const;
+    /**
+     * @brief  从jpeg数据的SOF段中读取图像尺寸
+     * @param  data             jpeg数据
+     * @param  size             数据大小
+     * @param  width            输出宽度
+     * @param  height           输出高度
+     * @return true  读取成功
+     * @return false 数据不完整
+     */
+    static bool JpegImageSize(const uint8_t *data, uint32_t size, int32_t *width, int32_t *height);
+
+private:
+    /**
+     * @brief 索引项
+     */
+    struct IndexEntry
+    {
+        uint32_t Offset; ///< 相对 movi 标识的偏移
+        uint32_t Size;   ///< 数据大小
+    };
+
+    int32_t mWidth;                 ///< 图像宽度
+    int32_t mHeight;                ///< 图像高度
+    uint32_t mFrameInterval;        ///< 帧间隔(微秒)
+    uint32_t mMoviSize;             ///< movi 列表中数据块的总大小
+    uint32_t mMaxFrameSize;         ///< 最大的帧大小
+    std::vector<IndexEntry> mIndex; ///< 帧索引
+};
+
+NAMESPACE_END
+
+#endif // AVI_WRITER_H
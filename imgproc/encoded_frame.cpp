@@ -0,0 +1,120 @@
+#include <string.h>
+#include <new>
+#include "encoded_frame.h"
+#include "image_pool.h"
+
+NAMESPACE_START
+
+EncodedFrame::EncodedFrame(uint8_t *data, uint32_t capacity, FrameCodec codec, bool ownMemory) : mData(data),
+                                                                                              mSize(0),
+                                                                                              mCapacity(capacity),
+                                                                                              mCodec(codec),
+                                                                                              mKeyFrame(false),
+                                                                                              mOwnMemory(ownMemory),
+                                                                                              mMappedSize(0),
+                                                                                              mSequence(0)
+{
+    mTimeStamp.tv_sec = 0;
+    mTimeStamp.tv_usec = 0;
+}
+
+EncodedFrame::~EncodedFrame()
+{
+    if ((mOwnMemory) && (mData != nullptr))
+    {
+        ImageMemory::Free(mData, mMappedSize);
+        mData = nullptr;
+    }
+}
+
+std::shared_ptr<EncodedFrame> EncodedFrame::Allocate(uint32_t capacity, FrameCodec codec)
+{
+    std::shared_ptr<EncodedFrame> frame(new (std::nothrow) EncodedFrame(nullptr, 0, codec, true));
+
+    if ((frame) && (frame->Reserve(capacity) != Error::Success))
+    {
+        frame.reset();
+    }
+    return frame;
+}
+
+std::shared_ptr<EncodedFrame> EncodedFrame::Create(uint8_t *data, uint32_t capacity, FrameCodec codec)
+{
+    return std::shared_ptr<EncodedFrame>(new (std::nothrow) EncodedFrame(data, capacity, codec, false));
+}
+
+Error EncodedFrame::SetSize(uint32_t size)
+{
+    if (size > mCapacity)
+    {
+        return Error::ImageParametersMismatch;
+    }
+    mSize = size;
+    return Error::Success;
+}
+
+// 按照粒度取整之后重新分配，只拷贝有效数据
+Error EncodedFrame::Reserve(uint32_t capacity)
+{
+    if ((capacity <= mCapacity) && (mData != nullptr))
+    {
+        return Error::Success;
+    }
+    if (!mOwnMemory)
+    {
+        return Error::ImageParametersMismatch;
+    }
+
+    size_t rounded = (static_cast<size_t>(capacity) + ENCODED_FRAME_GRANULARITY - 1) & ~static_cast<size_t>(ENCODED_FRAME_GRANULARITY - 1);
+    if (rounded == 0)
+    {
+        rounded = ENCODED_FRAME_GRANULARITY;
+    }
+    if (rounded > UINT32_MAX)
+    {
+        return Error::OutOfMemory;
+    }
+    size_t mappedSize = 0;
+    uint8_t *data = ImageMemory::Allocate(rounded, ImageMemoryOptions(), false, &mappedSize);
+    if (data == nullptr)
+    {
+        return Error::OutOfMemory;
+    }
+    if (mData != nullptr)
+    {
+        memcpy(data, mData, mSize);
+        ImageMemory::Free(mData, mMappedSize);
+    }
+    mData = data;
+    mMappedSize = mappedSize;
+    mCapacity = static_cast<uint32_t>(rounded);
+    return Error::Success;
+}
+
+Error EncodedFrame::CopyTo(std::shared_ptr<EncodedFrame> &copyTo, ImagePool &pool) const
+{
+    if (mData == nullptr)
+    {
+        return Error::NullPointer;
+    }
+    if ((!copyTo) || (copyTo->mCapacity < mSize))
+    {
+        // 先释放旧的缓冲区，使其可以被池重新使用
+        copyTo.reset();
+        copyTo = pool.AcquireEncoded(mSize, mCodec);
+        if (!copyTo)
+        {
+            return Error::OutOfMemory;
+        }
+    }
+
+    memcpy(copyTo->mData, mData, mSize);
+    copyTo->mSize = mSize;
+    copyTo->mCodec = mCodec;
+    copyTo->mKeyFrame = mKeyFrame;
+    copyTo->mTimeStamp = mTimeStamp;
+    copyTo->mSequence = mSequence;
+    return Error::Success;
+}
+
+NAMESPACE_END
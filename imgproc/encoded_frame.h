@@ -0,0 +1,177 @@
+/**
+ * @file encoded_frame.h
+ * @brief 压缩帧，保存变长的编码数据
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 21:05:37
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 21:05:37 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 压缩帧类型，替代宽度为数据大小的JPEG图像 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef ENCODED_FRAME_H
+#define ENCODED_FRAME_H
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <memory>
+
+#include "uncopyable.h"
+#include "base_error.h"
+#include "image_memory.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 压缩帧缓冲区容量的取整粒度
+ */
+#define ENCODED_FRAME_GRANULARITY (4096)
+
+/**
+ * @brief 压缩数据的编码格式
+ */
+enum class FrameCodec
+{
+    Unknown = 0, ///< 未知格式
+    JPEG,        ///< JPEG，每一帧都是关键帧
+};
+
+class ImagePool;
+/**
+ * @brief 压缩帧
+ * @details
+ *  数据大小和缓冲区容量分开保存，每一帧的大小都不同时只更新大小，不需要重新分配；
+ *  自己管理内存的帧可以通过 Reserve 扩大容量，从 ImagePool 获取的帧扩大之后归还到池中，
+ *  之后获取时直接使用扩大之后的容量。
+ *  序号在采集时分配，同时作为帧跟踪(FrameTrace)的帧编号
+ */
+class EncodedFrame : private Uncopyable
+{
+    friend class ImagePool;
+
+private:
+    /**
+     * @brief Construct a new Encoded Frame object
+     * @param  data             数据指针
+     * @param  capacity         缓冲区容量
+     * @param  codec            编码格式
+     * @param  ownMemory        是否自己管理内存，false 时只引用外部内存(如映射的摄像头缓冲区)
+     */
+    EncodedFrame(uint8_t *data, uint32_t capacity, FrameCodec codec, bool ownMemory);
+
+public:
+    ~EncodedFrame();
+    /**
+     * @brief  分配指定容量的压缩帧
+     * @param  capacity         缓冲区容量，按照 ENCODED_FRAME_GRANULARITY 取整
+     * @param  codec            编码格式
+     * @return std::shared_ptr<EncodedFrame> 压缩帧，分配失败时为空
+     */
+    static std::shared_ptr<EncodedFrame> Allocate(uint32_t capacity, FrameCodec codec);
+    /**
+     * @brief  包装外部内存，不进行内存分配，外部内存需要比压缩帧的生命周期更长
+     * @param  data             数据指针
+     * @param  capacity         缓冲区容量
+     * @param  codec            编码格式
+     * @return std::shared_ptr<EncodedFrame> 压缩帧
+     */
+    static std::shared_ptr<EncodedFrame> Create(uint8_t *data, uint32_t capacity, FrameCodec codec);
+    /**
+     * @brief  设置数据大小
+     * @param  size             数据大小，不能超过缓冲区容量
+     * @return Error            错误信息
+     */
+    Error SetSize(uint32_t size);
+    /**
+     * @brief  扩大缓冲区容量，保留已有的数据
+     * @param  capacity         最小容量
+     * @return Error            错误信息，引用外部内存的帧无法扩大
+     */
+    Error Reserve(uint32_t capacity);
+    /**
+     * @brief  拷贝数据和帧信息；目标容量足够时直接拷贝，否则从池中获取新的压缩帧
+     * @param  copyTo           目标压缩帧
+     * @param  pool             图像池
+     * @return Error            错误信息
+     */
+    Error CopyTo(std::shared_ptr<EncodedFrame> &copyTo, ImagePool &pool) const;
+    /**
+     * @brief 设置采集时间戳
+     * @param  timeStamp        时间戳
+     */
+    void SetTimeStamp(const struct timeval &timeStamp) { mTimeStamp = timeStamp; }
+    /**
+     * @brief 设置采集序号
+     * @param  sequence         序号，0 表示没有序号
+     */
+    void SetSequence(uint64_t sequence) { mSequence = sequence; }
+    /**
+     * @brief 设置是否为关键帧
+     * @param  keyFrame         是否可以不依赖其它帧独立解码
+     */
+    void SetKeyFrame(bool keyFrame) { mKeyFrame = keyFrame; }
+    /**
+     * @brief  数据指针
+     * @return uint8_t* 数据指针
+     */
+    uint8_t *Data() const { return mData; }
+    /**
+     * @brief  数据大小
+     * @return uint32_t 字节数
+     */
+    uint32_t Size() const { return mSize; }
+    /**
+     * @brief  缓冲区容量
+     * @return uint32_t 字节数
+     */
+    uint32_t Capacity() const { return mCapacity; }
+    /**
+     * @brief  编码格式
+     * @return FrameCodec 编码格式
+     */
+    FrameCodec Codec() const { return mCodec; }
+    /**
+     * @brief  采集时间戳
+     * @return struct timeval 时间戳
+     */
+    struct timeval TimeStamp() const { return mTimeStamp; }
+    /**
+     * @brief  采集序号
+     * @return uint64_t 序号
+     */
+    uint64_t Sequence() const { return mSequence; }
+    /**
+     * @brief  是否为关键帧
+     * @return true  可以独立解码
+     * @return false 依赖之前的帧
+     */
+    bool IsKeyFrame() const { return mKeyFrame; }
+
+private:
+    uint8_t *mData;            ///< 数据指针
+    uint32_t mSize;            ///< 数据大小
+    uint32_t mCapacity;        ///< 缓冲区容量
+    FrameCodec mCodec;         ///< 编码格式
+    bool mKeyFrame;            ///< 是否为关键帧
+    bool mOwnMemory;           ///< 是否自己管理内存
+    size_t mMappedSize;        ///< mmap分配的内存大小，堆上分配时为0
+    struct timeval mTimeStamp; ///< 采集时间戳
+    uint64_t mSequence;        ///< 采集序号
+};
+
+NAMESPACE_END
+
+#endif // ENCODED_FRAME_H
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include "frame_change_detector.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+NAMESPACE_START
+
+/* 计算一行块(8行缩略图)中每个 8x8 块的绝对差之和 */
+static void TileRowSad(const uint8_t *current, const uint8_t *reference, int32_t stride, int32_t tiles, uint32_t *maxSad)
+{
+    int32_t t = 0;
+    uint32_t result = *maxSad;
+
+#if defined(__SSE2__)
+    // 一次处理相邻的两个块，_mm_sad_epu8 的高低64位正好对应两个块
+    for (; t + 2 <= tiles; t += 2)
+    {
+        __m128i acc = _mm_setzero_si128();
+        for (int32_t y = 0; y < FRAME_CHANGE_TILE_SIZE; y++)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current + y * stride + t * FRAME_CHANGE_TILE_SIZE));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(reference + y * stride + t * FRAME_CHANGE_TILE_SIZE));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(a, b));
+        }
+        uint32_t low = static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+        uint32_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+        result = std::max(result, std::max(low, high));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; t + 2 <= tiles; t += 2)
+    {
+        // 8行的差值累加最大为 8*255，16位不会溢出
+        uint16x8_t accLow = vdupq_n_u16(0);
+        uint16x8_t accHigh = vdupq_n_u16(0);
+        for (int32_t y = 0; y < FRAME_CHANGE_TILE_SIZE; y++)
+        {
+            uint8x16_t a = vld1q_u8(current + y * stride + t * FRAME_CHANGE_TILE_SIZE);
+            uint8x16_t b = vld1q_u8(reference + y * stride + t * FRAME_CHANGE_TILE_SIZE);
+            uint8x16_t diff = vabdq_u8(a, b);
+            accLow = vaddw_u8(accLow, vget_low_u8(diff));
+            accHigh = vaddw_u8(accHigh, vget_high_u8(diff));
+        }
+        uint64x2_t sumLow = vpaddlq_u32(vpaddlq_u16(accLow));
+        uint64x2_t sumHigh = vpaddlq_u32(vpaddlq_u16(accHigh));
+        uint32_t low = static_cast<uint32_t>(vgetq_lane_u64(sumLow, 0) + vgetq_lane_u64(sumLow, 1));
+        uint32_t high = static_cast<uint32_t>(vgetq_lane_u64(sumHigh, 0) + vgetq_lane_u64(sumHigh, 1));
+        result = std::max(result, std::max(low, high));
+    }
+#endif
+    // 剩余的块使用普通实现
+    for (; t < tiles; t++)
+    {
+        uint32_t sad = 0;
+        for (int32_t y = 0; y < FRAME_CHANGE_TILE_SIZE; y++)
+        {
+            const uint8_t *a = current + y * stride + t * FRAME_CHANGE_TILE_SIZE;
+            const uint8_t *b = reference + y * stride + t * FRAME_CHANGE_TILE_SIZE;
+            for (int32_t x = 0; x < FRAME_CHANGE_TILE_SIZE; x++)
+            {
+                sad += (a[x] > b[x]) ? (a[x] - b[x]) : (b[x] - a[x]);
+            }
+        }
+        result = std::max(result, sad);
+    }
+
+    *maxSad = result;
+}
+
+/* 将一行数据累加到16位的列累加器中 */
+static void AccumulateRow(const uint8_t *row, uint16_t *sums, int32_t count)
+{
+    int32_t x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= count; x += 16)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + x));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + x + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + x), _mm_add_epi16(low, _mm_unpacklo_epi8(pixels, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + x + 8), _mm_add_epi16(high, _mm_unpackhi_epi8(pixels, zero)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; x + 16 <= count; x += 16)
+    {
+        uint8x16_t pixels = vld1q_u8(row + x);
+        vst1q_u16(sums + x, vaddw_u8(vld1q_u16(sums + x), vget_low_u8(pixels)));
+        vst1q_u16(sums + x + 8, vaddw_u8(vld1q_u16(sums + x + 8), vget_high_u8(pixels)));
+    }
+#endif
+    for (; x < count; x++)
+    {
+        sums[x] += row[x];
+    }
+}
+
+FrameChangeDetector::FrameChangeDetector(uint32_t downscale) : mDownscale(std::min<uint32_t>(std::max<uint32_t>(downscale, 1), FRAME_CHANGE_MAX_DOWNSCALE)),
+                                                               mWidth(0),
+                                                               mHeight(0),
+                                                               mFormat(PixelFormat::Unknown),
+                                                               mThumbStride(0),
+                                                               mThumbRows(0),
+                                                               mHasReference(false),
+                                                               mHasCurrent(false),
+                                                               mColumnSums(),
+                                                               mCurrent(),
+                                                               mReference()
+{
+}
+
+// 生成亮度缩略图，亮度近似为 (R + 2G + B) / 4，NV12/I420 直接使用Y平面；先按列累加每个块的所有行，再按块累加各列
+void FrameChangeDetector::BuildThumbnail(const std::shared_ptr<const Image> &image)
+{
+    const int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(image->Format()) / 8);
+    const int32_t thumbWidth = std::max<int32_t>(image->Width() / static_cast<int32_t>(mDownscale), 1);
+    const int32_t thumbHeight = std::max<int32_t>(image->Height() / static_cast<int32_t>(mDownscale), 1);
+    const int32_t blockWidth = std::min<int32_t>(static_cast<int32_t>(mDownscale), image->Width());
+    const int32_t blockHeight = std::min<int32_t>(static_cast<int32_t>(mDownscale), image->Height());
+    const uint32_t divider = static_cast<uint32_t>(blockWidth * blockHeight) * ((pixelSize == 1) ? 1 : 4);
+    const int32_t lineSize = thumbWidth * blockWidth * pixelSize;
+    const int32_t stride = image->Stride();
+
+    for (int32_t ty = 0; ty < thumbHeight; ty++)
+    {
+        uint8_t *thumbRow = mCurrent.data() + ty * mThumbStride;
+        const uint8_t *blockRow = image->Data() + ty * blockHeight * stride;
+        const uint16_t *sums = mColumnSums.data();
+
+        std::fill(mColumnSums.begin(), mColumnSums.begin() + lineSize, 0);
+        for (int32_t y = 0; y < blockHeight; y++)
+        {
+            AccumulateRow(blockRow + y * stride, mColumnSums.data(), lineSize);
+        }
+
+        for (int32_t tx = 0; tx < thumbWidth; tx++)
+        {
+            uint32_t sum = 0;
+
+            if (pixelSize == 1)
+            {
+                for (int32_t x = 0; x < blockWidth; x++)
+                {
+                    sum += sums[x];
+                }
+            }
+            else
+            {
+                for (int32_t x = 0; x < blockWidth * pixelSize; x += pixelSize)
+                {
+                    sum += sums[x] + 2 * sums[x + 1] + sums[x + 2];
+                }
+            }
+            sums += blockWidth * pixelSize;
+            thumbRow[tx] = static_cast<uint8_t>((sum + divider / 2) / divider);
+        }
+    }
+}
+
+Error FrameChangeDetector::Compare(const std::shared_ptr<const Image> &image, uint32_t *score)
+{
+    if ((!image) || (image->Data() == nullptr) || (score == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if ((image->Format() != PixelFormat::Grayscale8) &&
+        (image->Format() != PixelFormat::RGB24) &&
+        (image->Format() != PixelFormat::RGBA32) &&
+        (!ImageIsPlanar(image->Format())))
+    {
+        return Error::UnsupportedPixelFormat;
+    }
+
+    // 尺寸变化时重新分配缩略图，参考帧失效
+    if ((image->Width() != mWidth) || (image->Height() != mHeight) || (image->Format() != mFormat))
+    {
+        const int32_t pairWidth = 2 * FRAME_CHANGE_TILE_SIZE;
+        int32_t thumbWidth = std::max<int32_t>(image->Width() / static_cast<int32_t>(mDownscale), 1);
+        int32_t thumbHeight = std::max<int32_t>(image->Height() / static_cast<int32_t>(mDownscale), 1);
+
+        mWidth = image->Width();
+        mHeight = image->Height();
+        mFormat = image->Format();
+        mThumbStride = (thumbWidth + pairWidth - 1) / pairWidth * pairWidth;
+        mThumbRows = (thumbHeight + FRAME_CHANGE_TILE_SIZE - 1) / FRAME_CHANGE_TILE_SIZE * FRAME_CHANGE_TILE_SIZE;
+        // 填充部分保持为0，两帧之间没有差异
+        mColumnSums.resize(static_cast<size_t>(image->Width()) * ImageBitsPerPixel(mFormat) / 8);
+        mCurrent.assign(static_cast<size_t>(mThumbStride) * mThumbRows, 0);
+        mReference.assign(mCurrent.size(), 0);
+        mHasReference = false;
+    }
+
+    BuildThumbnail(image);
+    mHasCurrent = true;
+
+    if (!mHasReference)
+    {
+        *score = FRAME_CHANGE_MAX_SCORE;
+        return Error::Success;
+    }
+
+    const int32_t tiles = mThumbStride / FRAME_CHANGE_TILE_SIZE;
+    const int32_t tileArea = FRAME_CHANGE_TILE_SIZE * FRAME_CHANGE_TILE_SIZE;
+    uint32_t maxSad = 0;
+
+    for (int32_t y = 0; y < mThumbRows; y += FRAME_CHANGE_TILE_SIZE)
+    {
+        TileRowSad(mCurrent.data() + y * mThumbStride, mReference.data() + y * mThumbStride, mThumbStride, tiles, &maxSad);
+    }
+    *score = (maxSad + tileArea / 2) / tileArea;
+
+    return Error::Success;
+}
+
+void FrameChangeDetector::UpdateReference()
+{
+    if (mHasCurrent)
+    {
+        // 交换缓冲区，不进行内存分配
+        mCurrent.swap(mReference);
+        mHasReference = true;
+        mHasCurrent = false;
+    }
+}
+
+void FrameChangeDetector::Reset()
+{
+    mHasReference = false;
+    mHasCurrent = false;
+}
+
+NAMESPACE_END
@@ -0,0 +1,101 @@
+/**
+ * @file frame_change_detector.h
+ * @brief 图像变化检测，用于静止画面时跳过重复的jpeg编码
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 14:05:37
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 14:05:37 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 亮度缩略图分块差异检测 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef FRAME_CHANGE_DETECTOR_H
+#define FRAME_CHANGE_DETECTOR_H
+
+#include <vector>
+#include "image.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 缩略图中每个比较块的边长(像素)
+ */
+#define FRAME_CHANGE_TILE_SIZE (8)
+/**
+ * @brief 最大的变化分数
+ */
+#define FRAME_CHANGE_MAX_SCORE (255)
+/**
+ * @brief 最大的缩小倍数，保证16位的列累加不会溢出
+ */
+#define FRAME_CHANGE_MAX_DOWNSCALE (64)
+
+/**
+ * @brief 图像变化检测类
+ * @details
+ *  将图像缩小为亮度缩略图(每 downscale x downscale 个像素取平均)，
+ *  再按照 8x8 的块与参考帧计算绝对差之和(SAD，使用SSE2/NEON加速)。
+ *  分数为所有块中最大的平均亮度差(0-255)，局部的小物体移动同样可以检测到，
+ *  缩略图的平均可以抑制传感器噪声。非线程安全
+ */
+class FrameChangeDetector : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Frame Change Detector object
+     * @param  downscale        缩略图的缩小倍数，范围 1 - FRAME_CHANGE_MAX_DOWNSCALE
+     */
+    explicit FrameChangeDetector(uint32_t downscale = 8);
+    /**
+     * @brief  计算图像与参考帧的变化分数，不改变参考帧
+     * @details 没有参考帧或者图像尺寸变化时分数为 FRAME_CHANGE_MAX_SCORE
+     * @param  image            图像，支持Grayscale8/RGB24/RGBA32/NV12/I420
+     * @param  score            输出变化分数
+     * @return Error            错误信息
+     */
+    Error Compare(const std::shared_ptr<const Image> &image, uint32_t *score);
+    /**
+     * @brief 使用最近一次 Compare 的图像作为新的参考帧
+     */
+    void UpdateReference();
+    /**
+     * @brief 清除参考帧，下一帧一定会被认为发生了变化
+     */
+    void Reset();
+
+private:
+    /**
+     * @brief 生成亮度缩略图
+     */
+    void BuildThumbnail(const std::shared_ptr<const Image> &image);
+
+private:
+    uint32_t mDownscale;             ///< 缩小倍数
+    int32_t mWidth;                  ///< 源图像宽度
+    int32_t mHeight;                 ///< 源图像高度
+    PixelFormat mFormat;             ///< 源图像格式
+    int32_t mThumbStride;            ///< 缩略图的行长度，按照两个块的宽度对齐
+    int32_t mThumbRows;              ///< 缩略图的行数，按照块的高度对齐
+    bool mHasReference;              ///< 是否已经有参考帧
+    bool mHasCurrent;                ///< 是否有可以作为参考帧的缩略图
+    std::vector<uint16_t> mColumnSums; ///< 缩略图一行对应的源图像列累加值
+    std::vector<uint8_t> mCurrent;   ///< 最近一次比较的缩略图
+    std::vector<uint8_t> mReference; ///< 参考帧缩略图
+};
+
+NAMESPACE_END
+
+#endif // FRAME_CHANGE_DETECTOR_H
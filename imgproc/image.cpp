@@ -2,14 +2,27 @@
 #include <string.h>
 #include <new>
 #include "image.h"
+#include "image_pool.h"
 
 NAMESPACE_START
 
-Image::Image(uint8_t *data, int32_t width, int32_t height, int32_t stride, PixelFormat format, bool ownMemory) : mData(data), mWidth(width), mHeight(height), mStride(stride), mFormat(format), mOwnMemory(ownMemory)
+Image::Image(uint8_t *data, int32_t width, int32_t height, int32_t stride, PixelFormat format, bool ownMemory) : mData(data), mWidth(width), mHeight(height), mStride(stride), mFormat(format), mOwnMemory(ownMemory), mMappedSize(0)
 {
-    mSize = height * stride;
+    mSize = ImageBufferRows(format, height) * stride;
+    // 色度平面紧跟在Y平面之后，I420 的V平面在U平面之后
+    mChroma[0] = nullptr;
+    mChroma[1] = nullptr;
+    if ((data != nullptr) && (ImageIsPlanar(format)))
+    {
+        mChroma[0] = data + static_cast<size_t>(height) * stride;
+        if (format == PixelFormat::I420)
+        {
+            mChroma[1] = mChroma[0] + static_cast<size_t>((height + 1) / 2) * (stride / 2);
+        }
+    }
     mTimeStamp.tv_sec = 0;
     mTimeStamp.tv_usec = 0;
+    mFrameId = 0;
 }
 
 // Destroy image
@@ -17,33 +30,36 @@ Image::~Image()
 {
     if ((mOwnMemory) && (mData != nullptr))
     {
-        free(mData);
+        ImageMemory::Free(mData, mMappedSize);
         mData = nullptr;
     }
 }
 
 // 根据格式来进行数据分配，在这里进行了内存的分配
-std::shared_ptr<Image> Image::Allocate(int32_t width, int32_t height, PixelFormat format, bool zeroInitialize)
+std::shared_ptr<Image> Image::Allocate(int32_t width, int32_t height, PixelFormat format, bool zeroInitialize,
+                                       const ImageMemoryOptions &memoryOptions)
 {
     int32_t stride = (int32_t)ImageBytesPerStride(width * ImageBitsPerPixel(format));
     Image *image = nullptr;
-    uint8_t *data = nullptr;
+    size_t mappedSize = 0;
     /**
-     * 假设需要初始化，调用calloc
+     * 假设需要初始化，进行清零
      * https://blog.csdn.net/weibo1230123/article/details/81503135
+     * 大尺寸图像可以使用大页，减少转换和编码时的TLB缺失
      * */
-    if (zeroInitialize)
-    {
-        data = (uint8_t *)calloc(1, height * stride);
-    }
-    else
-    {
-        data = (uint8_t *)malloc(height * stride);
-    }
+    uint8_t *data = ImageMemory::Allocate(ImageBufferRows(format, height) * stride, memoryOptions, zeroInitialize, &mappedSize);
 
     if (data != nullptr)
     {
         image = new (std::nothrow) Image(data, width, height, stride, format, true);
+        if (image == nullptr)
+        {
+            ImageMemory::Free(data, mappedSize);
+        }
+        else
+        {
+            image->mMappedSize = mappedSize;
+        }
     }
 
     return std::shared_ptr<Image>(image);
@@ -54,6 +70,41 @@ std::shared_ptr<Image> Image::Create(uint8_t *data, int32_t width, int32_t heigh
 {
     return std::shared_ptr<Image>(new (std::nothrow) Image(data, width, height, stride, format, false));
 };
+//裁剪视图只偏移数据指针，步长与父图像相同
+std::shared_ptr<const Image> Image::CreateView(const std::shared_ptr<const Image> &parent, int32_t x, int32_t y, int32_t width, int32_t height)
+{
+    if ((!parent) || (parent->mData == nullptr) || (parent->mFormat == PixelFormat::JPEG) || (parent->mFormat == PixelFormat::Unknown) ||
+        (x < 0) || (y < 0) || (width <= 0) || (height <= 0) ||
+        (width > parent->mWidth - x) || (height > parent->mHeight - y) ||
+        ((parent->mFormat == PixelFormat::YUYV) && ((x & 1) != 0)) ||
+        ((ImageIsPlanar(parent->mFormat)) && (((x | y) & 1) != 0)))
+    {
+        return std::shared_ptr<const Image>();
+    }
+
+    uint32_t bitsPerPixel = ImageBitsPerPixel(parent->mFormat);
+    uint8_t *data = parent->mData + static_cast<size_t>(y) * parent->mStride + x * bitsPerPixel / 8;
+    Image *view = new (std::nothrow) Image(data, width, height, parent->mStride, parent->mFormat, false);
+    if (view != nullptr)
+    {
+        // 最后一行只到裁剪区域的右边界，不能越过父图像的末尾
+        view->mSize = (height - 1) * parent->mStride + static_cast<int32_t>(ImageBytesPerLine(width * bitsPerPixel));
+        if (ImageIsPlanar(parent->mFormat))
+        {
+            // NV12 的UV交错，水平偏移与Y平面相同；I420 的U、V各自偏移一半
+            int32_t chromaX = (parent->mFormat == PixelFormat::NV12) ? x : x / 2;
+            for (int32_t i = 0; i < 2; i++)
+            {
+                view->mChroma[i] = (parent->mChroma[i] == nullptr) ? nullptr
+                                                                   : parent->mChroma[i] + static_cast<size_t>(y / 2) * parent->PlaneStride(i + 1) + chromaX;
+            }
+        }
+        view->mTimeStamp = parent->mTimeStamp;
+        view->mFrameId = parent->mFrameId;
+        view->mParent = parent;
+    }
+    return std::shared_ptr<const Image>(view);
+}
 void Image::UpdateTimeStamp(const struct timeval &new_time)
 {
     if ((new_time.tv_sec > mTimeStamp.tv_sec) || (new_time.tv_usec > mTimeStamp.tv_usec))
@@ -85,6 +136,17 @@ std::shared_ptr<Image> Image::Clone() const
     return clone;
 }
 
+/* 按行拷贝一个平面 */
+static void CopyPlane(const uint8_t *src, int32_t srcStride, uint8_t *dst, int32_t dstStride, uint32_t lineSize, int32_t rows)
+{
+    for (int32_t y = 0; y < rows; y++)
+    {
+        memcpy(dst, src, lineSize);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
 //直接进行数据的拷贝和复制
 Error Image::CopyData(const std::shared_ptr<Image> &copyTo) const
 {
@@ -94,29 +156,33 @@ Error Image::CopyData(const std::shared_ptr<Image> &copyTo) const
     {
         ret = Error::NullPointer;
     }
-    //先检查高度是否对应，对于JPEG格式来说，一般只进行行内压缩，因此，只检查高度就可以了
-    else if ((mHeight != copyTo->mHeight) || (mFormat != copyTo->mFormat))
-    {
-        ret = Error::ImageParametersMismatch;
-    }
-    else if (((mFormat != PixelFormat::JPEG) && (mWidth != copyTo->mWidth)) ||
-             ((mFormat == PixelFormat::JPEG) && (mStride > copyTo->mStride)))
+    //压缩数据使用 EncodedFrame，这里只需要检查尺寸和格式
+    else if ((mWidth != copyTo->mWidth) || (mHeight != copyTo->mHeight) || (mFormat != copyTo->mFormat))
     {
         ret = Error::ImageParametersMismatch;
     }
     else
     {
+        copyTo->mTimeStamp = mTimeStamp;
+        copyTo->mFrameId = mFrameId;
         //计算每行大小
         uint32_t lineSize = ImageBytesPerLine(mWidth * ImageBitsPerPixel(mFormat));
-        uint8_t *srcPtr = mData;
-        uint8_t *dstPtr = copyTo->mData;
-        int32_t dstStride = copyTo->mStride;
         //对行进行拷贝
-        for (int y = 0; y < mHeight; y++)
+        CopyPlane(mData, mStride, copyTo->mData, copyTo->mStride, lineSize, mHeight);
+        if (ImageIsPlanar(mFormat))
         {
-            memcpy(dstPtr, srcPtr, lineSize);
-            srcPtr += mStride;
-            dstPtr += dstStride;
+            // 色度平面为一半的宽度和高度，NV12 每个位置两个字节
+            int32_t chromaWidth = (mWidth + 1) / 2;
+            int32_t chromaHeight = (mHeight + 1) / 2;
+            if (mFormat == PixelFormat::NV12)
+            {
+                CopyPlane(Plane(1), PlaneStride(1), copyTo->Plane(1), copyTo->PlaneStride(1), chromaWidth * 2, chromaHeight);
+            }
+            else
+            {
+                CopyPlane(Plane(1), PlaneStride(1), copyTo->Plane(1), copyTo->PlaneStride(1), chromaWidth, chromaHeight);
+                CopyPlane(Plane(2), PlaneStride(2), copyTo->Plane(2), copyTo->PlaneStride(2), chromaWidth, chromaHeight);
+            }
         }
     }
 
@@ -129,10 +195,9 @@ Error Image::CopyDataOrClone(std::shared_ptr<Image> &copyTo) const
     Error ret = Error::Success;
 
     if ((!copyTo) ||
+        (copyTo->Width() != mWidth) ||
         (copyTo->Height() != mHeight) ||
-        (copyTo->Format() != mFormat) ||
-        ((mFormat != PixelFormat::JPEG) && (copyTo->Width() != mWidth)) ||
-        ((mFormat == PixelFormat::JPEG) && (copyTo->Stride() < mStride)))
+        (copyTo->Format() != mFormat))
     {
         copyTo = Clone();
         if (!copyTo)
@@ -147,6 +212,25 @@ Error Image::CopyDataOrClone(std::shared_ptr<Image> &copyTo) const
 
     return ret;
 }
+//对于相同大小的数据，直接进行拷贝；否则从池中获取
+Error Image::CopyDataOrClone(std::shared_ptr<Image> &copyTo, ImagePool &pool) const
+{
+    if ((!copyTo) ||
+        (copyTo->Width() != mWidth) ||
+        (copyTo->Height() != mHeight) ||
+        (copyTo->Format() != mFormat))
+    {
+        // 先释放旧的图像，使其可以被池重新使用
+        copyTo.reset();
+        copyTo = pool.Acquire(mWidth, mHeight, mFormat);
+        if (!copyTo)
+        {
+            return Error::OutOfMemory;
+        }
+    }
+
+    return CopyData(copyTo);
+}
 /**
  *
  * 严格参数校验快速
@@ -165,7 +249,7 @@ Error Image::CopyDataStrict(std::shared_ptr<Image> &copyTo) const
     }
     else
     {
-        uint32_t totle_size = mHeight * ImageBytesPerLine(mWidth * ImageBitsPerPixel(mFormat));
+        uint32_t totle_size = ImageBufferRows(mFormat, mHeight) * ImageBytesPerLine(mWidth * ImageBitsPerPixel(mFormat));
         uint8_t *srcPtr = mData;
         uint8_t *dstPtr = copyTo->mData;
         memcpy(dstPtr, srcPtr, totle_size);
@@ -179,5 +263,7 @@ Error Image::CopyDataFast(uint8_t *dst_buffer, uint32_t buffer_size) const
 {
     buffer_size = buffer_size ? ((buffer_size < mSize) ? buffer_size : mSize) : mSize;
     memcpy(dst_buffer, mData, buffer_size);
+    return Error::Success;
 }
+
 NAMESPACE_END // namespace
\ No newline at end of file
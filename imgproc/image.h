@@ -30,13 +30,18 @@
 
 #include "uncopyable.h"
 #include "img_tools.h"
+#include "image_memory.h"
 
 NAMESPACE_START
+
+class ImagePool;
 /**
  * @brief 定义简单基本图像类，包含图像信息和基本数据
  */
 class Image : private Uncopyable
 {
+    friend class ImagePool;
+
 private:
     /**
      * @brief  图像构造函数
@@ -59,10 +64,12 @@ public:
      * @param  height           图像高度
      * @param  format           图像格式
      * @param  zeroInitialize   进行零值初始化
+     * @param  memoryOptions    内存分配选项，大尺寸图像可以使用大页和NUMA节点绑定
      * @return std::shared_ptr<Image> 指向数据的共享指针
      */
 
-    static std::shared_ptr<Image> Allocate(int32_t width, int32_t height, PixelFormat format, bool zeroInitialize = false);
+    static std::shared_ptr<Image> Allocate(int32_t width, int32_t height, PixelFormat format, bool zeroInitialize = false,
+                                           const ImageMemoryOptions &memoryOptions = ImageMemoryOptions());
     /**
      * @brief  直接在已有的数据内存上直接进行数据拷贝和复制
      * @param  data            原始数据指针
@@ -73,11 +80,29 @@ public:
      * @return std::shared_ptr<Image> 指向数据的共享指针
      */
     static std::shared_ptr<Image> Create(uint8_t *data, int32_t width, int32_t height, int32_t stride, PixelFormat format);
+    /**
+     * @brief  创建裁剪视图，不拷贝数据
+     * @details 视图与父图像共享内存，使用父图像的步长，数据指针偏移到裁剪区域的左上角，
+     *          并持有父图像的引用；时间戳和帧编号与父图像相同。YUYV的水平坐标需要为偶数，
+     *          NV12/I420的两个坐标都需要为偶数，不支持压缩数据
+     * @param  parent           父图像，可以是另一个视图
+     * @param  x                裁剪区域左上角的水平坐标
+     * @param  y                裁剪区域左上角的垂直坐标
+     * @param  width            裁剪区域宽度
+     * @param  height           裁剪区域高度
+     * @return std::shared_ptr<const Image> 视图，区域超出父图像或者格式不支持时为空
+     */
+    static std::shared_ptr<const Image> CreateView(const std::shared_ptr<const Image> &parent, int32_t x, int32_t y, int32_t width, int32_t height);
     /**
      * @brief 更新时间，只有比它的时间更大才能更新，保证实时性
      * @param  new_time        新的时间
      */
     void UpdateTimeStamp(const struct timeval &new_time);
+    /**
+     * @brief 设置帧编号，用于跟踪同一帧在采集、编码和发送中的耗时
+     * @param  frameId          帧编号，0 表示没有编号
+     */
+    void SetFrameId(uint64_t frameId) { mFrameId = frameId; }
     /**
      * @brief 深层拷贝数据
      * @details 重新创建内存，并返回器共享指针
@@ -98,6 +123,13 @@ public:
      * @return Error            错误信息
      */
     Error CopyDataOrClone(std::shared_ptr<Image> &copyTo) const;
+    /**
+     * @brief  对于相同大小的数据，直接进行拷贝；否则从图像池获取新的图像
+     * @param  copyTo           目标对象指针
+     * @param  pool             图像池
+     * @return Error            错误信息
+     */
+    Error CopyDataOrClone(std::shared_ptr<Image> &copyTo, ImagePool &pool) const;
     /**
      * @brief   数据拷贝
      * @details 严格检查数据类型，方便直接进行拷贝
@@ -126,7 +158,7 @@ public:
     int32_t Height() const { return mHeight; }
     /**
      * @brief   图像步长
-     * @return int32_t 图像步长
+     * @return int32_t 图像步长，NV12/I420 为Y平面的步长
      */
     int32_t Stride() const { return mStride; }
     /**
@@ -139,6 +171,11 @@ public:
      * @return struct timeval 时间戳
      */
     struct timeval TimeStamp() const { return mTimeStamp; }
+    /**
+     * @brief 帧编号，拷贝数据时一起拷贝
+     * @return uint64_t 帧编号
+     */
+    uint64_t FrameId() const { return mFrameId; }
     /**
      * @brief 图像
      * @return PixelFormat 图像格式
@@ -149,6 +186,18 @@ public:
      * @return uint8_t* 数据指针
      */
     uint8_t *Data() const { return mData; }
+    /**
+     * @brief  平面数据指针
+     * @param  plane            0 为Y平面(单平面格式为全部数据)；NV12 的1为UV平面，I420 的1、2为U、V平面
+     * @return uint8_t*         数据指针，格式没有该平面时为空
+     */
+    uint8_t *Plane(int32_t plane) const { return (plane == 0) ? mData : (((plane == 1) || (plane == 2)) ? mChroma[plane - 1] : nullptr); }
+    /**
+     * @brief  平面步长
+     * @param  plane            平面编号，与 Plane 相同
+     * @return int32_t          步长，I420 的U、V平面为Y平面的一半
+     */
+    int32_t PlaneStride(int32_t plane) const { return ((plane != 0) && (mFormat == PixelFormat::I420)) ? mStride / 2 : mStride; }
 
 private:
     /* data */
@@ -158,8 +207,12 @@ private:
     int32_t mSize;             ///< 记录数据块的总大小以字节为单位
     PixelFormat mFormat;       ///< 图像格式
     bool mOwnMemory;           ///< 是否自己进行内存管理
+    size_t mMappedSize;        ///< mmap分配的内存大小，堆上分配时为0
     struct timeval mTimeStamp; ///< 记录图片的时间戳;后期可以换掉
+    uint64_t mFrameId;         ///< 采集时分配的帧编号
     uint8_t *mData;            ///< 原始数据指针
+    uint8_t *mChroma[2];       ///< NV12/I420 的色度平面，视图中与Y平面分别偏移
+    std::shared_ptr<const Image> mParent; ///< 裁剪视图引用的父图像，保证共享的内存有效
 };
 
 /**
@@ -0,0 +1,406 @@
+#include <string.h>
+#include "image_converter.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+NAMESPACE_START
+
+/**
+ * @brief 4:2:0的色度平面，NV12 的U/V交错(步进为2)，I420 的U/V分别保存(步进为1)
+ */
+struct ChromaPlanes
+{
+    uint8_t *U;     ///< 第一个U
+    uint8_t *V;     ///< 第一个V
+    int32_t Stride; ///< 色度行的步长
+    int32_t Step;   ///< 同一行中相邻两个U之间的字节数
+};
+
+static ChromaPlanes GetChromaPlanes(const Image &image)
+{
+    ChromaPlanes planes;
+    planes.U = image.Plane(1);
+    if (image.Format() == PixelFormat::NV12)
+    {
+        planes.V = planes.U + 1;
+        planes.Step = 2;
+    }
+    else
+    {
+        planes.V = image.Plane(2);
+        planes.Step = 1;
+    }
+    planes.Stride = image.PlaneStride(1);
+    return planes;
+}
+
+static inline uint8_t Clamp255(int32_t value)
+{
+    return static_cast<uint8_t>((value > 255) ? 255 : ((value < 0) ? 0 : value));
+}
+
+/* 全范围YUV转换为RGB，系数与 DecodeYuyvToRgb 相同 */
+static inline void YuvToRgb(int32_t y, int32_t u, int32_t v, uint8_t *rgb)
+{
+    y <<= 8;
+    rgb[RedIndex] = Clamp255((y + (360 * v)) >> 8);
+    rgb[GreenIndex] = Clamp255((y - (88 * u) - (184 * v)) >> 8);
+    rgb[BlueIndex] = Clamp255((y + (455 * u)) >> 8);
+}
+
+/* 取出一行YUYV中的Y */
+static void YuyvRowToLuma(const uint8_t *yuyv, uint8_t *luma, int32_t width)
+{
+    int32_t x = 0;
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(yuyv + x * 2));
+        __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(yuyv + x * 2 + 16));
+        __m128i y = _mm_packus_epi16(_mm_and_si128(s0, mask), _mm_and_si128(s1, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(luma + x), y);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x2_t s = vld2q_u8(yuyv + x * 2);
+        vst1q_u8(luma + x, s.val[0]);
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        luma[x] = yuyv[x * 2];
+    }
+}
+
+/* 两行YUYV的色度取平均值，写入一行4:2:0色度，width 为像素数 */
+static void YuyvRowsToChroma(const uint8_t *row0, const uint8_t *row1, const ChromaPlanes &planes, uint8_t *u, uint8_t *v, int32_t width)
+{
+    int32_t pairs = (width + 1) / 2;
+    int32_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; i + 8 <= pairs; i += 8)
+    {
+        // 平均值之后每16位的高字节为U/V，依次为 U0 V0 U1 V1 ...
+        __m128i a0 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i * 4)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i * 4)));
+        __m128i a1 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i * 4 + 16)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i * 4 + 16)));
+        __m128i uv = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+        if (planes.Step == 2)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i * 2), uv);
+        }
+        else
+        {
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(u + i), _mm_packus_epi16(_mm_and_si128(uv, mask), mask));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(v + i), _mm_packus_epi16(_mm_srli_epi16(uv, 8), mask));
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= pairs; i += 8)
+    {
+        // 按4个字节拆分，val[1] 为U，val[3] 为V
+        uint8x8x4_t s0 = vld4_u8(row0 + i * 4);
+        uint8x8x4_t s1 = vld4_u8(row1 + i * 4);
+        uint8x8_t cu = vrhadd_u8(s0.val[1], s1.val[1]);
+        uint8x8_t cv = vrhadd_u8(s0.val[3], s1.val[3]);
+        if (planes.Step == 2)
+        {
+            uint8x8x2_t uv = {{cu, cv}};
+            vst2_u8(u + i * 2, uv);
+        }
+        else
+        {
+            vst1_u8(u + i, cu);
+            vst1_u8(v + i, cv);
+        }
+    }
+#endif
+
+    for (; i < pairs; i++)
+    {
+        u[i * planes.Step] = static_cast<uint8_t>((row0[i * 4 + 1] + row1[i * 4 + 1] + 1) >> 1);
+        v[i * planes.Step] = static_cast<uint8_t>((row0[i * 4 + 3] + row1[i * 4 + 3] + 1) >> 1);
+    }
+}
+
+/* NV12 的UV交错行与 I420 的U、V行之间互相转换 */
+static void SplitChromaRow(const uint8_t *uv, uint8_t *u, uint8_t *v, int32_t count)
+{
+    int32_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + i * 2));
+        __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + i * 2 + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i), _mm_packus_epi16(_mm_and_si128(s0, mask), _mm_and_si128(s1, mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i), _mm_packus_epi16(_mm_srli_epi16(s0, 8), _mm_srli_epi16(s1, 8)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16x2_t s = vld2q_u8(uv + i * 2);
+        vst1q_u8(u + i, s.val[0]);
+        vst1q_u8(v + i, s.val[1]);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        u[i] = uv[i * 2];
+        v[i] = uv[i * 2 + 1];
+    }
+}
+
+static void MergeChromaRow(const uint8_t *u, const uint8_t *v, uint8_t *uv, int32_t count)
+{
+    int32_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i su = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u + i));
+        __m128i sv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(uv + i * 2), _mm_unpacklo_epi8(su, sv));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(uv + i * 2 + 16), _mm_unpackhi_epi8(su, sv));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16x2_t s = {{vld1q_u8(u + i), vld1q_u8(v + i)}};
+        vst2q_u8(uv + i * 2, s);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        uv[i * 2] = u[i];
+        uv[i * 2 + 1] = v[i];
+    }
+}
+
+static void CopyRows(const uint8_t *src, int32_t srcStride, uint8_t *dst, int32_t dstStride, int32_t lineSize, int32_t rows)
+{
+    for (int32_t y = 0; y < rows; y++)
+    {
+        memcpy(dst + static_cast<size_t>(y) * dstStride, src + static_cast<size_t>(y) * srcStride, lineSize);
+    }
+}
+
+static void ConvertYuyv(const Image &src, Image &dst)
+{
+    int32_t width = src.Width();
+    int32_t height = src.Height();
+    const uint8_t *srcData = src.Data();
+    int32_t srcStride = src.Stride();
+
+    if (dst.Format() == PixelFormat::RGB24)
+    {
+        for (int32_t y = 0; y < height; y++)
+        {
+            const uint8_t *yuyv = srcData + static_cast<size_t>(y) * srcStride;
+            uint8_t *rgb = dst.Data() + static_cast<size_t>(y) * dst.Stride();
+            for (int32_t x = 0; x < width; x++, rgb += 3)
+            {
+                const uint8_t *pair = yuyv + (x / 2) * 4;
+                YuvToRgb(pair[(x & 1) * 2], pair[1] - 128, pair[3] - 128, rgb);
+            }
+        }
+        return;
+    }
+
+    for (int32_t y = 0; y < height; y++)
+    {
+        YuyvRowToLuma(srcData + static_cast<size_t>(y) * srcStride, dst.Data() + static_cast<size_t>(y) * dst.Stride(), width);
+    }
+    if (dst.Format() == PixelFormat::Grayscale8)
+    {
+        return;
+    }
+
+    // 色度取上下两行的平均值，奇数高度的最后一行单独使用
+    ChromaPlanes planes = GetChromaPlanes(dst);
+    for (int32_t y = 0; y < height; y += 2)
+    {
+        const uint8_t *row0 = srcData + static_cast<size_t>(y) * srcStride;
+        const uint8_t *row1 = (y + 1 < height) ? row0 + srcStride : row0;
+        size_t offset = static_cast<size_t>(y / 2) * planes.Stride;
+        YuyvRowsToChroma(row0, row1, planes, planes.U + offset, planes.V + offset, width);
+    }
+}
+
+static void ConvertYuv420(const Image &src, Image &dst)
+{
+    int32_t width = src.Width();
+    int32_t height = src.Height();
+    int32_t chromaWidth = (width + 1) / 2;
+    int32_t chromaHeight = (height + 1) / 2;
+    ChromaPlanes from = GetChromaPlanes(src);
+
+    if (dst.Format() == PixelFormat::RGB24)
+    {
+        for (int32_t y = 0; y < height; y++)
+        {
+            const uint8_t *luma = src.Data() + static_cast<size_t>(y) * src.Stride();
+            size_t offset = static_cast<size_t>(y / 2) * from.Stride;
+            const uint8_t *u = from.U + offset;
+            const uint8_t *v = from.V + offset;
+            uint8_t *rgb = dst.Data() + static_cast<size_t>(y) * dst.Stride();
+            for (int32_t x = 0; x < width; x++, rgb += 3)
+            {
+                int32_t i = (x / 2) * from.Step;
+                YuvToRgb(luma[x], u[i] - 128, v[i] - 128, rgb);
+            }
+        }
+        return;
+    }
+
+    CopyRows(src.Data(), src.Stride(), dst.Data(), dst.Stride(), width, height);
+    if (dst.Format() == PixelFormat::Grayscale8)
+    {
+        return;
+    }
+
+    // NV12 与 I420 之间只需要重新排列色度
+    ChromaPlanes to = GetChromaPlanes(dst);
+    for (int32_t y = 0; y < chromaHeight; y++)
+    {
+        size_t srcOffset = static_cast<size_t>(y) * from.Stride;
+        size_t dstOffset = static_cast<size_t>(y) * to.Stride;
+        if (from.Step == 2)
+        {
+            SplitChromaRow(from.U + srcOffset, to.U + dstOffset, to.V + dstOffset, chromaWidth);
+        }
+        else
+        {
+            MergeChromaRow(from.U + srcOffset, from.V + srcOffset, to.U + dstOffset, chromaWidth);
+        }
+    }
+}
+
+static void ConvertGray(const Image &src, Image &dst)
+{
+    int32_t width = src.Width();
+    int32_t height = src.Height();
+
+    if (dst.Format() == PixelFormat::RGB24)
+    {
+        for (int32_t y = 0; y < height; y++)
+        {
+            const uint8_t *gray = src.Data() + static_cast<size_t>(y) * src.Stride();
+            uint8_t *rgb = dst.Data() + static_cast<size_t>(y) * dst.Stride();
+            for (int32_t x = 0; x < width; x++, rgb += 3)
+            {
+                rgb[RedIndex] = rgb[GreenIndex] = rgb[BlueIndex] = gray[x];
+            }
+        }
+        return;
+    }
+
+    // 灰度的色度为中性值
+    CopyRows(src.Data(), src.Stride(), dst.Data(), dst.Stride(), width, height);
+    int32_t chromaWidth = (width + 1) / 2;
+    int32_t chromaHeight = (height + 1) / 2;
+    int32_t lineSize = (dst.Format() == PixelFormat::NV12) ? chromaWidth * 2 : chromaWidth;
+    for (int32_t plane = 1; plane <= ((dst.Format() == PixelFormat::NV12) ? 1 : 2); plane++)
+    {
+        for (int32_t y = 0; y < chromaHeight; y++)
+        {
+            memset(dst.Plane(plane) + static_cast<size_t>(y) * dst.PlaneStride(plane), 128, lineSize);
+        }
+    }
+}
+
+Error ImageConverter::Convert(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst)
+{
+    if ((!src) || (!dst) || (src->Data() == nullptr) || (dst->Data() == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if ((src->Width() != dst->Width()) || (src->Height() != dst->Height()))
+    {
+        return Error::ImageParametersMismatch;
+    }
+    if (src->Format() == dst->Format())
+    {
+        return src->CopyData(dst);
+    }
+    if (ConversionCost(src->Format(), dst->Format()) == IMAGE_CONVERSION_UNSUPPORTED)
+    {
+        return Error::UnsupportedPixelFormat;
+    }
+
+    switch (src->Format())
+    {
+    case PixelFormat::YUYV:
+        ConvertYuyv(*src, *dst);
+        break;
+    case PixelFormat::NV12:
+    case PixelFormat::I420:
+        ConvertYuv420(*src, *dst);
+        break;
+    default:
+        ConvertGray(*src, *dst);
+        break;
+    }
+    dst->UpdateTimeStamp(src->TimeStamp());
+    dst->SetFrameId(src->FrameId());
+    return Error::Success;
+}
+
+uint32_t ImageConverter::ConversionCost(PixelFormat from, PixelFormat to)
+{
+    if ((from == PixelFormat::Unknown) || (to == PixelFormat::Unknown))
+    {
+        return IMAGE_CONVERSION_UNSUPPORTED;
+    }
+    if (from == to)
+    {
+        return 1;
+    }
+
+    bool to420 = ImageIsPlanar(to);
+    switch (from)
+    {
+    case PixelFormat::YUYV:
+        return (to == PixelFormat::Grayscale8) ? 2 : (to420) ? 3 : (to == PixelFormat::RGB24) ? 5 : IMAGE_CONVERSION_UNSUPPORTED;
+    case PixelFormat::NV12:
+    case PixelFormat::I420:
+        return (to == PixelFormat::Grayscale8) ? 1 : (to420) ? 2 : (to == PixelFormat::RGB24) ? 5 : IMAGE_CONVERSION_UNSUPPORTED;
+    case PixelFormat::Grayscale8:
+        // 灰度没有颜色，彩色输出优先选择任何彩色的源格式
+        return ((to420) || (to == PixelFormat::RGB24)) ? 8 : IMAGE_CONVERSION_UNSUPPORTED;
+    default:
+        return IMAGE_CONVERSION_UNSUPPORTED;
+    }
+}
+
+PixelFormat ImageConverter::CheapestSource(const std::vector<PixelFormat> &offered, PixelFormat to)
+{
+    PixelFormat best = PixelFormat::Unknown;
+    uint32_t bestCost = IMAGE_CONVERSION_UNSUPPORTED;
+    for (size_t i = 0; i < offered.size(); i++)
+    {
+        uint32_t cost = ConversionCost(offered[i], to);
+        if (cost < bestCost)
+        {
+            best = offered[i];
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+NAMESPACE_END
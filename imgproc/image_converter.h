@@ -0,0 +1,80 @@
+/**
+ * @file image_converter.h
+ * @brief 像素格式转换，支持YUYV、NV12、I420和灰度
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 23:56:12
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 23:56:12 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 平面和半平面YUV的转换 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef IMAGE_CONVERTER_H
+#define IMAGE_CONVERTER_H
+
+#include <vector>
+#include "image.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 不支持的转换的代价
+ */
+#define IMAGE_CONVERSION_UNSUPPORTED (0xFFFFFFFFu)
+
+/**
+ * @brief 像素格式转换静态类
+ * @details
+ *  源格式为YUYV/NV12/I420/Grayscale8，目标格式为RGB24/Grayscale8/NV12/I420，相同格式时直接拷贝。
+ *  YUV按照JFIF全范围处理，系数与 DecodeYuyvToRgb 相同；转换为4:2:0时色度取上下两行的平均值。
+ *  YUYV到4:2:0以及NV12/I420之间的转换使用SSE2/NEON，每两行只读取一次色度。
+ *  JpegEncoder 可以直接编码NV12/I420/灰度，摄像头输出这些格式时只需要拷贝，不再转换为RGB
+ */
+class ImageConverter
+{
+public:
+    ImageConverter() = delete;
+
+public:
+    /**
+     * @brief  转换像素格式
+     * @param  src              源图像，可以是裁剪视图
+     * @param  dst              目标图像，尺寸与源图像相同
+     * @return Error            错误信息，不支持的转换返回 UnsupportedPixelFormat
+     */
+    static Error Convert(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst);
+    /**
+     * @brief  每个像素转换的相对代价，用于选择摄像头的采集格式
+     * @details 直接拷贝为1，只拷贝Y平面为1，重新排列色度为2，YUYV拆分为4:2:0为3，转换为RGB为5；
+     *          灰度转换为彩色格式计算量很小，但是没有颜色，代价为8，保证彩色输出优先选择彩色的源格式
+     * @param  from             源格式
+     * @param  to               目标格式
+     * @return uint32_t         代价，不支持时为 IMAGE_CONVERSION_UNSUPPORTED
+     */
+    static uint32_t ConversionCost(PixelFormat from, PixelFormat to);
+    /**
+     * @brief  在可用的源格式中选择转换到目标格式代价最小的一个
+     * @details 代价相同时选择排在前面的格式
+     * @param  offered          可用的源格式
+     * @param  to               目标格式
+     * @return PixelFormat      选择的格式，都不能转换时为 Unknown
+     */
+    static PixelFormat CheapestSource(const std::vector<PixelFormat> &offered, PixelFormat to);
+};
+
+NAMESPACE_END
+
+#endif // IMAGE_CONVERTER_H
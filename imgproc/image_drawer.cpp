@@ -585,6 +585,12 @@ Error ImageDrawer::PutText( const std::shared_ptr<const Image>& image, const std
     return ret;
 }
 
+// 字符点阵，与 PutText 使用相同的字体
+const uint8_t *ImageDrawer::Glyph( uint8_t symbol )
+{
+    return &( font8x8ext[symbol * 8] );
+}
+
 // 8位灰度图像，字符填充，使用1字节字符串，进行直接进行颜色设置，范围值在0~255
 void DrawingText8(
         const std::shared_ptr<const Image>& src, 
@@ -85,6 +85,13 @@ public:
      * @return Error            错误信息
      */
     static Error PutText(const std::shared_ptr<const Image> &image, const std::string &text, int32_t x, int32_t y, Argb color, Argb background, bool addBorder = true);
+
+    /**
+     * @brief  获取ASCII字符的 8x8 点阵
+     * @param  symbol           字符
+     * @return const uint8_t*   8个字节，每个字节为一行，最高位为最左边的像素
+     */
+    static const uint8_t *Glyph(uint8_t symbol);
 };
 
 NAMESPACE_END
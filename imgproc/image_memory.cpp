@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "image_memory.h"
+
+NAMESPACE_START
+
+/* 设置内存的NUMA优先节点，直接使用系统调用，不依赖libnuma */
+static bool BindMemoryToNode(void *data, size_t size, int node)
+{
+    const size_t bitsPerLong = sizeof(unsigned long) * 8;
+    unsigned long mask[4] = {0, 0, 0, 0};
+
+    if ((node < 0) || (static_cast<size_t>(node) >= sizeof(mask) * 8))
+    {
+        return false;
+    }
+    mask[node / bitsPerLong] |= 1UL << (node % bitsPerLong);
+    return (syscall(SYS_mbind, data, size, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0) == 0);
+}
+
+uint8_t *ImageMemory::Allocate(size_t size, const ImageMemoryOptions &options, bool zeroInitialize, size_t *mappedSize)
+{
+    void *data = nullptr;
+
+    *mappedSize = 0;
+    if ((options.HugePages) && (size >= IMAGE_MEMORY_HUGEPAGE_THRESHOLD))
+    {
+        size_t mapSize = (size + IMAGE_MEMORY_HUGEPAGE_SIZE - 1) & ~static_cast<size_t>(IMAGE_MEMORY_HUGEPAGE_SIZE - 1);
+
+        // 优先使用预留的大页，没有预留时使用透明大页
+        data = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            data = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (data == MAP_FAILED)
+            {
+                return nullptr;
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(data, mapSize, MADV_HUGEPAGE);
+#endif
+        }
+        // 在第一次访问之前设置，页面分配时才会生效
+        if (options.NumaNode >= 0)
+        {
+            BindMemoryToNode(data, mapSize, options.NumaNode);
+        }
+        *mappedSize = mapSize;
+    }
+    else
+    {
+        if (posix_memalign(&data, IMAGE_MEMORY_ALIGNMENT, size) != 0)
+        {
+            return nullptr;
+        }
+        if (zeroInitialize)
+        {
+            memset(data, 0, size);
+        }
+    }
+
+    return static_cast<uint8_t *>(data);
+}
+
+void ImageMemory::Free(uint8_t *data, size_t mappedSize)
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+    if (mappedSize != 0)
+    {
+        munmap(data, mappedSize);
+    }
+    else
+    {
+        free(data);
+    }
+}
+
+int ImageMemory::CurrentNumaNode()
+{
+    unsigned cpu = 0;
+    unsigned node = 0;
+
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    {
+        return -1;
+    }
+    return static_cast<int>(node);
+}
+
+bool ImageMemory::RunOnNumaNode(int node)
+{
+    char path[64];
+    char cpuList[256];
+    cpu_set_t cpus;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool readOk = (fgets(cpuList, sizeof(cpuList), file) != nullptr);
+    fclose(file);
+    if (!readOk)
+    {
+        return false;
+    }
+
+    // 解析 "0-3,8-11" 格式的CPU列表
+    CPU_ZERO(&cpus);
+    char *saveptr = nullptr;
+    for (char *item = strtok_r(cpuList, ",\n", &saveptr); item != nullptr; item = strtok_r(nullptr, ",\n", &saveptr))
+    {
+        int first = 0;
+        int last = 0;
+        int count = sscanf(item, "%d-%d", &first, &last);
+
+        if (count == 1)
+        {
+            last = first;
+        }
+        for (int cpu = first; (count >= 1) && (cpu <= last) && (cpu < CPU_SETSIZE); cpu++)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    return (CPU_COUNT(&cpus) > 0) && (sched_setaffinity(0, sizeof(cpus), &cpus) == 0);
+}
+
+bool ImageMemory::RunOnCpus(const uint32_t *cpus, size_t count)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (cpus[i] < CPU_SETSIZE)
+        {
+            CPU_SET(cpus[i], &set);
+        }
+    }
+    return (CPU_COUNT(&set) > 0) && (sched_setaffinity(0, sizeof(set), &set) == 0);
+}
+
+NAMESPACE_END
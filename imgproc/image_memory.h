@@ -0,0 +1,117 @@
+/**
+ * @file image_memory.h
+ * @brief 图像内存分配，支持大页和NUMA节点绑定，减少大尺寸图像的TLB缺失
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 13:20:16
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 13:20:16 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 大页和NUMA内存分配 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef IMAGE_MEMORY_H
+#define IMAGE_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "base_define.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 内存地址对齐字节数
+ */
+#define IMAGE_MEMORY_ALIGNMENT (64)
+/**
+ * @brief 大页大小，超过阈值的内存按照该大小取整
+ */
+#define IMAGE_MEMORY_HUGEPAGE_SIZE (2 * 1024 * 1024)
+/**
+ * @brief 使用大页的最小内存大小，更小的内存直接在堆上分配
+ */
+#define IMAGE_MEMORY_HUGEPAGE_THRESHOLD (1024 * 1024)
+
+/**
+ * @brief 图像内存分配选项
+ */
+struct ImageMemoryOptions
+{
+    /**
+     * @brief Construct a new Image Memory Options object
+     * @param  hugePages        是否使用大页
+     * @param  numaNode         绑定的NUMA节点，-1 表示不绑定
+     */
+    ImageMemoryOptions(bool hugePages = false, int numaNode = -1) : HugePages(hugePages), NumaNode(numaNode)
+    {
+    }
+
+    bool HugePages; ///< 使用 MAP_HUGETLB，失败时使用透明大页(madvise)
+    int NumaNode;   ///< 内存优先分配的NUMA节点，-1 表示由系统决定(首次访问的线程所在节点)
+};
+
+/**
+ * @brief 图像内存分配静态类
+ * @details
+ *  默认在堆上按照 IMAGE_MEMORY_ALIGNMENT 对齐分配；
+ *  开启大页且内存不小于 IMAGE_MEMORY_HUGEPAGE_THRESHOLD 时使用mmap分配，
+ *  并按照大页大小取整，释放时需要传入分配时返回的映射大小
+ */
+class ImageMemory
+{
+public:
+    ImageMemory() = delete;
+
+public:
+    /**
+     * @brief  分配图像内存
+     * @param  size             需要的字节数
+     * @param  options          分配选项
+     * @param  zeroInitialize   是否清零，mmap分配的内存总是清零的
+     * @param  mappedSize       输出mmap映射的大小，堆上分配时为0
+     * @return uint8_t*         内存地址，失败时为nullptr
+     */
+    static uint8_t *Allocate(size_t size, const ImageMemoryOptions &options, bool zeroInitialize, size_t *mappedSize);
+    /**
+     * @brief 释放图像内存
+     * @param  data             内存地址
+     * @param  mappedSize       分配时返回的映射大小
+     */
+    static void Free(uint8_t *data, size_t mappedSize);
+    /**
+     * @brief  获取当前线程所在的NUMA节点
+     * @return int              节点编号，失败时为-1
+     */
+    static int CurrentNumaNode();
+    /**
+     * @brief  将当前线程绑定到NUMA节点的CPU上，使线程访问的内存位于本地节点
+     * @param  node             节点编号
+     * @return true  成功
+     * @return false 节点不存在或者设置失败
+     */
+    static bool RunOnNumaNode(int node);
+    /**
+     * @brief  将当前线程绑定到指定的CPU上
+     * @param  cpus             CPU编号
+     * @param  count            CPU数量
+     * @return true  成功
+     * @return false 没有可用的CPU或者设置失败
+     */
+    static bool RunOnCpus(const uint32_t *cpus, size_t count);
+};
+
+NAMESPACE_END
+
+#endif // IMAGE_MEMORY_H
@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "image_pool.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 图像池内部数据，由池对象、分配器和外部图像共同持有
+ */
+class ImagePoolData
+{
+public:
+    /**
+     * @brief 相同尺寸和格式的空闲图像
+     */
+    struct Bucket
+    {
+        int32_t Width;
+        int32_t Height;
+        PixelFormat Format;
+        std::vector<Image *> Free;
+    };
+
+public:
+    ImagePoolData(size_t maxFreeImages, const ImageMemoryOptions &memoryOptions) : MaxFreeImages(maxFreeImages),
+                                                                                   TotalImages(0),
+                                                                                   MemoryOptions(memoryOptions)
+    {
+        // 预留空间，归还压缩帧时不会再分配内存
+        FreeFrames.reserve(MaxFreeImages);
+    }
+
+    ~ImagePoolData()
+    {
+        for (size_t i = 0; i < Buckets.size(); i++)
+        {
+            for (size_t j = 0; j < Buckets[i].Free.size(); j++)
+            {
+                DestroyImage(Buckets[i].Free[j]);
+            }
+        }
+        for (size_t i = 0; i < FreeFrames.size(); i++)
+        {
+            delete FreeFrames[i];
+        }
+        for (size_t i = 0; i < FreeBlocks.size(); i++)
+        {
+            free(FreeBlocks[i]);
+        }
+    }
+    /**
+     * @brief 查找对应的缓存，不存在时创建
+     */
+    Bucket &FindBucket(int32_t width, int32_t height, PixelFormat format)
+    {
+        for (size_t i = 0; i < Buckets.size(); i++)
+        {
+            if ((Buckets[i].Width == width) && (Buckets[i].Height == height) && (Buckets[i].Format == format))
+            {
+                return Buckets[i];
+            }
+        }
+
+        Buckets.push_back(Bucket());
+        Bucket &bucket = Buckets.back();
+        bucket.Width = width;
+        bucket.Height = height;
+        bucket.Format = format;
+        // 预留空间，归还图像时不会再分配内存
+        bucket.Free.reserve(MaxFreeImages);
+        return bucket;
+    }
+
+    static void DestroyImage(Image *image)
+    {
+        // 池中的图像自己管理内存，析构时按照分配方式释放
+        delete image;
+    }
+
+public:
+    std::mutex Guard;                 ///< 缓存锁
+    size_t MaxFreeImages;             ///< 每种尺寸最多缓存的空闲图像数量
+    size_t TotalImages;               ///< 分配的图像总数
+    ImageMemoryOptions MemoryOptions; ///< 新图像的内存分配选项
+    std::vector<Bucket> Buckets;      ///< 各个尺寸的空闲图像
+    std::vector<EncodedFrame *> FreeFrames; ///< 空闲的压缩帧，只按照容量区分
+    std::vector<void *> FreeBlocks;   ///< 空闲的控制块
+};
+
+/**
+ * @brief 图像删除器，将图像归还到池中
+ */
+struct ImageRecycler
+{
+    ImagePoolData *Data;
+
+    void operator()(Image *image) const
+    {
+        std::lock_guard<std::mutex> lock(Data->Guard);
+        ImagePoolData::Bucket &bucket = Data->FindBucket(image->Width(), image->Height(), image->Format());
+
+        if (bucket.Free.size() < Data->MaxFreeImages)
+        {
+            bucket.Free.push_back(image);
+        }
+        else
+        {
+            ImagePoolData::DestroyImage(image);
+            Data->TotalImages--;
+        }
+    }
+};
+
+/**
+ * @brief 压缩帧删除器，将压缩帧归还到池中
+ */
+struct EncodedFrameRecycler
+{
+    ImagePoolData *Data;
+
+    void operator()(EncodedFrame *frame) const
+    {
+        std::lock_guard<std::mutex> lock(Data->Guard);
+
+        if (Data->FreeFrames.size() < Data->MaxFreeImages)
+        {
+            Data->FreeFrames.push_back(frame);
+        }
+        else
+        {
+            delete frame;
+            Data->TotalImages--;
+        }
+    }
+};
+
+ImagePool::ImagePool(size_t maxFreeImages, const ImageMemoryOptions &memoryOptions) : mData(std::make_shared<ImagePoolData>(maxFreeImages, memoryOptions))
+{
+}
+
+ImagePool::~ImagePool()
+{
+}
+
+int32_t ImagePool::AlignedStride(int32_t width, PixelFormat format)
+{
+    int32_t stride = static_cast<int32_t>(ImageBytesPerLine(width * ImageBitsPerPixel(format)));
+    return (stride + IMAGE_POOL_ALIGNMENT - 1) & ~(IMAGE_POOL_ALIGNMENT - 1);
+}
+
+std::shared_ptr<Image> ImagePool::Acquire(int32_t width, int32_t height, PixelFormat format)
+{
+    Image *image = nullptr;
+
+    if ((width <= 0) || (height <= 0) || (format == PixelFormat::Unknown) || (format == PixelFormat::JPEG))
+    {
+        return std::shared_ptr<Image>();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mData->Guard);
+        ImagePoolData::Bucket &bucket = mData->FindBucket(width, height, format);
+
+        if (!bucket.Free.empty())
+        {
+            image = bucket.Free.back();
+            bucket.Free.pop_back();
+        }
+    }
+
+    if (image == nullptr)
+    {
+        image = CreateImage(width, height, AlignedStride(width, format), format);
+        if (image == nullptr)
+        {
+            return std::shared_ptr<Image>();
+        }
+    }
+
+    image->mTimeStamp.tv_sec = 0;
+    image->mTimeStamp.tv_usec = 0;
+    image->mFrameId = 0;
+    return std::shared_ptr<Image>(image, ImageRecycler{mData.get()}, Allocator<Image>(mData));
+}
+
+std::shared_ptr<EncodedFrame> ImagePool::AcquireEncoded(uint32_t capacity, FrameCodec codec)
+{
+    EncodedFrame *frame = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mData->Guard);
+        std::vector<EncodedFrame *> &freeFrames = mData->FreeFrames;
+
+        // 使用第一个容量足够的缓冲区
+        for (size_t i = 0; i < freeFrames.size(); i++)
+        {
+            if (freeFrames[i]->Capacity() >= capacity)
+            {
+                frame = freeFrames[i];
+                freeFrames[i] = freeFrames.back();
+                freeFrames.pop_back();
+                break;
+            }
+        }
+        // 容量都不够时扩大最后一个缓冲区，避免缓存中只剩下过小的缓冲区
+        if ((frame == nullptr) && (!freeFrames.empty()) && (freeFrames.size() == mData->MaxFreeImages))
+        {
+            frame = freeFrames.back();
+            freeFrames.pop_back();
+        }
+    }
+
+    if (frame == nullptr)
+    {
+        frame = new (std::nothrow) EncodedFrame(nullptr, 0, codec, true);
+        if (frame == nullptr)
+        {
+            return std::shared_ptr<EncodedFrame>();
+        }
+        std::lock_guard<std::mutex> lock(mData->Guard);
+        mData->TotalImages++;
+    }
+    // 丢弃旧的数据之后再扩大，不需要拷贝
+    frame->mSize = 0;
+    if (frame->Reserve(capacity) != Error::Success)
+    {
+        delete frame;
+        std::lock_guard<std::mutex> lock(mData->Guard);
+        mData->TotalImages--;
+        return std::shared_ptr<EncodedFrame>();
+    }
+
+    frame->mCodec = codec;
+    frame->mKeyFrame = false;
+    frame->mTimeStamp.tv_sec = 0;
+    frame->mTimeStamp.tv_usec = 0;
+    frame->mSequence = 0;
+    return std::shared_ptr<EncodedFrame>(frame, EncodedFrameRecycler{mData.get()}, Allocator<EncodedFrame>(mData));
+}
+
+Image *ImagePool::CreateImage(int32_t width, int32_t height, int32_t stride, PixelFormat format)
+{
+    ImageMemoryOptions options;
+    size_t mappedSize = 0;
+    {
+        std::lock_guard<std::mutex> lock(mData->Guard);
+        options = mData->MemoryOptions;
+    }
+
+    uint8_t *data = ImageMemory::Allocate(static_cast<size_t>(stride) * ImageBufferRows(format, height), options, false, &mappedSize);
+    if (data == nullptr)
+    {
+        return nullptr;
+    }
+    Image *image = new (std::nothrow) Image(data, width, height, stride, format, true);
+    if (image == nullptr)
+    {
+        ImageMemory::Free(data, mappedSize);
+        return nullptr;
+    }
+    image->mMappedSize = mappedSize;
+
+    std::lock_guard<std::mutex> lock(mData->Guard);
+    mData->TotalImages++;
+    return image;
+}
+
+void ImagePool::SetMemoryOptions(const ImageMemoryOptions &memoryOptions)
+{
+    std::lock_guard<std::mutex> lock(mData->Guard);
+    mData->MemoryOptions = memoryOptions;
+}
+
+ImageMemoryOptions ImagePool::MemoryOptions() const
+{
+    std::lock_guard<std::mutex> lock(mData->Guard);
+    return mData->MemoryOptions;
+}
+
+size_t ImagePool::FreeImageCount() const
+{
+    std::lock_guard<std::mutex> lock(mData->Guard);
+    size_t count = mData->FreeFrames.size();
+
+    for (size_t i = 0; i < mData->Buckets.size(); i++)
+    {
+        count += mData->Buckets[i].Free.size();
+    }
+    return count;
+}
+
+size_t ImagePool::TotalImageCount() const
+{
+    std::lock_guard<std::mutex> lock(mData->Guard);
+    return mData->TotalImages;
+}
+
+void *ImagePool::AllocateBlock(ImagePoolData *data, size_t size)
+{
+    if (size > IMAGE_POOL_BLOCK_SIZE)
+    {
+        return ::operator new(size);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(data->Guard);
+        if (!data->FreeBlocks.empty())
+        {
+            void *block = data->FreeBlocks.back();
+            data->FreeBlocks.pop_back();
+            return block;
+        }
+    }
+
+    void *block = malloc(IMAGE_POOL_BLOCK_SIZE);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void ImagePool::FreeBlock(ImagePoolData *data, void *block, size_t size)
+{
+    if (size > IMAGE_POOL_BLOCK_SIZE)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(data->Guard);
+    data->FreeBlocks.push_back(block);
+}
+
+NAMESPACE_END
@@ -0,0 +1,164 @@
+/**
+ * @file image_pool.h
+ * @brief 图像内存池，循环使用图像和压缩帧缓冲区，避免每帧的内存分配
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 12:02:41
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 12:02:41 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 按照(宽,高,格式)缓存图像 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef IMAGE_POOL_H
+#define IMAGE_POOL_H
+
+#include <utility>
+#include "image.h"
+#include "encoded_frame.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 图像数据和行首地址的对齐字节数，满足SIMD指令的要求
+ */
+#define IMAGE_POOL_ALIGNMENT (IMAGE_MEMORY_ALIGNMENT)
+/**
+ * @brief 缓存的共享指针控制块大小，更大的控制块直接在堆上分配
+ */
+#define IMAGE_POOL_BLOCK_SIZE (192)
+class ImagePoolData;
+
+/**
+ * @brief 图像内存池
+ * @details
+ *  按照(宽,高,格式)缓存图像，图像通过自定义的shared_ptr删除器归还到池中；
+ *  压缩帧(EncodedFrame)按照容量缓存，获取时使用第一个容量足够的缓冲区。
+ *  共享指针的控制块同样由池缓存，因此稳定运行之后获取和释放图像不会产生堆分配。
+ *  池中的图像每行按照 IMAGE_POOL_ALIGNMENT 对齐，可以在池对象析构之后继续使用，线程安全
+ */
+class ImagePool : private Uncopyable
+{
+public:
+    /**
+     * @brief 使用池缓存内存块的分配器，用于共享指针控制块
+     */
+    template <typename T>
+    class Allocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit Allocator(const std::shared_ptr<ImagePoolData> &data) : mData(data) {}
+        template <typename U>
+        Allocator(const Allocator<U> &other) : mData(other.mData) {}
+
+        T *allocate(size_t n) { return static_cast<T *>(ImagePool::AllocateBlock(mData.get(), n * sizeof(T))); }
+        void deallocate(T *p, size_t n) { ImagePool::FreeBlock(mData.get(), p, n * sizeof(T)); }
+
+        template <typename U>
+        bool operator==(const Allocator<U> &other) const { return mData == other.mData; }
+        template <typename U>
+        bool operator!=(const Allocator<U> &other) const { return mData != other.mData; }
+
+    public:
+        std::shared_ptr<ImagePoolData> mData; ///< 分配器持有池数据，保证控制块释放时池仍然有效
+    };
+
+public:
+    /**
+     * @brief Construct a new Image Pool object
+     * @param  maxFreeImages    每种尺寸最多缓存的空闲图像数量
+     * @param  memoryOptions    图像内存分配选项，大尺寸图像可以使用大页和NUMA节点绑定
+     */
+    explicit ImagePool(size_t maxFreeImages = 8, const ImageMemoryOptions &memoryOptions = ImageMemoryOptions());
+    ~ImagePool();
+    /**
+     * @brief  获取指定尺寸和格式的图像，图像内容未初始化
+     * @param  width            图像宽度
+     * @param  height           图像高度
+     * @param  format           图像格式，压缩数据请使用 AcquireEncoded
+     * @return std::shared_ptr<Image> 图像，分配失败时为空
+     */
+    std::shared_ptr<Image> Acquire(int32_t width, int32_t height, PixelFormat format);
+    /**
+     * @brief  获取容量至少为capacity的压缩帧
+     * @details 返回压缩帧的数据大小为0，写入数据之后通过 EncodedFrame::SetSize 设置
+     * @param  capacity         最小容量
+     * @param  codec            编码格式
+     * @return std::shared_ptr<EncodedFrame> 压缩帧，分配失败时为空
+     */
+    std::shared_ptr<EncodedFrame> AcquireEncoded(uint32_t capacity, FrameCodec codec);
+    /**
+     * @brief  使用池缓存的控制块创建共享对象，用于每帧创建的小对象
+     * @return std::shared_ptr<T> 共享对象
+     */
+    template <typename T, typename... Args>
+    std::shared_ptr<T> MakeShared(Args &&... args)
+    {
+        return std::allocate_shared<T>(Allocator<T>(mData), std::forward<Args>(args)...);
+    }
+    /**
+     * @brief 设置之后新分配图像的内存选项，已经缓存的图像不受影响
+     * @param  memoryOptions    内存分配选项
+     */
+    void SetMemoryOptions(const ImageMemoryOptions &memoryOptions);
+    /**
+     * @brief  获取内存分配选项
+     * @return ImageMemoryOptions 内存分配选项
+     */
+    ImageMemoryOptions MemoryOptions() const;
+    /**
+     * @brief  当前空闲的图像数量，包括压缩帧
+     * @return size_t 图像数量
+     */
+    size_t FreeImageCount() const;
+    /**
+     * @brief  池分配的全部图像数量，包括正在使用的图像和压缩帧
+     * @return size_t 图像数量
+     */
+    size_t TotalImageCount() const;
+    /**
+     * @brief  计算对齐之后的行字节数
+     * @param  width            图像宽度
+     * @param  format           图像格式
+     * @return int32_t          按照 IMAGE_POOL_ALIGNMENT 对齐的字节数
+     */
+    static int32_t AlignedStride(int32_t width, PixelFormat format);
+
+public:
+    /**
+     * @brief 分配控制块内存，供 Allocator 使用
+     */
+    static void *AllocateBlock(ImagePoolData *data, size_t size);
+    /**
+     * @brief 释放控制块内存，供 Allocator 使用
+     */
+    static void FreeBlock(ImagePoolData *data, void *block, size_t size);
+
+private:
+    /**
+     * @brief  按照内存选项分配新的图像
+     * @return Image*           图像，失败时为nullptr
+     */
+    Image *CreateImage(int32_t width, int32_t height, int32_t stride, PixelFormat format);
+
+private:
+    std::shared_ptr<ImagePoolData> mData; ///< 池数据，所有图像释放之后才会析构
+};
+
+NAMESPACE_END
+
+#endif // IMAGE_POOL_H
@@ -0,0 +1,450 @@
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "image_scaler.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+NAMESPACE_START
+
+/* 16位行缓冲区的最大缩小倍数，255 * 16 * 16 不会溢出 */
+static const uint32_t kMaxRowSumFactor = 16;
+/* 双线性插值的权重位数 */
+static const int kBilinearBits = 7;
+static const int32_t kBilinearOne = 1 << kBilinearBits;
+
+/* 每个线程复用的行缓冲区，只在变大时重新分配 */
+static thread_local std::vector<uint16_t> tRowSums;
+static thread_local std::vector<uint16_t> tBilinearRows;
+static thread_local std::vector<int32_t> tBilinearColumns;
+
+static bool IsScalableFormat(PixelFormat format)
+{
+    return (format == PixelFormat::Grayscale8) || (format == PixelFormat::RGB24) || (format == PixelFormat::RGBA32) ||
+           (ImageIsPlanar(format));
+}
+
+/* 将一行像素累加到行缓冲区，first 为真时覆盖原来的值 */
+static void AccumulateRow(uint16_t *sums, const uint8_t *src, int32_t count, bool first)
+{
+    int32_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i low = _mm_unpacklo_epi8(s, zero);
+        __m128i high = _mm_unpackhi_epi8(s, zero);
+        if (!first)
+        {
+            low = _mm_add_epi16(low, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i)));
+            high = _mm_add_epi16(high, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i + 8)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i + 8), high);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint16x8_t low = vmovl_u8(vget_low_u8(s));
+        uint16x8_t high = vmovl_u8(vget_high_u8(s));
+        if (!first)
+        {
+            low = vaddq_u16(low, vld1q_u16(sums + i));
+            high = vaddq_u16(high, vld1q_u16(sums + i + 8));
+        }
+        vst1q_u16(sums + i, low);
+        vst1q_u16(sums + i + 8, high);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        sums[i] = static_cast<uint16_t>(first ? src[i] : sums[i] + src[i]);
+    }
+}
+
+/* 对行缓冲区中每 factor 个像素求和并取均值；Factor 为0时使用运行时的倍数，2/4 倍时除法变为移位 */
+template <int PixelSize, int Factor>
+static void AverageColumns(const uint16_t *sums, uint8_t *dst, int32_t dstWidth, uint32_t factor)
+{
+    const uint32_t step = (Factor > 0) ? static_cast<uint32_t>(Factor) : factor;
+    const uint32_t area = step * step;
+
+    for (int32_t x = 0; x < dstWidth; x++, sums += step * PixelSize)
+    {
+        for (int32_t c = 0; c < PixelSize; c++)
+        {
+            uint32_t sum = 0;
+            for (uint32_t k = 0; k < step; k++)
+            {
+                sum += sums[k * PixelSize + c];
+            }
+            *dst++ = static_cast<uint8_t>((sum + area / 2) / area);
+        }
+    }
+}
+
+template <int Factor>
+static void AverageColumns(int32_t pixelSize, const uint16_t *sums, uint8_t *dst, int32_t dstWidth, uint32_t factor)
+{
+    switch (pixelSize)
+    {
+    case 1:
+        AverageColumns<1, Factor>(sums, dst, dstWidth, factor);
+        break;
+    case 2:
+        AverageColumns<2, Factor>(sums, dst, dstWidth, factor);
+        break;
+    case 3:
+        AverageColumns<3, Factor>(sums, dst, dstWidth, factor);
+        break;
+    default:
+        AverageColumns<4, Factor>(sums, dst, dstWidth, factor);
+        break;
+    }
+}
+
+/* 每个块直接求和，只用于超过行缓冲区范围的缩小倍数 */
+static void DownscaleBlocks(const uint8_t *src, int32_t srcStride, uint8_t *dst, int32_t dstStride,
+                            int32_t dstWidth, int32_t dstHeight, uint32_t factor, int32_t pixelSize)
+{
+    const int32_t blockStep = static_cast<int32_t>(factor) * pixelSize;
+    const uint32_t area = factor * factor;
+
+    for (int32_t y = 0; y < dstHeight; y++)
+    {
+        const uint8_t *srcRow = src + y * factor * srcStride;
+        uint8_t *dstPtr = dst + y * dstStride;
+
+        for (int32_t x = 0; x < dstWidth; x++, srcRow += blockStep)
+        {
+            for (int32_t c = 0; c < pixelSize; c++)
+            {
+                const uint8_t *srcPtr = srcRow + c;
+                uint32_t sum = 0;
+
+                for (uint32_t ky = 0; ky < factor; ky++, srcPtr += srcStride)
+                {
+                    for (int32_t kx = 0; kx < blockStep; kx += pixelSize)
+                    {
+                        sum += srcPtr[kx];
+                    }
+                }
+                *dstPtr++ = static_cast<uint8_t>((sum + area / 2) / area);
+            }
+        }
+    }
+}
+
+/* 对一个平面进行均值缩小，源平面至少有 dstWidth * factor 列和 dstHeight * factor 行 */
+static void DownscalePlane(const uint8_t *src, int32_t srcStride, uint8_t *dst, int32_t dstStride,
+                           int32_t dstWidth, int32_t dstHeight, uint32_t factor, int32_t pixelSize)
+{
+    if (factor > kMaxRowSumFactor)
+    {
+        DownscaleBlocks(src, srcStride, dst, dstStride, dstWidth, dstHeight, factor, pixelSize);
+        return;
+    }
+
+    // 不足一个块的边缘像素不参与计算
+    const int32_t count = dstWidth * static_cast<int32_t>(factor) * pixelSize;
+    if (tRowSums.size() < static_cast<size_t>(count))
+    {
+        tRowSums.resize(count);
+    }
+    uint16_t *sums = &tRowSums[0];
+
+    // 先用SIMD把 factor 行按列累加到16位缓冲区，再对每 factor 列求均值
+    for (int32_t y = 0; y < dstHeight; y++)
+    {
+        const uint8_t *srcRow = src + y * factor * srcStride;
+        uint8_t *dstRow = dst + y * dstStride;
+
+        for (uint32_t ky = 0; ky < factor; ky++, srcRow += srcStride)
+        {
+            AccumulateRow(sums, srcRow, count, ky == 0);
+        }
+        if (factor == 2)
+        {
+            AverageColumns<2>(pixelSize, sums, dstRow, dstWidth, factor);
+        }
+        else if (factor == 4)
+        {
+            AverageColumns<4>(pixelSize, sums, dstRow, dstWidth, factor);
+        }
+        else
+        {
+            AverageColumns<0>(pixelSize, sums, dstRow, dstWidth, factor);
+        }
+    }
+}
+
+/* 按照源像素和目标像素的中心对齐计算坐标，返回两个采样位置和第二个位置的权重 */
+static void BilinearPosition(int32_t dstIndex, int32_t srcSize, int32_t dstSize, int32_t *first, int32_t *second, int32_t *weight)
+{
+    int64_t position = ((2 * static_cast<int64_t>(dstIndex) + 1) * srcSize << 15) / dstSize - (1 << 15);
+    if (position < 0)
+    {
+        position = 0;
+    }
+    *first = static_cast<int32_t>(position >> 16);
+    *weight = static_cast<int32_t>((position >> (16 - kBilinearBits)) & (kBilinearOne - 1));
+    if (*first >= srcSize - 1)
+    {
+        *first = srcSize - 1;
+        *weight = 0;
+    }
+    *second = (*weight == 0) ? *first : *first + 1;
+}
+
+/* 水平插值一行，结果放大 kBilinearOne 倍保存 */
+template <int PixelSize>
+static void BilinearRow(const uint8_t *src, uint16_t *dst, const int32_t *columns, int32_t dstWidth)
+{
+    for (int32_t x = 0; x < dstWidth; x++, columns += 3)
+    {
+        const uint8_t *first = src + columns[0];
+        const uint8_t *second = src + columns[1];
+        uint32_t weight = static_cast<uint32_t>(columns[2]);
+        for (int32_t c = 0; c < PixelSize; c++)
+        {
+            *dst++ = static_cast<uint16_t>(first[c] * (kBilinearOne - weight) + second[c] * weight);
+        }
+    }
+}
+
+static void BilinearRow(int32_t pixelSize, const uint8_t *src, uint16_t *dst, const int32_t *columns, int32_t dstWidth)
+{
+    switch (pixelSize)
+    {
+    case 1:
+        BilinearRow<1>(src, dst, columns, dstWidth);
+        break;
+    case 2:
+        BilinearRow<2>(src, dst, columns, dstWidth);
+        break;
+    case 3:
+        BilinearRow<3>(src, dst, columns, dstWidth);
+        break;
+    default:
+        BilinearRow<4>(src, dst, columns, dstWidth);
+        break;
+    }
+}
+
+/* 垂直插值两行水平插值的结果：(r0 * (1 - w) + r1 * w) 缩小 kBilinearOne * kBilinearOne 倍并四舍五入 */
+static void BlendRows(const uint16_t *row0, const uint16_t *row1, uint8_t *dst, int32_t count, int32_t weight)
+{
+    const int32_t shift = 2 * kBilinearBits;
+    int32_t i = 0;
+
+#if defined(__SSE2__)
+    // 插值结果最大为 255 * 128，与权重交错之后用 madd 得到32位结果
+    const __m128i weights = _mm_set1_epi32(((weight) << 16) | (kBilinearOne - weight));
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i));
+        __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i));
+        __m128i low = _mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), weights);
+        __m128i high = _mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), weights);
+        low = _mm_srai_epi32(_mm_add_epi32(low, round), shift);
+        high = _mm_srai_epi32(_mm_add_epi32(high, round), shift);
+        __m128i packed = _mm_packs_epi32(low, high);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(packed, packed));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint16x4_t weight0 = vdup_n_u16(static_cast<uint16_t>(kBilinearOne - weight));
+    const uint16x4_t weight1 = vdup_n_u16(static_cast<uint16_t>(weight));
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t r0 = vld1q_u16(row0 + i);
+        uint16x8_t r1 = vld1q_u16(row1 + i);
+        uint32x4_t low = vmlal_u16(vmull_u16(vget_low_u16(r0), weight0), vget_low_u16(r1), weight1);
+        uint32x4_t high = vmlal_u16(vmull_u16(vget_high_u16(r0), weight0), vget_high_u16(r1), weight1);
+        uint16x8_t packed = vcombine_u16(vrshrn_n_u32(low, 2 * kBilinearBits), vrshrn_n_u32(high, 2 * kBilinearBits));
+        vst1_u8(dst + i, vqmovn_u16(packed));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        uint32_t value = row0[i] * static_cast<uint32_t>(kBilinearOne - weight) + row1[i] * static_cast<uint32_t>(weight);
+        dst[i] = static_cast<uint8_t>((value + (1u << (shift - 1))) >> shift);
+    }
+}
+
+/* 对一个平面进行双线性缩放，水平方向插值后的两行缓存起来，相邻目标行共用源行时不重复计算 */
+static void ResizePlane(const uint8_t *src, int32_t srcStride, int32_t srcWidth, int32_t srcHeight,
+                        uint8_t *dst, int32_t dstStride, int32_t dstWidth, int32_t dstHeight, int32_t pixelSize)
+{
+    const int32_t count = dstWidth * pixelSize;
+
+    // 每个目标列：两个源像素的字节偏移和第二个像素的权重
+    if (tBilinearColumns.size() < static_cast<size_t>(dstWidth) * 3)
+    {
+        tBilinearColumns.resize(static_cast<size_t>(dstWidth) * 3);
+    }
+    if (tBilinearRows.size() < static_cast<size_t>(count) * 2)
+    {
+        tBilinearRows.resize(static_cast<size_t>(count) * 2);
+    }
+    int32_t *columns = &tBilinearColumns[0];
+    for (int32_t x = 0; x < dstWidth; x++)
+    {
+        int32_t first = 0, second = 0, weight = 0;
+        BilinearPosition(x, srcWidth, dstWidth, &first, &second, &weight);
+        columns[x * 3] = first * pixelSize;
+        columns[x * 3 + 1] = second * pixelSize;
+        columns[x * 3 + 2] = weight;
+    }
+
+    uint16_t *rows[2] = {&tBilinearRows[0], &tBilinearRows[count]};
+    int32_t cached[2] = {-1, -1};
+    for (int32_t y = 0; y < dstHeight; y++)
+    {
+        int32_t first = 0, second = 0, weight = 0;
+        BilinearPosition(y, srcHeight, dstHeight, &first, &second, &weight);
+
+        if (cached[1] == first)
+        {
+            std::swap(rows[0], rows[1]);
+            std::swap(cached[0], cached[1]);
+        }
+        if (cached[0] != first)
+        {
+            BilinearRow(pixelSize, src + first * srcStride, rows[0], columns, dstWidth);
+            cached[0] = first;
+        }
+        if ((weight != 0) && (cached[1] != second))
+        {
+            BilinearRow(pixelSize, src + second * srcStride, rows[1], columns, dstWidth);
+            cached[1] = second;
+        }
+        BlendRows(rows[0], (weight != 0) ? rows[1] : rows[0], dst + y * dstStride, count, weight);
+    }
+}
+
+/* 缩放4:2:0的色度平面，factor 为0时使用双线性缩放；奇数尺寸使色度不能整块缩小时也使用双线性缩放 */
+static void ScaleChroma(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst, uint32_t factor)
+{
+    const int32_t srcWidth = (src->Width() + 1) / 2;
+    const int32_t srcHeight = (src->Height() + 1) / 2;
+    const int32_t dstWidth = (dst->Width() + 1) / 2;
+    const int32_t dstHeight = (dst->Height() + 1) / 2;
+    // NV12 的UV交错平面作为每像素2字节的图像缩放
+    const int32_t pixelSize = (src->Format() == PixelFormat::NV12) ? 2 : 1;
+    const int32_t planes = (src->Format() == PixelFormat::NV12) ? 1 : 2;
+    const bool box = (factor > 0) &&
+                     (dstWidth * static_cast<int32_t>(factor) <= srcWidth) &&
+                     (dstHeight * static_cast<int32_t>(factor) <= srcHeight);
+
+    for (int32_t plane = 1; plane <= planes; plane++)
+    {
+        if (box)
+        {
+            DownscalePlane(src->Plane(plane), src->PlaneStride(plane), dst->Plane(plane), dst->PlaneStride(plane),
+                           dstWidth, dstHeight, factor, pixelSize);
+        }
+        else
+        {
+            ResizePlane(src->Plane(plane), src->PlaneStride(plane), srcWidth, srcHeight,
+                        dst->Plane(plane), dst->PlaneStride(plane), dstWidth, dstHeight, pixelSize);
+        }
+    }
+}
+
+int32_t ImageScaler::ScaledSize(int32_t size, uint32_t factor)
+{
+    int32_t scaled = (factor == 0) ? size : size / static_cast<int32_t>(factor);
+    return (scaled < 1) ? 1 : scaled;
+}
+
+uint32_t ImageScaler::BoxFactor(int32_t srcWidth, int32_t srcHeight, int32_t dstWidth, int32_t dstHeight)
+{
+    uint32_t factor = 1;
+
+    while ((dstWidth > 0) && (dstHeight > 0) &&
+           (srcWidth / static_cast<int32_t>(factor * 2) >= dstWidth) &&
+           (srcHeight / static_cast<int32_t>(factor * 2) >= dstHeight))
+    {
+        factor *= 2;
+    }
+    return factor;
+}
+
+// 整数倍均值缩小，每个目标像素为 factor x factor 块的均值
+Error ImageScaler::Downscale(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst, uint32_t factor)
+{
+    Error ret = Error::Success;
+
+    if ((!src) || (!dst) || (src->Data() == nullptr) || (dst->Data() == nullptr))
+    {
+        ret = Error::NullPointer;
+    }
+    else if (!IsScalableFormat(src->Format()))
+    {
+        ret = Error::UnsupportedPixelFormat;
+    }
+    else if ((factor == 0) ||
+             (src->Format() != dst->Format()) ||
+             (dst->Width() != ScaledSize(src->Width(), factor)) ||
+             (dst->Height() != ScaledSize(src->Height(), factor)) ||
+             (src->Width() < static_cast<int32_t>(factor)) ||
+             (src->Height() < static_cast<int32_t>(factor)))
+    {
+        ret = Error::ImageParametersMismatch;
+    }
+    else if (factor == 1)
+    {
+        ret = src->CopyData(dst);
+    }
+    else
+    {
+        DownscalePlane(src->Data(), src->Stride(), dst->Data(), dst->Stride(), dst->Width(), dst->Height(),
+                       factor, static_cast<int32_t>(ImageBitsPerPixel(src->Format()) / 8));
+        if (ImageIsPlanar(src->Format()))
+        {
+            ScaleChroma(src, dst, factor);
+        }
+    }
+
+    return ret;
+}
+
+// 双线性缩放，平面格式分别缩放每个平面
+Error ImageScaler::Resize(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst)
+{
+    if ((!src) || (!dst) || (src->Data() == nullptr) || (dst->Data() == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if (!IsScalableFormat(src->Format()))
+    {
+        return Error::UnsupportedPixelFormat;
+    }
+    if (src->Format() != dst->Format())
+    {
+        return Error::ImageParametersMismatch;
+    }
+    if ((src->Width() == dst->Width()) && (src->Height() == dst->Height()))
+    {
+        return src->CopyData(dst);
+    }
+
+    ResizePlane(src->Data(), src->Stride(), src->Width(), src->Height(),
+                dst->Data(), dst->Stride(), dst->Width(), dst->Height(), static_cast<int32_t>(ImageBitsPerPixel(src->Format()) / 8));
+    if (ImageIsPlanar(src->Format()))
+    {
+        ScaleChroma(src, dst, 0);
+    }
+
+    return Error::Success;
+}
+
+NAMESPACE_END
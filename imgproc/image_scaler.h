@@ -0,0 +1,84 @@
+/**
+ * @file image_scaler.h
+ * @brief 图像缩放工具类，主要用于生成低分辨率的预览图像
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 10:12:05
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 10:12:05 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 整数倍缩小 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef IMAGE_SCALER_H
+#define IMAGE_SCALER_H
+
+#include "image.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 图像缩放静态类，对图像进行整数倍的均值缩小和任意尺寸的双线性缩放
+ * @details
+ *  均值缩小先用SSE2/NEON把每个块的行累加到16位的行缓冲区，再按列求均值，2倍和4倍使用固定倍数的实现；
+ *  双线性缩放使用7位定点权重。行缓冲区每个线程一份，稳定之后每帧不再分配内存。
+ *  缩小超过2倍时双线性插值会丢失细节，先用 BoxFactor 得到的倍数均值缩小，再用 Resize 缩放到目标尺寸。
+ *  NV12/I420 分别缩放Y平面和色度平面，NV12 的UV平面按照每像素2字节处理
+ */
+class ImageScaler
+{
+public:
+    ImageScaler() = delete;
+
+public:
+    /**
+     * @brief  获取缩小之后的尺寸
+     * @param  size             原始尺寸
+     * @param  factor           缩小倍数
+     * @return int32_t          缩小后的尺寸,至少为1
+     */
+    static int32_t ScaledSize(int32_t size, uint32_t factor);
+    /**
+     * @brief  按照整数倍对图像进行均值(box)缩小
+     * @details 目标图像尺寸必须为 ScaledSize(src, factor)，格式必须与源图像一致；
+     *          不足一个块的边缘像素直接丢弃
+     * @param  src              源图像
+     * @param  dst              目标图像
+     * @param  factor           缩小倍数，1 表示直接拷贝
+     * @return Error            错误信息
+     */
+    static Error Downscale(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst, uint32_t factor);
+    /**
+     * @brief  双线性缩放到目标图像的尺寸
+     * @details 源像素和目标像素中心对齐，格式必须一致，支持Grayscale8/RGB24/RGBA32/NV12/I420
+     * @param  src              源图像，可以是裁剪视图
+     * @param  dst              目标图像
+     * @return Error            错误信息
+     */
+    static Error Resize(const std::shared_ptr<const Image> &src, const std::shared_ptr<Image> &dst);
+    /**
+     * @brief  缩放到目标尺寸之前可以先进行均值缩小的倍数
+     * @param  srcWidth         源图像宽度
+     * @param  srcHeight        源图像高度
+     * @param  dstWidth         目标宽度
+     * @param  dstHeight        目标高度
+     * @return uint32_t         2的幂，均值缩小之后两个方向都不小于目标尺寸；1 表示直接双线性缩放
+     */
+    static uint32_t BoxFactor(int32_t srcWidth, int32_t srcHeight, int32_t dstWidth, int32_t dstHeight);
+};
+
+NAMESPACE_END
+
+#endif // IMAGE_SCALER_H
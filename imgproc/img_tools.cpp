@@ -4,13 +4,25 @@
 // 记录各种数据格式需要对应的每个数据的长度
 uint32_t ImageBitsPerPixel( PixelFormat format )
 {
-    static int sizes[]     = { 0, 8, 24, 32, 8 };
+    static int sizes[]     = { 0, 8, 24, 32, 8, 16, 8, 8 };
     // 将其转换为索引
     int        formatIndex = static_cast<int>( format );
     //检查越界并输出
     return ( formatIndex >= ( sizeof( sizes ) / sizeof( sizes[0] ) ) ) ? 0 : sizes[formatIndex];
 };
 
+// 4:2:0的Y平面之后跟随色度平面
+bool ImageIsPlanar( PixelFormat format )
+{
+    return ( format == PixelFormat::NV12 ) || ( format == PixelFormat::I420 );
+};
+
+// 色度平面按照Y平面的步长折算为行数
+int32_t ImageBufferRows( PixelFormat format, int32_t height )
+{
+    return ( ImageIsPlanar( format ) ) ? height + ( height + 1 ) / 2 : height;
+};
+
 // R当每行的位数已知时，返回每个stride的字节数（stride总是32位对齐）
 uint32_t ImageBytesPerStride( uint32_t bitsPerLine )
 {
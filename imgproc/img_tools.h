@@ -42,6 +42,9 @@ enum class PixelFormat
     RGB24,       ///< RGB
     RGBA32,      ///< RGBA
     JPEG,        ///< JPEG
+    YUYV,        ///< YUYV 4:2:2，每两个像素共用一组UV
+    NV12,        ///< YUV 4:2:0 半平面，Y平面之后为UV交错的平面，每2x2个像素共用一组UV
+    I420,        ///< YUV 4:2:0 平面，Y平面之后依次为U、V平面，U/V的步长为Y的一半
     // Enough for this project
 };
 
@@ -93,11 +96,30 @@ typedef union
 
 /**
  * @brief 记录各种数据格式需要对应的每个数据的长度
+ * @details NV12/I420 返回Y平面的位数(8)，步长和行宽都按照Y平面计算，色度平面见 ImageBufferRows
  * @param  format           格式
  * @return uint32_t         对应数据长度
  */
 uint32_t ImageBitsPerPixel(PixelFormat format);
 
+/**
+ * @brief  是否为Y平面之后跟随色度平面的4:2:0格式(NV12/I420)
+ * @param  format           格式
+ * @return true  平面格式
+ * @return false 单平面格式
+ */
+bool ImageIsPlanar(PixelFormat format);
+
+/**
+ * @brief  图像数据按照Y平面步长计算的总行数
+ * @details 4:2:0格式的色度平面共 (height + 1) / 2 行：NV12 的UV平面与Y平面步长相同，
+ *          I420 的U、V平面步长为一半，两个平面合起来也是同样的行数
+ * @param  format           格式
+ * @param  height           图像高度
+ * @return int32_t          总行数，数据大小为 总行数 * 步长
+ */
+int32_t ImageBufferRows(PixelFormat format, int32_t height);
+
 /**
  * @brief R当每行的位数已知时，返回每个stride的字节数（stride总是32位对齐）
  * @param  bitsPerLine      每行的bit大小
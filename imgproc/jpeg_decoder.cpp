@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <jpeglib.h>
+#include "jpeg_decoder.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 解码使用的libjpeg错误
+ */
+class JpegDecoderException : public std::exception
+{
+public:
+    virtual const char *what() const throw()
+    {
+        return "JPEG decoding failure";
+    }
+};
+static void DecoderErrorExit(j_common_ptr /* cinfo */)
+{
+    throw JpegDecoderException();
+}
+
+static void DecoderOutputMessage(j_common_ptr /* cinfo */)
+{
+    // 损坏数据的警告不输出
+}
+
+/* 每次 jpeg_read_scanlines 最多读取的行数 */
+static const int kDecodeRows = 8;
+
+/**
+ * @brief JpegDecoder 的libjpeg状态
+ */
+class JpegDecoderData
+{
+public:
+    JpegDecoderData(uint32_t scale, bool fasterDecompression);
+    ~JpegDecoderData();
+    /**
+     * @brief  解码，参数与 JpegDecoder::DecodeFromMemory 相同
+     */
+    Error Decode(const uint8_t *data, uint32_t size, ImagePool &pool, std::shared_ptr<Image> &image);
+
+public:
+    uint32_t Scale;           ///< 缩小倍数
+    bool FasterDecompression; ///< 是否使用快速解码
+    PixelFormat Format;       ///< 输出格式
+
+private:
+    struct jpeg_decompress_struct dinfo; ///< 解码状态，在多帧之间复用
+    struct jpeg_error_mgr jerr;          ///< 错误处理
+};
+
+JpegDecoderData::JpegDecoderData(uint32_t scale, bool fasterDecompression) : Scale(scale),
+                                                                             FasterDecompression(fasterDecompression),
+                                                                             Format(PixelFormat::Unknown)
+{
+    dinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = DecoderErrorExit;
+    jerr.output_message = DecoderOutputMessage;
+    jpeg_create_decompress(&dinfo);
+}
+
+JpegDecoderData::~JpegDecoderData()
+{
+    jpeg_destroy_decompress(&dinfo);
+}
+
+Error JpegDecoderData::Decode(const uint8_t *data, uint32_t size, ImagePool &pool, std::shared_ptr<Image> &image)
+{
+    if ((data == nullptr) || (size == 0))
+    {
+        return Error::NullPointer;
+    }
+
+    try
+    {
+        jpeg_mem_src(&dinfo, data, static_cast<unsigned long>(size));
+        jpeg_read_header(&dinfo, TRUE);
+        // CMYK/YCCK 不能转换为RGB
+        if ((dinfo.num_components != 1) && (dinfo.num_components != 3))
+        {
+            jpeg_abort_decompress(&dinfo);
+            return Error::UnsupportedPixelFormat;
+        }
+
+        PixelFormat format = Format;
+        if (format == PixelFormat::Unknown)
+        {
+            format = (dinfo.num_components == 1) ? PixelFormat::Grayscale8 : PixelFormat::RGB24;
+        }
+        dinfo.out_color_space = (format == PixelFormat::Grayscale8) ? JCS_GRAYSCALE : JCS_RGB;
+        // 在IDCT中缩小，1/8 时每个块只需要直流分量
+        dinfo.scale_num = 1;
+        dinfo.scale_denom = Scale;
+        dinfo.dct_method = (FasterDecompression) ? JDCT_IFAST : JDCT_ISLOW;
+        dinfo.do_fancy_upsampling = (FasterDecompression) ? FALSE : TRUE;
+        jpeg_start_decompress(&dinfo);
+
+        int32_t width = static_cast<int32_t>(dinfo.output_width);
+        int32_t height = static_cast<int32_t>(dinfo.output_height);
+        if ((!image) || (image->Width() != width) || (image->Height() != height) || (image->Format() != format))
+        {
+            // 先释放旧的图像，使其可以被池重新使用
+            image.reset();
+            image = pool.Acquire(width, height, format);
+            if (!image)
+            {
+                jpeg_abort_decompress(&dinfo);
+                return Error::OutOfMemory;
+            }
+        }
+
+        JSAMPROW rows[kDecodeRows];
+        while (dinfo.output_scanline < dinfo.output_height)
+        {
+            JDIMENSION count = dinfo.output_height - dinfo.output_scanline;
+            count = (count > static_cast<JDIMENSION>(kDecodeRows)) ? kDecodeRows : count;
+            for (JDIMENSION i = 0; i < count; i++)
+            {
+                rows[i] = image->Data() + image->Stride() * (dinfo.output_scanline + i);
+            }
+            jpeg_read_scanlines(&dinfo, rows, count);
+        }
+        jpeg_finish_decompress(&dinfo);
+    }
+    catch (const JpegDecoderException &)
+    {
+        // 恢复解码对象的状态，保证下一帧可以继续使用
+        jpeg_abort_decompress(&dinfo);
+        return Error::FailedImageDecoding;
+    }
+
+    return Error::Success;
+}
+
+JpegDecoder::JpegDecoder(uint32_t scale, bool fasterDecompression) : mData(new JpegDecoderData(1, fasterDecompression))
+{
+    SetScale(scale);
+}
+
+JpegDecoder::~JpegDecoder()
+{
+    delete mData;
+}
+
+uint32_t JpegDecoder::Scale() const
+{
+    return mData->Scale;
+}
+void JpegDecoder::SetScale(uint32_t scale)
+{
+    mData->Scale = (scale >= 8) ? 8 : (scale >= 4) ? 4 : (scale >= 2) ? 2 : 1;
+}
+
+bool JpegDecoder::FasterDecompression() const
+{
+    return mData->FasterDecompression;
+}
+void JpegDecoder::SetFasterDecompression(bool faster)
+{
+    mData->FasterDecompression = faster;
+}
+
+PixelFormat JpegDecoder::OutputFormat() const
+{
+    return mData->Format;
+}
+void JpegDecoder::SetOutputFormat(PixelFormat format)
+{
+    mData->Format = ((format == PixelFormat::Grayscale8) || (format == PixelFormat::RGB24)) ? format : PixelFormat::Unknown;
+}
+
+Error JpegDecoder::DecodeFromMemory(const uint8_t *data, uint32_t size, ImagePool &pool, std::shared_ptr<Image> &image)
+{
+    return mData->Decode(data, size, pool, image);
+}
+
+Error JpegDecoder::DecodeFrame(const std::shared_ptr<const EncodedFrame> &frame, ImagePool &pool, std::shared_ptr<Image> &image)
+{
+    if (!frame)
+    {
+        return Error::NullPointer;
+    }
+    if (frame->Codec() != FrameCodec::JPEG)
+    {
+        return Error::UnsupportedPixelFormat;
+    }
+
+    Error ret = mData->Decode(frame->Data(), frame->Size(), pool, image);
+    if (ret == Error::Success)
+    {
+        image->UpdateTimeStamp(frame->TimeStamp());
+        image->SetFrameId(frame->Sequence());
+    }
+    return ret;
+}
+
+// 依次跳过标记段，直到帧头部(SOFn)
+Error JpegDecoder::ReadSize(const uint8_t *data, uint32_t size, int32_t *width, int32_t *height)
+{
+    if ((data == nullptr) || (width == nullptr) || (height == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if ((size < 4) || (data[0] != 0xFF) || (data[1] != 0xD8))
+    {
+        return Error::FailedImageDecoding;
+    }
+
+    uint32_t offset = 2;
+    while (offset + 4 <= size)
+    {
+        if (data[offset] != 0xFF)
+        {
+            return Error::FailedImageDecoding;
+        }
+        uint8_t marker = data[offset + 1];
+        if (marker == 0xFF)
+        {
+            // 填充字节
+            offset++;
+            continue;
+        }
+        if ((marker == 0xD8) || (marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7)))
+        {
+            offset += 2;
+            continue;
+        }
+        if ((marker == 0xD9) || (marker == 0xDA))
+        {
+            break;
+        }
+
+        uint32_t length = (static_cast<uint32_t>(data[offset + 2]) << 8) | data[offset + 3];
+        bool frameHeader = (marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC);
+        if (frameHeader)
+        {
+            if ((length < 7) || (offset + 9 > size))
+            {
+                break;
+            }
+            *height = (static_cast<int32_t>(data[offset + 5]) << 8) | data[offset + 6];
+            *width = (static_cast<int32_t>(data[offset + 7]) << 8) | data[offset + 8];
+            return ((*width > 0) && (*height > 0)) ? Error::Success : Error::FailedImageDecoding;
+        }
+        offset += 2 + length;
+    }
+    return Error::FailedImageDecoding;
+}
+
+int32_t JpegDecoder::ScaledSize(int32_t size, uint32_t scale)
+{
+    return (scale <= 1) ? size : (size + static_cast<int32_t>(scale) - 1) / static_cast<int32_t>(scale);
+}
+
+NAMESPACE_END
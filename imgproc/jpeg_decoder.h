@@ -0,0 +1,126 @@
+/**
+ * @file jpeg_decoder.h
+ * @brief JPEG解码，支持DCT域的1/2、1/4、1/8缩小
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 23:05:42
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 23:05:42 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 复用解码对象的缩小解码 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include "uncopyable.h"
+#include "base_error.h"
+#include "encoded_frame.h"
+#include "image_pool.h"
+#include "img_tools.h"
+
+NAMESPACE_START
+
+class JpegDecoderData;
+/**
+ * @brief JpegEncoder 对应的解码器
+ * @details
+ *  缩小倍数通过libjpeg的 scale_num/scale_denom 在IDCT中完成：1/8 时每个8x8块只计算直流分量，
+ *  1/2、1/4 使用缩小的IDCT，颜色转换和上采样也只处理缩小之后的像素，
+ *  因此摄像头输出MJPEG时生成缩略图只需要完整解码的一小部分时间。
+ *  解码对象在多帧之间复用，不重复创建libjpeg状态。每个对象非线程安全
+ */
+class JpegDecoder : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Jpeg Decoder object
+     * @param  scale               缩小倍数，1/2/4/8
+     * @param  fasterDecompression 是否使用快速IDCT并关闭平滑上采样
+     */
+    explicit JpegDecoder(uint32_t scale = 1, bool fasterDecompression = false);
+    ~JpegDecoder();
+    /**
+     * @brief  缩小倍数
+     * @return uint32_t 1/2/4/8
+     */
+    uint32_t Scale() const;
+    /**
+     * @brief Set the Scale object
+     * @param  scale            缩小倍数，不是2的幂时向下取整，最大为8
+     */
+    void SetScale(uint32_t scale);
+    /**
+     * @brief  是否使用快速解码
+     * @return true  启用
+     * @return false 未启用
+     */
+    bool FasterDecompression() const;
+    /**
+     * @brief Set the Faster Decompression object
+     * @param  faster           开启快速解码
+     */
+    void SetFasterDecompression(bool faster);
+    /**
+     * @brief  输出格式
+     * @return PixelFormat Grayscale8/RGB24，Unknown 表示单分量图像输出灰度，其他输出RGB24
+     */
+    PixelFormat OutputFormat() const;
+    /**
+     * @brief Set the Output Format object
+     * @param  format           Grayscale8/RGB24/Unknown
+     */
+    void SetOutputFormat(PixelFormat format);
+    /**
+     * @brief  解码到图像
+     * @param  data             JPEG数据
+     * @param  size             数据大小
+     * @param  pool             图像池
+     * @param  image            输入为之前的图像，尺寸和格式相同时直接覆盖，否则从池中获取；输出为解码之后的图像
+     * @return Error            错误信息
+     */
+    Error DecodeFromMemory(const uint8_t *data, uint32_t size, ImagePool &pool, std::shared_ptr<Image> &image);
+    /**
+     * @brief  解码压缩帧，保留帧的时间戳和序号
+     * @param  frame            JPEG压缩帧
+     * @param  pool             图像池
+     * @param  image            与 DecodeFromMemory 相同
+     * @return Error            错误信息
+     */
+    Error DecodeFrame(const std::shared_ptr<const EncodedFrame> &frame, ImagePool &pool, std::shared_ptr<Image> &image);
+    /**
+     * @brief  只读取帧头部中的图像尺寸，不创建解码状态
+     * @param  data             JPEG数据
+     * @param  size             数据大小
+     * @param  width            图像宽度
+     * @param  height           图像高度
+     * @return Error            错误信息，没有找到帧头部时返回 FailedImageDecoding
+     */
+    static Error ReadSize(const uint8_t *data, uint32_t size, int32_t *width, int32_t *height);
+    /**
+     * @brief  缩小解码之后的尺寸，与libjpeg相同向上取整
+     * @param  size             原始尺寸
+     * @param  scale            缩小倍数
+     * @return int32_t          解码之后的尺寸
+     */
+    static int32_t ScaledSize(int32_t size, uint32_t scale);
+
+private:
+    JpegDecoderData *mData; ///< libjpeg解码状态
+};
+
+NAMESPACE_END
+
+#endif // JPEG_DECODER_H
@@ -1,4 +1,10 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "jpeg_encoder.h"
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
 
 NAMESPACE_START
 
@@ -23,7 +29,29 @@ static void my_output_message(j_common_ptr /* cinfo */)
     // do nothing - kill the message
 }
 
-JpegEncoderData::JpegEncoderData(uint16_t quality, bool fasterCompression) : Quality(quality), FasterCompression(fasterCompression)
+JpegEncoderData::JpegEncoderData(uint16_t quality, bool fasterCompression) : Quality(quality),
+                                                                             FasterCompression(fasterCompression),
+                                                                             RestartRows(0),
+                                                                             Backend(JpegBackend::LibJpeg),
+                                                                             RateControl(),
+                                                                             mArenaChunks(),
+                                                                             mArenaChunkSizes(),
+                                                                             mArenaChunk(0),
+                                                                             mArenaOffset(0),
+                                                                             mOutput(nullptr),
+                                                                             mMemoryBuffer(nullptr),
+                                                                             mMemoryCapacity(0),
+                                                                             mConfigured(false),
+                                                                             mConfiguredWidth(0),
+                                                                             mConfiguredHeight(0),
+                                                                             mConfiguredFormat(PixelFormat::Unknown),
+                                                                             mTableQuality(JPEG_QUALITY_LEVELS),
+                                                                             mQuantCache(),
+                                                                             mQuantCached(),
+                                                                             mRows(),
+                                                                             mRawScratch(),
+                                                                             mTurboHandle(nullptr),
+                                                                             mComplexity(0)
 {
     if (Quality > 100)
     {
@@ -36,88 +64,607 @@ JpegEncoderData::JpegEncoderData(uint16_t quality, bool fasterCompression) : Qua
     jerr.output_message = my_output_message;
     /*  创建压缩信息 */
     jpeg_create_compress(&cinfo);
+    cinfo.client_data = this;
+
+    /* 单张图片的内存每帧都会分配和释放，替换为循环使用的分块 */
+    mMemoryMethods = *cinfo.mem;
+    cinfo.mem->alloc_small = ArenaAllocSmall;
+    cinfo.mem->alloc_large = ArenaAllocLarge;
+    cinfo.mem->alloc_sarray = ArenaAllocSarray;
+    cinfo.mem->alloc_barray = ArenaAllocBarray;
+    cinfo.mem->free_pool = ArenaFreePool;
+
+    mPoolDest.init_destination = PoolInitDestination;
+    mPoolDest.empty_output_buffer = PoolEmptyOutputBuffer;
+    mPoolDest.term_destination = PoolTermDestination;
+    mPoolDest.next_output_byte = nullptr;
+    mPoolDest.free_in_buffer = 0;
+
+    mMemoryDest.init_destination = MemoryInitDestination;
+    mMemoryDest.empty_output_buffer = MemoryEmptyOutputBuffer;
+    mMemoryDest.term_destination = MemoryTermDestination;
+    mMemoryDest.next_output_byte = nullptr;
+    mMemoryDest.free_in_buffer = 0;
 }
 JpegEncoderData::~JpegEncoderData()
 {
     jpeg_destroy_compress(&cinfo);
+#ifdef HAVE_TURBOJPEG
+    if (mTurboHandle != nullptr)
+    {
+        tjDestroy(static_cast<tjhandle>(mTurboHandle));
+    }
+#endif
+    for (size_t i = 0; i < mArenaChunks.size(); i++)
+    {
+        free(mArenaChunks[i]);
+    }
 }
 
-/* 关键压缩函数 */
-Error JpegEncoderData::EncodeToMemory(
-    const std::shared_ptr<const Image> &image, /* 源图片地址 */
-    uint8_t **buffer,                          /* 压缩后的目标地址 */
-    uint32_t *bufferSize                       /* buffer的长度 */
-)
+void *JpegEncoderData::ArenaAllocate(size_t size)
 {
-    /* 编码的行指针 */
-    JSAMPROW row_pointer[1];
-    Error ret = Error::Success;
-    /* 检查数据 */
-    if ((!image) || (image->Data() == nullptr) || (buffer == nullptr) || (*buffer == nullptr) || (bufferSize == nullptr))
+    size = (size + IMAGE_POOL_ALIGNMENT - 1) & ~static_cast<size_t>(IMAGE_POOL_ALIGNMENT - 1);
+
+    // 每张图片的分配顺序相同，因此第一张图片之后不会再分配新的分块
+    while (mArenaChunk < mArenaChunks.size())
     {
-        ret = Error::NullPointer;
+        if (mArenaOffset + size <= mArenaChunkSizes[mArenaChunk])
+        {
+            void *ptr = mArenaChunks[mArenaChunk] + mArenaOffset;
+            mArenaOffset += size;
+            return ptr;
+        }
+        mArenaChunk++;
+        mArenaOffset = 0;
     }
-    else if ((image->Format() != PixelFormat::RGB24) && (image->Format() != PixelFormat::Grayscale8))
+
+    size_t chunkSize = (size > JPEG_ARENA_CHUNK_SIZE) ? size : JPEG_ARENA_CHUNK_SIZE;
+    void *chunk = nullptr;
+    if (posix_memalign(&chunk, IMAGE_POOL_ALIGNMENT, chunkSize) != 0)
     {
-        ret = Error::UnsupportedPixelFormat;
+        throw JpegException();
     }
-    else
+    mArenaChunks.push_back(static_cast<uint8_t *>(chunk));
+    mArenaChunkSizes.push_back(chunkSize);
+    mArenaChunk = mArenaChunks.size() - 1;
+    mArenaOffset = size;
+    return chunk;
+}
+
+void *JpegEncoderData::ArenaAllocSmall(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    if (pool_id != JPOOL_IMAGE)
     {
-        try
+        return data->mMemoryMethods.alloc_small(cinfo, pool_id, sizeofobject);
+    }
+    return data->ArenaAllocate(sizeofobject);
+}
+
+void *JpegEncoderData::ArenaAllocLarge(j_common_ptr cinfo, int pool_id, size_t sizeofobject)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return data->mMemoryMethods.alloc_large(cinfo, pool_id, sizeofobject);
+    }
+    return data->ArenaAllocate(sizeofobject);
+}
+
+JSAMPARRAY JpegEncoderData::ArenaAllocSarray(j_common_ptr cinfo, int pool_id, JDIMENSION samplesperrow, JDIMENSION numrows)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return data->mMemoryMethods.alloc_sarray(cinfo, pool_id, samplesperrow, numrows);
+    }
+    // 与libjpeg-turbo一致，每行按照SIMD宽度补齐，SIMD代码可能读写行尾的填充
+    size_t rowSize = ((samplesperrow * sizeof(JSAMPLE)) + IMAGE_POOL_ALIGNMENT - 1) & ~static_cast<size_t>(IMAGE_POOL_ALIGNMENT - 1);
+    JSAMPARRAY result = static_cast<JSAMPARRAY>(data->ArenaAllocate(numrows * sizeof(JSAMPROW)));
+    uint8_t *rows = static_cast<uint8_t *>(data->ArenaAllocate(rowSize * numrows));
+
+    for (JDIMENSION i = 0; i < numrows; i++)
+    {
+        result[i] = reinterpret_cast<JSAMPROW>(rows + i * rowSize);
+    }
+    return result;
+}
+
+JBLOCKARRAY JpegEncoderData::ArenaAllocBarray(j_common_ptr cinfo, int pool_id, JDIMENSION blocksperrow, JDIMENSION numrows)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    if (pool_id != JPOOL_IMAGE)
+    {
+        return data->mMemoryMethods.alloc_barray(cinfo, pool_id, blocksperrow, numrows);
+    }
+    size_t rowSize = blocksperrow * sizeof(JBLOCK);
+    JBLOCKARRAY result = static_cast<JBLOCKARRAY>(data->ArenaAllocate(numrows * sizeof(JBLOCKROW)));
+    uint8_t *rows = static_cast<uint8_t *>(data->ArenaAllocate(rowSize * numrows));
+
+    for (JDIMENSION i = 0; i < numrows; i++)
+    {
+        result[i] = reinterpret_cast<JBLOCKROW>(rows + i * rowSize);
+    }
+    return result;
+}
+
+void JpegEncoderData::ArenaFreePool(j_common_ptr cinfo, int pool_id)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    if (pool_id == JPOOL_IMAGE)
+    {
+        // 分块保留给下一张图片使用
+        data->mArenaChunk = 0;
+        data->mArenaOffset = 0;
+    }
+    data->mMemoryMethods.free_pool(cinfo, pool_id);
+}
+
+void JpegEncoderData::PoolInitDestination(j_compress_ptr cinfo)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    cinfo->dest->next_output_byte = data->mOutput->Data();
+    cinfo->dest->free_in_buffer = data->mOutput->Capacity();
+}
+
+boolean JpegEncoderData::PoolEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    // 缓冲区已满，原地扩大为两倍，归还到池中之后保留扩大的容量
+    uint32_t used = data->mOutput->Capacity();
+
+    if ((data->mOutput->SetSize(used) != Error::Success) || (data->mOutput->Reserve(used * 2) != Error::Success))
+    {
+        throw JpegException();
+    }
+    cinfo->dest->next_output_byte = data->mOutput->Data() + used;
+    cinfo->dest->free_in_buffer = data->mOutput->Capacity() - used;
+    return TRUE;
+}
+
+void JpegEncoderData::PoolTermDestination(j_compress_ptr cinfo)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    data->mOutput->SetSize(static_cast<uint32_t>(data->mOutput->Capacity() - cinfo->dest->free_in_buffer));
+}
+
+void JpegEncoderData::MemoryInitDestination(j_compress_ptr cinfo)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    cinfo->dest->next_output_byte = *data->mMemoryBuffer;
+    cinfo->dest->free_in_buffer = data->mMemoryCapacity;
+}
+
+boolean JpegEncoderData::MemoryEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+    JpegEncoderData *data = static_cast<JpegEncoderData *>(cinfo->client_data);
+    // 与接口说明一致使用realloc扩大调用者的缓冲区，不会泄漏原来的内存
+    uint32_t used = data->mMemoryCapacity;
+    uint32_t capacity = (used < ENCODED_FRAME_GRANULARITY) ? ENCODED_FRAME_GRANULARITY : used * 2;
+    uint8_t *buffer = static_cast<uint8_t *>(realloc(*data->mMemoryBuffer, capacity));
+
+    if (buffer == nullptr)
+    {
+        throw JpegException();
+    }
+    *data->mMemoryBuffer = buffer;
+    data->mMemoryCapacity = capacity;
+    cinfo->dest->next_output_byte = buffer + used;
+    cinfo->dest->free_in_buffer = capacity - used;
+    return TRUE;
+}
+
+void JpegEncoderData::MemoryTermDestination(j_compress_ptr /* cinfo */)
+{
+    // 压缩之后的大小由 EncodeToMemory 根据剩余容量计算
+}
+
+// 编码参数只在尺寸或格式改变时重新设置，量化表按照质量缓存
+void JpegEncoderData::Configure(const std::shared_ptr<const Image> &image)
+{
+    if ((!mConfigured) || (image->Width() != mConfiguredWidth) || (image->Height() != mConfiguredHeight) ||
+        (image->Format() != mConfiguredFormat))
+    {
+        // 获取压缩的参数信息
+        cinfo.image_width = image->Width();
+        cinfo.image_height = image->Height();
+
+        if (image->Format() == PixelFormat::RGB24)
         {
-            //获取buffer的长度
-            unsigned long mem_buffer_size = *bufferSize;
-            /* 分配内存，将cinfo中的指针指向buffer */
-            jpeg_mem_dest(&cinfo, buffer, &mem_buffer_size);
+            cinfo.input_components = 3;
+            cinfo.in_color_space = JCS_RGB;
+        }
+        else if (ImageIsPlanar(image->Format()))
+        {
+            // 4:2:0数据直接作为YCbCr输入，默认的采样因子也是 2x2、1x1、1x1
+            cinfo.input_components = 3;
+            cinfo.in_color_space = JCS_YCbCr;
+        }
+        else
+        {
+            cinfo.input_components = 1;
+            cinfo.in_color_space = JCS_GRAYSCALE;
+        }
 
-            // 获取压缩的参数信息
-            cinfo.image_width = image->Width();
-            cinfo.image_height = image->Height();
+        // 设置默认的压缩参数，标准Huffman表与质量无关，在压缩对象中一直保留
+        jpeg_set_defaults(&cinfo);
+        // 平面格式跳过颜色转换和下采样，直接传入每个分量的行
+        cinfo.raw_data_in = (ImageIsPlanar(image->Format())) ? TRUE : FALSE;
+        mConfigured = true;
+        mConfiguredWidth = image->Width();
+        mConfiguredHeight = image->Height();
+        mConfiguredFormat = image->Format();
+        mTableQuality = JPEG_QUALITY_LEVELS;
+    }
 
-            if (image->Format() == PixelFormat::RGB24)
+    if (Quality != mTableQuality)
+    {
+        if (mQuantCache.empty())
+        {
+            mQuantCache.resize(JPEG_QUALITY_LEVELS * 2 * DCTSIZE2);
+            mQuantCached.assign(JPEG_QUALITY_LEVELS, false);
+        }
+        UINT16 *tables = &mQuantCache[Quality * 2 * DCTSIZE2];
+        if (!mQuantCached[Quality])
+        {
+            // 设置压缩质量
+            jpeg_set_quality(&cinfo, (int)Quality, TRUE /* limit to baseline-JPEG values */);
+            for (int i = 0; i < 2; i++)
             {
-                cinfo.input_components = 3;
-                cinfo.in_color_space = JCS_RGB;
+                memcpy(tables + i * DCTSIZE2, cinfo.quant_tbl_ptrs[i]->quantval, sizeof(UINT16) * DCTSIZE2);
             }
-            else
+            mQuantCached[Quality] = true;
+        }
+        else
+        {
+            for (int i = 0; i < 2; i++)
             {
-                cinfo.input_components = 1;
-                cinfo.in_color_space = JCS_GRAYSCALE;
+                memcpy(cinfo.quant_tbl_ptrs[i]->quantval, tables + i * DCTSIZE2, sizeof(UINT16) * DCTSIZE2);
+                cinfo.quant_tbl_ptrs[i]->sent_table = FALSE;
             }
+        }
+        mTableQuality = Quality;
+    }
 
-            //设置默认的压缩参数
-            jpeg_set_defaults(&cinfo);
-            // 设置压缩质量
-            jpeg_set_quality(&cinfo, (int)Quality, TRUE /* limit to baseline-JPEG values */);
+    // 是否使用快速压缩算法
+    cinfo.dct_method = (FasterCompression) ? JDCT_FASTEST : JDCT_DEFAULT;
+    // 重启间隔；restart_interval 在上一次压缩时由 restart_in_rows 计算，需要清零
+    cinfo.restart_interval = 0;
+    cinfo.restart_in_rows = RestartRows;
+}
 
-            // 是否使用快速压缩算法
-            cinfo.dct_method = (FasterCompression) ? JDCT_FASTEST : JDCT_DEFAULT;
+/* 质量对应的相对帧大小，质量50时为1；libjpeg按照 scale 百分比缩放量化表 */
+static double QualitySizeFactor(uint16_t quality)
+{
+    double scale = (quality < 50) ? 5000.0 / ((quality < 1) ? 1 : quality) : 200.0 - 2.0 * quality;
+    return pow(100.0 / ((scale < 1.0) ? 1.0 : scale), JPEG_RATE_SIZE_EXPONENT);
+}
+
+void JpegEncoderData::SelectQuality(const std::shared_ptr<const Image> &image)
+{
+    // 第一帧没有模型，使用设置的质量
+    if ((RateControl.TargetBytes == 0) || (mComplexity <= 0))
+    {
+        return;
+    }
+
+    double wanted = static_cast<double>(RateControl.TargetBytes) / (mComplexity * image->Width() * image->Height());
+    uint16_t quality = RateControl.MinQuality;
+    // 预测大小不超过目标的最高质量
+    while ((quality < RateControl.MaxQuality) && (QualitySizeFactor(static_cast<uint16_t>(quality + 1)) <= wanted))
+    {
+        quality++;
+    }
+
+    // 模型只是近似，限制每帧的变化避免画面质量跳变和振荡
+    int lower = static_cast<int>(Quality) - RateControl.MaxStep;
+    int upper = static_cast<int>(Quality) + RateControl.MaxStep;
+    int next = (quality < lower) ? lower : ((quality > upper) ? upper : quality);
+    next = (next < RateControl.MinQuality) ? RateControl.MinQuality : ((next > RateControl.MaxQuality) ? RateControl.MaxQuality : next);
+    Quality = static_cast<uint16_t>(next);
+}
+
+void JpegEncoderData::UpdateRateModel(const std::shared_ptr<const Image> &image, uint32_t size)
+{
+    if (RateControl.TargetBytes == 0)
+    {
+        return;
+    }
+    // 按照像素数归一化，档位尺寸改变之后模型仍然可用
+    double pixels = static_cast<double>(image->Width()) * image->Height();
+    double complexity = static_cast<double>(size) / (QualitySizeFactor(Quality) * pixels);
+    mComplexity = (mComplexity <= 0) ? complexity : (mComplexity + complexity) / 2;
+}
+
+bool JpegEncoderData::UseTurbo(const std::shared_ptr<const Image> &image) const
+{
+#ifdef HAVE_TURBOJPEG
+    // TurboJPEG不能插入重启标记，没有NV12的输入接口，不支持的格式由libjpeg返回错误
+    return (Backend == JpegBackend::TurboJpeg) && (RestartRows == 0) &&
+           ((image->Format() == PixelFormat::RGB24) || (image->Format() == PixelFormat::Grayscale8) ||
+            (image->Format() == PixelFormat::I420));
+#else
+    return false;
+#endif
+}
+
+uint32_t JpegEncoderData::TurboBufferSize(const std::shared_ptr<const Image> &image) const
+{
+#ifdef HAVE_TURBOJPEG
+    int subsampling = (image->Format() == PixelFormat::Grayscale8) ? TJSAMP_GRAY : TJSAMP_420;
+    return static_cast<uint32_t>(tjBufSize(image->Width(), image->Height(), subsampling));
+#else
+    return 0;
+#endif
+}
+
+Error JpegEncoderData::TurboCompress(const std::shared_ptr<const Image> &image, uint8_t *buffer, unsigned long *size)
+{
+#ifdef HAVE_TURBOJPEG
+    if (mTurboHandle == nullptr)
+    {
+        mTurboHandle = tjInitCompress();
+        if (mTurboHandle == nullptr)
+        {
+            return Error::OutOfMemory;
+        }
+    }
+
+    bool gray = (image->Format() == PixelFormat::Grayscale8);
+    // 缓冲区按照 tjBufSize 预先分配，不允许TurboJPEG重新分配
+    int flags = TJFLAG_NOREALLOC | ((FasterCompression) ? TJFLAG_FASTDCT : 0);
+    unsigned char *output = buffer;
+    if (image->Format() == PixelFormat::I420)
+    {
+        const unsigned char *planes[3] = {image->Plane(0), image->Plane(1), image->Plane(2)};
+        int strides[3] = {image->PlaneStride(0), image->PlaneStride(1), image->PlaneStride(2)};
+        if (tjCompressFromYUVPlanes(static_cast<tjhandle>(mTurboHandle), planes, image->Width(), strides, image->Height(), TJSAMP_420,
+                                    &output, size, (Quality < 1) ? 1 : Quality, flags) != 0)
+        {
+            return Error::FailedImageEncoding;
+        }
+        return Error::Success;
+    }
+    if (tjCompress2(static_cast<tjhandle>(mTurboHandle), image->Data(), image->Width(), image->Stride(), image->Height(),
+                    (gray) ? TJPF_GRAY : TJPF_RGB, &output, size, (gray) ? TJSAMP_GRAY : TJSAMP_420,
+                    (Quality < 1) ? 1 : Quality, flags) != 0)
+    {
+        return Error::FailedImageEncoding;
+    }
+    return Error::Success;
+#else
+    return Error::ConfigurationNotSupported;
+#endif
+}
+
+/* 一行补齐到 paddedSize，超出部分重复最后一个像素；step 为2时读取UV交错中的一个分量 */
+static void PadRawRow(const uint8_t *src, int32_t step, int32_t count, uint8_t *dst, int32_t paddedSize)
+{
+    if (step == 1)
+    {
+        memcpy(dst, src, count);
+    }
+    else
+    {
+        for (int32_t i = 0; i < count; i++)
+        {
+            dst[i] = src[i * step];
+        }
+    }
+    memset(dst + count, dst[count - 1], paddedSize - count);
+}
+
+// 每次写入一个iMCU行：16行Y和8行U、V
+void JpegEncoderData::WriteRawData(const std::shared_ptr<const Image> &image)
+{
+    const int32_t height = image->Height();
+    const int32_t chromaWidth = (image->Width() + 1) / 2;
+    const int32_t chromaHeight = (height + 1) / 2;
+    const bool nv12 = (image->Format() == PixelFormat::NV12);
+    // libjpeg按照整块读取每个分量，宽度不是8的倍数或者色度交错时先拷贝到补齐的行
+    const int32_t widths[3] = {image->Width(), chromaWidth, chromaWidth};
+    const int32_t rowCounts[3] = {2 * DCTSIZE, DCTSIZE, DCTSIZE};
+    int32_t paddedWidths[3];
+    bool direct[3];
+    size_t scratchSize = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        paddedWidths[c] = (widths[c] + DCTSIZE - 1) / DCTSIZE * DCTSIZE;
+        direct[c] = (paddedWidths[c] == widths[c]) && ((c == 0) || (!nv12));
+        scratchSize += (direct[c]) ? 0 : static_cast<size_t>(paddedWidths[c]) * rowCounts[c];
+    }
+    if (mRawScratch.size() < scratchSize)
+    {
+        mRawScratch.resize(scratchSize);
+    }
+
+    JSAMPROW rows[3][2 * DCTSIZE];
+    JSAMPARRAY planes[3] = {rows[0], rows[1], rows[2]};
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        uint8_t *scratch = (scratchSize > 0) ? &mRawScratch[0] : nullptr;
+        for (int c = 0; c < 3; c++)
+        {
+            int32_t first = static_cast<int32_t>(cinfo.next_scanline) / ((c == 0) ? 1 : 2);
+            int32_t planeHeight = (c == 0) ? height : chromaHeight;
+            // NV12 的U、V都在平面1中，V偏移一个字节
+            int32_t plane = (nv12) ? ((c == 0) ? 0 : 1) : c;
+            const uint8_t *data = image->Plane(plane) + ((nv12 && (c == 2)) ? 1 : 0);
+            int32_t stride = image->PlaneStride(plane);
+
+            for (int32_t i = 0; i < rowCounts[c]; i++)
+            {
+                // 超过图像高度的行指向最后一行，libjpeg只用于补齐最后的块
+                int32_t y = first + i;
+                if (y >= planeHeight)
+                {
+                    rows[c][i] = rows[c][i - 1];
+                    continue;
+                }
+                const uint8_t *src = data + static_cast<size_t>(y) * stride;
+                if (direct[c])
+                {
+                    rows[c][i] = const_cast<JSAMPROW>(src);
+                }
+                else
+                {
+                    PadRawRow(src, (nv12 && (c > 0)) ? 2 : 1, widths[c], scratch, paddedWidths[c]);
+                    rows[c][i] = scratch;
+                    scratch += paddedWidths[c];
+                }
+            }
+        }
+        jpeg_write_raw_data(&cinfo, planes, 2 * DCTSIZE);
+    }
+}
+
+/* 关键压缩函数 */
+Error JpegEncoderData::Compress(const std::shared_ptr<const Image> &image)
+{
+    Error ret = Error::Success;
+
+    if ((image->Format() != PixelFormat::RGB24) && (image->Format() != PixelFormat::Grayscale8) && (!ImageIsPlanar(image->Format())))
+    {
+        ret = Error::UnsupportedPixelFormat;
+    }
+    else
+    {
+        try
+        {
+            Configure(image);
 
             //开始压缩
             jpeg_start_compress(&cinfo, TRUE);
 
-            // 开始进行压缩
-            while (cinfo.next_scanline < cinfo.image_height)
+            if (ImageIsPlanar(image->Format()))
+            {
+                WriteRawData(image);
+            }
+            else
             {
-                /* 获取偏移指针 */
-                row_pointer[0] = image->Data() + image->Stride() * cinfo.next_scanline;
-                /* 写入压缩数据 */
-                jpeg_write_scanlines(&cinfo, row_pointer, 1);
+                // 一次传入所有行，libjpeg内部按照MCU行处理，省去每行一次的调用和状态检查
+                if (mRows.size() < cinfo.image_height)
+                {
+                    mRows.resize(cinfo.image_height);
+                }
+                for (JDIMENSION i = 0; i < cinfo.image_height; i++)
+                {
+                    mRows[i] = image->Data() + image->Stride() * i;
+                }
+                while (cinfo.next_scanline < cinfo.image_height)
+                {
+                    /* 写入压缩数据 */
+                    jpeg_write_scanlines(&cinfo, &mRows[cinfo.next_scanline], cinfo.image_height - cinfo.next_scanline);
+                }
             }
 
             // 完成压缩，添加尾部数据
             jpeg_finish_compress(&cinfo);
-
-            *bufferSize = (uint32_t)mem_buffer_size;
         }
         catch (const JpegException &)
         {
+            // 恢复压缩对象的状态，保证下一次可以继续使用
+            jpeg_abort_compress(&cinfo);
             ret = Error::FailedImageEncoding;
         }
     }
 
     return ret;
 }
+
+Error JpegEncoderData::EncodeToMemory(
+    const std::shared_ptr<const Image> &image, /* 源图片地址 */
+    uint8_t **buffer,                          /* 压缩后的目标地址 */
+    uint32_t *bufferSize                       /* buffer的长度 */
+)
+{
+    Error ret = Error::Success;
+    /* 检查数据 */
+    if ((!image) || (image->Data() == nullptr) || (buffer == nullptr) || (*buffer == nullptr) || (bufferSize == nullptr))
+    {
+        ret = Error::NullPointer;
+    }
+    else if (UseTurbo(image))
+    {
+        uint32_t bound = TurboBufferSize(image);
+        if (*bufferSize < bound)
+        {
+            uint8_t *resized = static_cast<uint8_t *>(realloc(*buffer, bound));
+            if (resized == nullptr)
+            {
+                return Error::OutOfMemory;
+            }
+            *buffer = resized;
+            *bufferSize = bound;
+        }
+        unsigned long size = *bufferSize;
+        ret = TurboCompress(image, *buffer, &size);
+        if (ret == Error::Success)
+        {
+            *bufferSize = static_cast<uint32_t>(size);
+        }
+    }
+    else
+    {
+        /* 输出到调用者的缓冲区，不足时realloc */
+        mMemoryBuffer = buffer;
+        mMemoryCapacity = *bufferSize;
+        cinfo.dest = &mMemoryDest;
+
+        ret = Compress(image);
+        if (ret == Error::Success)
+        {
+            *bufferSize = static_cast<uint32_t>(mMemoryCapacity - mMemoryDest.free_in_buffer);
+        }
+        mMemoryBuffer = nullptr;
+    }
+
+    return ret;
+}
+
+Error JpegEncoderData::EncodeToFrame(const std::shared_ptr<const Image> &image, ImagePool &pool, std::shared_ptr<EncodedFrame> &frame)
+{
+    Error ret = Error::Success;
+
+    if ((!image) || (image->Data() == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if ((!frame) || (frame->Codec() != FrameCodec::JPEG))
+    {
+        // 没有预估大小时按照原始数据的1/8获取
+        frame = pool.AcquireEncoded(static_cast<uint32_t>(image->Size() / 8) + ENCODED_FRAME_GRANULARITY, FrameCodec::JPEG);
+        if (!frame)
+        {
+            return Error::OutOfMemory;
+        }
+    }
+
+    if (UseTurbo(image))
+    {
+        ret = frame->Reserve(TurboBufferSize(image));
+        if (ret == Error::Success)
+        {
+            unsigned long size = frame->Capacity();
+            ret = TurboCompress(image, frame->Data(), &size);
+            frame->SetSize((ret == Error::Success) ? static_cast<uint32_t>(size) : 0);
+        }
+        frame->SetKeyFrame(ret == Error::Success);
+        return ret;
+    }
+
+    mOutput = frame.get();
+    mOutput->SetSize(0);
+    cinfo.dest = &mPoolDest;
+
+    ret = Compress(image);
+
+    mOutput = nullptr;
+    // JPEG没有帧间预测，每一帧都可以独立解码
+    frame->SetKeyFrame(ret == Error::Success);
+
+    return ret;
+}
 /**
  * jpegdecoder实现
  */
@@ -151,10 +698,81 @@ void JpegEncoder::SetFasterCompression(bool faster)
     mData->FasterCompression = faster;
 }
 
+// Set/get restart interval in MCU rows
+uint16_t JpegEncoder::RestartRows() const
+{
+    return mData->RestartRows;
+}
+void JpegEncoder::SetRestartRows(uint16_t rows)
+{
+    mData->RestartRows = rows;
+}
+
+// Get/Set rate control parameters
+JpegRateControl JpegEncoder::RateControl() const
+{
+    return mData->RateControl;
+}
+void JpegEncoder::SetRateControl(const JpegRateControl &control)
+{
+    JpegRateControl &rate = mData->RateControl;
+    rate = control;
+    rate.MaxQuality = (rate.MaxQuality > 100) ? 100 : ((rate.MaxQuality < 1) ? 1 : rate.MaxQuality);
+    rate.MinQuality = (rate.MinQuality < 1) ? 1 : ((rate.MinQuality > rate.MaxQuality) ? rate.MaxQuality : rate.MinQuality);
+    rate.MaxStep = (rate.MaxStep < 1) ? 1 : rate.MaxStep;
+}
+
+// Get/Set encoding backend
+JpegBackend JpegEncoder::Backend() const
+{
+    return mData->Backend;
+}
+Error JpegEncoder::SetBackend(JpegBackend backend)
+{
+    if (!IsBackendAvailable(backend))
+    {
+        return Error::ConfigurationNotSupported;
+    }
+    mData->Backend = backend;
+    return Error::Success;
+}
+bool JpegEncoder::IsBackendAvailable(JpegBackend backend)
+{
+#ifdef HAVE_TURBOJPEG
+    return true;
+#else
+    return backend == JpegBackend::LibJpeg;
+#endif
+}
+
 // Compress the specified image into provided buffer
 Error JpegEncoder::EncodeToMemory(const std::shared_ptr<const Image> &image, uint8_t **buffer, uint32_t *bufferSize)
 {
-    return mData->EncodeToMemory(image, buffer, bufferSize);
+    if (image)
+    {
+        mData->SelectQuality(image);
+    }
+    Error ret = mData->EncodeToMemory(image, buffer, bufferSize);
+    if (ret == Error::Success)
+    {
+        mData->UpdateRateModel(image, *bufferSize);
+    }
+    return ret;
+}
+
+// Compress the specified image into a pooled encoded frame
+Error JpegEncoder::EncodeToFrame(const std::shared_ptr<const Image> &image, ImagePool &pool, std::shared_ptr<EncodedFrame> &frame)
+{
+    if (image)
+    {
+        mData->SelectQuality(image);
+    }
+    Error ret = mData->EncodeToFrame(image, pool, frame);
+    if (ret == Error::Success)
+    {
+        mData->UpdateRateModel(image, frame->Size());
+    }
+    return ret;
 }
 
 NAMESPACE_END
\ No newline at end of file
@@ -27,13 +27,53 @@
 #define JPEG_ENCODER_H
 #include <stdio.h>
 #include <jpeglib.h>
+#include <vector>
 #include "uncopyable.h"
 #include "image.h"
+#include "image_pool.h"
 #include "base_error.h"
 #include "img_tools.h"
 
 NAMESPACE_START
 
+/**
+ * @brief libjpeg单张图片内存的分块大小
+ */
+#define JPEG_ARENA_CHUNK_SIZE (256 * 1024)
+/**
+ * @brief 缓存量化表的质量参数个数，质量范围为 [1, 100]
+ */
+#define JPEG_QUALITY_LEVELS (101)
+
+/**
+ * @brief 码率控制的帧大小模型中，帧大小与量化表缩放比例的幂指数
+ */
+#define JPEG_RATE_SIZE_EXPONENT (0.75)
+
+/**
+ * @brief 按照每帧字节数调整压缩质量的参数
+ */
+struct JpegRateControl
+{
+    JpegRateControl() : TargetBytes(0), MinQuality(20), MaxQuality(95), MaxStep(5)
+    {
+    }
+
+    uint32_t TargetBytes; ///< 每帧的目标字节数，0 表示关闭，使用固定质量
+    uint16_t MinQuality;  ///< 最低质量
+    uint16_t MaxQuality;  ///< 最高质量
+    uint16_t MaxStep;     ///< 相邻两帧的质量最多改变的值
+};
+
+/**
+ * @brief 编码使用的后端
+ */
+enum class JpegBackend
+{
+    LibJpeg,   ///< libjpeg接口，复用压缩对象和编码参数，支持重启标记
+    TurboJpeg, ///< libjpeg-turbo的TurboJPEG接口(tjCompress2)，需要编译时找到turbojpeg库
+};
+
 /**
  * @brief 定义对libjpeg函数的统一封装类
  * @details 主要用于原始数据转向jpeg
@@ -59,13 +99,109 @@ public:
      * @return Error            错误信息
      */
     Error EncodeToMemory(const std::shared_ptr<const Image> &image, uint8_t **buffer, uint32_t *bufferSize);
+    /**
+     * @brief  将数据压缩至压缩帧
+     * @param  image            图像数据指针
+     * @param  pool             图像池，没有预先获取压缩帧时从中获取
+     * @param  frame            输入为预先获取的压缩帧，容量不足时原地扩大；输出为压缩之后的JPEG帧
+     * @return Error            错误信息
+     */
+    Error EncodeToFrame(const std::shared_ptr<const Image> &image, ImagePool &pool, std::shared_ptr<EncodedFrame> &frame);
+    /**
+     * @brief  开启码率控制时，按照帧大小模型选择这一帧的压缩质量
+     * @param  image            将要编码的图像
+     */
+    void SelectQuality(const std::shared_ptr<const Image> &image);
+    /**
+     * @brief  用编码之后的大小更新帧大小模型
+     * @param  image            编码的图像
+     * @param  size             编码之后的字节数
+     */
+    void UpdateRateModel(const std::shared_ptr<const Image> &image, uint32_t size);
+
+private:
+    /**
+     * @brief  使用当前设置的输出目标进行压缩
+     * @param  image            图像数据指针
+     * @return Error            错误信息
+     */
+    Error Compress(const std::shared_ptr<const Image> &image);
+    /**
+     * @brief  图像尺寸或格式改变时重新设置编码参数，质量改变时更新量化表
+     * @param  image            图像数据指针
+     */
+    void Configure(const std::shared_ptr<const Image> &image);
+    /**
+     * @brief  按照iMCU行写入NV12/I420的原始分量数据，不经过颜色转换和下采样
+     * @param  image            图像数据指针
+     */
+    void WriteRawData(const std::shared_ptr<const Image> &image);
+    /**
+     * @brief  使用TurboJPEG压缩到预先分配的缓冲区
+     * @param  image            图像数据指针
+     * @param  buffer           缓冲区，容量不小于 tjBufSize
+     * @param  size             输入为缓冲区容量，输出为压缩之后的大小
+     * @return Error            错误信息
+     */
+    Error TurboCompress(const std::shared_ptr<const Image> &image, uint8_t *buffer, unsigned long *size);
+    /**
+     * @brief  当前设置是否使用TurboJPEG压缩
+     */
+    bool UseTurbo(const std::shared_ptr<const Image> &image) const;
+    /**
+     * @brief  TurboJPEG压缩需要的最大缓冲区大小
+     */
+    uint32_t TurboBufferSize(const std::shared_ptr<const Image> &image) const;
+    /**
+     * @brief 从单张图片内存中分配，每张图片压缩完成后整体回收
+     */
+    void *ArenaAllocate(size_t size);
+
+    /* libjpeg内存管理回调，JPOOL_IMAGE的内存使用循环利用的分块 */
+    static void *ArenaAllocSmall(j_common_ptr cinfo, int pool_id, size_t sizeofobject);
+    static void *ArenaAllocLarge(j_common_ptr cinfo, int pool_id, size_t sizeofobject);
+    static JSAMPARRAY ArenaAllocSarray(j_common_ptr cinfo, int pool_id, JDIMENSION samplesperrow, JDIMENSION numrows);
+    static JBLOCKARRAY ArenaAllocBarray(j_common_ptr cinfo, int pool_id, JDIMENSION blocksperrow, JDIMENSION numrows);
+    static void ArenaFreePool(j_common_ptr cinfo, int pool_id);
+    /* 输出到压缩帧的回调 */
+    static void PoolInitDestination(j_compress_ptr cinfo);
+    static boolean PoolEmptyOutputBuffer(j_compress_ptr cinfo);
+    static void PoolTermDestination(j_compress_ptr cinfo);
+    /* 输出到调用者内存的回调，容量不足时realloc */
+    static void MemoryInitDestination(j_compress_ptr cinfo);
+    static boolean MemoryEmptyOutputBuffer(j_compress_ptr cinfo);
+    static void MemoryTermDestination(j_compress_ptr cinfo);
 
 public:
     uint16_t Quality;       /** 图片质量参数 */
     bool FasterCompression; /** 是否使用快速压缩 */
+    uint16_t RestartRows;   /** 每隔多少MCU行插入重启标记，0 表示不插入 */
+    JpegBackend Backend;    /** 编码后端 */
+    JpegRateControl RateControl; /** 码率控制参数 */
 private:
     struct jpeg_compress_struct cinfo; /** jpeg压缩信息结构体 */
     struct jpeg_error_mgr jerr;        /** 错误信息 */
+    struct jpeg_memory_mgr mMemoryMethods;   /** libjpeg原始的内存管理函数 */
+    std::vector<uint8_t *> mArenaChunks;     /** 单张图片内存分块 */
+    std::vector<size_t> mArenaChunkSizes;    /** 分块大小 */
+    size_t mArenaChunk;                      /** 当前使用的分块 */
+    size_t mArenaOffset;                     /** 当前分块中已经使用的大小 */
+    struct jpeg_destination_mgr mPoolDest;   /** 输出到压缩帧的目标 */
+    EncodedFrame *mOutput;                   /** 当前输出的压缩帧 */
+    struct jpeg_destination_mgr mMemoryDest; /** 输出到调用者内存的目标 */
+    uint8_t **mMemoryBuffer;                 /** 当前输出的调用者内存 */
+    uint32_t mMemoryCapacity;                /** 调用者内存的容量 */
+    bool mConfigured;                        /** 是否已经设置编码参数 */
+    int32_t mConfiguredWidth;                /** 编码参数对应的图像宽度 */
+    int32_t mConfiguredHeight;               /** 编码参数对应的图像高度 */
+    PixelFormat mConfiguredFormat;           /** 编码参数对应的图像格式 */
+    uint16_t mTableQuality;                  /** 当前量化表对应的质量，0 表示需要更新 */
+    std::vector<UINT16> mQuantCache;         /** 每个质量的亮度和色度量化表 */
+    std::vector<bool> mQuantCached;          /** 质量对应的量化表是否已经缓存 */
+    std::vector<JSAMPROW> mRows;             /** 整张图片的行指针，一次写入多行 */
+    std::vector<uint8_t> mRawScratch;        /** 平面格式补齐到整块宽度或拆分UV交错的行 */
+    void *mTurboHandle;                      /** TurboJPEG压缩句柄，第一次使用时创建 */
+    double mComplexity;                      /** 画面复杂度：每像素在质量50时的估计字节数，0 表示还没有编码 */
 };
 /**
  *
@@ -73,6 +209,8 @@ private:
 
 /**
  * @brief 定义jpegencoder对外接口
+ * @details 支持RGB24、Grayscale8以及NV12/I420；4:2:0格式按照原始分量写入，
+ *          不需要先转换为RGB再由libjpeg转换回YCbCr和下采样
  */
 class JpegEncoder : private Uncopyable
 {
@@ -107,6 +245,59 @@ public:
      * @param  faster           开启快速压缩
      */
     void SetFasterCompression(bool faster);
+    /**
+     * @brief  每隔多少MCU行插入重启标记
+     * @return uint16_t 行数，0 表示不插入
+     */
+    uint16_t RestartRows() const;
+    /**
+     * @brief Set the restart interval in MCU rows
+     * @details
+     *  Restart markers split the entropy-coded data into independently decodable
+     *  segments, so JpegOverlay can re-encode only the MCU rows covered by an overlay.
+     *  Each marker adds a few bytes per interval.
+     * @param  rows             MCU行数，0 表示不插入
+     */
+    void SetRestartRows(uint16_t rows);
+    /**
+     * @brief  码率控制参数
+     * @return JpegRateControl 当前参数，TargetBytes 为0表示关闭
+     */
+    JpegRateControl RateControl() const;
+    /**
+     * @brief Set the rate control parameters
+     * @details
+     *  When TargetBytes is not 0, quality is chosen before each frame from a running
+     *  model: frame size = complexity * pixels * (100 / libjpeg quality scale)^0.75.
+     *  Complexity is re-estimated from every encoded frame, the highest quality whose
+     *  predicted size fits the target is used, and quality moves at most MaxStep per
+     *  frame inside [MinQuality, MaxQuality]. Quality() returns the quality of the last frame.
+     * @param  control          码率控制参数
+     */
+    void SetRateControl(const JpegRateControl &control);
+    /**
+     * @brief  编码后端
+     * @return JpegBackend 当前后端
+     */
+    JpegBackend Backend() const;
+    /**
+     * @brief Set the encoding backend
+     * @details
+     *  TurboJpeg compresses with tjCompress2 into a buffer preallocated with tjBufSize.
+     *  It cannot insert restart markers, so frames are still encoded with libjpeg
+     *  while RestartRows is not 0. I420 images use tjCompressFromYUVPlanes; NV12
+     *  has no TurboJPEG input and is always encoded with libjpeg.
+     * @param  backend          编码后端
+     * @return Error            编译时没有找到turbojpeg库时返回 ConfigurationNotSupported
+     */
+    Error SetBackend(JpegBackend backend);
+    /**
+     * @brief  编码后端是否可用
+     * @param  backend          编码后端
+     * @return true  可用
+     * @return false 编译时没有找到对应的库
+     */
+    static bool IsBackendAvailable(JpegBackend backend);
     /**
      * @brief Compress the specified image into provided buffer
      * @details
@@ -119,6 +310,21 @@ public:
      * @return Error            错误信息
      */
     Error EncodeToMemory(const std::shared_ptr<const Image> &image, uint8_t **buffer, uint32_t *bufferSize);
+    /**
+     * @brief Compress the specified image into a pooled encoded frame
+     * @details
+     *  On input, frame may hold a frame acquired with ImagePool::AcquireEncoded (if empty,
+     *  a frame is acquired from the pool). If the frame is too small, it grows in place
+     *  and keeps the larger capacity when it goes back to the pool, so no heap allocation
+     *  happens once the pool is warmed up.
+     *  On output, frame size is set to the size of encoded JPEG image and the frame is
+     *  marked as a key frame.
+     * @param  image            图像数据指针
+     * @param  pool             图像池
+     * @param  frame            压缩帧
+     * @return Error            错误信息
+     */
+    Error EncodeToFrame(const std::shared_ptr<const Image> &image, ImagePool &pool, std::shared_ptr<EncodedFrame> &frame);
 
 private:
     JpegEncoderData *mData; ///< jpeg 数据封装类
@@ -0,0 +1,745 @@
+#include <string.h>
+#include <stdio.h>
+#include <jpeglib.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "jpeg_overlay.h"
+#include "jpeg_encoder.h"
+#include "jpeg_decoder.h"
+#include "overlay_tile.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 局部编码使用的libjpeg错误
+ */
+class JpegOverlayException : public std::exception
+{
+public:
+    virtual const char *what() const throw()
+    {
+        return "JPEG overlay failure";
+    }
+};
+static void OverlayErrorExit(j_common_ptr /* cinfo */)
+{
+    throw JpegOverlayException();
+}
+
+static void OverlayOutputMessage(j_common_ptr /* cinfo */)
+{
+    // 损坏数据的警告不输出
+}
+
+/* DQT中的量化值按照之字形顺序保存，libjpeg的量化表按照自然顺序保存 */
+static const int ZigzagToNatural[DCTSIZE2] = {
+    0, 1, 8, 16, 9, 2, 3, 10,
+    17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63};
+
+/**
+ * @brief JPEG文件结构，只记录局部重新编码需要的信息
+ */
+struct JpegLayout
+{
+    uint32_t Width;                                   ///< 图像宽度
+    uint32_t Height;                                  ///< 图像高度
+    size_t HeightOffset;                              ///< SOF中高度字段的偏移
+    uint16_t RestartInterval;                         ///< 重启间隔(MCU数)，0 表示没有
+    int Components;                                   ///< 分量个数，1或者3
+    int ComponentId[3];                               ///< 分量编号
+    int HSampling[3];                                 ///< 水平采样因子
+    int VSampling[3];                                 ///< 垂直采样因子
+    int QuantTable[3];                                ///< 分量使用的量化表
+    int DcTable[3];                                   ///< 分量使用的DC Huffman表
+    int AcTable[3];                                   ///< 分量使用的AC Huffman表
+    bool QuantPresent[NUM_QUANT_TBLS];                ///< 量化表是否存在
+    UINT16 Quant[NUM_QUANT_TBLS][DCTSIZE2];           ///< 量化表，自然顺序
+    bool HuffPresent[2][NUM_HUFF_TBLS];               ///< Huffman表是否存在，[0]为DC，[1]为AC
+    UINT8 HuffBits[2][NUM_HUFF_TBLS][17];             ///< 每种长度的编码个数
+    UINT8 HuffValues[2][NUM_HUFF_TBLS][256];          ///< 编码对应的符号
+    bool AnyHuff;                                     ///< 是否有DHT，MJPEG摄像头通常省略而使用标准表
+    size_t ScanStart;                                 ///< 熵编码数据的开始
+    std::vector<std::pair<size_t, size_t> > Segments; ///< 被重启标记分开的段 [开始, 结束)
+};
+
+/**
+ * @brief 需要重新编码的段和对应的像素行
+ */
+struct JpegBand
+{
+    size_t FirstSegment; ///< 第一个段
+    size_t LastSegment;  ///< 最后一个段之后
+    int32_t Top;         ///< 第一行像素
+    int32_t Height;      ///< 像素行数
+};
+
+static inline uint32_t ReadWord(const uint8_t *data)
+{
+    return (static_cast<uint32_t>(data[0]) << 8) | data[1];
+}
+
+/* 解析单个扫描的基线JPEG，其它情况(渐进式、多个扫描、12位精度等)返回false */
+static bool ParseJpeg(const uint8_t *data, size_t size, JpegLayout &layout)
+{
+    layout.Components = 0;
+    layout.RestartInterval = 0;
+    layout.AnyHuff = false;
+    layout.Segments.clear();
+    memset(layout.QuantPresent, 0, sizeof(layout.QuantPresent));
+    memset(layout.HuffPresent, 0, sizeof(layout.HuffPresent));
+
+    if ((size < 4) || (data[0] != 0xFF) || (data[1] != 0xD8))
+    {
+        return false;
+    }
+
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+        {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF)
+        {
+            // 填充字节
+            pos++;
+            continue;
+        }
+        if ((marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7)))
+        {
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xD9)
+        {
+            return false;
+        }
+
+        size_t length = ReadWord(data + pos + 2);
+        size_t end = pos + 2 + length;
+        const uint8_t *payload = data + pos + 4;
+        if ((length < 2) || (end > size))
+        {
+            return false;
+        }
+        size_t payloadSize = length - 2;
+
+        if ((marker == 0xC0) || (marker == 0xC1))
+        {
+            if ((payloadSize < 6) || (payload[0] != 8))
+            {
+                return false;
+            }
+            layout.HeightOffset = pos + 5;
+            layout.Height = ReadWord(payload + 1);
+            layout.Width = ReadWord(payload + 3);
+            layout.Components = payload[5];
+            if ((layout.Height == 0) || (layout.Width == 0) || ((layout.Components != 1) && (layout.Components != 3)) ||
+                (payloadSize < 6 + 3 * static_cast<size_t>(layout.Components)))
+            {
+                return false;
+            }
+            for (int i = 0; i < layout.Components; i++)
+            {
+                layout.ComponentId[i] = payload[6 + i * 3];
+                layout.HSampling[i] = payload[7 + i * 3] >> 4;
+                layout.VSampling[i] = payload[7 + i * 3] & 0x0F;
+                layout.QuantTable[i] = payload[8 + i * 3];
+                if ((layout.HSampling[i] < 1) || (layout.HSampling[i] > 4) || (layout.VSampling[i] < 1) ||
+                    (layout.VSampling[i] > 4) || (layout.QuantTable[i] >= NUM_QUANT_TBLS))
+                {
+                    return false;
+                }
+            }
+        }
+        else if ((marker >= 0xC2) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC))
+        {
+            // 渐进式、无损和算术编码
+            return false;
+        }
+        else if (marker == 0xC4)
+        {
+            for (size_t p = 0; p < payloadSize;)
+            {
+                if (p + 17 > payloadSize)
+                {
+                    return false;
+                }
+                int tableClass = payload[p] >> 4;
+                int table = payload[p] & 0x0F;
+                size_t count = 0;
+                if ((tableClass > 1) || (table >= NUM_HUFF_TBLS))
+                {
+                    return false;
+                }
+                layout.HuffBits[tableClass][table][0] = 0;
+                for (int i = 1; i <= 16; i++)
+                {
+                    layout.HuffBits[tableClass][table][i] = payload[p + i];
+                    count += payload[p + i];
+                }
+                if ((count > 256) || (p + 17 + count > payloadSize))
+                {
+                    return false;
+                }
+                memcpy(layout.HuffValues[tableClass][table], payload + p + 17, count);
+                layout.HuffPresent[tableClass][table] = true;
+                layout.AnyHuff = true;
+                p += 17 + count;
+            }
+        }
+        else if (marker == 0xDB)
+        {
+            for (size_t p = 0; p < payloadSize; p += 1 + DCTSIZE2)
+            {
+                int table = payload[p] & 0x0F;
+                // 只支持8位量化值
+                if ((p + 1 + DCTSIZE2 > payloadSize) || ((payload[p] >> 4) != 0) || (table >= NUM_QUANT_TBLS))
+                {
+                    return false;
+                }
+                for (int i = 0; i < DCTSIZE2; i++)
+                {
+                    layout.Quant[table][ZigzagToNatural[i]] = payload[p + 1 + i];
+                }
+                layout.QuantPresent[table] = true;
+            }
+        }
+        else if (marker == 0xDD)
+        {
+            if (payloadSize < 2)
+            {
+                return false;
+            }
+            layout.RestartInterval = static_cast<uint16_t>(ReadWord(payload));
+        }
+        else if (marker == 0xDA)
+        {
+            // 单个扫描包含所有分量，顺序与SOF相同
+            if ((layout.Components == 0) || (payloadSize < 1 + 2 * static_cast<size_t>(layout.Components) + 3) ||
+                (payload[0] != layout.Components))
+            {
+                return false;
+            }
+            for (int i = 0; i < layout.Components; i++)
+            {
+                if (payload[1 + i * 2] != layout.ComponentId[i])
+                {
+                    return false;
+                }
+                layout.DcTable[i] = payload[2 + i * 2] >> 4;
+                layout.AcTable[i] = payload[2 + i * 2] & 0x0F;
+                if ((layout.DcTable[i] >= NUM_HUFF_TBLS) || (layout.AcTable[i] >= NUM_HUFF_TBLS))
+                {
+                    return false;
+                }
+            }
+            const uint8_t *spectral = payload + 1 + 2 * layout.Components;
+            if ((spectral[0] != 0) || (spectral[1] != 63) || (spectral[2] != 0))
+            {
+                return false;
+            }
+
+            // 按照重启标记分段，0xFF00 是填充，其它标记表示扫描结束
+            layout.ScanStart = end;
+            size_t segmentStart = end;
+            for (size_t i = end; i + 1 < size;)
+            {
+                if (data[i] != 0xFF)
+                {
+                    i++;
+                    continue;
+                }
+                uint8_t next = data[i + 1];
+                if ((next == 0x00) || (next == 0xFF))
+                {
+                    i += (next == 0x00) ? 2 : 1;
+                }
+                else if ((next >= 0xD0) && (next <= 0xD7))
+                {
+                    layout.Segments.push_back(std::make_pair(segmentStart, i));
+                    i += 2;
+                    segmentStart = i;
+                }
+                else
+                {
+                    layout.Segments.push_back(std::make_pair(segmentStart, i));
+                    return (next == 0xD9);
+                }
+            }
+            return false;
+        }
+
+        pos = end;
+    }
+
+    return false;
+}
+
+/* 原始的表是否足够重新编码 */
+static bool CanReencode(const JpegLayout &layout)
+{
+    for (int i = 0; i < layout.Components; i++)
+    {
+        if (!layout.QuantPresent[layout.QuantTable[i]])
+        {
+            return false;
+        }
+        if (layout.AnyHuff)
+        {
+            if ((!layout.HuffPresent[0][layout.DcTable[i]]) || (!layout.HuffPresent[1][layout.AcTable[i]]))
+            {
+                return false;
+            }
+        }
+        else if ((layout.DcTable[i] > 1) || (layout.AcTable[i] > 1))
+        {
+            // 省略DHT时只有0号和1号标准表
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 计算覆盖 [top, bottom) 像素行的段，重启间隔需要是MCU行的整数倍或者整除MCU行 */
+static bool PlanBand(const JpegLayout &layout, int32_t top, int32_t bottom, JpegBand &band)
+{
+    uint32_t interval = layout.RestartInterval;
+    uint32_t mcuWidth = 8;
+    uint32_t mcuHeight = 8;
+
+    if (interval == 0)
+    {
+        return false;
+    }
+    if (layout.Components > 1)
+    {
+        // 多个分量交错时MCU的大小由最大的采样因子决定，单个分量时MCU为一个8x8块
+        for (int i = 0; i < layout.Components; i++)
+        {
+            mcuWidth = std::max(mcuWidth, static_cast<uint32_t>(layout.HSampling[i]) * 8);
+            mcuHeight = std::max(mcuHeight, static_cast<uint32_t>(layout.VSampling[i]) * 8);
+        }
+    }
+
+    uint32_t mcusPerRow = (layout.Width + mcuWidth - 1) / mcuWidth;
+    uint32_t mcuRows = (layout.Height + mcuHeight - 1) / mcuHeight;
+    if (layout.Segments.size() != (static_cast<size_t>(mcusPerRow) * mcuRows + interval - 1) / interval)
+    {
+        return false;
+    }
+
+    top = std::max(top, 0);
+    bottom = std::min(bottom, static_cast<int32_t>(layout.Height));
+    if (top >= bottom)
+    {
+        return false;
+    }
+    uint32_t firstRow = static_cast<uint32_t>(top) / mcuHeight;
+    uint32_t lastRow = (static_cast<uint32_t>(bottom) - 1) / mcuHeight + 1;
+
+    if (interval % mcusPerRow == 0)
+    {
+        uint32_t rowsPerSegment = interval / mcusPerRow;
+        band.FirstSegment = firstRow / rowsPerSegment;
+        band.LastSegment = (lastRow + rowsPerSegment - 1) / rowsPerSegment;
+        firstRow = static_cast<uint32_t>(band.FirstSegment) * rowsPerSegment;
+        lastRow = std::min(static_cast<uint32_t>(band.LastSegment) * rowsPerSegment, mcuRows);
+    }
+    else if (mcusPerRow % interval == 0)
+    {
+        uint32_t segmentsPerRow = mcusPerRow / interval;
+        band.FirstSegment = static_cast<size_t>(firstRow) * segmentsPerRow;
+        band.LastSegment = static_cast<size_t>(lastRow) * segmentsPerRow;
+    }
+    else
+    {
+        return false;
+    }
+
+    band.Top = static_cast<int32_t>(firstRow * mcuHeight);
+    band.Height = std::min(static_cast<int32_t>(lastRow * mcuHeight), static_cast<int32_t>(layout.Height)) - band.Top;
+    return true;
+}
+
+/**
+ * @brief JpegOverlay 的libjpeg状态和缓冲区
+ */
+class JpegOverlayData
+{
+public:
+    /**
+     * @brief Construct a new Jpeg Overlay Data object
+     * @param  quality          退回完整编码时的压缩质量
+     */
+    explicit JpegOverlayData(uint16_t quality);
+    ~JpegOverlayData();
+    /**
+     * @brief  叠加文字，参数与 JpegOverlay::Apply 相同
+     */
+    Error Apply(const std::shared_ptr<const EncodedFrame> &frame, const std::string &text, Argb color, Argb background,
+                int32_t x, int32_t y, ImagePool &pool, std::shared_ptr<EncodedFrame> &output);
+
+private:
+    /**
+     * @brief  只重新编码覆盖文字的段，失败时由调用者退回完整编码
+     */
+    Error ApplyPartial(const EncodedFrame &frame, const JpegBand &band, int32_t x, int32_t y, ImagePool &pool,
+                       std::shared_ptr<EncodedFrame> &output);
+    /**
+     * @brief  完整解码、混合和编码
+     */
+    Error ApplyFull(const EncodedFrame &frame, PixelFormat format, int32_t x, int32_t y, ImagePool &pool,
+                    std::shared_ptr<EncodedFrame> &output);
+    /**
+     * @brief  解码到图像，尺寸或者格式不同时从池中重新获取
+     */
+    Error Decode(const uint8_t *data, size_t size, PixelFormat format, ImagePool &pool, std::shared_ptr<Image> &image);
+    /**
+     * @brief  使用原始的表和采样因子编码到 mEncoded
+     */
+    Error EncodeBand(const std::shared_ptr<Image> &image);
+
+    /* 输出到 mEncoded 的回调 */
+    static void VectorInitDestination(j_compress_ptr cinfo);
+    static boolean VectorEmptyOutputBuffer(j_compress_ptr cinfo);
+    static void VectorTermDestination(j_compress_ptr cinfo);
+
+public:
+    uint64_t PartialFrames; ///< 局部编码的帧数
+    uint64_t FullFrames;    ///< 完整编码的帧数
+
+private:
+    struct jpeg_compress_struct cinfo;   ///< 编码状态
+    struct jpeg_error_mgr jerr;          ///< 错误处理
+    struct jpeg_destination_mgr mDest;   ///< 输出到 mEncoded 的目标
+    JpegEncoder mEncoder;                ///< 完整编码
+    JpegDecoder mDecoder;                ///< 覆盖段和完整帧的解码
+    OverlayTile mTile;                   ///< 文字图块
+    JpegLayout mLayout;                  ///< 输入帧的结构
+    JpegLayout mBandLayout;              ///< 重新编码之后的结构
+    std::vector<uint8_t> mBand;          ///< 只包含覆盖段的JPEG，用于解码
+    std::vector<uint8_t> mEncoded;       ///< 重新编码的JPEG
+    std::shared_ptr<Image> mBandImage;   ///< 覆盖段的像素
+    std::shared_ptr<Image> mFullImage;   ///< 完整解码的像素
+};
+
+JpegOverlayData::JpegOverlayData(uint16_t quality) : PartialFrames(0),
+                                                      FullFrames(0),
+                                                      mEncoder(quality),
+                                                      mDecoder(),
+                                                      mTile(),
+                                                      mBand(),
+                                                      mEncoded(),
+                                                      mBandImage(),
+                                                      mFullImage()
+{
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = OverlayErrorExit;
+    jerr.output_message = OverlayOutputMessage;
+    jpeg_create_compress(&cinfo);
+    cinfo.client_data = this;
+
+    mDest.init_destination = VectorInitDestination;
+    mDest.empty_output_buffer = VectorEmptyOutputBuffer;
+    mDest.term_destination = VectorTermDestination;
+    mDest.next_output_byte = nullptr;
+    mDest.free_in_buffer = 0;
+    cinfo.dest = &mDest;
+}
+
+JpegOverlayData::~JpegOverlayData()
+{
+    jpeg_destroy_compress(&cinfo);
+}
+
+void JpegOverlayData::VectorInitDestination(j_compress_ptr cinfo)
+{
+    JpegOverlayData *data = static_cast<JpegOverlayData *>(cinfo->client_data);
+    data->mEncoded.resize(std::max(data->mEncoded.capacity(), static_cast<size_t>(ENCODED_FRAME_GRANULARITY)));
+    cinfo->dest->next_output_byte = &data->mEncoded[0];
+    cinfo->dest->free_in_buffer = data->mEncoded.size();
+}
+
+boolean JpegOverlayData::VectorEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+    JpegOverlayData *data = static_cast<JpegOverlayData *>(cinfo->client_data);
+    size_t used = data->mEncoded.size();
+
+    data->mEncoded.resize(used * 2);
+    cinfo->dest->next_output_byte = &data->mEncoded[used];
+    cinfo->dest->free_in_buffer = used;
+    return TRUE;
+}
+
+void JpegOverlayData::VectorTermDestination(j_compress_ptr cinfo)
+{
+    JpegOverlayData *data = static_cast<JpegOverlayData *>(cinfo->client_data);
+    data->mEncoded.resize(data->mEncoded.size() - cinfo->dest->free_in_buffer);
+}
+
+Error JpegOverlayData::Decode(const uint8_t *data, size_t size, PixelFormat format, ImagePool &pool, std::shared_ptr<Image> &image)
+{
+    if (size > UINT32_MAX)
+    {
+        return Error::FailedImageDecoding;
+    }
+    mDecoder.SetOutputFormat(format);
+    return mDecoder.DecodeFromMemory(data, static_cast<uint32_t>(size), pool, image);
+}
+
+Error JpegOverlayData::EncodeBand(const std::shared_ptr<Image> &image)
+{
+    const JpegLayout &layout = mLayout;
+
+    try
+    {
+        cinfo.image_width = image->Width();
+        cinfo.image_height = image->Height();
+        cinfo.input_components = layout.Components;
+        cinfo.in_color_space = (layout.Components == 1) ? JCS_GRAYSCALE : JCS_RGB;
+        jpeg_set_defaults(&cinfo);
+
+        // 编码结果需要与原始的段使用相同的表，才能拼接到原始的文件头之后
+        for (int i = 0; i < layout.Components; i++)
+        {
+            jpeg_component_info *component = &cinfo.comp_info[i];
+            component->component_id = layout.ComponentId[i];
+            component->h_samp_factor = (layout.Components == 1) ? 1 : layout.HSampling[i];
+            component->v_samp_factor = (layout.Components == 1) ? 1 : layout.VSampling[i];
+            component->quant_tbl_no = layout.QuantTable[i];
+            component->dc_tbl_no = layout.DcTable[i];
+            component->ac_tbl_no = layout.AcTable[i];
+        }
+        for (int table = 0; table < NUM_QUANT_TBLS; table++)
+        {
+            if (!layout.QuantPresent[table])
+            {
+                continue;
+            }
+            if (cinfo.quant_tbl_ptrs[table] == nullptr)
+            {
+                cinfo.quant_tbl_ptrs[table] = jpeg_alloc_quant_table(reinterpret_cast<j_common_ptr>(&cinfo));
+            }
+            memcpy(cinfo.quant_tbl_ptrs[table]->quantval, layout.Quant[table], sizeof(layout.Quant[table]));
+        }
+        for (int tableClass = 0; (layout.AnyHuff) && (tableClass < 2); tableClass++)
+        {
+            for (int table = 0; table < NUM_HUFF_TBLS; table++)
+            {
+                JHUFF_TBL **slot = (tableClass == 0) ? &cinfo.dc_huff_tbl_ptrs[table] : &cinfo.ac_huff_tbl_ptrs[table];
+                if (!layout.HuffPresent[tableClass][table])
+                {
+                    continue;
+                }
+                if (*slot == nullptr)
+                {
+                    *slot = jpeg_alloc_huff_table(reinterpret_cast<j_common_ptr>(&cinfo));
+                }
+                memcpy((*slot)->bits, layout.HuffBits[tableClass][table], sizeof((*slot)->bits));
+                memcpy((*slot)->huffval, layout.HuffValues[tableClass][table], sizeof((*slot)->huffval));
+            }
+        }
+        cinfo.restart_interval = layout.RestartInterval;
+        cinfo.restart_in_rows = 0;
+        cinfo.optimize_coding = FALSE;
+
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height)
+        {
+            JSAMPROW row = image->Data() + image->Stride() * cinfo.next_scanline;
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+    }
+    catch (const JpegOverlayException &)
+    {
+        // 原始的Huffman表可能只包含原图出现过的符号
+        jpeg_abort_compress(&cinfo);
+        return Error::FailedImageEncoding;
+    }
+    return Error::Success;
+}
+
+Error JpegOverlayData::ApplyPartial(const EncodedFrame &frame, const JpegBand &band, int32_t x, int32_t y, ImagePool &pool,
+                                    std::shared_ptr<EncodedFrame> &output)
+{
+    const JpegLayout &layout = mLayout;
+    const uint8_t *data = frame.Data();
+    Error ret;
+
+    // 原始文件头(修改高度) + 覆盖的段(重新编号重启标记) + EOI
+    mBand.assign(data, data + layout.ScanStart);
+    mBand[layout.HeightOffset] = static_cast<uint8_t>(band.Height >> 8);
+    mBand[layout.HeightOffset + 1] = static_cast<uint8_t>(band.Height & 0xFF);
+    for (size_t k = band.FirstSegment; k < band.LastSegment; k++)
+    {
+        mBand.insert(mBand.end(), data + layout.Segments[k].first, data + layout.Segments[k].second);
+        if (k + 1 < band.LastSegment)
+        {
+            mBand.push_back(0xFF);
+            mBand.push_back(static_cast<uint8_t>(0xD0 + ((k - band.FirstSegment) & 7)));
+        }
+    }
+    mBand.push_back(0xFF);
+    mBand.push_back(0xD9);
+
+    PixelFormat format = (layout.Components == 1) ? PixelFormat::Grayscale8 : PixelFormat::RGB24;
+    if (((ret = Decode(&mBand[0], mBand.size(), format, pool, mBandImage)) != Error::Success) ||
+        ((ret = mTile.Blend(mBandImage, x, y - band.Top)) != Error::Success) ||
+        ((ret = EncodeBand(mBandImage)) != Error::Success))
+    {
+        return ret;
+    }
+    if ((!ParseJpeg(&mEncoded[0], mEncoded.size(), mBandLayout)) ||
+        (mBandLayout.Segments.size() != band.LastSegment - band.FirstSegment))
+    {
+        return Error::FailedImageEncoding;
+    }
+
+    // 覆盖段之前和之后的数据(包括重启标记和EOI)原样拷贝
+    size_t total = layout.Segments.size();
+    size_t prefix = layout.Segments[band.FirstSegment].first;
+    size_t suffix = (band.LastSegment < total) ? layout.Segments[band.LastSegment].first : layout.Segments[total - 1].second;
+    size_t capacity = prefix + (frame.Size() - suffix);
+    for (size_t k = 0; k < mBandLayout.Segments.size(); k++)
+    {
+        capacity += mBandLayout.Segments[k].second - mBandLayout.Segments[k].first + 2;
+    }
+    if (capacity > UINT32_MAX)
+    {
+        return Error::OutOfMemory;
+    }
+
+    output = pool.AcquireEncoded(static_cast<uint32_t>(capacity), FrameCodec::JPEG);
+    if (!output)
+    {
+        return Error::OutOfMemory;
+    }
+    uint8_t *dst = output->Data();
+    memcpy(dst, data, prefix);
+    dst += prefix;
+    for (size_t k = band.FirstSegment; k < band.LastSegment; k++)
+    {
+        const std::pair<size_t, size_t> &segment = mBandLayout.Segments[k - band.FirstSegment];
+        memcpy(dst, &mEncoded[segment.first], segment.second - segment.first);
+        dst += segment.second - segment.first;
+        if (k + 1 < total)
+        {
+            *dst++ = 0xFF;
+            *dst++ = static_cast<uint8_t>(0xD0 + (k & 7));
+        }
+    }
+    memcpy(dst, data + suffix, frame.Size() - suffix);
+    dst += frame.Size() - suffix;
+
+    return output->SetSize(static_cast<uint32_t>(dst - output->Data()));
+}
+
+Error JpegOverlayData::ApplyFull(const EncodedFrame &frame, PixelFormat format, int32_t x, int32_t y, ImagePool &pool,
+                                 std::shared_ptr<EncodedFrame> &output)
+{
+    Error ret = Decode(frame.Data(), frame.Size(), format, pool, mFullImage);
+
+    if (ret == Error::Success)
+    {
+        ret = mTile.Blend(mFullImage, x, y);
+    }
+    if (ret == Error::Success)
+    {
+        ret = mEncoder.EncodeToFrame(mFullImage, pool, output);
+    }
+    return ret;
+}
+
+Error JpegOverlayData::Apply(const std::shared_ptr<const EncodedFrame> &frame, const std::string &text, Argb color, Argb background,
+                             int32_t x, int32_t y, ImagePool &pool, std::shared_ptr<EncodedFrame> &output)
+{
+    output.reset();
+    if ((!frame) || (frame->Data() == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if (frame->Codec() != FrameCodec::JPEG)
+    {
+        return Error::UnsupportedPixelFormat;
+    }
+
+    bool parsed = ParseJpeg(frame->Data(), frame->Size(), mLayout);
+    PixelFormat format = ((parsed) && (mLayout.Components == 1)) ? PixelFormat::Grayscale8 : PixelFormat::RGB24;
+    Error ret = mTile.Render(text, color, background, format);
+    if (ret != Error::Success)
+    {
+        return ret;
+    }
+
+    if ((mTile.Width() == 0) ||
+        ((parsed) && ((y >= static_cast<int32_t>(mLayout.Height)) || (y + mTile.Height() <= 0) ||
+                      (x >= static_cast<int32_t>(mLayout.Width)) || (x + mTile.Width() <= 0))))
+    {
+        // 文字不可见
+        return frame->CopyTo(output, pool);
+    }
+
+    JpegBand band;
+    if ((parsed) && (CanReencode(mLayout)) && (PlanBand(mLayout, y, y + mTile.Height(), band)) &&
+        (ApplyPartial(*frame, band, x, y, pool, output) == Error::Success))
+    {
+        PartialFrames++;
+    }
+    else
+    {
+        output.reset();
+        ret = ApplyFull(*frame, format, x, y, pool, output);
+        if (ret != Error::Success)
+        {
+            output.reset();
+            return ret;
+        }
+        FullFrames++;
+    }
+
+    output->SetTimeStamp(frame->TimeStamp());
+    output->SetSequence(frame->Sequence());
+    output->SetKeyFrame(true);
+    return Error::Success;
+}
+
+/**
+ * JpegOverlay实现
+ */
+JpegOverlay::JpegOverlay(uint16_t quality) : mData(new JpegOverlayData(quality))
+{
+}
+
+JpegOverlay::~JpegOverlay()
+{
+    delete mData;
+}
+
+Error JpegOverlay::Apply(const std::shared_ptr<const EncodedFrame> &frame, const std::string &text, Argb color, Argb background,
+                         int32_t x, int32_t y, ImagePool &pool, std::shared_ptr<EncodedFrame> &output)
+{
+    return mData->Apply(frame, text, color, background, x, y, pool, output);
+}
+
+uint64_t JpegOverlay::PartialFrames() const
+{
+    return mData->PartialFrames;
+}
+
+uint64_t JpegOverlay::FullFrames() const
+{
+    return mData->FullFrames;
+}
+
+NAMESPACE_END
@@ -0,0 +1,88 @@
+/**
+ * @file jpeg_overlay.h
+ * @brief JPEG文字叠加，只重新编码被覆盖的MCU行
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 22:31:05
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 22:31:05 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 按照重启间隔分段的局部重新编码 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef JPEG_OVERLAY_H
+#define JPEG_OVERLAY_H
+
+#include <string>
+#include "uncopyable.h"
+#include "base_error.h"
+#include "encoded_frame.h"
+#include "image_pool.h"
+#include "img_tools.h"
+
+NAMESPACE_START
+
+class JpegOverlayData;
+/**
+ * @brief 在JPEG帧上叠加文字
+ * @details
+ *  JPEG的熵编码数据在重启标记(RSTn)处重置DC预测，每一段都可以单独解码和编码。
+ *  基线JPEG带有重启间隔(DRI)并且分段与MCU行对齐时，只把覆盖文字的几段解码为像素，
+ *  混合文字之后使用原始的量化表、Huffman表和采样因子重新编码，其余的段逐字节拷贝，
+ *  输出仍然使用原始的文件头。
+ *  没有重启间隔、渐进式编码或者原始Huffman表缺少需要的编码时，退回到完整的解码和编码。
+ *  每个对象保存一组libjpeg状态和缓冲区，非线程安全
+ */
+class JpegOverlay : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Jpeg Overlay object
+     * @param  quality          退回完整编码时的压缩质量
+     */
+    explicit JpegOverlay(uint16_t quality = 85);
+    ~JpegOverlay();
+    /**
+     * @brief  在压缩帧上叠加文字
+     * @param  frame            JPEG压缩帧
+     * @param  text             ASCII文字，为空时只拷贝
+     * @param  color            文字颜色
+     * @param  background       背景颜色
+     * @param  x                水平坐标
+     * @param  y                垂直坐标
+     * @param  pool             图像池，输出帧从中获取
+     * @param  output           叠加之后的压缩帧，保留原始帧的时间戳和序号
+     * @return Error            错误信息
+     */
+    Error Apply(const std::shared_ptr<const EncodedFrame> &frame, const std::string &text, Argb color, Argb background,
+                int32_t x, int32_t y, ImagePool &pool, std::shared_ptr<EncodedFrame> &output);
+    /**
+     * @brief  只重新编码部分MCU行的帧数
+     * @return uint64_t 帧数
+     */
+    uint64_t PartialFrames() const;
+    /**
+     * @brief  完整解码和编码的帧数
+     * @return uint64_t 帧数
+     */
+    uint64_t FullFrames() const;
+
+private:
+    JpegOverlayData *mData; ///< libjpeg状态和缓冲区
+};
+
+NAMESPACE_END
+
+#endif // JPEG_OVERLAY_H
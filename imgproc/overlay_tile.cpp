@@ -0,0 +1,314 @@
+#include <string.h>
+#include <algorithm>
+#include "overlay_tile.h"
+#include "image_drawer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+NAMESPACE_START
+
+/* 除以255并四舍五入，x 不超过 255 * 255 */
+static inline uint32_t Div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+/* 混合一行：dst = color + dst * alpha / 255，alpha 为 255 减去叠加的不透明度 */
+static void BlendRow(uint8_t *dst, const uint8_t *colors, const uint8_t *alphas, int32_t count)
+{
+    int32_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(alphas + i));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(colors + i));
+        // 乘积最大为 255 * 255，16位无符号不会溢出
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(a, zero)), half);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(a, zero)), half);
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_adds_epu8(_mm_packus_epi16(low, high), c));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint16x8_t half = vdupq_n_u16(128);
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t d = vld1q_u8(dst + i);
+        uint8x16_t a = vld1q_u8(alphas + i);
+        uint8x16_t c = vld1q_u8(colors + i);
+        uint16x8_t low = vaddq_u16(vmull_u8(vget_low_u8(d), vget_low_u8(a)), half);
+        uint16x8_t high = vaddq_u16(vmull_u8(vget_high_u8(d), vget_high_u8(a)), half);
+        uint8x8_t lowResult = vshrn_n_u16(vaddq_u16(low, vshrq_n_u16(low, 8)), 8);
+        uint8x8_t highResult = vshrn_n_u16(vaddq_u16(high, vshrq_n_u16(high, 8)), 8);
+        vst1q_u8(dst + i, vqaddq_u8(vcombine_u8(lowResult, highResult), c));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        uint32_t value = colors[i] + Div255(static_cast<uint32_t>(dst[i]) * alphas[i]);
+        dst[i] = static_cast<uint8_t>((value > 255) ? 255 : value);
+    }
+}
+
+/* 图块中 (x, y) 是否为文字像素，边框和字符间隙为背景 */
+static inline int GlyphPixel(const std::string &text, int32_t borderSize, int32_t x, int32_t y)
+{
+    int32_t glyphX = x - borderSize;
+    int32_t glyphRow = y - borderSize;
+
+    if ((glyphRow < 0) || (glyphRow >= 8) || (glyphX < 0) || (glyphX >= static_cast<int32_t>(text.length()) * 8))
+    {
+        return 0;
+    }
+    const uint8_t *glyph = ImageDrawer::Glyph(static_cast<uint8_t>(text[glyphX / 8]));
+    return (glyph[glyphRow] & (0x80 >> (glyphX % 8))) ? 1 : 0;
+}
+
+OverlayTile::OverlayTile() : mText(),
+                             mColor(0),
+                             mBackground(0),
+                             mFormat(PixelFormat::Unknown),
+                             mBorder(false),
+                             mWidth(0),
+                             mHeight(0),
+                             mPixelSize(0),
+                             mOpaque(false),
+                             mColors(),
+                             mAlphas(),
+                             mChromaColors(),
+                             mChromaAlphas()
+{
+}
+
+void OverlayTile::Reset()
+{
+    mText.clear();
+    mFormat = PixelFormat::Unknown;
+    mWidth = 0;
+    mHeight = 0;
+}
+
+Error OverlayTile::Render(const std::string &text, Argb color, Argb background, PixelFormat format, bool addBorder)
+{
+    if ((format != PixelFormat::Grayscale8) && (format != PixelFormat::RGB24) && (format != PixelFormat::RGBA32) &&
+        (format != PixelFormat::YUYV) && (!ImageIsPlanar(format)))
+    {
+        return Error::UnsupportedPixelFormat;
+    }
+    if ((format == mFormat) && (text == mText) && (color.argb == mColor) && (background.argb == mBackground) && (addBorder == mBorder))
+    {
+        return Error::Success;
+    }
+
+    int32_t borderSize = (addBorder) ? 2 : 0;
+    mText = text;
+    mColor = color.argb;
+    mBackground = background.argb;
+    mFormat = format;
+    mBorder = addBorder;
+    mPixelSize = static_cast<int32_t>(ImageBitsPerPixel(format) / 8);
+    mWidth = (text.empty()) ? 0 : static_cast<int32_t>(text.length()) * 8 + borderSize * 2;
+    mHeight = (text.empty()) ? 0 : 8 + borderSize * 2;
+    mOpaque = (format != PixelFormat::RGBA32) && (color.components.a == 255) && (background.components.a == 255);
+
+    // 两种颜色各自的预乘值和逆alpha，每个像素只需要选择其中一种
+    uint8_t pixels[2][4];
+    uint8_t alphas[2][4];
+    Argb colors[2] = {background, color};
+    for (int k = 0; k < 2; k++)
+    {
+        uint32_t a = colors[k].components.a;
+        uint32_t r = colors[k].components.r;
+        uint32_t g = colors[k].components.g;
+        uint32_t b = colors[k].components.b;
+        if (format == PixelFormat::Grayscale8)
+        {
+            pixels[k][0] = static_cast<uint8_t>(Div255(RGB_TO_GRAY(r, g, b) * a));
+        }
+        else if ((format == PixelFormat::YUYV) || (ImageIsPlanar(format)))
+        {
+            // JFIF全范围BT.601，与 DecodeYuyvToRgb 对应；依次保存 Y、U、V
+            pixels[k][0] = static_cast<uint8_t>(Div255(((19595 * r + 38470 * g + 7471 * b + 32768) >> 16) * a));
+            pixels[k][1] = static_cast<uint8_t>(Div255((((128 << 16) - 11059 * r - 21709 * g + 32768 * b + 32767) >> 16) * a));
+            pixels[k][2] = static_cast<uint8_t>(Div255((((128 << 16) + 32768 * r - 27439 * g - 5329 * b + 32767) >> 16) * a));
+        }
+        else
+        {
+            pixels[k][RedIndex] = static_cast<uint8_t>(Div255(r * a));
+            pixels[k][GreenIndex] = static_cast<uint8_t>(Div255(g * a));
+            pixels[k][BlueIndex] = static_cast<uint8_t>(Div255(b * a));
+            // RGBA32的alpha通道不改变
+            pixels[k][3] = 0;
+        }
+        for (int32_t i = 0; i < 4; i++)
+        {
+            alphas[k][i] = static_cast<uint8_t>(((format == PixelFormat::RGBA32) && (i == 3)) ? 255 : 255 - a);
+        }
+    }
+
+    size_t size = static_cast<size_t>(mWidth) * mHeight * mPixelSize;
+    mColors.resize(size);
+    mAlphas.resize(size);
+    for (int32_t y = 0; y < mHeight; y++)
+    {
+        size_t offset = static_cast<size_t>(y) * mWidth * mPixelSize;
+        if (format == PixelFormat::YUYV)
+        {
+            // 每个像素保存自己的Y，一对像素共用的U/V取两个像素的平均值
+            for (int32_t x = 0; x < mWidth; x += 2, offset += 4)
+            {
+                int k0 = GlyphPixel(text, borderSize, x, y);
+                int k1 = GlyphPixel(text, borderSize, x + 1, y);
+                mColors[offset] = pixels[k0][0];
+                mColors[offset + 1] = static_cast<uint8_t>((pixels[k0][1] + pixels[k1][1] + 1) / 2);
+                mColors[offset + 2] = pixels[k1][0];
+                mColors[offset + 3] = static_cast<uint8_t>((pixels[k0][2] + pixels[k1][2] + 1) / 2);
+                mAlphas[offset] = alphas[k0][0];
+                mAlphas[offset + 1] = static_cast<uint8_t>((alphas[k0][1] + alphas[k1][1]) / 2);
+                mAlphas[offset + 2] = alphas[k1][0];
+                mAlphas[offset + 3] = mAlphas[offset + 1];
+            }
+            continue;
+        }
+        for (int32_t x = 0; x < mWidth; x++, offset += mPixelSize)
+        {
+            int k = GlyphPixel(text, borderSize, x, y);
+            std::copy(pixels[k], pixels[k] + mPixelSize, &mColors[offset]);
+            std::copy(alphas[k], alphas[k] + mPixelSize, &mAlphas[offset]);
+        }
+    }
+
+    if (ImageIsPlanar(format))
+    {
+        // 上面只渲染了Y平面；色度图块取每2x2个像素的平均值，NV12 为UV交错的一个图块，I420 为U、V两个图块
+        int32_t chromaWidth = mWidth / 2;
+        int32_t chromaHeight = mHeight / 2;
+        size_t planeSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+        bool nv12 = (format == PixelFormat::NV12);
+        mChromaColors.resize(planeSize * 2);
+        mChromaAlphas.resize(planeSize * 2);
+        for (int32_t cy = 0; cy < chromaHeight; cy++)
+        {
+            for (int32_t cx = 0; cx < chromaWidth; cx++)
+            {
+                uint32_t u = 0, v = 0, alpha = 0;
+                for (int32_t i = 0; i < 4; i++)
+                {
+                    int k = GlyphPixel(text, borderSize, cx * 2 + (i & 1), cy * 2 + (i >> 1));
+                    u += pixels[k][1];
+                    v += pixels[k][2];
+                    alpha += alphas[k][1];
+                }
+                size_t index = static_cast<size_t>(cy) * chromaWidth + cx;
+                size_t uOffset = (nv12) ? index * 2 : index;
+                size_t vOffset = (nv12) ? index * 2 + 1 : planeSize + index;
+                mChromaColors[uOffset] = static_cast<uint8_t>((u + 2) / 4);
+                mChromaColors[vOffset] = static_cast<uint8_t>((v + 2) / 4);
+                mChromaAlphas[uOffset] = static_cast<uint8_t>(alpha / 4);
+                mChromaAlphas[vOffset] = static_cast<uint8_t>(alpha / 4);
+            }
+        }
+    }
+
+    return Error::Success;
+}
+
+/* 混合一个平面中的区域，图块的每行为 tileStride 字节 */
+static void BlendPlane(uint8_t *dst, int32_t dstStride, const uint8_t *colors, const uint8_t *alphas, int32_t tileStride,
+                       int32_t count, int32_t rows, bool opaque)
+{
+    for (int32_t row = 0; row < rows; row++)
+    {
+        if (opaque)
+        {
+            memcpy(dst, colors, count);
+        }
+        else
+        {
+            BlendRow(dst, colors, alphas, count);
+        }
+        dst += dstStride;
+        colors += tileStride;
+        alphas += tileStride;
+    }
+}
+
+Error OverlayTile::Blend(const std::shared_ptr<const Image> &image, int32_t x, int32_t y) const
+{
+    if ((!image) || (image->Data() == nullptr))
+    {
+        return Error::NullPointer;
+    }
+    if (image->Format() != mFormat)
+    {
+        return Error::ImageParametersMismatch;
+    }
+
+    bool planar = ImageIsPlanar(mFormat);
+    if ((mFormat == PixelFormat::YUYV) || (planar))
+    {
+        // 一对像素共用U/V，水平位置对齐到偶数；4:2:0 的垂直位置也对齐到偶数
+        x &= ~1;
+    }
+    if (planar)
+    {
+        y &= ~1;
+    }
+    int32_t startX = std::max(x, 0);
+    int32_t startY = std::max(y, 0);
+    int32_t endX = std::min(x + mWidth, image->Width());
+    int32_t endY = std::min(y + mHeight, image->Height());
+    if ((mFormat == PixelFormat::YUYV) || (planar))
+    {
+        endX -= (endX - startX) & 1;
+    }
+    if (planar)
+    {
+        endY -= (endY - startY) & 1;
+    }
+    if ((startX >= endX) || (startY >= endY))
+    {
+        return Error::Success;
+    }
+
+    int32_t count = (endX - startX) * mPixelSize;
+    size_t offset = (static_cast<size_t>(startY - y) * mWidth + (startX - x)) * mPixelSize;
+    BlendPlane(image->Data() + startY * image->Stride() + startX * mPixelSize, image->Stride(),
+               &mColors[offset], &mAlphas[offset], mWidth * mPixelSize, count, endY - startY, mOpaque);
+
+    if (planar)
+    {
+        int32_t chromaWidth = mWidth / 2;
+        size_t planeSize = static_cast<size_t>(chromaWidth) * (mHeight / 2);
+        size_t index = static_cast<size_t>((startY - y) / 2) * chromaWidth + (startX - x) / 2;
+        int32_t rows = (endY - startY) / 2;
+        int32_t chromaY = startY / 2;
+        if (mFormat == PixelFormat::NV12)
+        {
+            BlendPlane(image->Plane(1) + chromaY * image->PlaneStride(1) + startX, image->PlaneStride(1),
+                       &mChromaColors[index * 2], &mChromaAlphas[index * 2], chromaWidth * 2, endX - startX, rows, mOpaque);
+        }
+        else
+        {
+            for (int32_t plane = 1; plane <= 2; plane++)
+            {
+                size_t tileOffset = (plane == 1) ? index : planeSize + index;
+                BlendPlane(image->Plane(plane) + chromaY * image->PlaneStride(plane) + startX / 2, image->PlaneStride(plane),
+                           &mChromaColors[tileOffset], &mChromaAlphas[tileOffset], chromaWidth, (endX - startX) / 2, rows, mOpaque);
+            }
+        }
+    }
+
+    return Error::Success;
+}
+
+NAMESPACE_END
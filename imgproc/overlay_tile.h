@@ -0,0 +1,105 @@
+/**
+ * @file overlay_tile.h
+ * @brief 预先渲染的文字叠加图块，每帧只进行整数alpha混合
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 21:48:12
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 21:48:12 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 缓存的文字叠加图块 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef OVERLAY_TILE_H
+#define OVERLAY_TILE_H
+
+#include <string>
+#include <vector>
+#include "image.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 文字叠加图块
+ * @details
+ *  Render 按照目标图像的像素格式把文字、背景和边框渲染为预乘颜色和逆alpha两个平面，
+ *  与 ImageDrawer::PutText 的效果相同。Blend 对每个字节计算 color + dst * (255 - alpha) / 255，
+ *  全部为整数运算并使用SSE2/NEON加速，文字不变时每帧只需要混合，不再逐位绘制字符。
+ *  RGBA32图像的alpha通道保持不变；YUYV图像的水平位置对齐到偶数，U/V取一对像素的平均值，
+ *  不需要为了叠加文字把整条流水线保持在RGB。NV12/I420 另外渲染每2x2个像素平均的色度图块，
+ *  两个方向的位置都对齐到偶数。
+ *  文字和背景都不透明的图块直接按行拷贝。非线程安全
+ */
+class OverlayTile : private Uncopyable
+{
+public:
+    OverlayTile();
+    /**
+     * @brief  渲染文字，文字、颜色和格式都没有变化时直接返回
+     * @param  text             ASCII文字
+     * @param  color            文字颜色
+     * @param  background       背景颜色
+     * @param  format           目标图像格式，支持Grayscale8/RGB24/RGBA32/YUYV/NV12/I420
+     * @param  addBorder        是否增加2像素的背景边框
+     * @return Error            错误信息
+     */
+    Error Render(const std::string &text, Argb color, Argb background, PixelFormat format, bool addBorder = true);
+    /**
+     * @brief  将图块混合到图像的指定位置，超出图像的部分被裁剪
+     * @param  image            目标图像，格式需要与渲染时相同
+     * @param  x                水平坐标
+     * @param  y                垂直坐标
+     * @return Error            错误信息
+     */
+    Error Blend(const std::shared_ptr<const Image> &image, int32_t x, int32_t y) const;
+    /**
+     * @brief 清除图块，下一次 Render 一定会重新渲染
+     */
+    void Reset();
+    /**
+     * @brief  图块宽度
+     * @return int32_t 宽度，没有渲染时为0
+     */
+    int32_t Width() const { return mWidth; }
+    /**
+     * @brief  图块高度
+     * @return int32_t 高度，没有渲染时为0
+     */
+    int32_t Height() const { return mHeight; }
+    /**
+     * @brief  已经渲染的文字
+     * @return const std::string& 文字
+     */
+    const std::string &Text() const { return mText; }
+
+private:
+    std::string mText;            ///< 渲染的文字
+    uint32_t mColor;              ///< 文字颜色
+    uint32_t mBackground;         ///< 背景颜色
+    PixelFormat mFormat;          ///< 目标图像格式
+    bool mBorder;                 ///< 是否有边框
+    int32_t mWidth;               ///< 图块宽度(像素)
+    int32_t mHeight;              ///< 图块高度
+    int32_t mPixelSize;           ///< 每个像素的字节数
+    bool mOpaque;                 ///< 完全不透明，混合时直接拷贝
+    std::vector<uint8_t> mColors; ///< 预乘alpha的颜色，按照目标图像的像素格式排列
+    std::vector<uint8_t> mAlphas; ///< 每个字节对应的 255 - alpha，0 表示完全覆盖
+    std::vector<uint8_t> mChromaColors; ///< NV12/I420 的色度图块，排列与目标图像的色度平面相同
+    std::vector<uint8_t> mChromaAlphas; ///< 色度图块的逆alpha
+};
+
+NAMESPACE_END
+
+#endif // OVERLAY_TILE_H
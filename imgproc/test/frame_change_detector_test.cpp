@@ -0,0 +1,130 @@
+#include "frame_change_detector.h"
+#include "image_pool.h"
+#include "jpeg_encoder.h"
+#include "test_check.h"
+
+#include <iostream>
+#include <chrono>
+#include <stdint.h>
+
+using namespace MY_NAME_SPACE;
+
+/* 生成渐变图像，noise 为每个字节叠加的随机噪声幅度 */
+static void FillImage(const std::shared_ptr<Image> &image, uint32_t seed, uint32_t noise)
+{
+    int32_t lineSize = static_cast<int32_t>(image->Width() * ImageBitsPerPixel(image->Format()) / 8);
+
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            int value = 64 + ((x / 3 + y) & 0x7F) + ((noise == 0) ? 0 : static_cast<int>((seed >> 16) % (2 * noise + 1)) - static_cast<int>(noise));
+            row[x] = static_cast<uint8_t>(value);
+        }
+    }
+}
+
+/* 在图像中绘制一个白色方块，模拟小物体进入画面 */
+static void DrawSquare(const std::shared_ptr<Image> &image, int32_t left, int32_t top, int32_t size)
+{
+    int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(image->Format()) / 8);
+
+    for (int32_t y = top; y < top + size; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride() + left * pixelSize;
+        for (int32_t x = 0; x < size * pixelSize; x++)
+        {
+            row[x] = 255;
+        }
+    }
+}
+
+/* 检查不同格式下的分数 */
+void TestScores(PixelFormat format, int32_t width, int32_t height)
+{
+    ImagePool pool(4);
+    FrameChangeDetector detector;
+    std::shared_ptr<Image> image = pool.Acquire(width, height, format);
+    uint32_t score = 0;
+
+    FillImage(image, 1, 0);
+    Check(detector.Compare(image, &score) == Error::Success, "compare first frame");
+    Check(score == FRAME_CHANGE_MAX_SCORE, "first frame has no reference");
+    detector.UpdateReference();
+
+    Check(detector.Compare(image, &score) == Error::Success, "compare same frame");
+    Check(score == 0, "same frame scores zero");
+
+    // 传感器噪声经过缩略图平均之后基本消失
+    FillImage(image, 2, 12);
+    detector.Compare(image, &score);
+    std::cout << "format " << static_cast<int>(format) << " " << width << "x" << height << " noise score: " << score;
+    Check(score < 4, "noise stays below threshold");
+
+    // 32x32 的小物体需要被检测到
+    DrawSquare(image, width / 2, height / 3, 32);
+    detector.Compare(image, &score);
+    std::cout << ", object score: " << score << std::endl;
+    Check(score >= 8, "small object is detected");
+
+    // 参考帧不会被 Compare 修改
+    FillImage(image, 1, 0);
+    detector.Compare(image, &score);
+    Check(score == 0, "reference kept after compare");
+
+    // 尺寸变化之后没有参考帧
+    std::shared_ptr<Image> other = pool.Acquire(width / 2, height / 2, format);
+    FillImage(other, 1, 0);
+    detector.Compare(other, &score);
+    Check(score == FRAME_CHANGE_MAX_SCORE, "size change resets reference");
+
+    detector.Reset();
+    detector.Compare(other, &score);
+    Check(score == FRAME_CHANGE_MAX_SCORE, "reset clears reference");
+}
+
+/* 输出变化检测和jpeg编码的耗时 */
+void TestCost()
+{
+    const int rounds = 50;
+    ImagePool pool(4);
+    FrameChangeDetector detector;
+    JpegEncoder encoder(85, true);
+    std::shared_ptr<Image> image = pool.Acquire(1280, 720, PixelFormat::RGB24);
+    std::shared_ptr<EncodedFrame> jpeg;
+    uint32_t score = 0;
+
+    FillImage(image, 3, 8);
+    detector.Compare(image, &score);
+    detector.UpdateReference();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        detector.Compare(image, &score);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        jpeg = pool.AcquireEncoded(512 * 1024, FrameCodec::JPEG);
+        encoder.EncodeToFrame(image, pool, jpeg);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double compareTime = std::chrono::duration<double, std::micro>(middle - start).count() / rounds;
+    double encodeTime = std::chrono::duration<double, std::micro>(end - middle).count() / rounds;
+    // Debug(-O0)编译时耗时没有参考意义，只输出结果
+    std::cout << "1280x720 compare: " << compareTime << " us, encode: " << encodeTime << " us" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    TestScores(PixelFormat::RGB24, 640, 480);
+    TestScores(PixelFormat::RGBA32, 641, 479);
+    TestScores(PixelFormat::Grayscale8, 1280, 720);
+    TestCost();
+
+    return TestResult();
+}
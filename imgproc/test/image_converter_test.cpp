@@ -0,0 +1,204 @@
+#include "image_converter.h"
+#include "test_check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace MY_NAME_SPACE;
+
+/* 按照 ImageBufferRows 填充全部平面的随机数据 */
+static void FillImage(const std::shared_ptr<Image> &image)
+{
+    int32_t rows = ImageBufferRows(image->Format(), image->Height());
+    uint32_t seed = 7;
+
+    for (int32_t i = 0; i < rows * image->Stride(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image->Data()[i] = static_cast<uint8_t>(seed >> 16);
+    }
+}
+
+/* 4:2:0色度的参考值，component 0 为U，1 为V */
+static uint8_t ChromaAt(const std::shared_ptr<const Image> &image, int32_t x, int32_t y, int32_t component)
+{
+    if (image->Format() == PixelFormat::NV12)
+    {
+        return image->Plane(1)[y * image->PlaneStride(1) + x * 2 + component];
+    }
+    return image->Plane(1 + component)[y * image->PlaneStride(1 + component) + x];
+}
+
+/* YUYV 转换为4:2:0或灰度：Y不变，色度为上下两行向上取整的平均值，奇数高度的最后一行直接使用 */
+void TestYuyvTo420(PixelFormat format, int32_t width, int32_t height)
+{
+    std::shared_ptr<Image> yuyv = Image::Allocate(width, height, PixelFormat::YUYV);
+    std::shared_ptr<Image> dst = Image::Allocate(width, height, format);
+    FillImage(yuyv);
+    Check(ImageConverter::Convert(yuyv, dst) == Error::Success, "yuyv to 420");
+
+    bool luma = true, chroma = true;
+    for (int32_t y = 0; y < height; y++)
+    {
+        const uint8_t *row = yuyv->Data() + y * yuyv->Stride();
+        for (int32_t x = 0; x < width; x++)
+        {
+            luma = luma && (dst->Data()[y * dst->Stride() + x] == row[x * 2]);
+        }
+    }
+    for (int32_t y = 0; (ImageIsPlanar(format)) && (y < (height + 1) / 2); y++)
+    {
+        const uint8_t *row0 = yuyv->Data() + y * 2 * yuyv->Stride();
+        const uint8_t *row1 = (y * 2 + 1 < height) ? row0 + yuyv->Stride() : row0;
+        for (int32_t x = 0; x < width / 2; x++)
+        {
+            chroma = chroma && (ChromaAt(dst, x, y, 0) == (row0[x * 4 + 1] + row1[x * 4 + 1] + 1) / 2) &&
+                     (ChromaAt(dst, x, y, 1) == (row0[x * 4 + 3] + row1[x * 4 + 3] + 1) / 2);
+        }
+    }
+    Check(luma, "yuyv luma copied");
+    Check(chroma, "yuyv chroma averaged over two rows");
+}
+
+static uint8_t Clamp(int value)
+{
+    return static_cast<uint8_t>((value > 255) ? 255 : ((value < 0) ? 0 : value));
+}
+
+/* YUYV 转换为RGB与 DecodeYuyvToRgb 的系数相同 */
+void TestYuyvToRgb()
+{
+    std::shared_ptr<Image> yuyv = Image::Allocate(66, 20, PixelFormat::YUYV);
+    std::shared_ptr<Image> rgb = Image::Allocate(66, 20, PixelFormat::RGB24);
+    FillImage(yuyv);
+    Check(ImageConverter::Convert(yuyv, rgb) == Error::Success, "yuyv to rgb");
+
+    bool same = true;
+    for (int32_t y = 0; y < 20; y++)
+    {
+        for (int32_t x = 0; x < 66; x++)
+        {
+            const uint8_t *pair = yuyv->Data() + y * yuyv->Stride() + (x / 2) * 4;
+            const uint8_t *pixel = rgb->Data() + y * rgb->Stride() + x * 3;
+            int luma = pair[(x & 1) * 2] << 8, u = pair[1] - 128, v = pair[3] - 128;
+            same = same && (pixel[RedIndex] == Clamp((luma + 360 * v) >> 8)) &&
+                   (pixel[GreenIndex] == Clamp((luma - 88 * u - 184 * v) >> 8)) &&
+                   (pixel[BlueIndex] == Clamp((luma + 455 * u) >> 8));
+        }
+    }
+    Check(same, "yuyv to rgb matches DecodeYuyvToRgb");
+}
+
+/* NV12 和 I420 互相转换之后还原，转换为RGB时两者相同，转换为灰度只保留Y */
+void TestYuv420(int32_t width, int32_t height)
+{
+    std::shared_ptr<Image> nv12 = Image::Allocate(width, height, PixelFormat::NV12);
+    std::shared_ptr<Image> i420 = Image::Allocate(width, height, PixelFormat::I420);
+    std::shared_ptr<Image> back = Image::Allocate(width, height, PixelFormat::NV12);
+    std::shared_ptr<Image> rgb1 = Image::Allocate(width, height, PixelFormat::RGB24);
+    std::shared_ptr<Image> rgb2 = Image::Allocate(width, height, PixelFormat::RGB24);
+    std::shared_ptr<Image> gray = Image::Allocate(width, height, PixelFormat::Grayscale8);
+    FillImage(nv12);
+
+    Check(ImageConverter::Convert(nv12, i420) == Error::Success, "nv12 to i420");
+    Check(ImageConverter::Convert(i420, back) == Error::Success, "i420 to nv12");
+    bool same = true;
+    for (int32_t y = 0; y < (height + 1) / 2; y++)
+    {
+        for (int32_t x = 0; x < (width + 1) / 2; x++)
+        {
+            same = same && (ChromaAt(i420, x, y, 0) == ChromaAt(nv12, x, y, 0)) && (ChromaAt(i420, x, y, 1) == ChromaAt(nv12, x, y, 1)) &&
+                   (ChromaAt(back, x, y, 0) == ChromaAt(nv12, x, y, 0)) && (ChromaAt(back, x, y, 1) == ChromaAt(nv12, x, y, 1));
+        }
+    }
+    for (int32_t y = 0; y < height; y++)
+    {
+        same = same && (memcmp(back->Data() + y * back->Stride(), nv12->Data() + y * nv12->Stride(), width) == 0);
+    }
+    Check(same, "planes rearranged without loss");
+
+    Check(ImageConverter::Convert(nv12, rgb1) == Error::Success, "nv12 to rgb");
+    Check(ImageConverter::Convert(i420, rgb2) == Error::Success, "i420 to rgb");
+    Check(memcmp(rgb1->Data(), rgb2->Data(), rgb1->Size()) == 0, "nv12 and i420 decode the same");
+    // 中性色度时 R = G = B = Y
+    Check(ImageConverter::Convert(nv12, gray) == Error::Success, "nv12 to gray");
+    Check(ImageConverter::Convert(gray, i420) == Error::Success, "gray to i420");
+    Check(ImageConverter::Convert(i420, rgb1) == Error::Success, "neutral i420 to rgb");
+    bool neutral = true;
+    for (int32_t y = 0; y < height; y++)
+    {
+        for (int32_t x = 0; x < width; x++)
+        {
+            const uint8_t *pixel = rgb1->Data() + y * rgb1->Stride() + x * 3;
+            uint8_t luma = nv12->Data()[y * nv12->Stride() + x];
+            neutral = neutral && (gray->Data()[y * gray->Stride() + x] == luma) && (pixel[0] == luma) && (pixel[1] == luma) && (pixel[2] == luma);
+        }
+    }
+    Check(neutral, "gray keeps luma and converts to neutral chroma");
+}
+
+/* 裁剪视图作为源，色度平面随视图偏移 */
+void TestView()
+{
+    std::shared_ptr<Image> i420 = Image::Allocate(64, 48, PixelFormat::I420);
+    FillImage(i420);
+    struct timeval stamp;
+    stamp.tv_sec = 5;
+    stamp.tv_usec = 6;
+    i420->UpdateTimeStamp(stamp);
+    i420->SetFrameId(42);
+
+    std::shared_ptr<const Image> view = Image::CreateView(i420, 8, 4, 30, 21);
+    std::shared_ptr<Image> nv12 = Image::Allocate(30, 21, PixelFormat::NV12);
+    Check(ImageConverter::Convert(view, nv12) == Error::Success, "convert view");
+    Check((nv12->TimeStamp().tv_sec == 5) && (nv12->FrameId() == 42), "timestamp and frame id copied");
+    Check((nv12->Data()[0] == i420->Data()[4 * i420->Stride() + 8]) && (ChromaAt(nv12, 0, 0, 0) == ChromaAt(i420, 4, 2, 0)) &&
+              (ChromaAt(nv12, 14, 10, 1) == ChromaAt(i420, 18, 12, 1)),
+          "view planes offset");
+}
+
+void TestParameters()
+{
+    std::shared_ptr<Image> rgb = Image::Allocate(32, 16, PixelFormat::RGB24);
+    std::shared_ptr<Image> yuyv = Image::Allocate(32, 16, PixelFormat::YUYV);
+    std::shared_ptr<Image> small = Image::Allocate(16, 16, PixelFormat::I420);
+
+    Check(ImageConverter::Convert(rgb, yuyv) == Error::UnsupportedPixelFormat, "rgb source unsupported");
+    Check(ImageConverter::Convert(yuyv, small) == Error::ImageParametersMismatch, "size mismatch");
+    Check(ImageConverter::Convert(nullptr, small) == Error::NullPointer, "null source");
+
+    Check(ImageConverter::ConversionCost(PixelFormat::NV12, PixelFormat::NV12) == 1, "same format cost");
+    Check(ImageConverter::ConversionCost(PixelFormat::YUYV, PixelFormat::I420) <
+              ImageConverter::ConversionCost(PixelFormat::YUYV, PixelFormat::RGB24),
+          "420 cheaper than rgb");
+    Check(ImageConverter::ConversionCost(PixelFormat::JPEG, PixelFormat::RGB24) == IMAGE_CONVERSION_UNSUPPORTED, "jpeg not converted");
+
+    std::vector<PixelFormat> offered;
+    offered.push_back(PixelFormat::Grayscale8);
+    offered.push_back(PixelFormat::YUYV);
+    offered.push_back(PixelFormat::NV12);
+    Check(ImageConverter::CheapestSource(offered, PixelFormat::I420) == PixelFormat::NV12, "nv12 preferred for i420");
+    Check(ImageConverter::CheapestSource(offered, PixelFormat::Grayscale8) == PixelFormat::Grayscale8, "gray preferred for gray");
+    offered.pop_back();
+    Check(ImageConverter::CheapestSource(offered, PixelFormat::RGB24) == PixelFormat::YUYV, "color source preferred for rgb");
+    offered.clear();
+    offered.push_back(PixelFormat::JPEG);
+    Check(ImageConverter::CheapestSource(offered, PixelFormat::I420) == PixelFormat::Unknown, "no convertible source");
+}
+
+int main()
+{
+    TestYuyvTo420(PixelFormat::I420, 64, 48);
+    TestYuyvTo420(PixelFormat::NV12, 64, 48);
+    TestYuyvTo420(PixelFormat::I420, 102, 37);
+    TestYuyvTo420(PixelFormat::NV12, 102, 37);
+    TestYuyvTo420(PixelFormat::Grayscale8, 102, 37);
+    TestYuyvToRgb();
+    TestYuv420(64, 48);
+    TestYuv420(101, 37);
+    TestView();
+    TestParameters();
+
+    return TestResult();
+}
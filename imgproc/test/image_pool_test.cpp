@@ -0,0 +1,259 @@
+#include "image_pool.h"
+#include "image_scaler.h"
+#include "jpeg_encoder.h"
+#include "test_check.h"
+
+#include <iostream>
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace MY_NAME_SPACE;
+
+/**
+ * 替换malloc系列函数，统计测试区间内的堆分配次数
+ */
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *ptr);
+}
+
+static std::atomic<bool> gCounting(false);
+static std::atomic<uint64_t> gAllocations(0);
+
+static inline void CountAllocation()
+{
+    if (gCounting.load(std::memory_order_relaxed))
+    {
+        gAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+extern "C"
+{
+    void *malloc(size_t size)
+    {
+        CountAllocation();
+        return __libc_malloc(size);
+    }
+    void *calloc(size_t count, size_t size)
+    {
+        CountAllocation();
+        return __libc_calloc(count, size);
+    }
+    void *realloc(void *ptr, size_t size)
+    {
+        CountAllocation();
+        return __libc_realloc(ptr, size);
+    }
+    void *memalign(size_t alignment, size_t size)
+    {
+        CountAllocation();
+        return __libc_memalign(alignment, size);
+    }
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        CountAllocation();
+        return __libc_memalign(alignment, size);
+    }
+    int posix_memalign(void **ptr, size_t alignment, size_t size)
+    {
+        CountAllocation();
+        void *result = __libc_memalign(alignment, size);
+        if (result == nullptr)
+        {
+            return ENOMEM;
+        }
+        *ptr = result;
+        return 0;
+    }
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+
+/* 模拟发布的编码帧 */
+struct TestFrame
+{
+    TestFrame(const std::shared_ptr<const EncodedFrame> &buffer, uint64_t sequence) : Buffer(buffer), Sequence(sequence)
+    {
+    }
+    std::shared_ptr<const EncodedFrame> Buffer;
+    uint64_t Sequence;
+};
+
+/* 生成带噪声的渐变图像，保证jpeg大小有变化 */
+static void FillImage(const std::shared_ptr<Image> &image, uint32_t seed)
+{
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < image->Width() * 3; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            row[x] = static_cast<uint8_t>((x + y) + ((seed >> 16) & 0x0F));
+        }
+    }
+}
+
+/* 检查对齐和复用 */
+void TestAlignmentAndRecycle()
+{
+    ImagePool pool(4);
+    std::shared_ptr<Image> image = pool.Acquire(641, 480, PixelFormat::RGB24);
+    Check(image != nullptr, "acquire image");
+    Check((reinterpret_cast<uintptr_t>(image->Data()) % IMAGE_POOL_ALIGNMENT) == 0, "image data is aligned");
+    Check((image->Stride() % IMAGE_POOL_ALIGNMENT) == 0, "image stride is aligned");
+    Check(image->Stride() >= 641 * 3, "image stride covers row");
+
+    uint8_t *data = image->Data();
+    image.reset();
+    Check(pool.FreeImageCount() == 1, "released image returns to pool");
+    image = pool.Acquire(641, 480, PixelFormat::RGB24);
+    Check(image->Data() == data, "released image is reused");
+
+    std::shared_ptr<Image> other = pool.Acquire(320, 240, PixelFormat::RGB24);
+    Check(other->Data() != data, "different size uses different image");
+    Check(pool.TotalImageCount() == 2, "pool counts allocated images");
+
+    std::shared_ptr<EncodedFrame> jpeg = pool.AcquireEncoded(1000, FrameCodec::JPEG);
+    Check((jpeg->Codec() == FrameCodec::JPEG) && (jpeg->Size() == 0) && (jpeg->Capacity() >= 1000), "acquire encoded frame");
+    Check(jpeg->SetSize(jpeg->Capacity() + 1) != Error::Success, "encoded frame size is limited by capacity");
+    Check(jpeg->SetSize(700) == Error::Success, "set encoded frame size");
+    jpeg->SetSequence(7);
+    uint8_t *jpegData = jpeg->Data();
+    jpeg.reset();
+    jpeg = pool.AcquireEncoded(900, FrameCodec::JPEG);
+    Check((jpeg->Data() == jpegData) && (jpeg->Size() == 0) && (jpeg->Sequence() == 0), "released encoded frame is reused and reset");
+
+    // 容量和大小分开，不同大小的帧拷贝到同一个缓冲区
+    uint8_t external[300];
+    memset(external, 0x3C, sizeof(external));
+    std::shared_ptr<EncodedFrame> wrapped = EncodedFrame::Create(external, sizeof(external), FrameCodec::JPEG);
+    Check(wrapped->Reserve(sizeof(external) + 1) != Error::Success, "wrapped memory can not grow");
+    wrapped->SetSize(200);
+    wrapped->SetKeyFrame(true);
+    Check((wrapped->CopyTo(jpeg, pool) == Error::Success) && (jpeg->Data() == jpegData), "copy into pooled frame");
+    Check((jpeg->Size() == 200) && (jpeg->IsKeyFrame()) && (jpeg->Data()[199] == 0x3C), "copy keeps size and flags");
+    wrapped->SetSize(300);
+    Check((wrapped->CopyTo(jpeg, pool) == Error::Success) && (jpeg->Data() == jpegData), "larger frame fits without reallocation");
+
+    // 池对象析构之后图像依然可以正常释放
+    ImagePool *shortLived = new ImagePool();
+    std::shared_ptr<Image> orphan = shortLived->Acquire(16, 16, PixelFormat::Grayscale8);
+    delete shortLived;
+    memset(orphan->Data(), 0, orphan->Size());
+    orphan.reset();
+}
+
+/* 输出缓冲区不足时从池中获取更大的缓冲区 */
+void TestJpegBufferGrowth()
+{
+    ImagePool pool;
+    JpegEncoder encoder(90, true);
+    std::shared_ptr<Image> image = pool.Acquire(320, 240, PixelFormat::RGB24);
+    FillImage(image, 1);
+
+    std::shared_ptr<EncodedFrame> jpeg = pool.AcquireEncoded(64, FrameCodec::JPEG);
+    Error ret = encoder.EncodeToFrame(image, pool, jpeg);
+    Check(ret == Error::Success, "encode into small buffer");
+    Check(jpeg->Size() > ENCODED_FRAME_GRANULARITY, "buffer grows past first capacity");
+    Check(jpeg->IsKeyFrame(), "jpeg is a key frame");
+    Check((jpeg->Data()[0] == 0xFF) && (jpeg->Data()[1] == 0xD8), "jpeg starts with SOI");
+    Check((jpeg->Data()[jpeg->Size() - 2] == 0xFF) && (jpeg->Data()[jpeg->Size() - 1] == 0xD9), "jpeg ends with EOI");
+
+    // 扩大之后的缓冲区归还到池中，下一次获取时直接使用
+    uint32_t capacity = jpeg->Capacity();
+    jpeg.reset();
+    jpeg = pool.AcquireEncoded(64, FrameCodec::JPEG);
+    Check(jpeg->Capacity() == capacity, "grown buffer keeps its capacity in the pool");
+}
+
+/* 大页分配，没有预留大页时使用透明大页 */
+void TestHugePageAllocation()
+{
+    ImageMemoryOptions options(true, ImageMemory::CurrentNumaNode());
+    std::shared_ptr<Image> image = Image::Allocate(3840, 2160, PixelFormat::RGB24, true, options);
+    Check(image != nullptr, "allocate 4K image with huge pages");
+    Check((reinterpret_cast<uintptr_t>(image->Data()) % IMAGE_MEMORY_HUGEPAGE_SIZE) == 0, "huge page memory is page aligned");
+    Check((image->Data()[0] == 0) && (image->Data()[image->Size() - 1] == 0), "mapped memory is zeroed");
+    memset(image->Data(), 0x5A, image->Size());
+
+    ImagePool pool(2, options);
+    std::shared_ptr<Image> pooled = pool.Acquire(3840, 2160, PixelFormat::RGB24);
+    Check(pooled != nullptr, "pool allocates with huge pages");
+    memset(pooled->Data(), 0x5A, pooled->Size());
+    std::shared_ptr<Image> small = pool.Acquire(64, 64, PixelFormat::RGB24);
+    Check((reinterpret_cast<uintptr_t>(small->Data()) % IMAGE_POOL_ALIGNMENT) == 0, "small image falls back to heap");
+}
+
+/* 稳定运行时每帧不应该有堆分配 */
+void TestSteadyStateAllocations()
+{
+    const int warmupFrames = 10;
+    const int measuredFrames = 100;
+    ImagePool pool;
+    JpegEncoder fullEncoder(70, true);
+    JpegEncoder scaledEncoder(60, true);
+    std::shared_ptr<Image> camera = Image::Allocate(640, 480, PixelFormat::RGB24);
+    std::shared_ptr<Image> cameraCopy;
+    std::shared_ptr<Image> scaled;
+    std::shared_ptr<const TestFrame> published[2];
+    uint32_t lastSize[2] = {0, 0};
+
+    for (int i = 0; i < warmupFrames + measuredFrames; i++)
+    {
+        FillImage(camera, static_cast<uint32_t>(i));
+        if (i == warmupFrames)
+        {
+            gAllocations = 0;
+            gCounting = true;
+        }
+
+        // 采集线程拷贝图像，上一帧仍然被引用时使用新的图像
+        if (cameraCopy.use_count() > 1)
+        {
+            cameraCopy.reset();
+        }
+        Check(camera->CopyDataOrClone(cameraCopy, pool) == Error::Success, "copy camera image");
+        std::shared_ptr<const Image> source = cameraCopy;
+
+        if (!scaled)
+        {
+            scaled = pool.Acquire(320, 240, PixelFormat::RGB24);
+        }
+        Check(ImageScaler::Downscale(source, scaled, 2) == Error::Success, "downscale image");
+
+        JpegEncoder *encoders[2] = {&fullEncoder, &scaledEncoder};
+        std::shared_ptr<const Image> inputs[2] = {source, scaled};
+        for (int tier = 0; tier < 2; tier++)
+        {
+            std::shared_ptr<EncodedFrame> jpeg = pool.AcquireEncoded(lastSize[tier] + lastSize[tier] / 10, FrameCodec::JPEG);
+            Check(encoders[tier]->EncodeToFrame(inputs[tier], pool, jpeg) == Error::Success, "encode frame");
+            lastSize[tier] = jpeg->Size();
+            published[tier] = pool.MakeShared<TestFrame>(jpeg, static_cast<uint64_t>(i));
+        }
+    }
+    gCounting = false;
+
+    std::cout << "allocations in " << measuredFrames << " frames: " << gAllocations.load()
+              << ", pooled images: " << pool.TotalImageCount() << std::endl;
+    Check(gAllocations.load() == 0, "no heap allocation in steady state");
+}
+
+int main(int argc, char *argv[])
+{
+    TestAlignmentAndRecycle();
+    TestJpegBufferGrowth();
+    TestHugePageAllocation();
+    TestSteadyStateAllocations();
+
+    return TestResult();
+}
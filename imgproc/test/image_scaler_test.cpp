@@ -0,0 +1,277 @@
+#include "image_scaler.h"
+#include "test_check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace MY_NAME_SPACE;
+
+/* 生成带有噪声的渐变图像 */
+static void FillImage(const std::shared_ptr<Image> &image)
+{
+    int32_t lineSize = static_cast<int32_t>(image->Width() * ImageBitsPerPixel(image->Format()) / 8);
+    uint32_t seed = 1;
+
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            row[x] = static_cast<uint8_t>(x * 3 + y * 5 + ((seed >> 16) & 0x3F));
+        }
+    }
+}
+
+/* 逐块求和的参考实现 */
+static uint8_t ReferencePixel(const std::shared_ptr<const Image> &src, uint32_t factor, int32_t x, int32_t y, int32_t c)
+{
+    int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(src->Format()) / 8);
+    uint32_t sum = 0;
+
+    for (uint32_t ky = 0; ky < factor; ky++)
+    {
+        const uint8_t *row = src->Data() + (y * factor + ky) * src->Stride();
+        for (uint32_t kx = 0; kx < factor; kx++)
+        {
+            sum += row[(x * factor + kx) * pixelSize + c];
+        }
+    }
+    return static_cast<uint8_t>((sum + factor * factor / 2) / (factor * factor));
+}
+
+/* SIMD行缓冲区实现与逐块求和的结果完全相同，包括裁剪视图和被丢弃的边缘 */
+void TestDownscale(PixelFormat format, uint32_t factor, bool view)
+{
+    std::shared_ptr<Image> image = Image::Allocate(101, 67, format);
+    FillImage(image);
+    std::shared_ptr<const Image> src = image;
+    if (view)
+    {
+        src = Image::CreateView(image, 5, 3, 90, 61);
+    }
+
+    int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(format) / 8);
+    std::shared_ptr<Image> dst = Image::Allocate(ImageScaler::ScaledSize(src->Width(), factor),
+                                                 ImageScaler::ScaledSize(src->Height(), factor), format);
+    Check(ImageScaler::Downscale(src, dst, factor) == Error::Success, "downscale");
+
+    bool same = true;
+    for (int32_t y = 0; y < dst->Height(); y++)
+    {
+        for (int32_t x = 0; x < dst->Width(); x++)
+        {
+            for (int32_t c = 0; c < pixelSize; c++)
+            {
+                same = same && (dst->Data()[y * dst->Stride() + x * pixelSize + c] == ReferencePixel(src, factor, x, y, c));
+            }
+        }
+    }
+    Check(same, "downscale matches block average");
+}
+
+/* 双线性缩放：纯色保持不变，水平渐变缩放后仍然是单调的，中心对齐 */
+void TestResize(PixelFormat format)
+{
+    int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(format) / 8);
+    std::shared_ptr<Image> src = Image::Allocate(100, 40, format);
+    std::shared_ptr<Image> dst = Image::Allocate(37, 23, format);
+    std::shared_ptr<Image> up = Image::Allocate(250, 90, format);
+
+    memset(src->Data(), 77, src->Size());
+    Check(ImageScaler::Resize(src, dst) == Error::Success, "resize solid");
+    bool solid = true;
+    for (int32_t y = 0; y < dst->Height(); y++)
+    {
+        for (int32_t x = 0; x < dst->Width() * pixelSize; x++)
+        {
+            solid = solid && (dst->Data()[y * dst->Stride() + x] == 77);
+        }
+    }
+    Check(solid, "solid color unchanged");
+
+    for (int32_t y = 0; y < src->Height(); y++)
+    {
+        for (int32_t x = 0; x < src->Width(); x++)
+        {
+            memset(src->Data() + y * src->Stride() + x * pixelSize, x * 2 + 20, pixelSize);
+        }
+    }
+    Check(ImageScaler::Resize(src, dst) == Error::Success, "resize gradient");
+    Check(ImageScaler::Resize(src, up) == Error::Success, "upscale gradient");
+    bool monotonic = true;
+    for (int32_t y = 0; y < dst->Height(); y++)
+    {
+        const uint8_t *row = dst->Data() + y * dst->Stride();
+        for (int32_t x = 1; x < dst->Width(); x++)
+        {
+            monotonic = monotonic && (row[x * pixelSize] >= row[(x - 1) * pixelSize]);
+        }
+    }
+    Check(monotonic, "gradient stays monotonic");
+    // 目标像素中心 (x + 0.5) * 100 / 37 - 0.5，对应的源值为 2 * position + 20
+    int expected = static_cast<int>((18 + 0.5) * 100 / 37 - 0.5) * 2 + 20;
+    Check(abs(dst->Data()[5 * dst->Stride() + 18 * pixelSize] - expected) <= 2, "center aligned sample");
+    Check(up->Data()[0] == 20, "left edge clamped");
+    Check(up->Data()[(up->Width() - 1) * pixelSize] == 218, "right edge clamped");
+}
+
+/* 填充4:2:0图像的色度平面，U为u，V为v */
+static void FillChroma(const std::shared_ptr<Image> &image, uint8_t u, uint8_t v)
+{
+    for (int32_t y = 0; y < (image->Height() + 1) / 2; y++)
+    {
+        for (int32_t x = 0; x < (image->Width() + 1) / 2; x++)
+        {
+            if (image->Format() == PixelFormat::NV12)
+            {
+                image->Plane(1)[y * image->PlaneStride(1) + x * 2] = u;
+                image->Plane(1)[y * image->PlaneStride(1) + x * 2 + 1] = v;
+            }
+            else
+            {
+                image->Plane(1)[y * image->PlaneStride(1) + x] = u;
+                image->Plane(2)[y * image->PlaneStride(2) + x] = v;
+            }
+        }
+    }
+}
+
+/* 检查色度平面的每个值 */
+static bool ChromaEquals(const std::shared_ptr<const Image> &image, uint8_t u, uint8_t v)
+{
+    bool same = true;
+    for (int32_t y = 0; y < (image->Height() + 1) / 2; y++)
+    {
+        for (int32_t x = 0; x < (image->Width() + 1) / 2; x++)
+        {
+            if (image->Format() == PixelFormat::NV12)
+            {
+                same = same && (image->Plane(1)[y * image->PlaneStride(1) + x * 2] == u) &&
+                       (image->Plane(1)[y * image->PlaneStride(1) + x * 2 + 1] == v);
+            }
+            else
+            {
+                same = same && (image->Plane(1)[y * image->PlaneStride(1) + x] == u) &&
+                       (image->Plane(2)[y * image->PlaneStride(2) + x] == v);
+            }
+        }
+    }
+    return same;
+}
+
+/* NV12/I420：Y平面与灰度图相同，色度平面分别缩放，U、V不会混合 */
+void TestPlanar(PixelFormat format)
+{
+    std::shared_ptr<Image> image = Image::Allocate(101, 67, format);
+    std::shared_ptr<Image> gray = Image::Allocate(101, 67, PixelFormat::Grayscale8);
+    FillImage(gray);
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        memcpy(image->Data() + y * image->Stride(), gray->Data() + y * gray->Stride(), image->Width());
+    }
+    FillChroma(image, 90, 200);
+
+    uint32_t factors[] = {2, 4};
+    for (uint32_t factor : factors)
+    {
+        std::shared_ptr<Image> dst = Image::Allocate(ImageScaler::ScaledSize(101, factor), ImageScaler::ScaledSize(67, factor), format);
+        std::shared_ptr<Image> reference = Image::Allocate(dst->Width(), dst->Height(), PixelFormat::Grayscale8);
+        Check(ImageScaler::Downscale(image, dst, factor) == Error::Success, "planar downscale");
+        Check(ImageScaler::Downscale(gray, reference, factor) == Error::Success, "gray downscale");
+        bool same = true;
+        for (int32_t y = 0; y < dst->Height(); y++)
+        {
+            same = same && (memcmp(dst->Data() + y * dst->Stride(), reference->Data() + y * reference->Stride(), dst->Width()) == 0);
+        }
+        Check(same, "planar luma matches gray downscale");
+        Check(ChromaEquals(dst, 90, 200), "planar chroma downscaled per plane");
+    }
+
+    std::shared_ptr<Image> resized = Image::Allocate(37, 23, format);
+    Check(ImageScaler::Resize(image, resized) == Error::Success, "planar resize");
+    Check(ChromaEquals(resized, 90, 200), "planar chroma resized per plane");
+
+    std::shared_ptr<const Image> view = Image::CreateView(image, 10, 6, 40, 30);
+    Check(!Image::CreateView(image, 3, 6, 40, 30), "planar odd x");
+    Check(!Image::CreateView(image, 10, 5, 40, 30), "planar odd y");
+    Check((view) && (view->Plane(1) == image->Plane(1) + 3 * image->PlaneStride(1) + ((format == PixelFormat::NV12) ? 10 : 5)),
+          "planar view offsets chroma");
+    std::shared_ptr<Image> copy = Image::Allocate(40, 30, format);
+    Check((view) && (view->CopyData(copy) == Error::Success) && ChromaEquals(copy, 90, 200) &&
+              (copy->Data()[0] == image->Data()[6 * image->Stride() + 10]),
+          "planar view copies every plane");
+}
+
+/* 裁剪视图共享父图像的内存，父图像释放之后仍然有效 */
+void TestView()
+{
+    std::shared_ptr<Image> image = Image::Allocate(64, 48, PixelFormat::RGB24);
+    FillImage(image);
+    struct timeval stamp;
+    stamp.tv_sec = 12;
+    stamp.tv_usec = 34;
+    image->UpdateTimeStamp(stamp);
+    image->SetFrameId(99);
+
+    std::shared_ptr<const Image> view = Image::CreateView(image, 10, 20, 30, 28);
+    Check(view != nullptr, "create view");
+    Check(view->Data() == image->Data() + 20 * image->Stride() + 30, "view shares memory");
+    Check((view->Width() == 30) && (view->Height() == 28) && (view->Stride() == image->Stride()), "view size");
+    Check(view->Size() == 27 * image->Stride() + 90, "view size ends at last pixel");
+    Check((view->TimeStamp().tv_sec == 12) && (view->FrameId() == 99), "view keeps timestamp");
+
+    std::shared_ptr<const Image> nested = Image::CreateView(view, 2, 1, 4, 4);
+    Check((nested) && (nested->Data() == view->Data() + view->Stride() + 6), "nested view");
+
+    uint8_t first = image->Data()[20 * image->Stride() + 30];
+    image.reset();
+    Check(view->Data()[0] == first, "view keeps parent alive");
+
+    std::shared_ptr<Image> parent = Image::Allocate(64, 48, PixelFormat::YUYV);
+    Check(!Image::CreateView(parent, 1, 0, 8, 8), "yuyv odd x");
+    Check(Image::CreateView(parent, 2, 0, 8, 8) != nullptr, "yuyv even x");
+    Check(!Image::CreateView(parent, 60, 0, 8, 8), "view outside image");
+    Check(!Image::CreateView(parent, 0, 0, 0, 8), "empty view");
+    Check(!Image::CreateView(nullptr, 0, 0, 8, 8), "view without parent");
+}
+
+void TestParameters()
+{
+    std::shared_ptr<Image> src = Image::Allocate(64, 48, PixelFormat::RGB24);
+    std::shared_ptr<Image> gray = Image::Allocate(32, 24, PixelFormat::Grayscale8);
+    std::shared_ptr<Image> yuyv = Image::Allocate(64, 48, PixelFormat::YUYV);
+    std::shared_ptr<Image> small = Image::Allocate(20, 20, PixelFormat::YUYV);
+
+    Check(ImageScaler::Downscale(src, gray, 2) == Error::ImageParametersMismatch, "downscale format mismatch");
+    Check(ImageScaler::Resize(src, gray) == Error::ImageParametersMismatch, "resize format mismatch");
+    Check(ImageScaler::Resize(yuyv, small) == Error::UnsupportedPixelFormat, "resize yuyv");
+    Check(ImageScaler::Resize(nullptr, gray) == Error::NullPointer, "resize null");
+    Check(ImageScaler::BoxFactor(1920, 1080, 320, 180) == 4, "box factor");
+    Check(ImageScaler::BoxFactor(1280, 720, 500, 281) == 2, "box factor remainder");
+    Check(ImageScaler::BoxFactor(640, 480, 400, 300) == 1, "box factor small ratio");
+    Check(ImageScaler::BoxFactor(640, 480, 100, 400) == 1, "box factor limited by height");
+}
+
+int main()
+{
+    PixelFormat formats[] = {PixelFormat::Grayscale8, PixelFormat::RGB24, PixelFormat::RGBA32};
+    uint32_t factors[] = {2, 3, 4, 5, 17};
+
+    for (PixelFormat format : formats)
+    {
+        for (uint32_t factor : factors)
+        {
+            TestDownscale(format, factor, false);
+            TestDownscale(format, factor, true);
+        }
+        TestResize(format);
+    }
+    TestPlanar(PixelFormat::NV12);
+    TestPlanar(PixelFormat::I420);
+    TestView();
+    TestParameters();
+
+    return TestResult();
+}
@@ -0,0 +1,148 @@
+#include "jpeg_decoder.h"
+#include "jpeg_encoder.h"
+#include "image_scaler.h"
+#include "image_pool.h"
+#include "test_check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace MY_NAME_SPACE;
+
+/* 平滑的彩色渐变，压缩误差较小 */
+static std::shared_ptr<Image> GradientImage(int32_t width, int32_t height)
+{
+    std::shared_ptr<Image> image = Image::Allocate(width, height, PixelFormat::RGB24);
+    for (int32_t y = 0; y < height; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < width; x++)
+        {
+            row[x * 3] = static_cast<uint8_t>(x * 255 / width);
+            row[x * 3 + 1] = static_cast<uint8_t>(y * 255 / height);
+            row[x * 3 + 2] = 128;
+        }
+    }
+    return image;
+}
+
+/* 两张相同尺寸图像的平均绝对误差 */
+static double MeanDifference(const std::shared_ptr<const Image> &a, const std::shared_ptr<const Image> &b)
+{
+    int32_t lineSize = a->Width() * static_cast<int32_t>(ImageBitsPerPixel(a->Format()) / 8);
+    uint64_t sum = 0;
+
+    for (int32_t y = 0; y < a->Height(); y++)
+    {
+        const uint8_t *rowA = a->Data() + y * a->Stride();
+        const uint8_t *rowB = b->Data() + y * b->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            sum += static_cast<uint64_t>(abs(rowA[x] - rowB[x]));
+        }
+    }
+    return static_cast<double>(sum) / (static_cast<double>(lineSize) * a->Height());
+}
+
+/* 缩小解码的尺寸向上取整，内容与先完整解码再均值缩小接近 */
+void TestScaledDecode()
+{
+    ImagePool pool(8);
+    JpegEncoder encoder(95);
+    std::shared_ptr<Image> original = GradientImage(203, 117);
+    std::shared_ptr<EncodedFrame> frame;
+    Check(encoder.EncodeToFrame(original, pool, frame) == Error::Success, "encode");
+
+    const uint32_t scales[] = {1, 2, 4, 8};
+    for (uint32_t scale : scales)
+    {
+        JpegDecoder decoder(scale);
+        std::shared_ptr<Image> decoded;
+        Check(decoder.Scale() == scale, "scale");
+        Check(decoder.DecodeFromMemory(frame->Data(), frame->Size(), pool, decoded) == Error::Success, "scaled decode");
+        Check((decoded->Width() == JpegDecoder::ScaledSize(203, scale)) && (decoded->Height() == JpegDecoder::ScaledSize(117, scale)),
+              "scaled size rounds up");
+        Check(decoded->Format() == PixelFormat::RGB24, "rgb output");
+
+        // 参考图像只比较能够整除的部分
+        int32_t width = 203 / static_cast<int32_t>(scale);
+        int32_t height = 117 / static_cast<int32_t>(scale);
+        std::shared_ptr<Image> reference = Image::Allocate(width, height, PixelFormat::RGB24);
+        Check(ImageScaler::Downscale(original, reference, scale) == Error::Success, "reference downscale");
+        std::shared_ptr<const Image> view = Image::CreateView(decoded, 0, 0, width, height);
+        Check(MeanDifference(view, reference) < 4.0, "scaled decode close to reference");
+    }
+
+    JpegDecoder faster(4, true);
+    std::shared_ptr<Image> decoded;
+    Check(faster.DecodeFromMemory(frame->Data(), frame->Size(), pool, decoded) == Error::Success, "faster decode");
+    Check(decoded->Width() == 51, "faster decode size");
+}
+
+/* 灰度输出、解码对象复用以及损坏数据之后的恢复 */
+void TestReuse()
+{
+    ImagePool pool(8);
+    JpegEncoder encoder(90);
+    std::shared_ptr<EncodedFrame> frame;
+    Check(encoder.EncodeToFrame(GradientImage(64, 48), pool, frame) == Error::Success, "encode");
+
+    JpegDecoder decoder(2);
+    std::shared_ptr<Image> image;
+    Check(decoder.DecodeFromMemory(frame->Data(), frame->Size(), pool, image) == Error::Success, "first decode");
+    uint8_t *data = image->Data();
+    Check(decoder.DecodeFromMemory(frame->Data(), frame->Size(), pool, image) == Error::Success, "second decode");
+    Check(image->Data() == data, "same size decodes in place");
+
+    decoder.SetOutputFormat(PixelFormat::Grayscale8);
+    Check(decoder.DecodeFromMemory(frame->Data(), frame->Size(), pool, image) == Error::Success, "gray decode");
+    Check((image->Format() == PixelFormat::Grayscale8) && (image->Width() == 32), "gray output");
+    decoder.SetOutputFormat(PixelFormat::YUYV);
+    Check(decoder.OutputFormat() == PixelFormat::Unknown, "unsupported output format");
+
+    std::vector<uint8_t> corrupt(frame->Data(), frame->Data() + frame->Size() / 3);
+    std::shared_ptr<Image> broken;
+    Check(decoder.DecodeFromMemory(&corrupt[0], 16, pool, broken) == Error::FailedImageDecoding, "truncated header");
+    memset(&corrupt[0] + 2, 0x00, 4);
+    Check(decoder.DecodeFromMemory(&corrupt[0], static_cast<uint32_t>(corrupt.size()), pool, broken) == Error::FailedImageDecoding,
+          "corrupt markers");
+    Check(decoder.DecodeFromMemory(frame->Data(), frame->Size(), pool, image) == Error::Success, "decode after failure");
+    Check(decoder.DecodeFromMemory(nullptr, 0, pool, image) == Error::NullPointer, "null data");
+}
+
+/* 读取尺寸和压缩帧的时间戳 */
+void TestFrame()
+{
+    ImagePool pool(8);
+    JpegEncoder encoder(90);
+    std::shared_ptr<EncodedFrame> frame;
+    Check(encoder.EncodeToFrame(GradientImage(320, 180), pool, frame) == Error::Success, "encode");
+    struct timeval stamp;
+    stamp.tv_sec = 56;
+    stamp.tv_usec = 78;
+    frame->SetTimeStamp(stamp);
+    frame->SetSequence(42);
+
+    int32_t width = 0;
+    int32_t height = 0;
+    Check(JpegDecoder::ReadSize(frame->Data(), frame->Size(), &width, &height) == Error::Success, "read size");
+    Check((width == 320) && (height == 180), "header size");
+    Check(JpegDecoder::ReadSize(frame->Data() + 1, frame->Size() - 1, &width, &height) == Error::FailedImageDecoding, "missing SOI");
+
+    JpegDecoder decoder(8);
+    std::shared_ptr<Image> image;
+    Check(decoder.DecodeFrame(frame, pool, image) == Error::Success, "decode frame");
+    Check((image->Width() == 40) && (image->Height() == 23), "frame size");
+    Check((image->TimeStamp().tv_sec == 56) && (image->TimeStamp().tv_usec == 78) && (image->FrameId() == 42), "frame keeps timestamp");
+}
+
+int main()
+{
+    TestScaledDecode();
+    TestReuse();
+    TestFrame();
+
+    return TestResult();
+}
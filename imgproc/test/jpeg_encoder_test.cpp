@@ -0,0 +1,238 @@
+#include "jpeg_encoder.h"
+#include "jpeg_decoder.h"
+#include "image_converter.h"
+#include "image_pool.h"
+#include "test_check.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace MY_NAME_SPACE;
+
+static std::shared_ptr<Image> TestImage(int32_t width, int32_t height, PixelFormat format)
+{
+    std::shared_ptr<Image> image = Image::Allocate(width, height, format);
+    int32_t lineSize = width * static_cast<int32_t>(ImageBitsPerPixel(format) / 8);
+    for (int32_t y = 0; y < height; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            row[x] = static_cast<uint8_t>(x * 7 + y * 3);
+        }
+    }
+    return image;
+}
+
+/* 新建编码器的结果作为参考 */
+static std::shared_ptr<EncodedFrame> Reference(const std::shared_ptr<const Image> &image, uint16_t quality, uint16_t restartRows)
+{
+    ImagePool pool(4);
+    JpegEncoder encoder(quality);
+    std::shared_ptr<EncodedFrame> frame;
+    encoder.SetRestartRows(restartRows);
+    encoder.EncodeToFrame(image, pool, frame);
+    return frame;
+}
+
+static bool SameFrame(const std::shared_ptr<const EncodedFrame> &a, const std::shared_ptr<const EncodedFrame> &b)
+{
+    return (a) && (b) && (a->Size() == b->Size()) && (memcmp(a->Data(), b->Data(), a->Size()) == 0);
+}
+
+/* 复用编码参数和缓存的量化表之后，输出与新建的编码器完全相同 */
+void TestReuse()
+{
+    ImagePool pool(8);
+    JpegEncoder encoder(80);
+    std::shared_ptr<Image> rgb = TestImage(96, 64, PixelFormat::RGB24);
+    std::shared_ptr<Image> gray = TestImage(50, 30, PixelFormat::Grayscale8);
+    const uint16_t qualities[] = {80, 40, 95, 40, 80};
+
+    for (uint16_t quality : qualities)
+    {
+        std::shared_ptr<EncodedFrame> frame;
+        encoder.SetQuality(quality);
+        Check(encoder.EncodeToFrame(rgb, pool, frame) == Error::Success, "encode rgb");
+        Check(SameFrame(frame, Reference(rgb, quality, 0)), "cached quality tables");
+    }
+
+    std::shared_ptr<EncodedFrame> frame;
+    encoder.SetRestartRows(1);
+    Check(encoder.EncodeToFrame(gray, pool, frame) == Error::Success, "encode gray");
+    Check(SameFrame(frame, Reference(gray, 80, 1)), "format and size change");
+    encoder.SetRestartRows(0);
+    frame.reset();
+    Check(encoder.EncodeToFrame(gray, pool, frame) == Error::Success, "encode without restart");
+    Check(SameFrame(frame, Reference(gray, 80, 0)), "restart interval cleared");
+
+    std::shared_ptr<Image> yuyv = Image::Allocate(16, 16, PixelFormat::YUYV);
+    frame.reset();
+    Check(encoder.EncodeToFrame(yuyv, pool, frame) == Error::UnsupportedPixelFormat, "unsupported format");
+    frame.reset();
+    Check(encoder.EncodeToFrame(rgb, pool, frame) == Error::Success, "encode after error");
+    Check(SameFrame(frame, Reference(rgb, 80, 0)), "same output after error");
+}
+
+/* 调用者的缓冲区不足时使用realloc扩大 */
+void TestMemory()
+{
+    JpegEncoder encoder(90);
+    std::shared_ptr<Image> rgb = TestImage(96, 64, PixelFormat::RGB24);
+    std::shared_ptr<EncodedFrame> reference = Reference(rgb, 90, 0);
+    uint32_t size = 16;
+    uint8_t *buffer = static_cast<uint8_t *>(malloc(size));
+
+    Check(encoder.EncodeToMemory(rgb, &buffer, &size) == Error::Success, "encode to small buffer");
+    Check((size == reference->Size()) && (memcmp(buffer, reference->Data(), size) == 0), "grown buffer holds image");
+    Check(encoder.EncodeToMemory(rgb, &buffer, &size) == Error::Success, "encode again");
+    Check(size == reference->Size(), "same size");
+    free(buffer);
+}
+
+/* 带有噪声的图像，noise 越大压缩之后越大 */
+static std::shared_ptr<Image> NoisyImage(int32_t width, int32_t height, uint32_t noise)
+{
+    std::shared_ptr<Image> image = Image::Allocate(width, height, PixelFormat::RGB24);
+    uint32_t seed = 7;
+    for (int32_t y = 0; y < height; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < width * 3; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            row[x] = static_cast<uint8_t>(x / 3 + y + ((seed >> 16) % noise));
+        }
+    }
+    return image;
+}
+
+/* 码率控制：收敛到目标大小附近，每帧的质量变化不超过限制；画面变简单之后质量逐步升高 */
+void TestRateControl()
+{
+    ImagePool pool(8);
+    JpegEncoder encoder(85);
+    std::shared_ptr<Image> busy = NoisyImage(320, 240, 64);
+    std::shared_ptr<Image> flat = NoisyImage(320, 240, 2);
+    std::shared_ptr<EncodedFrame> frame;
+
+    Check(encoder.EncodeToFrame(busy, pool, frame) == Error::Success, "fixed quality encode");
+    uint32_t target = frame->Size() / 3;
+    JpegRateControl control;
+    control.TargetBytes = target;
+    control.MinQuality = 10;
+    control.MaxQuality = 90;
+    control.MaxStep = 8;
+    encoder.SetRateControl(control);
+    Check(encoder.RateControl().TargetBytes == target, "rate control set");
+
+    uint16_t previous = encoder.Quality();
+    bool limited = true;
+    for (int i = 0; i < 30; i++)
+    {
+        frame.reset();
+        Check(encoder.EncodeToFrame(busy, pool, frame) == Error::Success, "rate controlled encode");
+        limited = limited && (abs(static_cast<int>(encoder.Quality()) - static_cast<int>(previous)) <= 8);
+        previous = encoder.Quality();
+    }
+    Check(limited, "quality step limited");
+    Check(encoder.Quality() < 85, "quality lowered");
+    Check((frame->Size() > target * 8 / 10) && (frame->Size() < target * 12 / 10), "size converges to target");
+
+    for (int i = 0; i < 30; i++)
+    {
+        frame.reset();
+        Check(encoder.EncodeToFrame(flat, pool, frame) == Error::Success, "flat encode");
+    }
+    Check(encoder.Quality() == 90, "flat scene uses max quality");
+    Check(frame->Size() <= target, "flat scene within target");
+
+    control.MinQuality = 0;
+    control.MaxQuality = 200;
+    control.MaxStep = 0;
+    encoder.SetRateControl(control);
+    Check((encoder.RateControl().MinQuality == 1) && (encoder.RateControl().MaxQuality == 100) && (encoder.RateControl().MaxStep == 1),
+          "rate control limits");
+}
+
+/* 可用时TurboJPEG的结果可以正常解码，不可用时设置失败 */
+void TestBackend()
+{
+    JpegEncoder encoder(85);
+    Check(encoder.Backend() == JpegBackend::LibJpeg, "default backend");
+    if (!JpegEncoder::IsBackendAvailable(JpegBackend::TurboJpeg))
+    {
+        Check(encoder.SetBackend(JpegBackend::TurboJpeg) == Error::ConfigurationNotSupported, "turbojpeg unavailable");
+        Check(encoder.Backend() == JpegBackend::LibJpeg, "backend unchanged");
+        return;
+    }
+
+    ImagePool pool(8);
+    std::shared_ptr<Image> rgb = TestImage(97, 61, PixelFormat::RGB24);
+    std::shared_ptr<EncodedFrame> frame;
+    Check(encoder.SetBackend(JpegBackend::TurboJpeg) == Error::Success, "turbojpeg backend");
+    Check(encoder.EncodeToFrame(rgb, pool, frame) == Error::Success, "turbojpeg encode");
+    JpegDecoder decoder;
+    std::shared_ptr<Image> decoded;
+    Check(decoder.DecodeFrame(frame, pool, decoded) == Error::Success, "turbojpeg decode");
+    Check((decoded->Width() == 97) && (decoded->Height() == 61), "turbojpeg size");
+}
+
+/* 4:2:0图像直接作为原始数据编码，宽度不是8的倍数时使用填充的行；NV12与I420的色度相同时输出相同 */
+void TestPlanar()
+{
+    ImagePool pool(8);
+    JpegEncoder encoder(95);
+    std::shared_ptr<Image> i420 = Image::Allocate(100, 75, PixelFormat::I420);
+    std::shared_ptr<Image> nv12 = Image::Allocate(100, 75, PixelFormat::NV12);
+    std::shared_ptr<Image> rgb = Image::Allocate(100, 75, PixelFormat::RGB24);
+    for (int32_t y = 0; y < 75; y++)
+    {
+        for (int32_t x = 0; x < 100; x++)
+        {
+            i420->Data()[y * i420->Stride() + x] = static_cast<uint8_t>(40 + x + y);
+        }
+    }
+    for (int32_t y = 0; y < 38; y++)
+    {
+        for (int32_t x = 0; x < 50; x++)
+        {
+            i420->Plane(1)[y * i420->PlaneStride(1) + x] = static_cast<uint8_t>(100 + x / 2);
+            i420->Plane(2)[y * i420->PlaneStride(2) + x] = static_cast<uint8_t>(150 - y / 2);
+        }
+    }
+    Check(ImageConverter::Convert(i420, nv12) == Error::Success, "i420 to nv12");
+    Check(ImageConverter::Convert(i420, rgb) == Error::Success, "i420 to rgb");
+
+    std::shared_ptr<EncodedFrame> planar, semiPlanar;
+    Check(encoder.EncodeToFrame(i420, pool, planar) == Error::Success, "encode i420");
+    Check(encoder.EncodeToFrame(nv12, pool, semiPlanar) == Error::Success, "encode nv12");
+    Check(SameFrame(planar, semiPlanar), "nv12 and i420 encode the same");
+    Check(SameFrame(planar, Reference(i420, 95, 0)), "raw data encoder reused");
+
+    JpegDecoder decoder;
+    std::shared_ptr<Image> decoded;
+    Check(decoder.DecodeFrame(planar, pool, decoded) == Error::Success, "decode i420 jpeg");
+    Check((decoded->Width() == 100) && (decoded->Height() == 75), "i420 jpeg size");
+    uint64_t difference = 0;
+    for (int32_t y = 0; y < 75; y++)
+    {
+        for (int32_t x = 0; x < 300; x++)
+        {
+            difference += abs(decoded->Data()[y * decoded->Stride() + x] - rgb->Data()[y * rgb->Stride() + x]);
+        }
+    }
+    Check(difference / (75 * 300) <= 3, "i420 jpeg matches rgb conversion");
+}
+
+int main()
+{
+    TestReuse();
+    TestMemory();
+    TestRateControl();
+    TestBackend();
+    TestPlanar();
+
+    return TestResult();
+}
@@ -0,0 +1,196 @@
+#include "jpeg_overlay.h"
+#include "jpeg_encoder.h"
+#include "image_drawer.h"
+#include "image_pool.h"
+#include "test_check.h"
+
+#include <iostream>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+using namespace MY_NAME_SPACE;
+
+struct TestErrorManager
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void TestErrorExit(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<TestErrorManager *>(cinfo->err)->jump, 1);
+}
+
+/* 解码压缩帧，warnings 返回libjpeg的警告个数(重启标记错误、数据损坏等) */
+static std::shared_ptr<Image> Decode(const std::shared_ptr<const EncodedFrame> &frame, PixelFormat format, long *warnings)
+{
+    struct jpeg_decompress_struct dinfo;
+    TestErrorManager jerr;
+    std::shared_ptr<Image> image;
+
+    dinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = TestErrorExit;
+    jerr.pub.output_message = [](j_common_ptr) {};
+    jpeg_create_decompress(&dinfo);
+    if (setjmp(jerr.jump) == 0)
+    {
+        jpeg_mem_src(&dinfo, frame->Data(), frame->Size());
+        jpeg_read_header(&dinfo, TRUE);
+        dinfo.out_color_space = (format == PixelFormat::Grayscale8) ? JCS_GRAYSCALE : JCS_RGB;
+        jpeg_start_decompress(&dinfo);
+        image = Image::Allocate(dinfo.output_width, dinfo.output_height, format);
+        while (dinfo.output_scanline < dinfo.output_height)
+        {
+            JSAMPROW row = image->Data() + image->Stride() * dinfo.output_scanline;
+            jpeg_read_scanlines(&dinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&dinfo);
+    }
+    else
+    {
+        image.reset();
+    }
+    *warnings = jerr.pub.num_warnings;
+    jpeg_destroy_decompress(&dinfo);
+    return image;
+}
+
+/* 生成带有细节的测试图像 */
+static std::shared_ptr<Image> CreateImage(int32_t width, int32_t height, PixelFormat format)
+{
+    std::shared_ptr<Image> image = Image::Allocate(width, height, format);
+    int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(format) / 8);
+
+    for (int32_t y = 0; y < height; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < width * pixelSize; x++)
+        {
+            row[x] = static_cast<uint8_t>((x * 3 + y * 2 + ((x / 16 + y / 16) % 2) * 60) & 0xFF);
+        }
+    }
+    return image;
+}
+
+/* 两幅图像在 [top, bottom) 行内的平均差值 */
+static double MeanDifference(const std::shared_ptr<Image> &first, const std::shared_ptr<Image> &second, int32_t top, int32_t bottom,
+                             int32_t right)
+{
+    int32_t pixelSize = static_cast<int32_t>(ImageBitsPerPixel(first->Format()) / 8);
+    double sum = 0;
+    size_t count = 0;
+
+    for (int32_t y = top; y < bottom; y++)
+    {
+        const uint8_t *row1 = first->Data() + y * first->Stride();
+        const uint8_t *row2 = second->Data() + y * second->Stride();
+        for (int32_t x = 0; x < right * pixelSize; x++, count++)
+        {
+            sum += abs(static_cast<int>(row1[x]) - static_cast<int>(row2[x]));
+        }
+    }
+    return (count == 0) ? 0 : sum / count;
+}
+
+/* 局部重新编码：覆盖区域与先解码再绘制的结果接近，其余的行完全相同 */
+void TestPartial(PixelFormat format, uint16_t restartRows, int32_t y)
+{
+    ImagePool pool(4);
+    JpegEncoder encoder(80);
+    JpegOverlay overlay(80);
+    std::shared_ptr<Image> image = CreateImage(640, 480, format);
+    std::shared_ptr<EncodedFrame> source;
+    std::shared_ptr<EncodedFrame> output;
+    std::string text = "26/10/19 22:31:05 :: camera";
+    Argb color, background;
+    long warnings = 0;
+
+    color.argb = 0xFFFFFFFF;
+    background.argb = 0xFF000000;
+    encoder.SetRestartRows(restartRows);
+    encoder.EncodeToFrame(image, pool, source);
+    source->SetSequence(42);
+
+    Check(overlay.Apply(source, text, color, background, 8, y, pool, output) == Error::Success, "apply overlay");
+    Check(overlay.PartialFrames() == 1, "overlay is partial");
+    Check(overlay.FullFrames() == 0, "no full transcode");
+    Check((output) && (output->Sequence() == 42) && (output->IsKeyFrame()), "frame information is kept");
+    if (!output)
+    {
+        return;
+    }
+
+    std::shared_ptr<Image> original = Decode(source, format, &warnings);
+    std::shared_ptr<Image> decorated = Decode(output, format, &warnings);
+    Check((original) && (decorated) && (warnings == 0), "output decodes without warnings");
+    if ((!original) || (!decorated))
+    {
+        return;
+    }
+
+    // 4:2:0 的MCU为16行，色度上采样会影响相邻的一行MCU
+    int32_t segmentHeight = 16 * restartRows;
+    int32_t bandBottom = ((y + 12 + segmentHeight - 1) / segmentHeight) * segmentHeight;
+    double outside = MeanDifference(original, decorated, bandBottom + 16, 480, 640);
+    ImageDrawer::PutText(original, text, 8, y, color, background);
+    double inside = MeanDifference(original, decorated, y, y + 12, 8 + static_cast<int32_t>(text.size()) * 8 + 4);
+    std::cout << "format " << static_cast<int>(format) << " restart rows " << restartRows << ": " << source->Size() << " -> "
+              << output->Size() << " bytes, overlay difference " << inside << ", other rows " << outside << std::endl;
+    Check(outside == 0, "rows outside the band are unchanged");
+    Check(inside < 24, "overlay matches drawing on decoded image");
+}
+
+/* 没有重启标记时完整解码和编码 */
+void TestFull()
+{
+    ImagePool pool(4);
+    JpegEncoder encoder(80);
+    JpegOverlay overlay(80);
+    std::shared_ptr<EncodedFrame> source;
+    std::shared_ptr<EncodedFrame> output;
+    Argb color, background;
+    long warnings = 0;
+
+    color.argb = 0xFF000000;
+    background.argb = 0xFFFFFFFF;
+    encoder.EncodeToFrame(CreateImage(320, 240, PixelFormat::RGB24), pool, source);
+    Check(overlay.Apply(source, "full", color, background, 0, 0, pool, output) == Error::Success, "apply full overlay");
+    Check((overlay.FullFrames() == 1) && (overlay.PartialFrames() == 0), "overlay without restart markers is full");
+    Check((output) && (Decode(output, PixelFormat::RGB24, &warnings)) && (warnings == 0), "full output decodes");
+}
+
+/* 文字在图像之外、空文字和错误的编码格式 */
+void TestParameters()
+{
+    ImagePool pool(4);
+    JpegEncoder encoder(80);
+    JpegOverlay overlay(80);
+    std::shared_ptr<EncodedFrame> source;
+    std::shared_ptr<EncodedFrame> output;
+    Argb color, background;
+
+    color.argb = 0xFF000000;
+    background.argb = 0xFFFFFFFF;
+    encoder.EncodeToFrame(CreateImage(64, 64, PixelFormat::RGB24), pool, source);
+    Check(overlay.Apply(source, "outside", color, background, 0, 100, pool, output) == Error::Success, "apply outside");
+    Check((output) && (output->Size() == source->Size()), "outside overlay copies frame");
+    Check(overlay.Apply(source, "", color, background, 0, 0, pool, output) == Error::Success, "apply empty text");
+    Check((output) && (output->Size() == source->Size()), "empty text copies frame");
+    Check((overlay.FullFrames() == 0) && (overlay.PartialFrames() == 0), "nothing is encoded");
+    Check(overlay.Apply(nullptr, "x", color, background, 0, 0, pool, output) == Error::NullPointer, "null frame");
+
+    std::shared_ptr<EncodedFrame> unknown = pool.AcquireEncoded(16, FrameCodec::Unknown);
+    Check(overlay.Apply(unknown, "x", color, background, 0, 0, pool, output) == Error::UnsupportedPixelFormat, "unknown codec");
+}
+
+int main()
+{
+    TestPartial(PixelFormat::RGB24, 1, 0);
+    TestPartial(PixelFormat::RGB24, 2, 40);
+    TestPartial(PixelFormat::Grayscale8, 1, 4);
+    TestFull();
+    TestParameters();
+
+    return TestResult();
+}
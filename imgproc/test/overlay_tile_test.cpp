@@ -0,0 +1,190 @@
+#include "overlay_tile.h"
+#include "image_drawer.h"
+#include "image_pool.h"
+#include "test_check.h"
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace MY_NAME_SPACE;
+
+/* 生成渐变图像 */
+static void FillImage(const std::shared_ptr<Image> &image)
+{
+    int32_t lineSize = static_cast<int32_t>(image->Width() * ImageBitsPerPixel(image->Format()) / 8);
+
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            row[x] = static_cast<uint8_t>((x * 7 + y * 13) & 0xFF);
+        }
+    }
+}
+
+/* 返回两幅图像所有字节的最大差值 */
+static int MaxDifference(const std::shared_ptr<Image> &first, const std::shared_ptr<Image> &second)
+{
+    int32_t lineSize = static_cast<int32_t>(first->Width() * ImageBitsPerPixel(first->Format()) / 8);
+    int maxDiff = 0;
+
+    for (int32_t y = 0; y < first->Height(); y++)
+    {
+        const uint8_t *row1 = first->Data() + y * first->Stride();
+        const uint8_t *row2 = second->Data() + y * second->Stride();
+        for (int32_t x = 0; x < lineSize; x++)
+        {
+            int diff = abs(static_cast<int>(row1[x]) - static_cast<int>(row2[x]));
+            maxDiff = (diff > maxDiff) ? diff : maxDiff;
+        }
+    }
+    return maxDiff;
+}
+
+/* 与 PutText 的结果比较，整数混合和浮点混合最多相差1 */
+void TestMatchesPutText(PixelFormat format, uint32_t color, uint32_t background, int32_t x, int32_t y)
+{
+    ImagePool pool(4);
+    std::shared_ptr<Image> expected = pool.Acquire(100, 40, format);
+    std::shared_ptr<Image> actual = pool.Acquire(100, 40, format);
+    std::string text = "18/10/19 12:34:56";
+    Argb textColor, backgroundColor;
+    OverlayTile tile;
+
+    textColor.argb = color;
+    backgroundColor.argb = background;
+    FillImage(expected);
+    FillImage(actual);
+    ImageDrawer::PutText(expected, text, x, y, textColor, backgroundColor);
+    Check(tile.Render(text, textColor, backgroundColor, format) == Error::Success, "render tile");
+    Check(tile.Width() == static_cast<int32_t>(text.size()) * 8 + 4, "tile width includes border");
+    Check(tile.Height() == 12, "tile height includes border");
+    Check(tile.Blend(actual, x, y) == Error::Success, "blend tile");
+
+    int diff = MaxDifference(expected, actual);
+    std::cout << "format " << static_cast<int>(format) << " at (" << x << "," << y << ") max difference: " << diff << std::endl;
+    Check(diff <= 1, "blend matches PutText");
+}
+
+/* RGBA32 的alpha通道不改变 */
+void TestAlphaChannel()
+{
+    ImagePool pool(2);
+    std::shared_ptr<Image> image = pool.Acquire(64, 16, PixelFormat::RGBA32);
+    Argb color, background;
+    OverlayTile tile;
+
+    color.argb = 0xFFFF0000;
+    background.argb = 0x80FFFFFF;
+    FillImage(image);
+    tile.Render("ab", color, background, PixelFormat::RGBA32);
+    tile.Blend(image, 3, 2);
+
+    bool unchanged = true;
+    for (int32_t y = 0; y < image->Height(); y++)
+    {
+        for (int32_t x = 0; x < image->Width(); x++)
+        {
+            unchanged = unchanged && (image->Data()[y * image->Stride() + x * 4 + 3] == static_cast<uint8_t>((x * 4 * 7 + 21 + y * 13) & 0xFF));
+        }
+    }
+    Check(unchanged, "alpha channel is unchanged");
+}
+
+/* YUYV：不透明的白色文字和黑色背景，水平位置对齐到偶数 */
+void TestYuyv()
+{
+    ImagePool pool(2);
+    std::shared_ptr<Image> image = pool.Acquire(32, 16, PixelFormat::YUYV);
+    Argb color, background;
+    OverlayTile tile;
+
+    color.argb = 0xFFFFFFFF;
+    background.argb = 0xFF000000;
+    memset(image->Data(), 77, image->Stride() * image->Height());
+    Check(tile.Render("|", color, background, PixelFormat::YUYV) == Error::Success, "render yuyv");
+    Check(tile.Blend(image, 3, 0) == Error::Success, "blend yuyv");
+
+    // 从 x = 2 开始，边框为背景，'|' 的第4、5列为文字
+    const uint8_t *row = image->Data() + 4 * image->Stride();
+    Check((row[2] == 77) && (row[3] == 77), "pixels before the aligned position are unchanged");
+    Check((row[4] == 0) && (row[4 + 2] == 0), "border is black");
+    Check((row[(2 + 2 + 3) * 2] == 255) && (row[(2 + 2 + 4) * 2] == 255), "glyph is white");
+    Check((row[4 + 1] == 128) && (row[4 + 3] == 128), "chroma is neutral");
+    Check(row[(2 + 12) * 2] == 77, "pixels after the tile are unchanged");
+}
+
+/* NV12/I420：位置对齐到偶数，Y平面与YUYV相同，不透明的黑白图块色度为中性值 */
+void TestPlanar(PixelFormat format)
+{
+    ImagePool pool(2);
+    std::shared_ptr<Image> image = pool.Acquire(32, 16, format);
+    Argb color, background;
+    OverlayTile tile;
+
+    color.argb = 0xFFFFFFFF;
+    background.argb = 0xFF000000;
+    memset(image->Data(), 77, image->Stride() * ImageBufferRows(format, image->Height()));
+    Check(tile.Render("|", color, background, format) == Error::Success, "render planar");
+    Check(tile.Blend(image, 3, 1) == Error::Success, "blend planar");
+
+    // 从 (2, 0) 开始，边框为背景，'|' 的第4、5列为文字
+    const uint8_t *row = image->Data() + 4 * image->Stride();
+    Check(row[1] == 77, "luma before the aligned position is unchanged");
+    Check((row[2] == 0) && (row[3] == 0), "planar border is black");
+    Check((row[2 + 2 + 3] == 255) && (row[2 + 2 + 4] == 255), "planar glyph is white");
+    Check(row[2 + 12] == 77, "luma after the tile is unchanged");
+    Check(image->Data()[12 * image->Stride() + 2] == 77, "rows after the tile are unchanged");
+
+    int32_t step = (format == PixelFormat::NV12) ? 2 : 1;
+    const uint8_t *chroma = image->Plane(1) + 2 * image->PlaneStride(1);
+    Check((chroma[0] == 77) && (chroma[step] == 128) && (chroma[7 * step] == 77), "planar chroma is neutral inside the tile");
+    chroma = image->Plane((format == PixelFormat::NV12) ? 1 : 2) + 2 * image->PlaneStride(1) + ((format == PixelFormat::NV12) ? 1 : 0);
+    Check((chroma[step] == 128) && (chroma[7 * step] == 77), "second chroma component is neutral inside the tile");
+}
+
+/* 格式不匹配、重复渲染和完全在图像之外 */
+void TestParameters()
+{
+    ImagePool pool(2);
+    std::shared_ptr<Image> image = pool.Acquire(32, 32, PixelFormat::RGB24);
+    Argb color, background;
+    OverlayTile tile;
+
+    color.argb = 0xFF000000;
+    background.argb = 0xFFFFFFFF;
+    Check(tile.Render("x", color, background, PixelFormat::JPEG) == Error::UnsupportedPixelFormat, "unsupported format");
+    Check(tile.Render("x", color, background, PixelFormat::Grayscale8) == Error::Success, "render gray");
+    Check(tile.Blend(image, 0, 0) == Error::ImageParametersMismatch, "format mismatch");
+    Check(tile.Blend(nullptr, 0, 0) == Error::NullPointer, "null image");
+    Check(tile.Render("x", color, background, PixelFormat::RGB24) == Error::Success, "render rgb");
+    Check(tile.Blend(image, 40, 0) == Error::Success, "blend outside image");
+    Check(tile.Blend(image, -20, -20) == Error::Success, "blend before image");
+    Check(tile.Render("", color, background, PixelFormat::RGB24) == Error::Success, "render empty text");
+    Check(tile.Width() == 0, "empty text has no tile");
+    Check(tile.Blend(image, 0, 0) == Error::Success, "blend empty tile");
+}
+
+int main()
+{
+    PixelFormat formats[] = {PixelFormat::Grayscale8, PixelFormat::RGB24, PixelFormat::RGBA32};
+
+    for (PixelFormat format : formats)
+    {
+        TestMatchesPutText(format, 0xFF000000, 0xFFFFFFFF, 0, 0);
+        TestMatchesPutText(format, 0xC0FF8000, 0x60204080, 5, 7);
+        // 裁剪
+        TestMatchesPutText(format, 0xFFFFFFFF, 0x80000000, -11, -3);
+        TestMatchesPutText(format, 0x80FFFF00, 0xFF000000, 60, 33);
+    }
+    TestAlphaChannel();
+    TestYuyv();
+    TestPlanar(PixelFormat::NV12);
+    TestPlanar(PixelFormat::I420);
+    TestParameters();
+
+    return TestResult();
+}
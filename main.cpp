@@ -1,8 +1,7 @@
 #include <iostream>
 #include "base_error.h"
 #include "web_camera_server.h"
-#include "video_source_to_web.h"
-#include "v4l2_camera.h"
+#include "camera_manager.h"
 #include "web_camera_control_handler.h"
 #include <memory>
 using namespace std;
@@ -11,31 +10,55 @@ int main(int argc,char* argv[])
 {
 
     MyStreamer::Logger::setLogLevel(MyStreamer::Logger::INFO);
-    unsigned int camera_frame= 20;
-    /* 创建视频数据转换器 */
-    MyStreamer::VideoSourceToWeb video_web;
-    /* 创建摄像头 */
-    auto my_camera=MyStreamer::V4L2Camera::Create();
-    my_camera->SetVideoDeviceName("/dev/video0");
+    /* 所有摄像头共用的参数 */
+    MyStreamer::CameraManagerOptions options;
+    options.FrameRate = 20;
+    options.Width = 640;
+    options.Height = 480;
     //是否开启jpeg编码，开启的化，只能接收jpeg的摄像头视频源
-    my_camera->EnableJpegEncoding(false);
-    // 设置帧率
-    my_camera->SetFrameRate(camera_frame);
-    my_camera->SetVideoSize(640,480);
-    // 设置监听者
-    my_camera->SetListener(video_web.VideoSourceListener());
-    // 创建图片handler 
-    auto jpeg_handler = video_web.CreateJpegHandler("jpeg");
-    auto mjpeg_handler = video_web.CreateMjpegHandler("mjpeg",camera_frame);
+    options.JpegEncoding = false;
+    // 不使用jpeg时的采集格式，Unknown 时NV12/I420/灰度摄像头直接编码，YUYV摄像头转换为I420
+    options.OutputFormat = PixelFormat::Unknown;
     // 设置图片质量
-    video_web.SetJpegQuality(70);
+    options.JpegQuality = 70;
+    // 每个流的目标码率(bit/s)，不为0时按照码率逐帧调整质量，JpegQuality 作为初始质量
+    options.JpegBitrate = 0;
+    // 没有请求30秒之后暂停摄像头，设备保持打开，下一个请求到达时立即恢复
+    options.IdleSeconds = 30;
+    options.WarmStandby = true;
+    // 内存中保存最近30秒的编码帧，最多64MB；开启之后摄像头不会因为空闲而暂停
+    options.HistorySeconds = 0;
+    options.HistoryBytes = 64 * 1024 * 1024;
+    // 叠加时间戳，MJPEG摄像头带有重启标记时只重新编码时间戳所在的MCU行
+    options.TimestampOverlay = false;
+    // 设备能力(格式、尺寸、帧率)的缓存目录，重启之后已知的设备不再重新枚举
+    options.CapabilityCacheDirectory = "/tmp/mystreamer";
+    /* 创建摄像头管理，参数中指定设备时只使用这些设备，否则使用所有摄像头 */
+    MyStreamer::CameraManager cameras(options);
+    for (int i = 1; i < argc; i++)
+    {
+        cameras.AddDevice(argv[i]);
+    }
+    if ((cameras.Count() == 0) && (cameras.AddAllDevices() == 0))
+    {
+        cameras.AddDevice("/dev/video0");
+    }
     // 创建
     MyStreamer::WebCameraServer camera_server(string("web"),8000,"mystreamer",2);
-    my_camera->Start();
-    /* 添加图像服务 */
-    camera_server.AddHandler("/camera/jpeg",jpeg_handler);
-    camera_server.AddHandler("/camera/mjpeg",mjpeg_handler);
-    //camera_server.AddHandler("/camera/info",std::make_shared<MyStreamer::CameraInfoHandler>(my_camera,"/camera/info"));
+    cameras.Start();
+    /* 添加图像服务: /cameras 以及 /cameras/{id}/jpeg|mjpeg|ws|history|info */
+    cameras.RegisterHandlers(camera_server, "/cameras");
+    /* 兼容单摄像头的地址 */
+    MyStreamer::VideoSourceToWeb *video_web = cameras.Web(0);
+    camera_server.AddHandler("/camera/jpeg",video_web->CreateJpegHandler("/camera/jpeg"));
+    camera_server.AddHandler("/camera/mjpeg",video_web->CreateMjpegHandler("/camera/mjpeg",options.FrameRate));
+    camera_server.AddHandler("/camera/ws",video_web->CreateWebSocketHandler("/camera/ws",options.FrameRate));
+    camera_server.AddHandler("/camera/history",video_web->CreateFrameHistoryHandler("/camera/history"));
+    /* 运行指标 */
+    camera_server.AddHandler("/metrics",std::make_shared<MyStreamer::MetricsRequestHandler>("/metrics"));
+    /* 逐帧跟踪 */
+    camera_server.AddHandler("/debug/trace",std::make_shared<MyStreamer::TraceRequestHandler>("/debug/trace"));
+    camera_server.AddHandler("/camera/info",std::make_shared<MyStreamer::CameraInfoHandler>(cameras.Camera(0),"/camera/info"));
     camera_server.Start();
     return 0;
 }
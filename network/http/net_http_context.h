@@ -3,6 +3,7 @@
 
 #include "uncopyable.h"
 #include "net_http_request.h"
+#include "net_websocket.h"
 
 NAMESPACE_START
 
@@ -28,7 +29,9 @@ namespace net
         };
 
         HttpContext()
-            : state_(kExpectRequestLine)
+            : state_(kExpectRequestLine),
+              webSocketOpcode_(websocket::kContinuation),
+              webSocketClosed_(false)
         {
         }
 
@@ -59,11 +62,55 @@ namespace net
             return request_;
         }
 
+        /* 升级为WebSocket，之后收到的数据按照帧解析；reset 不会清除 */
+        void upgradeWebSocket(const websocket::MessageCallback &cb)
+        {
+            webSocketCallback_ = cb;
+        }
+
+        bool isWebSocket() const
+        {
+            return static_cast<bool>(webSocketCallback_);
+        }
+
+        const websocket::MessageCallback &webSocketCallback() const
+        {
+            return webSocketCallback_;
+        }
+
+        /* 分片消息的类型，kContinuation 表示没有未完成的消息 */
+        websocket::Opcode &webSocketOpcode()
+        {
+            return webSocketOpcode_;
+        }
+
+        /* 分片消息已经收到的数据 */
+        string &webSocketMessage()
+        {
+            return webSocketMessage_;
+        }
+
+        /* 已经收到或者发送关闭帧，之后的数据全部丢弃 */
+        bool webSocketClosed() const
+        {
+            return webSocketClosed_;
+        }
+
+        void setWebSocketClosed()
+        {
+            webSocketClosed_ = true;
+            webSocketMessage_.clear();
+        }
+
     private:
         bool processRequestLine(const char *begin, const char *end);
 
         HttpRequestParseState state_; /** 请求状态 */
         HttpRequest request_;         /** 请求解析 */
+        websocket::MessageCallback webSocketCallback_; /** 升级之后的消息回调 */
+        websocket::Opcode webSocketOpcode_;            /** 分片消息的类型 */
+        string webSocketMessage_;                      /** 分片消息的数据 */
+        bool webSocketClosed_;                         /** 是否已经关闭 */
     };
 
 } // namespace net
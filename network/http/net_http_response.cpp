@@ -9,12 +9,14 @@ using namespace MY_NAME_SPACE::net;
 
 /* map初始化 */
 HttpResponse::HttpStateMap HttpResponse::state_map = {
+    {HttpResponse::HttpStatusCode::k101SwitchingProtocols, "Switching Protocols"},
     {HttpResponse::HttpStatusCode::k200Ok, "OK"},
     {HttpResponse::HttpStatusCode::k400BadRequest, "400 Bad Request"},
     {HttpResponse::HttpStatusCode::k404NotFound, "404 Not Found"},
     {HttpResponse::HttpStatusCode::k405MethodNotAllowed, "405 Method Not Allowed"},
     {HttpResponse::HttpStatusCode::k301MovedPermanently, "301 Moved Permanently"},
     {HttpResponse::HttpStatusCode::k500ServerError, "500 Server Error"},
+    {HttpResponse::HttpStatusCode::k503ServiceUnavailable, "503 Service Unavailable"},
     {HttpResponse::HttpStatusCode::kUnknown, "Unkown error"},
 
 };
@@ -48,7 +50,12 @@ void HttpResponse::appendToBuffer(Buffer *output)
     output->append(statusMessage_);
     output->append("\r\n");
 
-    if (closeConnection_)
+    if (webSocketCallback_)
+    {
+        /* 升级之后连接保持打开 */
+        addHeader("Connection","Upgrade");
+    }
+    else if (closeConnection_)
     {
         addHeader("Connection","close");
     }
@@ -4,6 +4,7 @@
 #include "uncopyable.h"
 #include "base_types.h"
 #include "net_tcp_connection.h"
+#include "net_websocket.h"
 #include "logging.h"
 #include <map>
 #include <unordered_map>
@@ -23,12 +24,14 @@ namespace net
         enum HttpStatusCode
         {
             kUnknown = 0,
+            k101SwitchingProtocols = 101,
             k200Ok = 200,
             k301MovedPermanently = 301,
             k400BadRequest = 400,
             k404NotFound = 404,
             k405MethodNotAllowed = 405,
-            k500ServerError = 500
+            k500ServerError = 500,
+            k503ServiceUnavailable = 503
         };
         typedef std::unordered_map<int, string> HttpStateMap;
         /* 状态映射图 */
@@ -94,6 +97,15 @@ namespace net
         {
             return body_;
         };
+        /* 升级为WebSocket之后的消息回调，设置之后连接不再按照http解析，通过 websocket::accept 设置 */
+        void setWebSocketCallback(const websocket::MessageCallback &cb)
+        {
+            webSocketCallback_ = cb;
+        }
+        const websocket::MessageCallback &webSocketCallback() const
+        {
+            return webSocketCallback_;
+        }
         /* 添加到buffer中 */
         void appendToBuffer(Buffer *output);
         /* 添加快速发送函数 */
@@ -107,6 +119,7 @@ namespace net
         bool closeConnection_; /* 关闭连接 */
         string body_;          /* http主体信息 */
         string externalHeader_;/* 额外的header 信息，主要是为了mjpeg信息 */
+        websocket::MessageCallback webSocketCallback_; /* WebSocket消息回调 */
     };
 } // namespace net
 typedef net::HttpResponse WebResponse;
@@ -3,6 +3,8 @@
 #include "net_http_context.h"
 #include "net_http_request.h"
 #include "logging.h"
+#include "net_event_loop.h"
+#include "net_event_loop_threadpool.h"
 
 using namespace MY_NAME_SPACE;
 using namespace MY_NAME_SPACE::net;
@@ -42,11 +44,28 @@ HttpServer::HttpServer(EventLoop *loop,
     
 }
 
+HttpServer::~HttpServer()
+{
+    MetricsRegistry::Instance().RemoveCallbacks(this);
+}
+
 void HttpServer::start()
 {
     LOG_WARN << "HttpServer[" << server_.name()
              << "] starts listenning on " << server_.ipPort();
     server_.start();
+    /* 线程池启动之后才能获取所有的事件循环，按照编号区分 */
+    MetricsRegistry &registry = MetricsRegistry::Instance();
+    std::vector<EventLoop *> loops = server_.threadPool()->getAllLoops();
+    for (size_t i = 0; i < loops.size(); i++)
+    {
+        EventLoop *loop = loops[i];
+        std::string labels = MetricsRegistry::Label("server", server_.name()) + "," +
+                             MetricsRegistry::Label("loop", std::to_string(i));
+        connectionGauges_[loop] = registry.Gauge("http_connections", "Open HTTP connections per event loop", labels);
+        registry.AddCallback("event_loop_timers", "Timers queued in the event loop", labels,
+                             [loop]() { return static_cast<double>(loop->timerCount()); }, this);
+    }
 }
 void HttpServer::stop()
 {
@@ -57,11 +76,27 @@ void HttpServer::stop()
 /* 设置连接结构体 */
 void HttpServer::onConnection(const TcpConnectionPtr &conn)
 {
+    std::map<EventLoop *, MetricGauge *>::iterator gauge = connectionGauges_.find(conn->getLoop());
     /* 设置上下文 */
     if (conn->connected())
     {
         conn->setContext(HttpContext());
     }
+    else
+    {
+        /* 没有收到关闭帧就断开的WebSocket连接，同样通知处理函数 */
+        HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+        if ((context != nullptr) && context->isWebSocket() && !context->webSocketClosed())
+        {
+            context->setWebSocketClosed();
+            context->webSocketCallback()(conn, websocket::kClose, string());
+        }
+    }
+    /* 连接和断开都在连接所属的事件循环中回调 */
+    if (gauge != connectionGauges_.end())
+    {
+        gauge->second->Add(conn->connected() ? 1 : -1);
+    }
 }
 /* 设置连接响应函数 */
 void HttpServer::onMessage(const TcpConnectionPtr &conn,
@@ -70,6 +105,11 @@ void HttpServer::onMessage(const TcpConnectionPtr &conn,
 {
     /* 获取上下文 */
     HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    if (context->isWebSocket())
+    {
+        onWebSocketMessage(conn, context, buf);
+        return;
+    }
     /* 使用context解析连接 */
     if (!context->parseRequest(buf, receiveTime))
     {
@@ -82,6 +122,11 @@ void HttpServer::onMessage(const TcpConnectionPtr &conn,
         /* 调用请求处理函数 */
         onRequest(conn, context->request());
         context->reset();
+        /* 升级请求之后客户端可能已经发送了帧 */
+        if (context->isWebSocket() && (buf->readableBytes() > 0))
+        {
+            onWebSocketMessage(conn, context, buf);
+        }
     }
 }
 /* 请求回调函数 */
@@ -104,9 +149,94 @@ void HttpServer::onRequest(const TcpConnectionPtr &conn, const HttpRequest &req)
 
     /* 发送buffer */
     conn->send(&buf);
+    /* 处理函数接受了升级请求，之后按照WebSocket帧解析 */
+    if (response.webSocketCallback())
+    {
+        boost::any_cast<HttpContext>(conn->getMutableContext())->upgradeWebSocket(response.webSocketCallback());
+    }
     /* 检查是否需要关闭 */
-    if (response.closeConnection())
+    else if (response.closeConnection())
     {
         conn->shutdown();
     }
 }
+
+void HttpServer::onWebSocketMessage(const TcpConnectionPtr &conn, HttpContext *context, Buffer *buf)
+{
+    websocket::Frame frame;
+
+    while (!context->webSocketClosed())
+    {
+        websocket::ParseResult result = websocket::parseFrame(buf, websocket::kMaxMessageBytes, &frame);
+        if (result == websocket::kIncomplete)
+        {
+            return;
+        }
+        if (result == websocket::kBadFrame)
+        {
+            LOG_WARN << conn->name() << " bad websocket frame";
+            closeWebSocket(conn, context, websocket::kProtocolError);
+            break;
+        }
+
+        switch (frame.opcode)
+        {
+        case websocket::kPing:
+        {
+            Buffer pong;
+            websocket::appendFrame(&pong, websocket::kPong, frame.payload.data(), frame.payload.size());
+            conn->send(&pong);
+            break;
+        }
+        case websocket::kPong:
+            break;
+        case websocket::kClose:
+            /* 回复关闭帧 */
+            closeWebSocket(conn, context, websocket::kNormalClosure);
+            break;
+        default:
+        {
+            websocket::Opcode &opcode = context->webSocketOpcode();
+            string &message = context->webSocketMessage();
+            /* 新消息不能在分片消息结束之前开始，后续分片必须有开始的分片 */
+            if ((frame.opcode == websocket::kContinuation) == (opcode == websocket::kContinuation))
+            {
+                closeWebSocket(conn, context, websocket::kProtocolError);
+                break;
+            }
+            if (frame.opcode != websocket::kContinuation)
+            {
+                opcode = frame.opcode;
+            }
+            if (message.size() + frame.payload.size() > websocket::kMaxMessageBytes)
+            {
+                closeWebSocket(conn, context, websocket::kMessageTooBig);
+                break;
+            }
+            message += frame.payload;
+            if (frame.fin)
+            {
+                string complete;
+                complete.swap(message);
+                websocket::Opcode messageOpcode = opcode;
+                opcode = websocket::kContinuation;
+                context->webSocketCallback()(conn, messageOpcode, complete);
+            }
+            break;
+        }
+        }
+    }
+    /* 关闭之后的数据全部丢弃 */
+    buf->retrieveAll();
+}
+
+void HttpServer::closeWebSocket(const TcpConnectionPtr &conn, HttpContext *context, websocket::CloseCode code)
+{
+    Buffer close;
+    websocket::appendClose(&close, code);
+    conn->send(&close);
+    conn->shutdown();
+    context->setWebSocketClosed();
+    /* 通知处理函数连接结束 */
+    context->webSocketCallback()(conn, websocket::kClose, string());
+}
@@ -2,6 +2,9 @@
 #define NET_HTTP_HTTPSERVER_H
 
 #include "net_tcp_server.h"
+#include "base_metrics.h"
+#include "net_websocket.h"
+#include <map>
 
 NAMESPACE_START
 
@@ -10,6 +13,7 @@ namespace net
 
     class HttpRequest;
     class HttpResponse;
+    class HttpContext;
 
     /// A simple embeddable HTTP server designed for report status of a program.
     /// It is not a fully HTTP 1.1 compliant server, but provides minimum features
@@ -27,6 +31,7 @@ namespace net
                    const InetAddress &listenAddr,
                    const string &name,
                    TcpServer::Option option = TcpServer::kNoReusePort);
+        ~HttpServer();
 
         EventLoop *getLoop() const { return server_.getLoop(); }
 
@@ -54,11 +59,16 @@ namespace net
 
         /* 注意谨慎使用 */
         void onRequest(const TcpConnectionPtr &, const HttpRequest &);
+        /* 升级之后的WebSocket数据，处理控制帧并拼接分片消息 */
+        void onWebSocketMessage(const TcpConnectionPtr &conn, HttpContext *context, Buffer *buf);
+        /* 发送关闭帧并关闭写端，通知处理函数连接结束 */
+        void closeWebSocket(const TcpConnectionPtr &conn, HttpContext *context, websocket::CloseCode code);
 
         TcpServer server_;          /* tcp server */
         HttpCallback httpCallback_; /* 响应回调函数 */
                                     /* server主动回调函数 */
-        
+        /* 每个事件循环的连接数量，start 之后只读 */
+        std::map<EventLoop *, MetricGauge *> connectionGauges_;
     };
 
 } // namespace net
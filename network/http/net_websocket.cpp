@@ -0,0 +1,283 @@
+#include "net_websocket.h"
+#include "net_buffer.h"
+#include "net_http_request.h"
+#include "net_http_response.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace MY_NAME_SPACE;
+using namespace MY_NAME_SPACE::net;
+
+namespace
+{
+    /* 握手时拼接在客户端key之后的固定字符串 */
+    const char kHandshakeGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    inline uint32_t rotateLeft(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    /* 握手只需要对几十个字节计算SHA-1，不引入额外的依赖 */
+    void sha1(const string &message, unsigned char digest[20])
+    {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        string data(message);
+        uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+
+        data += static_cast<char>(0x80);
+        while (data.size() % 64 != 56)
+        {
+            data += static_cast<char>(0);
+        }
+        for (int i = 7; i >= 0; i--)
+        {
+            data += static_cast<char>((bitLength >> (i * 8)) & 0xFF);
+        }
+
+        for (size_t chunk = 0; chunk < data.size(); chunk += 64)
+        {
+            uint32_t w[80];
+            for (int i = 0; i < 16; i++)
+            {
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data() + chunk + i * 4);
+                w[i] = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                       (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+            }
+            for (int i = 16; i < 80; i++)
+            {
+                w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; i++)
+            {
+                uint32_t f, k;
+                if (i < 20)
+                {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }
+                else if (i < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if (i < 60)
+                {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotateLeft(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            digest[i * 4] = static_cast<unsigned char>(h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<unsigned char>(h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<unsigned char>(h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<unsigned char>(h[i]);
+        }
+    }
+
+    string base64Encode(const unsigned char *data, size_t len)
+    {
+        static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        string result;
+
+        for (size_t i = 0; i < len; i += 3)
+        {
+            uint32_t value = static_cast<uint32_t>(data[i]) << 16;
+            if (i + 1 < len)
+            {
+                value |= static_cast<uint32_t>(data[i + 1]) << 8;
+            }
+            if (i + 2 < len)
+            {
+                value |= static_cast<uint32_t>(data[i + 2]);
+            }
+            result += kTable[(value >> 18) & 0x3F];
+            result += kTable[(value >> 12) & 0x3F];
+            result += (i + 1 < len) ? kTable[(value >> 6) & 0x3F] : '=';
+            result += (i + 2 < len) ? kTable[value & 0x3F] : '=';
+        }
+        return result;
+    }
+
+    /* 头部的值是否包含指定的单词(不区分大小写)，例如 Connection: keep-alive, Upgrade */
+    bool headerHasToken(const string &value, const char *token)
+    {
+        size_t tokenLength = strlen(token);
+        size_t start = 0;
+
+        while (start < value.size())
+        {
+            size_t end = value.find(',', start);
+            if (end == string::npos)
+            {
+                end = value.size();
+            }
+            size_t first = value.find_first_not_of(" \t", start);
+            size_t last = value.find_last_not_of(" \t", end - 1);
+            if ((first != string::npos) && (first < end) && (last - first + 1 == tokenLength) &&
+                (strncasecmp(value.data() + first, token, tokenLength) == 0))
+            {
+                return true;
+            }
+            start = end + 1;
+        }
+        return false;
+    }
+} // namespace
+
+bool websocket::isUpgradeRequest(const HttpRequest &req)
+{
+    return (req.method() == HttpRequest::kGet) &&
+           headerHasToken(req.getHeader("Upgrade"), "websocket") &&
+           headerHasToken(req.getHeader("Connection"), "Upgrade");
+}
+
+string websocket::acceptKey(const string &clientKey)
+{
+    unsigned char digest[20];
+    sha1(clientKey + kHandshakeGuid, digest);
+    return base64Encode(digest, sizeof(digest));
+}
+
+bool websocket::accept(const HttpRequest &req, HttpResponse *resp, const MessageCallback &cb)
+{
+    const string key = req.getHeader("Sec-WebSocket-Key");
+
+    if (!isUpgradeRequest(req) || key.empty() || (req.getHeader("Sec-WebSocket-Version") != "13"))
+    {
+        resp->SendFast(HttpResponse::k400BadRequest, "WebSocket upgrade required");
+        resp->addHeader("Sec-WebSocket-Version", "13");
+        resp->setCloseConnection(true);
+        return false;
+    }
+    resp->setStatusCode(HttpResponse::k101SwitchingProtocols);
+    resp->setStatusMessage("Switching Protocols");
+    resp->addHeader("Upgrade", "websocket");
+    resp->addHeader("Sec-WebSocket-Accept", acceptKey(key));
+    resp->setWebSocketCallback(cb);
+    return true;
+}
+
+void websocket::appendFrameHeader(Buffer *output, Opcode opcode, size_t len)
+{
+    output->appendInt8(static_cast<int8_t>(0x80 | opcode));
+    if (len < 126)
+    {
+        output->appendInt8(static_cast<int8_t>(len));
+    }
+    else if (len <= 0xFFFF)
+    {
+        output->appendInt8(126);
+        output->appendInt16(static_cast<int16_t>(len));
+    }
+    else
+    {
+        output->appendInt8(127);
+        output->appendInt64(static_cast<int64_t>(len));
+    }
+}
+
+void websocket::appendFrame(Buffer *output, Opcode opcode, const void *data, size_t len)
+{
+    appendFrameHeader(output, opcode, len);
+    output->append(data, len);
+}
+
+void websocket::appendClose(Buffer *output, CloseCode code)
+{
+    appendFrameHeader(output, kClose, 2);
+    output->appendInt16(static_cast<int16_t>(code));
+}
+
+websocket::ParseResult websocket::parseFrame(Buffer *input, size_t maxPayload, Frame *frame)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(input->peek());
+    size_t available = input->readableBytes();
+    size_t headerLength = 2;
+
+    if (available < headerLength)
+    {
+        return kIncomplete;
+    }
+    bool fin = (data[0] & 0x80) != 0;
+    unsigned opcode = data[0] & 0x0F;
+    bool masked = (data[1] & 0x80) != 0;
+    uint64_t length = data[1] & 0x7F;
+
+    /* 没有协商扩展，保留位必须为0；客户端的帧必须带掩码 */
+    if (((data[0] & 0x70) != 0) || !masked)
+    {
+        return kBadFrame;
+    }
+    if ((opcode != kContinuation) && (opcode != kText) && (opcode != kBinary) &&
+        (opcode != kClose) && (opcode != kPing) && (opcode != kPong))
+    {
+        return kBadFrame;
+    }
+    if (length == 126)
+    {
+        headerLength += 2;
+    }
+    else if (length == 127)
+    {
+        headerLength += 8;
+    }
+    if (available < headerLength + 4)
+    {
+        return kIncomplete;
+    }
+    if (length >= 126)
+    {
+        length = 0;
+        for (size_t i = 2; i < headerLength; i++)
+        {
+            length = (length << 8) | data[i];
+        }
+    }
+    /* 控制帧不能分片，数据不超过125字节 */
+    if ((opcode >= kClose) && (!fin || (length > 125)))
+    {
+        return kBadFrame;
+    }
+    if (length > maxPayload)
+    {
+        return kBadFrame;
+    }
+    if (available < headerLength + 4 + length)
+    {
+        return kIncomplete;
+    }
+
+    const unsigned char *mask = data + headerLength;
+    const unsigned char *payload = mask + 4;
+    frame->fin = fin;
+    frame->opcode = static_cast<Opcode>(opcode);
+    frame->payload.resize(static_cast<size_t>(length));
+    for (size_t i = 0; i < length; i++)
+    {
+        frame->payload[i] = static_cast<char>(payload[i] ^ mask[i & 3]);
+    }
+    input->retrieve(headerLength + 4 + static_cast<size_t>(length));
+    return kFrameReady;
+}
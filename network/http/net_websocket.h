@@ -0,0 +1,92 @@
+#ifndef NET_HTTP_WEBSOCKET_H
+#define NET_HTTP_WEBSOCKET_H
+
+#include "base_types.h"
+#include "net_callbacks.h"
+#include <functional>
+
+NAMESPACE_START
+
+namespace net
+{
+
+    class Buffer;
+    class HttpRequest;
+    class HttpResponse;
+
+    /*
+     * WebSocket(RFC 6455)协议的握手和帧格式
+     * 只实现服务端：接收的帧必须带掩码，发送的帧不带掩码，不支持扩展
+     */
+    namespace websocket
+    {
+        /* 帧类型 */
+        enum Opcode
+        {
+            kContinuation = 0x0,
+            kText = 0x1,
+            kBinary = 0x2,
+            kClose = 0x8,
+            kPing = 0x9,
+            kPong = 0xA
+        };
+
+        /* 关闭原因 */
+        enum CloseCode
+        {
+            kNormalClosure = 1000,
+            kProtocolError = 1002,
+            kMessageTooBig = 1009,
+            kInternalError = 1011
+        };
+
+        /* 解析结果 */
+        enum ParseResult
+        {
+            kIncomplete, /* 数据不足一帧，等待更多数据 */
+            kFrameReady, /* 解析出一帧，已经从缓冲区中取出 */
+            kBadFrame    /* 格式错误，需要关闭连接 */
+        };
+
+        /* 单个消息最多的字节数，客户端只发送控制命令 */
+        const size_t kMaxMessageBytes = 64 * 1024;
+
+        /* 解析之后的一帧 */
+        struct Frame
+        {
+            bool fin;       /* 是否为消息的最后一帧 */
+            Opcode opcode;  /* 帧类型 */
+            string payload; /* 去掉掩码之后的数据 */
+        };
+
+        /*
+         * 收到完整消息(或者关闭帧)时的回调，在连接所属的事件循环中执行
+         * 连接关闭(收到关闭帧、协议错误或者直接断开)时 opcode 为 kClose，只回调一次
+         */
+        typedef std::function<void(const TcpConnectionPtr &, Opcode, const string &)> MessageCallback;
+
+        /* 是否为 WebSocket 升级请求 */
+        bool isUpgradeRequest(const HttpRequest &req);
+        /* 根据客户端的 Sec-WebSocket-Key 计算 Sec-WebSocket-Accept */
+        string acceptKey(const string &clientKey);
+        /*
+         * 接受升级请求，设置 101 响应和消息回调；HttpServer 发送响应之后按照 WebSocket 帧解析之后的数据
+         * 请求不合法时设置 400 响应并返回false
+         */
+        bool accept(const HttpRequest &req, HttpResponse *resp, const MessageCallback &cb);
+        /* 写入帧头部，之后由调用者写入 len 字节的数据，避免复制大块数据 */
+        void appendFrameHeader(Buffer *output, Opcode opcode, size_t len);
+        /* 写入完整的一帧 */
+        void appendFrame(Buffer *output, Opcode opcode, const void *data, size_t len);
+        /* 写入关闭帧 */
+        void appendClose(Buffer *output, CloseCode code);
+        /* 从缓冲区中解析客户端的一帧，数据超过 maxPayload 时返回 kBadFrame */
+        ParseResult parseFrame(Buffer *input, size_t maxPayload, Frame *frame);
+
+    } // namespace websocket
+
+} // namespace net
+
+NAMESPACE_END
+
+#endif // NET_HTTP_WEBSOCKET_H
@@ -197,6 +197,10 @@ size_t EventLoop::queueSize() const
     MutexLockGuard lock(mutex_);
     return pendingFunctors_.size();
 }
+size_t EventLoop::timerCount() const
+{
+    return timerQueue_->size();
+}
 /* 某个时间点执行函数回调函数 */
 TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 {
@@ -70,6 +70,8 @@ public:
     void queueInLoop(Functor cb);
 
     size_t queueSize() const;
+    /* 定时器队列中的定时器数量，可以在其它线程中调用 */
+    size_t timerCount() const;
 
     // 定时执行相关函数
 
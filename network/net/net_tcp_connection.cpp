@@ -5,6 +5,7 @@
 #include "net_socket.h"
 #include "net_sockets_ops.h"
 #include "net_channel.h"
+#include "base_trace.h"
 
 #include <errno.h>
 using namespace MY_NAME_SPACE;
@@ -43,7 +44,10 @@ TcpConnection::TcpConnection(EventLoop* loop,
     channel_(new Channel(loop, sockfd)),/* 每个TCPconnet都会由自己的监听事件管理 */
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024) /* 设置高水位临界值 */
+    highWaterMark_(64*1024*1024), /* 设置高水位临界值 */
+    traceId_(0),
+    traceQueuedId_(0),
+    traceQueuedAt_(0)
 {
     /* 设置各种回调函数 */
     channel_->setReadCallback(
@@ -161,6 +165,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
+    int64_t traceBegin = (traceId_ != 0) ? FrameTrace::Begin() : 0;
     if (state_ == kDisconnected)
     {
         LOG_WARN << "disconnected, give up writing";
@@ -213,6 +218,15 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         {
             channel_->enableWriting();
         }
+        if (traceBegin != 0)
+        {
+            traceQueuedId_ = traceId_;
+            traceQueuedAt_ = traceBegin;
+        }
+    }
+    if (traceBegin != 0)
+    {
+        FrameTrace::Record("socket_write", traceId_, traceBegin, FrameTrace::Now(), "queued", static_cast<int64_t>(remaining));
     }
 }
 void TcpConnection::timeCallBack(Timestamp nextTime,TimerCallback sendCallBack) 
@@ -434,6 +448,11 @@ void TcpConnection::handleWrite()
             {
                 /* 全部写到tcp缓冲区中，关闭对可写事件的监听 */
                 channel_->disableWriting();
+                if (traceQueuedId_ != 0)
+                {
+                    FrameTrace::Record("write_complete", traceQueuedId_, traceQueuedAt_, FrameTrace::Now());
+                    traceQueuedId_ = 0;
+                }
                 /* 如果有写入完成时的回调函数（用户提供，则等待函数结束后调用 */
                 if (writeCompleteCallback_)
                 {
@@ -122,6 +122,11 @@ namespace net
         {
             return &context_;
         }
+        /* 设置之后发送的数据所属的帧编号，用于逐帧跟踪，0 表示不记录；只在loop线程中调用 */
+        void setTraceId(uint64_t traceId)
+        {
+            traceId_ = traceId;
+        }
 
         void setConnectionCallback(const ConnectionCallback &cb)
         {
@@ -239,6 +244,9 @@ namespace net
         Buffer inputBuffer_;
         Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
         boost::any context_;  /* 处理上下文消息的任意指针 */
+        uint64_t traceId_;        /* 当前发送数据的帧编号 */
+        uint64_t traceQueuedId_;  /* 写入应用层缓冲区的最后一帧编号，缓冲区写完时记录 */
+        int64_t traceQueuedAt_;   /* 该帧开始排队的时间(微秒) */
         // FIXME: creationTime_, lastReceiveTime_
         //        bytesReceived_, bytesSent_
         
@@ -94,7 +94,8 @@ TimerQueue::TimerQueue(EventLoop* loop)
         timerfd_(createTimerfd()),
         timerfdChannel_(loop, timerfd_),
         timers_(),
-        callingExpiredTimers_(false)
+        callingExpiredTimers_(false),
+        timerCount_(0)
 {
     /* 添加计时器文件，读取监听函数 */
     timerfdChannel_.setReadCallback(
@@ -163,6 +164,7 @@ void TimerQueue::cancelInLoop(TimerId timerId)
         assert(n == 1); (void)n;
         delete it->first; // FIXME: no delete please
         activeTimers_.erase(it);
+        timerCount_ = timers_.size();
     }
     else if (callingExpiredTimers_)
     {
@@ -210,6 +212,7 @@ std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
     std::copy(timers_.begin(), end, back_inserter(expired));
     /* 定时器中删除超时的集合 */
     timers_.erase(timers_.begin(), end);
+    timerCount_ = timers_.size();
 
     /* 从激活的计时器队列中移除选中的定时器 */
     for (const Entry& it : expired)
@@ -286,6 +289,7 @@ bool TimerQueue::insert(Timer* timer)
         = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
         assert(result.second); (void)result;
     }
+    timerCount_ = timers_.size();
 
     assert(timers_.size() == activeTimers_.size());
     return earliestChanged;
@@ -2,6 +2,7 @@
 #define NET_TIMERQUEUE_H
 
 #include <set>
+#include <atomic>
 #include <vector>
 #include "base_mutex.h"
 #include "time_stamp.h"
@@ -35,6 +36,8 @@ public:
                      );
 
     void cancel(TimerId timerId);
+    /* 队列中的定时器数量，可以在其它线程中读取 */
+    size_t size() const { return timerCount_; }
 
 private:
     // FIXME: use unique_ptr<Timer> instead of raw pointers.
@@ -76,6 +79,7 @@ private:
     ActiveTimerSet activeTimers_;           /* 处于激活状态的时钟 */ /* 和timers_对应，主要是方便timer指针的快速查找 */
     bool callingExpiredTimers_; /* atomic */ /* 是否存在超时人物 */
     ActiveTimerSet cancelingTimers_;         /* 保存的是被取消的定时器，列表 */
+    std::atomic<size_t> timerCount_;         /* timers_ 的大小，供其它线程读取 */
 };
 } // namespace net
 NAMESPACE_END
@@ -0,0 +1,128 @@
+#include "net_websocket.h"
+#include "net_buffer.h"
+#include "net_http_request.h"
+#include "net_http_response.h"
+#include "test_check.h"
+
+#include <string.h>
+#include <string>
+
+using namespace MY_NAME_SPACE;
+using namespace MY_NAME_SPACE::net;
+
+/* 按照客户端的格式写入带掩码的帧 */
+static void AppendClientFrame(Buffer *buf, int firstByte, const std::string &payload)
+{
+    const unsigned char mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+    buf->appendInt8(static_cast<int8_t>(firstByte));
+    if (payload.size() < 126)
+    {
+        buf->appendInt8(static_cast<int8_t>(0x80 | payload.size()));
+    }
+    else
+    {
+        buf->appendInt8(static_cast<int8_t>(0x80 | 126));
+        buf->appendInt16(static_cast<int16_t>(payload.size()));
+    }
+    buf->append(mask, sizeof(mask));
+    for (size_t i = 0; i < payload.size(); i++)
+    {
+        char c = static_cast<char>(payload[i] ^ mask[i & 3]);
+        buf->append(&c, 1);
+    }
+}
+
+/* RFC 6455 1.3 中的握手示例 */
+void TestHandshake()
+{
+    const char get[] = "GET";
+
+    Check(websocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", "accept key matches RFC example");
+
+    const char *headers[] = {"Upgrade: WebSocket", "Connection: keep-alive, Upgrade",
+                             "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==", "Sec-WebSocket-Version: 13"};
+    HttpRequest upgrade;
+    upgrade.setMethod(get, get + 3);
+    for (size_t i = 0; i < sizeof(headers) / sizeof(headers[0]); i++)
+    {
+        const char *colon = strchr(headers[i], ':');
+        upgrade.addHeader(headers[i], colon, headers[i] + strlen(headers[i]));
+    }
+    Check(websocket::isUpgradeRequest(upgrade), "upgrade request detected");
+
+    HttpResponse accepted(false);
+    bool ok = websocket::accept(upgrade, &accepted, [](const TcpConnectionPtr &, websocket::Opcode, const string &) {});
+    Buffer out;
+    accepted.appendToBuffer(&out);
+    std::string text = out.retrieveAllAsString();
+    Check(ok && static_cast<bool>(accepted.webSocketCallback()), "upgrade accepted");
+    Check(text.find("HTTP/1.1 101 Switching Protocols\r\n") == 0, "101 status line");
+    Check(text.find("Connection: Upgrade\r\n") != std::string::npos, "connection upgrade header");
+    Check(text.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos, "accept header");
+
+    HttpRequest plain;
+    plain.setMethod(get, get + 3);
+    HttpResponse rejected(false);
+    Check(!websocket::accept(plain, &rejected, websocket::MessageCallback()), "plain request rejected");
+    Check(rejected.closeConnection(), "rejected request closes the connection");
+}
+
+void TestParseFrame()
+{
+    Buffer buf;
+    websocket::Frame frame;
+
+    AppendClientFrame(&buf, 0x81, "ack 42");
+    Check(websocket::parseFrame(&buf, websocket::kMaxMessageBytes, &frame) == websocket::kFrameReady, "masked text frame parsed");
+    Check(frame.fin && (frame.opcode == websocket::kText) && (frame.payload == "ack 42"), "payload unmasked");
+    Check(buf.readableBytes() == 0, "frame removed from the buffer");
+
+    std::string large(300, 'x');
+    AppendClientFrame(&buf, 0x02, large);
+    Buffer partial;
+    partial.append(buf.peek(), buf.readableBytes() - 1);
+    Check(websocket::parseFrame(&partial, websocket::kMaxMessageBytes, &frame) == websocket::kIncomplete, "partial frame waits for more data");
+    Check(websocket::parseFrame(&buf, websocket::kMaxMessageBytes, &frame) == websocket::kFrameReady, "16-bit length frame parsed");
+    Check(!frame.fin && (frame.opcode == websocket::kBinary) && (frame.payload == large), "fragment payload");
+
+    AppendClientFrame(&buf, 0x81, large);
+    Check(websocket::parseFrame(&buf, 100, &frame) == websocket::kBadFrame, "oversized frame rejected");
+
+    Buffer unmasked;
+    websocket::appendFrame(&unmasked, websocket::kText, "hi", 2);
+    Check(websocket::parseFrame(&unmasked, websocket::kMaxMessageBytes, &frame) == websocket::kBadFrame, "unmasked client frame rejected");
+
+    Buffer ping;
+    AppendClientFrame(&ping, 0x09, std::string(126, 'p'));
+    Check(websocket::parseFrame(&ping, websocket::kMaxMessageBytes, &frame) == websocket::kBadFrame, "control frame over 125 bytes rejected");
+}
+
+/* 服务端的帧不带掩码，长度按照 7/16/64 位编码 */
+void TestAppendFrame()
+{
+    Buffer buf;
+
+    websocket::appendFrameHeader(&buf, websocket::kBinary, 125);
+    Check((buf.readableBytes() == 2) && (static_cast<unsigned char>(buf.peek()[0]) == 0x82) && (buf.peek()[1] == 125), "7-bit length");
+    buf.retrieveAll();
+    websocket::appendFrameHeader(&buf, websocket::kBinary, 65535);
+    Check((buf.readableBytes() == 4) && (buf.peek()[1] == 126), "16-bit length");
+    buf.retrieveAll();
+    websocket::appendFrameHeader(&buf, websocket::kBinary, 65536);
+    Check((buf.readableBytes() == 10) && (buf.peek()[1] == 127), "64-bit length");
+    buf.retrieveAll();
+    websocket::appendClose(&buf, websocket::kNormalClosure);
+    Check((buf.readableBytes() == 4) && (static_cast<unsigned char>(buf.peek()[0]) == 0x88) &&
+              (static_cast<unsigned char>(buf.peek()[2]) == 0x03) && (static_cast<unsigned char>(buf.peek()[3]) == 0xe8),
+          "close frame with status code");
+}
+
+int main(int argc, char *argv[])
+{
+    TestHandshake();
+    TestParseFrame();
+    TestAppendFrame();
+
+    return TestResult();
+}
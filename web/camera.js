@@ -1,10 +1,14 @@
 var Camera = (function () {
     var jpegUrl = '/camera/jpeg';
     var mjpegUrl = '/camera/mjpeg';
+    var wsUrl = ((location.protocol == 'https:') ? 'wss://' : 'ws://') + location.host + '/camera/ws';
     var mjpegMode;
     var frameInterval;
     var imageElement;
     var timeStart;
+    var socket = null;
+    var pendingFrame = null;
+    var latency = 0;
 
     function refreshImage() {
         if (mjpegMode) {
@@ -16,7 +20,66 @@ var Camera = (function () {
         }
     }
 
+    /** frame header: version, tier, header length, jpeg size, frame id, capture time (us), network byte order */
+    function onSocketMessage(event) {
+        var view = new DataView(event.data);
+        var headerLength = view.getUint16(2);
+        var frame = {
+            id: view.getUint32(8) * 4294967296 + view.getUint32(12),
+            captured: (view.getUint32(16) * 4294967296 + view.getUint32(20)) / 1000,
+            url: URL.createObjectURL(new Blob([new Uint8Array(event.data, headerLength)], { type: 'image/jpeg' }))
+        };
+
+        if (pendingFrame != null) {
+            URL.revokeObjectURL(pendingFrame.url);
+        }
+        pendingFrame = frame;
+        imageElement.src = frame.url;
+    }
+
+    /** acknowledge the frame once it is shown, so the server sends the next one */
+    function ackFrame() {
+        if (pendingFrame != null) {
+            latency = new Date().getTime() - pendingFrame.captured;
+            socket.send('ack ' + pendingFrame.id);
+            URL.revokeObjectURL(pendingFrame.url);
+            pendingFrame = null;
+        }
+    }
+
+    function startWebSocket() {
+        var opened = false;
+
+        socket = new WebSocket(wsUrl);
+        socket.binaryType = 'arraybuffer';
+        socket.onopen = function () {
+            opened = true;
+            socket.send('window 2');
+            if (frameInterval > 0) {
+                socket.send('fps ' + Math.round(1000 / frameInterval));
+            }
+        };
+        socket.onmessage = onSocketMessage;
+        socket.onclose = function () {
+            /** fall back to polling JPEG images; retry WebSocket later if it worked before */
+            socket = null;
+            pendingFrame = null;
+            refreshImage();
+            if (opened) {
+                setTimeout(function () {
+                    if (!mjpegMode) {
+                        startWebSocket();
+                    }
+                }, 5000);
+            }
+        };
+    }
+
     function onImageError() {
+        if (socket != null) {
+            ackFrame();
+            return;
+        }
         /** try rotating between MJPEG/JPEG modes - browsers like IE don't get MJPEG at all */
         mjpegMode = !mjpegMode;
         /** also give it a small pause on error */
@@ -24,7 +87,10 @@ var Camera = (function () {
     }
 
     function onImageLoaded() {
-        if (!mjpegMode) {
+        if (socket != null) {
+            ackFrame();
+        }
+        else if (!mjpegMode) {
             var timeTaken = new Date().getTime() - timeStart;
             setTimeout(refreshImage, (timeTaken > frameInterval) ? 0 : frameInterval - timeTaken);
         }
@@ -43,13 +109,24 @@ var Camera = (function () {
             frameInterval = 100;
         }
 
-        /** always try capturing in MJPEG mode */ 
+        /** prefer WebSocket streaming, polling JPEG images is the fallback */
         //mjpegMode = true;
-        mjpegMode = false 
-        refreshImage();
+        mjpegMode = false
+        if (window.WebSocket) {
+            startWebSocket();
+        }
+        else {
+            refreshImage();
+        }
+    };
+
+    /** milliseconds from capture to display of the last WebSocket frame */
+    var getLatency = function () {
+        return latency;
     };
 
     return {
-        Start: start
+        Start: start,
+        Latency: getLatency
     }
 })();
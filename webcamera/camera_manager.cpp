@@ -0,0 +1,391 @@
+#include <unistd.h>
+#include <sched.h>
+#include <chrono>
+#include "camera_manager.h"
+#include "web_camera_server.h"
+#include "web_camera_control_handler.h"
+#include "logging.h"
+#include "time_stamp.h"
+#include "base_str_tools.h"
+
+NAMESPACE_START
+
+CameraManager::CameraManager(const CameraManagerOptions &options) : mOptions(options),
+                                                                    mPipelines(),
+                                                                    mMonitor(std::bind(&CameraManager::MonitorLoop, this), "CameraMonitor"),
+                                                                    mMonitorGuard(),
+                                                                    mMonitorCondition(),
+                                                                    mMonitorRunning(false),
+                                                                    mDemandPending(false)
+{
+}
+
+CameraManager::~CameraManager()
+{
+    // 摄像头持有转换器的监听者指针，必须先停止采集
+    Stop();
+}
+
+size_t CameraManager::AddDevice(const std::string &device)
+{
+    std::unique_ptr<Pipeline> pipeline(new Pipeline());
+
+    pipeline->Device = device;
+    pipeline->Active = false;
+    pipeline->LastDemand = 0;
+    pipeline->Web.reset(new VideoSourceToWeb(mOptions.JpegQuality, mOptions.EncoderThreads));
+    pipeline->Web->SetMetricsLabel(std::to_string(mPipelines.size()));
+    if (mOptions.JpegBitrate > 0)
+    {
+        pipeline->Web->SetJpegBitrate(mOptions.JpegBitrate, mOptions.FrameRate);
+    }
+    pipeline->Camera = V4L2Camera::Create();
+    pipeline->Camera->SetVideoDeviceName(device);
+    pipeline->Camera->SetCapabilityCacheDirectory(mOptions.CapabilityCacheDirectory);
+    pipeline->Camera->SetOutputFormat((mOptions.JpegEncoding) ? PixelFormat::JPEG : mOptions.OutputFormat);
+    pipeline->Camera->SetFrameRate(mOptions.FrameRate);
+    pipeline->Camera->SetVideoSize(mOptions.Width, mOptions.Height);
+    if (mOptions.TimestampOverlay)
+    {
+        // 水印作为采集和编码之间的处理环节
+        pipeline->Decorator.reset(new VideoFrameDecorator());
+        pipeline->Decorator->SetTimestampOverlay(true);
+        pipeline->Decorator->SetListener(pipeline->Web->VideoSourceListener());
+        pipeline->Camera->SetListener(pipeline->Decorator.get());
+    }
+    else
+    {
+        pipeline->Camera->SetListener(pipeline->Web->VideoSourceListener());
+    }
+    if ((mOptions.HistorySeconds > 0) && (mOptions.HistoryBytes > 0))
+    {
+        pipeline->Web->EnableFrameHistory(mOptions.HistorySeconds, mOptions.HistoryBytes);
+    }
+    if (mOptions.IdleSeconds > 0)
+    {
+        pipeline->Web->SetDemandCallback([this]() { WakeMonitor(); });
+    }
+
+    mPipelines.push_back(std::move(pipeline));
+    return mPipelines.size() - 1;
+}
+
+size_t CameraManager::AddAllDevices()
+{
+    std::vector<std::string> devices = V4L2Camera::ListDevices();
+
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        AddDevice(devices[i]);
+    }
+    return devices.size();
+}
+
+/* 进程允许运行的CPU，受 taskset/cgroup cpuset 限制时不是从0开始的连续编号 */
+static std::vector<uint32_t> AllowedCpus()
+{
+    std::vector<uint32_t> cpus;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (cpus.empty())
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (uint32_t cpu = 0; cpu < static_cast<uint32_t>((online > 0) ? online : 1); cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// 摄像头少于CPU时每个摄像头独占一组连续的CPU，否则多个摄像头轮流共享单个CPU
+void CameraManager::AssignCpus()
+{
+    std::vector<uint32_t> allowed = AllowedCpus();
+    size_t cpuCount = allowed.size();
+    size_t cameraCount = mPipelines.size();
+
+    for (size_t i = 0; i < cameraCount; i++)
+    {
+        std::vector<uint32_t> &cpus = mPipelines[i]->Cpus;
+        cpus.clear();
+        if ((!mOptions.PinThreads) || (cpuCount < 2))
+        {
+            continue;
+        }
+        if (cameraCount >= cpuCount)
+        {
+            cpus.push_back(allowed[i % cpuCount]);
+            continue;
+        }
+        size_t groupSize = cpuCount / cameraCount;
+        cpus.assign(allowed.begin() + i * groupSize, allowed.begin() + (i + 1) * groupSize);
+    }
+}
+
+Error CameraManager::Start()
+{
+    size_t started = 0;
+
+    AssignCpus();
+    for (size_t i = 0; i < mPipelines.size(); i++)
+    {
+        Pipeline &pipeline = *mPipelines[i];
+
+        pipeline.Camera->SetCpuAffinity(pipeline.Cpus);
+        pipeline.Web->SetEncoderAffinity(pipeline.Cpus);
+        if (mOptions.IdleSeconds > 0)
+        {
+            // 按需运行时先不采集，热备模式下提前打开设备，第一个请求到达时只需要开启视频流
+            pipeline.Web->MarkSourceIdle();
+            if (!mOptions.WarmStandby)
+            {
+                started++;
+                continue;
+            }
+            // 热备模式下设备打开失败的摄像头不计入启动数量
+            pipeline.Camera->SetStreamingPaused(true);
+            if (pipeline.Camera->Start())
+            {
+                started++;
+            }
+            else
+            {
+                LOG_ERROR << "Failed to start camera " << i << " (" << pipeline.Device << ")";
+            }
+            continue;
+        }
+        if (pipeline.Camera->Start())
+        {
+            pipeline.Active = true;
+            started++;
+        }
+        else
+        {
+            LOG_ERROR << "Failed to start camera " << i << " (" << pipeline.Device << ")";
+        }
+    }
+    LOG_INFO << "Started " << started << " of " << mPipelines.size() << " cameras";
+
+    if (mOptions.IdleSeconds > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMonitorGuard);
+            mMonitorRunning = true;
+        }
+        mMonitor.start();
+    }
+    return (started > 0) ? Error::Success : Error::DeviceNotReady;
+}
+
+// 监视线程定时检查空闲的摄像头，有新请求时立即唤醒
+void CameraManager::MonitorLoop()
+{
+    std::unique_lock<std::mutex> lock(mMonitorGuard);
+
+    while (mMonitorRunning)
+    {
+        mDemandPending = false;
+        lock.unlock();
+        UpdateActivity();
+        lock.lock();
+        mMonitorCondition.wait_for(lock, std::chrono::milliseconds(CAMERA_ACTIVITY_CHECK_INTERVAL),
+                                   [this]() { return (mDemandPending) || (!mMonitorRunning); });
+    }
+}
+
+void CameraManager::UpdateActivity()
+{
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    int64_t idle = static_cast<int64_t>(mOptions.IdleSeconds) * 1000 * 1000;
+
+    for (size_t i = 0; i < mPipelines.size(); i++)
+    {
+        Pipeline &pipeline = *mPipelines[i];
+
+        if (pipeline.Web->HasDemand())
+        {
+            pipeline.LastDemand = now;
+            if (!pipeline.Active)
+            {
+                Activate(pipeline);
+            }
+        }
+        else if ((pipeline.Active) && (now - pipeline.LastDemand >= idle))
+        {
+            Deactivate(pipeline);
+        }
+    }
+}
+
+void CameraManager::Activate(Pipeline &pipeline)
+{
+    LOG_INFO << "Activating camera " << pipeline.Device;
+    pipeline.Camera->SetStreamingPaused(false);
+    // 冷备模式或者采集线程因为错误退出时重新打开设备
+    if ((!pipeline.Camera->IsRunning()) && (!pipeline.Camera->Start()))
+    {
+        LOG_ERROR << "Failed to start camera " << pipeline.Device;
+        return;
+    }
+    pipeline.Active = true;
+}
+
+void CameraManager::Deactivate(Pipeline &pipeline)
+{
+    LOG_INFO << "Camera " << pipeline.Device << " is idle, " << (mOptions.WarmStandby ? "pausing" : "stopping");
+    pipeline.Web->MarkSourceIdle();
+    if (mOptions.WarmStandby)
+    {
+        pipeline.Camera->SetStreamingPaused(true);
+    }
+    else
+    {
+        pipeline.Camera->SignalToStop();
+        pipeline.Camera->WaitForStop();
+    }
+    pipeline.Active = false;
+}
+
+void CameraManager::WakeMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMonitorGuard);
+        mDemandPending = true;
+    }
+    mMonitorCondition.notify_one();
+}
+
+void CameraManager::Stop()
+{
+    // 先停止监视线程，避免停止过程中摄像头被重新启动
+    bool monitorRunning = false;
+    {
+        std::lock_guard<std::mutex> lock(mMonitorGuard);
+        monitorRunning = mMonitorRunning;
+        mMonitorRunning = false;
+    }
+    if (monitorRunning)
+    {
+        mMonitorCondition.notify_one();
+        mMonitor.join();
+    }
+
+    // 先通知所有摄像头，再逐个等待，停止时间不随摄像头数量累加
+    for (size_t i = 0; i < mPipelines.size(); i++)
+    {
+        mPipelines[i]->Camera->SignalToStop();
+    }
+    for (size_t i = 0; i < mPipelines.size(); i++)
+    {
+        mPipelines[i]->Camera->WaitForStop();
+        mPipelines[i]->Active = false;
+    }
+}
+
+size_t CameraManager::Count() const
+{
+    return mPipelines.size();
+}
+
+std::shared_ptr<V4L2Camera> CameraManager::Camera(size_t id) const
+{
+    return (id < mPipelines.size()) ? mPipelines[id]->Camera : std::shared_ptr<V4L2Camera>();
+}
+
+VideoSourceToWeb *CameraManager::Web(size_t id) const
+{
+    return (id < mPipelines.size()) ? mPipelines[id]->Web.get() : nullptr;
+}
+
+std::string CameraManager::DeviceName(size_t id) const
+{
+    return (id < mPipelines.size()) ? mPipelines[id]->Device : std::string();
+}
+
+std::vector<uint32_t> CameraManager::Cpus(size_t id) const
+{
+    return (id < mPipelines.size()) ? mPipelines[id]->Cpus : std::vector<uint32_t>();
+}
+
+bool CameraManager::IsActive(size_t id) const
+{
+    return (id < mPipelines.size()) && (mPipelines[id]->Active);
+}
+
+void CameraManager::RegisterHandlers(WebCameraServer &server, const std::string &prefix) const
+{
+    server.AddHandler(prefix, std::make_shared<CameraListRequestHandler>(prefix, this, prefix));
+    for (size_t i = 0; i < mPipelines.size(); i++)
+    {
+        const VideoSourceToWeb &web = *mPipelines[i]->Web;
+        std::string base = prefix + "/" + std::to_string(i);
+
+        server.AddHandler(base + "/jpeg", web.CreateJpegHandler(base + "/jpeg"));
+        server.AddHandler(base + "/mjpeg", web.CreateMjpegHandler(base + "/mjpeg", mOptions.FrameRate));
+        server.AddHandler(base + "/ws", web.CreateWebSocketHandler(base + "/ws", mOptions.FrameRate));
+        server.AddHandler(base + "/history", web.CreateFrameHistoryHandler(base + "/history"));
+        server.AddHandler(base + "/info", std::make_shared<CameraInfoHandler>(mPipelines[i]->Camera, base + "/info"));
+    }
+}
+
+CameraListRequestHandler::CameraListRequestHandler(const std::string &uri, const CameraManager *manager, const std::string &prefix)
+    : WebRequestHandlerInterface(uri, false), mManager(manager), mPrefix(prefix)
+{
+}
+
+/* 设备名和路径来自命令行，需要转义之后写入json */
+static std::string JsonString(std::string value)
+{
+    StringReplace(value, "\\", "\\\\");
+    StringReplace(value, "\"", "\\\"");
+    return "\"" + value + "\"";
+}
+
+void CameraListRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+{
+    std::string reply("{\"status\":\"OK\",\"cameras\":[");
+
+    for (size_t i = 0; i < mManager->Count(); i++)
+    {
+        std::shared_ptr<V4L2Camera> camera = mManager->Camera(i);
+        std::vector<uint32_t> cpus = mManager->Cpus(i);
+
+        reply += (i == 0) ? "{" : ",{";
+        reply += "\"id\":" + std::to_string(i) + ",\"device\":" + JsonString(mManager->DeviceName(i)) +
+                 ",\"uri\":" + JsonString(mPrefix + "/" + std::to_string(i)) +
+                 ",\"running\":" + (camera->IsRunning() ? "true" : "false") +
+                 ",\"active\":" + (mManager->IsActive(i) ? "true" : "false") +
+                 ",\"frames\":" + std::to_string(camera->FramesReceived()) + ",\"cpus\":[";
+        for (size_t j = 0; j < cpus.size(); j++)
+        {
+            if (j > 0)
+            {
+                reply += ',';
+            }
+            reply += std::to_string(cpus[j]);
+        }
+        reply += "]}";
+    }
+    reply += "]}";
+
+    response.setStatusCode(WebResponse::k200Ok);
+    response.setStatusMessage("OK");
+    response.setContentType("application/json");
+    response.addHeader("Cache-Control", "no-store, must-revalidate");
+    response.addHeader("Content-Length", std::to_string(reply.size()));
+    response.setBody(reply);
+}
+
+NAMESPACE_END
@@ -0,0 +1,261 @@
+/**
+ * @file camera_manager.h
+ * @brief 多摄像头管理，每个摄像头拥有独立的采集、编码和分发流程
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 17:05:36
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 17:05:36 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 枚举V4L2设备并注册 /cameras/{id} 路由 </td>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 17:32:10 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 按需启动摄像头，空闲时暂停 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef CAMERA_MANAGER_H
+#define CAMERA_MANAGER_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <condition_variable>
+#include "base_error.h"
+#include "base_thread.h"
+#include "uncopyable.h"
+#include "v4l2_camera.h"
+#include "video_frame_decorator.h"
+#include "video_source_to_web.h"
+#include "web_request_handler.h"
+
+NAMESPACE_START
+
+class WebCameraServer;
+
+/**
+ * @brief 检查摄像头是否空闲的间隔(毫秒)
+ */
+#define CAMERA_ACTIVITY_CHECK_INTERVAL (500)
+
+/**
+ * @brief 所有摄像头共用的参数
+ */
+struct CameraManagerOptions
+{
+    CameraManagerOptions() : Width(640),
+                             Height(480),
+                             FrameRate(20),
+                             JpegQuality(70),
+                             JpegBitrate(0),
+                             JpegEncoding(false),
+                             OutputFormat(PixelFormat::Unknown),
+                             EncoderThreads(1),
+                             PinThreads(true),
+                             HistorySeconds(0),
+                             HistoryBytes(0),
+                             IdleSeconds(0),
+                             WarmStandby(true),
+                             TimestampOverlay(false),
+                             CapabilityCacheDirectory()
+    {
+    }
+
+    uint32_t Width;          ///< 图像宽度
+    uint32_t Height;         ///< 图像高度
+    uint32_t FrameRate;      ///< 帧率
+    uint16_t JpegQuality;    ///< jpeg压缩质量
+    uint64_t JpegBitrate;    ///< 每个jpeg流的目标码率(bit/s)，0 表示使用固定质量
+    bool JpegEncoding;       ///< 是否直接使用摄像头输出的jpeg
+    PixelFormat OutputFormat; ///< JpegEncoding 为false时采集之后输出的格式，Unknown 为按照摄像头支持的格式自动选择
+    uint32_t EncoderThreads; ///< 每个摄像头的编码线程数量
+    bool PinThreads;         ///< 是否把每个摄像头的采集和编码线程绑定到不同的CPU
+    uint32_t HistorySeconds; ///< 历史帧缓存时长(秒)，0 表示关闭
+    size_t HistoryBytes;     ///< 每个摄像头历史帧缓存的最大字节数
+    uint32_t IdleSeconds;    ///< 没有请求多少秒之后暂停摄像头，0 表示一直运行
+    bool WarmStandby;        ///< 暂停时保持设备打开只关闭视频流(恢复快)，否则关闭设备(恢复需要重新初始化)
+    bool TimestampOverlay;   ///< 是否叠加时间戳，MJPEG摄像头只重新编码时间戳覆盖的MCU行
+    std::string CapabilityCacheDirectory; ///< 设备能力的磁盘缓存目录，为空时只缓存在内存中
+};
+
+/**
+ * @brief 多摄像头管理
+ * @details
+ *  每个设备对应一个 V4L2Camera 和一个 VideoSourceToWeb：采集和颜色转换在摄像头自己的线程中，
+ *  编码在自己的线程池中，图像池、档位和锁都不共享，摄像头之间只竞争CPU。
+ *  开启 PinThreads 时按照摄像头数量把进程允许运行的CPU(sched_getaffinity)分组，每个摄像头的线程只运行在自己的分组上。
+ *  IdleSeconds 不为0时摄像头按需运行：第一个请求到达时启动，没有连接订阅、单张图片请求、
+ *  历史缓存和录像超过 IdleSeconds 之后暂停，启动和暂停都在独立的监视线程中进行。
+ *  摄像头编号为添加的顺序，路由为 /cameras/{id}/jpeg、/cameras/{id}/mjpeg、/cameras/{id}/history，
+ *  /cameras/{id}/info 返回摄像头的配置、能力和采集模式，/cameras 返回所有摄像头的状态
+ */
+class CameraManager : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Camera Manager object
+     * @param  options          摄像头参数
+     */
+    explicit CameraManager(const CameraManagerOptions &options = CameraManagerOptions());
+    /**
+     * @brief 停止所有摄像头
+     */
+    ~CameraManager();
+    /**
+     * @brief  添加一个摄像头设备，需要在 Start 之前调用
+     * @param  device           设备名称，如：/dev/video0
+     * @return size_t           摄像头编号
+     */
+    size_t AddDevice(const std::string &device);
+    /**
+     * @brief  添加系统中所有支持视频采集的设备
+     * @return size_t           添加的设备数量
+     */
+    size_t AddAllDevices();
+    /**
+     * @brief  分配CPU并启动所有摄像头，只能调用一次
+     * @details 按需运行时只打开设备(热备)或者什么都不做(冷备)，由监视线程在请求到达时开始采集
+     * @return Error            没有摄像头或者全部启动失败时返回 DeviceNotReady
+     */
+    Error Start();
+    /**
+     * @brief 停止所有摄像头，并等待采集线程退出
+     */
+    void Stop();
+    /**
+     * @brief  摄像头数量
+     * @return size_t 数量
+     */
+    size_t Count() const;
+    /**
+     * @brief  获取摄像头
+     * @param  id               摄像头编号
+     * @return std::shared_ptr<V4L2Camera> 摄像头，编号不存在时为空
+     */
+    std::shared_ptr<V4L2Camera> Camera(size_t id) const;
+    /**
+     * @brief  获取摄像头的web转换器，可以用来单独设置质量、历史缓存和录像
+     * @param  id               摄像头编号
+     * @return VideoSourceToWeb* 转换器，编号不存在时为nullptr
+     */
+    VideoSourceToWeb *Web(size_t id) const;
+    /**
+     * @brief  获取摄像头的设备名称
+     * @param  id               摄像头编号
+     * @return std::string      设备名称
+     */
+    std::string DeviceName(size_t id) const;
+    /**
+     * @brief  获取摄像头线程绑定的CPU
+     * @param  id               摄像头编号
+     * @return std::vector<uint32_t> CPU编号，没有绑定时为空
+     */
+    std::vector<uint32_t> Cpus(size_t id) const;
+    /**
+     * @brief  摄像头是否正在采集
+     * @param  id               摄像头编号
+     * @return true  正在采集
+     * @return false 已暂停或者编号不存在
+     */
+    bool IsActive(size_t id) const;
+    /**
+     * @brief 在服务器上注册所有摄像头的路由
+     * @param  server           web服务器
+     * @param  prefix           路由前缀
+     */
+    void RegisterHandlers(WebCameraServer &server, const std::string &prefix = "/cameras") const;
+
+private:
+    /**
+     * @brief 单个摄像头的处理流程
+     */
+    struct Pipeline
+    {
+        std::string Device;                   ///< 设备名称
+        std::shared_ptr<V4L2Camera> Camera;   ///< 摄像头，采集和颜色转换线程
+        std::unique_ptr<VideoSourceToWeb> Web; ///< 编码和分发
+        std::unique_ptr<VideoFrameDecorator> Decorator; ///< 时间戳水印，关闭时为空
+        std::vector<uint32_t> Cpus;           ///< 绑定的CPU
+        std::atomic<bool> Active;             ///< 是否正在采集，只在监视线程中修改
+        int64_t LastDemand;                   ///< 最近一次有请求的时间(微秒)
+    };
+    /**
+     * @brief 按照摄像头数量把进程允许运行的CPU分组
+     */
+    void AssignCpus();
+    /**
+     * @brief 监视线程，按照请求启动和暂停摄像头
+     */
+    void MonitorLoop();
+    /**
+     * @brief 检查所有摄像头的请求状态
+     */
+    void UpdateActivity();
+    /**
+     * @brief 开始采集
+     */
+    void Activate(Pipeline &pipeline);
+    /**
+     * @brief 暂停采集
+     */
+    void Deactivate(Pipeline &pipeline);
+    /**
+     * @brief 唤醒监视线程，在网络线程中调用
+     */
+    void WakeMonitor();
+
+private:
+    const CameraManagerOptions mOptions;                 ///< 摄像头参数
+    std::vector<std::unique_ptr<Pipeline> > mPipelines; ///< 摄像头处理流程，下标为编号
+    Thread mMonitor;                                     ///< 监视线程
+    std::mutex mMonitorGuard;                            ///< 监视线程锁
+    std::condition_variable mMonitorCondition;           ///< 有新请求或者停止时唤醒监视线程
+    bool mMonitorRunning;                                ///< 监视线程是否运行
+    bool mDemandPending;                                 ///< 是否有未处理的新请求
+};
+
+/**
+ * @brief 摄像头列表请求，返回所有摄像头的状态(json)
+ */
+class CameraListRequestHandler : public WebRequestHandlerInterface
+{
+public:
+    /**
+     * @brief Construct a new Camera List Request Handler object
+     * @param  uri              句柄对应url
+     * @param  manager          摄像头管理
+     * @param  prefix           摄像头路由前缀
+     */
+    CameraListRequestHandler(const std::string &uri, const CameraManager *manager, const std::string &prefix);
+    /**
+     * @brief 返回摄像头列表
+     * @param  conn             TCP 连接
+     * @param  request          解析的请求
+     * @param  response         请求的响应
+     */
+    void HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response);
+
+private:
+    const CameraManager *mManager; ///< 摄像头管理
+    std::string mPrefix;           ///< 摄像头路由前缀
+};
+
+NAMESPACE_END
+
+#endif // CAMERA_MANAGER_H
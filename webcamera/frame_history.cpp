@@ -0,0 +1,251 @@
+#include <algorithm>
+#include "frame_history.h"
+#include "video_source_to_webdata.h"
+#include "time_stamp.h"
+
+NAMESPACE_START
+
+/* 环形存储的初始容量 */
+static const size_t kInitialCapacity = 64;
+
+FrameHistory::FrameHistory() : mGuard(),
+                               mMaxSeconds(0),
+                               mMaxBytes(0),
+                               mMotionThreshold(FRAME_HISTORY_MOTION_THRESHOLD),
+                               mEntries(),
+                               mHead(0),
+                               mCount(0),
+                               mBytes(0),
+                               mEvents()
+{
+    mEvents.reserve(FRAME_HISTORY_MAX_EVENTS);
+}
+
+void FrameHistory::SetLimits(uint32_t seconds, size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+
+    mMaxSeconds = seconds;
+    mMaxBytes = maxBytes;
+    if ((seconds == 0) || (maxBytes == 0))
+    {
+        while (mCount > 0)
+        {
+            PopOldest();
+        }
+        mEvents.clear();
+        return;
+    }
+    while ((mCount > 1) && (mBytes > mMaxBytes))
+    {
+        PopOldest();
+    }
+}
+
+bool FrameHistory::IsEnabled() const
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    return (mMaxSeconds != 0) && (mMaxBytes != 0);
+}
+
+void FrameHistory::SetMotionThreshold(uint32_t threshold)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    mMotionThreshold = threshold;
+}
+
+uint32_t FrameHistory::MotionThreshold() const
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    return mMotionThreshold;
+}
+
+FrameHistory::Entry &FrameHistory::At(size_t index)
+{
+    return mEntries[(mHead + index) & (mEntries.size() - 1)];
+}
+
+const FrameHistory::Entry &FrameHistory::At(size_t index) const
+{
+    return mEntries[(mHead + index) & (mEntries.size() - 1)];
+}
+
+// 淘汰最旧的帧；下一帧共享同一份数据时，由下一帧继续计入大小
+void FrameHistory::PopOldest()
+{
+    Entry &oldest = At(0);
+
+    if (mCount > 1)
+    {
+        Entry &next = At(1);
+        if ((next.Charge == 0) && (next.Frame->Buffer == oldest.Frame->Buffer))
+        {
+            next.Charge = oldest.Charge;
+            oldest.Charge = 0;
+        }
+    }
+    mBytes -= oldest.Charge;
+    oldest.Frame.reset();
+    mHead = (mHead + 1) & (mEntries.size() - 1);
+    mCount--;
+}
+
+void FrameHistory::Push(const JpegFramePtr &frame)
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+
+    if ((mMaxSeconds == 0) || (mMaxBytes == 0) || (!frame))
+    {
+        return;
+    }
+
+    // 使用帧的采集时间，编码排队的延迟不影响导出的时间范围；视频源没有提供时间时使用当前时间
+    int64_t time = static_cast<int64_t>(frame->TimeStamp.tv_sec) * 1000 * 1000 + frame->TimeStamp.tv_usec;
+    if (time == 0)
+    {
+        time = Timestamp::now().microSecondsSinceEpoch();
+    }
+    // 时间向回调整时保持时间顺序
+    if ((mCount > 0) && (time < At(mCount - 1).Time))
+    {
+        time = At(mCount - 1).Time;
+    }
+
+    uint32_t charge = ((mCount > 0) && (At(mCount - 1).Frame->Buffer == frame->Buffer)) ? 0 : frame->Size;
+    int64_t window = static_cast<int64_t>(mMaxSeconds) * 1000 * 1000;
+
+    // 先淘汰超出限制的帧，至少保留新的一帧
+    while ((mCount > 0) && ((mBytes + charge > mMaxBytes) || (time - At(0).Time > window)))
+    {
+        PopOldest();
+        if (mCount == 0)
+        {
+            charge = frame->Size;
+        }
+    }
+
+    // 容量不足时按照2倍扩展，稳定之后不再分配内存
+    if (mCount == mEntries.size())
+    {
+        std::vector<Entry> entries(std::max(kInitialCapacity, mEntries.size() * 2));
+        for (size_t i = 0; i < mCount; i++)
+        {
+            entries[i] = At(i);
+        }
+        mEntries.swap(entries);
+        mHead = 0;
+    }
+
+    Entry &entry = At(mCount);
+    entry.Frame = frame;
+    entry.Time = time;
+    entry.Charge = charge;
+    mCount++;
+    mBytes += charge;
+
+    UpdateEvents(time, frame->ChangeScore);
+}
+
+// 变化分数为 FRAME_CHANGE_MAX_SCORE 表示无法比较(第一帧或者jpeg视频源)，不作为运动
+void FrameHistory::UpdateEvents(int64_t time, uint32_t score)
+{
+    // 删除已经没有画面的事件
+    int64_t oldest = At(0).Time;
+    size_t expired = 0;
+    while ((expired < mEvents.size()) && (mEvents[expired].End < oldest))
+    {
+        expired++;
+    }
+    if (expired > 0)
+    {
+        mEvents.erase(mEvents.begin(), mEvents.begin() + expired);
+    }
+
+    if ((mMotionThreshold == 0) || (score < mMotionThreshold) || (score >= FRAME_CHANGE_MAX_SCORE))
+    {
+        return;
+    }
+
+    if ((!mEvents.empty()) && (time - mEvents.back().End <= FRAME_HISTORY_EVENT_GAP))
+    {
+        mEvents.back().End = time;
+        mEvents.back().PeakScore = std::max(mEvents.back().PeakScore, score);
+        return;
+    }
+
+    if (mEvents.size() == FRAME_HISTORY_MAX_EVENTS)
+    {
+        mEvents.erase(mEvents.begin());
+    }
+    MotionEvent event;
+    event.Start = time;
+    event.End = time;
+    event.PeakScore = score;
+    mEvents.push_back(event);
+}
+
+size_t FrameHistory::Range(int64_t from, int64_t to, std::vector<JpegFramePtr> &frames, std::vector<int64_t> *times) const
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    size_t low = 0;
+    size_t high = mCount;
+
+    frames.clear();
+    if (times != nullptr)
+    {
+        times->clear();
+    }
+
+    // 帧按照时间顺序添加，二分查找第一帧
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (At(middle).Time < from)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    for (size_t i = low; (i < mCount) && (At(i).Time <= to); i++)
+    {
+        frames.push_back(At(i).Frame);
+        if (times != nullptr)
+        {
+            times->push_back(At(i).Time);
+        }
+    }
+    return frames.size();
+}
+
+std::vector<MotionEvent> FrameHistory::Events() const
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    return mEvents;
+}
+
+void FrameHistory::Status(size_t *frames, size_t *bytes, int64_t *oldest, int64_t *newest) const
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+
+    *frames = mCount;
+    *bytes = mBytes;
+    *oldest = (mCount > 0) ? At(0).Time : 0;
+    *newest = (mCount > 0) ? At(mCount - 1).Time : 0;
+}
+
+void FrameHistory::Clear()
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+
+    while (mCount > 0)
+    {
+        PopOldest();
+    }
+    mEvents.clear();
+}
+
+NAMESPACE_END
@@ -0,0 +1,165 @@
+/**
+ * @file frame_history.h
+ * @brief 最近一段时间编码帧的内存环形缓存，以及画面变化事件记录
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 15:40:26
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 15:40:26 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 按照字节数和时长限制的帧缓存 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef FRAME_HISTORY_H
+#define FRAME_HISTORY_H
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include "uncopyable.h"
+
+NAMESPACE_START
+
+struct JpegFrame;
+typedef std::shared_ptr<const JpegFrame> JpegFramePtr;
+
+/**
+ * @brief 最多保存的画面变化事件数量
+ */
+#define FRAME_HISTORY_MAX_EVENTS (32)
+/**
+ * @brief 默认的画面变化事件阈值，变化分数不小于该值的帧被认为有运动
+ */
+#define FRAME_HISTORY_MOTION_THRESHOLD (16)
+/**
+ * @brief 两次运动之间间隔小于该时间(微秒)时合并为同一个事件
+ */
+#define FRAME_HISTORY_EVENT_GAP (2 * 1000 * 1000)
+
+/**
+ * @brief 画面变化(运动)事件
+ */
+struct MotionEvent
+{
+    int64_t Start;      ///< 开始时间(微秒，UTC)
+    int64_t End;        ///< 最后一次运动的时间(微秒，UTC)
+    uint32_t PeakScore; ///< 事件中最大的变化分数
+};
+
+/**
+ * @brief 编码帧历史缓存
+ * @details
+ *  保存最近一段时间的编码帧引用(不复制jpeg数据)，同时按照字节数和时长限制，
+ *  超出限制时在O(1)时间内淘汰最旧的帧。相邻帧复用同一份jpeg数据时只计算一次大小。
+ *  根据帧的变化分数记录运动事件，事件可以用来导出事件前后的画面。线程安全
+ */
+class FrameHistory : private Uncopyable
+{
+public:
+    FrameHistory();
+    /**
+     * @brief 设置缓存限制，任意一个限制为0时关闭缓存并清空
+     * @param  seconds          最多保存的时长(秒)
+     * @param  maxBytes         最多占用的jpeg数据字节数
+     */
+    void SetLimits(uint32_t seconds, size_t maxBytes);
+    /**
+     * @brief  缓存是否开启
+     * @return true  开启
+     * @return false 关闭
+     */
+    bool IsEnabled() const;
+    /**
+     * @brief 设置运动事件的变化分数阈值
+     * @param  threshold        变化分数阈值
+     */
+    void SetMotionThreshold(uint32_t threshold);
+    /**
+     * @brief  获取运动事件的变化分数阈值
+     * @return uint32_t 变化分数阈值
+     */
+    uint32_t MotionThreshold() const;
+    /**
+     * @brief 添加新的编码帧，时间为帧的采集时间，没有采集时间时为当前时间
+     * @param  frame            编码帧
+     */
+    void Push(const JpegFramePtr &frame);
+    /**
+     * @brief  获取时间范围内的帧
+     * @param  from             开始时间(微秒，UTC)
+     * @param  to               结束时间(微秒，UTC)
+     * @param  frames           输出帧
+     * @param  times            输出每一帧的时间，可以为nullptr
+     * @return size_t           帧数量
+     */
+    size_t Range(int64_t from, int64_t to, std::vector<JpegFramePtr> &frames, std::vector<int64_t> *times) const;
+    /**
+     * @brief  获取还有画面缓存的运动事件，按照时间从旧到新排列
+     * @return std::vector<MotionEvent> 运动事件
+     */
+    std::vector<MotionEvent> Events() const;
+    /**
+     * @brief 获取缓存状态
+     * @param  frames           帧数量
+     * @param  bytes            jpeg数据字节数
+     * @param  oldest           最旧帧的时间(微秒)，没有帧时为0
+     * @param  newest           最新帧的时间(微秒)，没有帧时为0
+     */
+    void Status(size_t *frames, size_t *bytes, int64_t *oldest, int64_t *newest) const;
+    /**
+     * @brief 清空缓存和事件
+     */
+    void Clear();
+
+private:
+    /**
+     * @brief 缓存项
+     */
+    struct Entry
+    {
+        JpegFramePtr Frame; ///< 编码帧
+        int64_t Time;       ///< 采集时间(微秒，UTC)
+        uint32_t Charge;    ///< 计入字节数的大小，与前一帧共享数据时为0
+    };
+    /**
+     * @brief 获取第index个缓存项，0 为最旧的帧
+     */
+    Entry &At(size_t index);
+    const Entry &At(size_t index) const;
+    /**
+     * @brief 淘汰最旧的帧
+     */
+    void PopOldest();
+    /**
+     * @brief 记录运动事件
+     */
+    void UpdateEvents(int64_t time, uint32_t score);
+
+private:
+    mutable std::mutex mGuard;        ///< 缓存锁
+    uint32_t mMaxSeconds;             ///< 最多保存的时长(秒)
+    size_t mMaxBytes;                 ///< 最多占用的字节数
+    uint32_t mMotionThreshold;        ///< 运动事件阈值
+    std::vector<Entry> mEntries;      ///< 环形存储，容量为2的幂
+    size_t mHead;                     ///< 最旧帧的位置
+    size_t mCount;                    ///< 帧数量
+    size_t mBytes;                    ///< 当前字节数
+    std::vector<MotionEvent> mEvents; ///< 运动事件
+};
+
+NAMESPACE_END
+
+#endif // FRAME_HISTORY_H
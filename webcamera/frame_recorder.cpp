@@ -0,0 +1,423 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include "frame_recorder.h"
+#include "video_source_to_webdata.h"
+#include "time_stamp.h"
+#include "logging.h"
+
+NAMESPACE_START
+
+/* AVI数据块的对齐填充 */
+static const uint8_t kPadding[1] = {0};
+
+FrameRecorder::FrameRecorder(const FrameRecorderOptions &options) : mOptions(options),
+                                                                    mRollSize((options.Format == RecordFormat::Avi) ? std::min<off_t>(options.RollSize, FRAME_RECORDER_AVI_MAX_SIZE) : options.RollSize),
+                                                                    mThread(std::bind(&FrameRecorder::ThreadFunc, this), "FrameRecorder"),
+                                                                    mRunning(false),
+                                                                    mGuard(),
+                                                                    mCondition(),
+                                                                    mQueue(std::max<uint32_t>(options.QueueSize, 1)),
+                                                                    mQueueHead(0),
+                                                                    mQueueCount(0),
+                                                                    mCurrentFile(),
+                                                                    mFd(-1),
+                                                                    mOffset(0),
+                                                                    mSyncedOffset(0),
+                                                                    mDroppedOffset(0),
+                                                                    mPeriodStart(0),
+                                                                    mFirstFrameTime(0),
+                                                                    mLastFrameTime(0),
+                                                                    mLastBuffer(),
+                                                                    mLastSegmentTime(0),
+                                                                    mSegmentIndex(0),
+                                                                    mAvi(),
+                                                                    mIov(),
+                                                                    mPendingBytes(0),
+                                                                    mChunkHeaders(FRAME_RECORDER_MAX_IOV * AVI_CHUNK_HEADER_SIZE),
+                                                                    mFramesWritten(0),
+                                                                    mFramesDropped(0),
+                                                                    mBytesWritten(0),
+                                                                    mSegments(0),
+                                                                    mWriteErrors(0)
+{
+    mIov.reserve(FRAME_RECORDER_MAX_IOV);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    Stop();
+}
+
+Error FrameRecorder::Start()
+{
+    if (mRunning)
+    {
+        return Error::Success;
+    }
+    if (access(mOptions.Directory.c_str(), W_OK) != 0)
+    {
+        LOG_ERROR << "Record directory " << mOptions.Directory << " is not writable";
+        return Error::IOError;
+    }
+    mRunning = true;
+    mThread.start();
+    return Error::Success;
+}
+
+void FrameRecorder::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mGuard);
+        if (!mRunning)
+        {
+            return;
+        }
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    mThread.join();
+}
+
+// 只在锁内交换引用，编码线程不会等待磁盘
+bool FrameRecorder::Push(const JpegFramePtr &frame)
+{
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    {
+        std::lock_guard<std::mutex> lock(mGuard);
+        if (!mRunning)
+        {
+            return false;
+        }
+        if (mQueueCount == mQueue.size())
+        {
+            mFramesDropped++;
+            return false;
+        }
+        QueuedFrame &slot = mQueue[(mQueueHead + mQueueCount) % mQueue.size()];
+        slot.Frame = frame;
+        slot.Time = now;
+        mQueueCount++;
+    }
+    mCondition.notify_one();
+    return true;
+}
+
+FrameRecorderStats FrameRecorder::Stats() const
+{
+    FrameRecorderStats stats;
+
+    stats.FramesWritten = mFramesWritten;
+    stats.FramesDropped = mFramesDropped;
+    stats.BytesWritten = mBytesWritten;
+    stats.Segments = mSegments;
+    stats.WriteErrors = mWriteErrors;
+    return stats;
+}
+
+std::string FrameRecorder::CurrentFile() const
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    return mCurrentFile;
+}
+
+void FrameRecorder::ThreadFunc()
+{
+    std::vector<QueuedFrame> batch;
+    batch.reserve(mQueue.size());
+
+    for (;;)
+    {
+        bool running = true;
+        {
+            std::unique_lock<std::mutex> lock(mGuard);
+            // 没有新帧时定时醒来，检查按时间滚动
+            if ((mQueueCount == 0) && (mRunning))
+            {
+                mCondition.wait_for(lock, std::chrono::seconds(1));
+            }
+            while (mQueueCount > 0)
+            {
+                batch.push_back(QueuedFrame());
+                batch.back().Frame.swap(mQueue[mQueueHead].Frame);
+                batch.back().Time = mQueue[mQueueHead].Time;
+                mQueueHead = (mQueueHead + 1) % mQueue.size();
+                mQueueCount--;
+            }
+            running = mRunning;
+        }
+
+        WriteBatch(batch);
+        // 在IO线程中释放帧的引用
+        batch.clear();
+
+        if (!running)
+        {
+            break;
+        }
+        if ((mFd >= 0) && (NeedRoll(Timestamp::now().microSecondsSinceEpoch())))
+        {
+            CloseSegment(true);
+        }
+    }
+    CloseSegment(true);
+}
+
+void FrameRecorder::WriteBatch(std::vector<QueuedFrame> &batch)
+{
+    const bool avi = (mOptions.Format == RecordFormat::Avi);
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const QueuedFrame &queued = batch[i];
+
+        if ((mFd >= 0) && (NeedRoll(queued.Time)))
+        {
+            CloseSegment(FlushIov());
+        }
+        if ((mFd < 0) && (!OpenSegment(queued)))
+        {
+            mFramesDropped++;
+            continue;
+        }
+        if ((mIov.size() + 3 > FRAME_RECORDER_MAX_IOV) && (!FlushIov()))
+        {
+            CloseSegment(false);
+            mFramesDropped++;
+            continue;
+        }
+
+        const JpegFrame &frame = *queued.Frame;
+        if (avi)
+        {
+            // 画面没有变化的帧复用同一份数据，写入空的数据块，播放器会重复上一帧
+            uint32_t size = (frame.Buffer == mLastBuffer) ? 0 : frame.Size;
+            uint8_t *header = mChunkHeaders.data() + mIov.size() * AVI_CHUNK_HEADER_SIZE;
+            uint32_t padding = mAvi.AddFrame(size, header);
+
+            mIov.push_back({header, AVI_CHUNK_HEADER_SIZE});
+            if (size != 0)
+            {
+                mIov.push_back({const_cast<uint8_t *>(frame.Data), size});
+            }
+            if (padding != 0)
+            {
+                mIov.push_back({const_cast<uint8_t *>(kPadding), padding});
+            }
+            mPendingBytes += AVI_CHUNK_HEADER_SIZE + size + padding;
+        }
+        else
+        {
+            mIov.push_back({const_cast<uint8_t *>(frame.Data), frame.Size});
+            mPendingBytes += frame.Size;
+        }
+
+        mLastBuffer = frame.Buffer;
+        mLastFrameTime = queued.Time;
+        mFramesWritten++;
+    }
+
+    if ((mFd >= 0) && (!FlushIov()))
+    {
+        CloseSegment(false);
+    }
+}
+
+bool FrameRecorder::FlushIov()
+{
+    size_t index = 0;
+
+    while (index < mIov.size())
+    {
+        ssize_t written = pwritev(mFd, &mIov[index], static_cast<int>(mIov.size() - index), mOffset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR << "Write " << mCurrentFile << " failed: " << strerror(errno);
+            mWriteErrors++;
+            mIov.clear();
+            mPendingBytes = 0;
+            return false;
+        }
+        mOffset += written;
+        mBytesWritten += static_cast<uint64_t>(written);
+
+        // 部分写入时调整剩余的数据块
+        while ((index < mIov.size()) && (static_cast<size_t>(written) >= mIov[index].iov_len))
+        {
+            written -= static_cast<ssize_t>(mIov[index].iov_len);
+            index++;
+        }
+        if (index < mIov.size())
+        {
+            mIov[index].iov_base = static_cast<uint8_t *>(mIov[index].iov_base) + written;
+            mIov[index].iov_len -= static_cast<size_t>(written);
+        }
+    }
+    mIov.clear();
+    mPendingBytes = 0;
+
+    // 启动新数据的回写；积累一定数据后等待落盘并释放页缓存
+    sync_file_range(mFd, mSyncedOffset, mOffset - mSyncedOffset, SYNC_FILE_RANGE_WRITE);
+    if (mSyncedOffset - mDroppedOffset >= FRAME_RECORDER_SYNC_SIZE)
+    {
+        sync_file_range(mFd, mDroppedOffset, mSyncedOffset - mDroppedOffset,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(mFd, mDroppedOffset, mSyncedOffset - mDroppedOffset, POSIX_FADV_DONTNEED);
+        mDroppedOffset = mSyncedOffset;
+    }
+    mSyncedOffset = mOffset;
+    return true;
+}
+
+bool FrameRecorder::OpenSegment(const QueuedFrame &first)
+{
+    time_t now = static_cast<time_t>(first.Time / 1000000);
+    std::string fileName = SegmentFileName(now);
+
+    mFd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0)
+    {
+        LOG_ERROR << "Open " << fileName << " failed: " << strerror(errno);
+        mWriteErrors++;
+        return false;
+    }
+    // 预分配空间，减少文件系统碎片和写入时的元数据更新；不改变文件大小
+    if (mOptions.Preallocate)
+    {
+        fallocate(mFd, FALLOC_FL_KEEP_SIZE, 0, mRollSize);
+    }
+
+    mOffset = 0;
+    mSyncedOffset = 0;
+    mDroppedOffset = 0;
+    mPeriodStart = (mOptions.RollSeconds == 0) ? 0 : static_cast<int64_t>(now) / mOptions.RollSeconds * mOptions.RollSeconds;
+    mFirstFrameTime = first.Time;
+    mLastFrameTime = first.Time;
+    mLastBuffer.reset();
+    mSegments++;
+    {
+        std::lock_guard<std::mutex> lock(mGuard);
+        mCurrentFile = fileName;
+    }
+
+    if (mOptions.Format == RecordFormat::Avi)
+    {
+        int32_t width = 0;
+        int32_t height = 0;
+        uint8_t header[AVI_HEADER_SIZE];
+
+        AviWriter::JpegImageSize(first.Frame->Data, first.Frame->Size, &width, &height);
+        mAvi.Reset(width, height, 0);
+        // 先写入没有帧的头部，关闭时再更新
+        mAvi.BuildHeader(header);
+        if (pwrite(mFd, header, AVI_HEADER_SIZE, 0) != AVI_HEADER_SIZE)
+        {
+            LOG_ERROR << "Write " << fileName << " failed: " << strerror(errno);
+            mWriteErrors++;
+            CloseSegment(false);
+            return false;
+        }
+        mOffset = AVI_HEADER_SIZE;
+        mBytesWritten += AVI_HEADER_SIZE;
+    }
+    LOG_INFO << "Recording to " << fileName;
+    return true;
+}
+
+void FrameRecorder::CloseSegment(bool finalize)
+{
+    if (mFd < 0)
+    {
+        return;
+    }
+
+    if ((finalize) && (mOptions.Format == RecordFormat::Avi))
+    {
+        uint32_t frames = mAvi.FrameCount();
+        std::string index;
+        uint8_t header[AVI_HEADER_SIZE];
+
+        // 帧率按照分段内的平均帧间隔计算
+        mAvi.SetFrameInterval((frames > 1) ? static_cast<uint32_t>((mLastFrameTime - mFirstFrameTime) / (frames - 1)) : 100000);
+        mAvi.BuildIndex(&index);
+        mAvi.BuildHeader(header);
+        if ((pwrite(mFd, index.data(), index.size(), mOffset) != static_cast<ssize_t>(index.size())) ||
+            (pwrite(mFd, header, AVI_HEADER_SIZE, 0) != AVI_HEADER_SIZE))
+        {
+            LOG_ERROR << "Finalize " << mCurrentFile << " failed: " << strerror(errno);
+            mWriteErrors++;
+        }
+        else
+        {
+            mOffset += static_cast<off_t>(index.size());
+            mBytesWritten += index.size();
+        }
+    }
+
+    // 释放预分配但没有使用的空间
+    if (ftruncate(mFd, mOffset) != 0)
+    {
+        mWriteErrors++;
+    }
+    close(mFd);
+    mFd = -1;
+    mIov.clear();
+    mPendingBytes = 0;
+    mLastBuffer.reset();
+
+    std::lock_guard<std::mutex> lock(mGuard);
+    mCurrentFile.clear();
+}
+
+bool FrameRecorder::NeedRoll(int64_t now) const
+{
+    // 还没有提交的数据块同样计入分段大小
+    if (mOffset + mPendingBytes >= mRollSize)
+    {
+        return true;
+    }
+    if (mOptions.RollSeconds == 0)
+    {
+        return false;
+    }
+    int64_t seconds = now / 1000000;
+    return (seconds / mOptions.RollSeconds * mOptions.RollSeconds != mPeriodStart);
+}
+
+std::string FrameRecorder::SegmentFileName(time_t now)
+{
+    char timebuf[32];
+    struct tm tm;
+    std::string fileName;
+
+    localtime_r(&now, &tm);
+    strftime(timebuf, sizeof(timebuf), ".%Y%m%d-%H%M%S", &tm);
+    fileName.reserve(mOptions.Directory.size() + mOptions.BaseName.size() + 32);
+    fileName = mOptions.Directory;
+    if ((!fileName.empty()) && (fileName.back() != '/'))
+    {
+        fileName += '/';
+    }
+    fileName += mOptions.BaseName;
+    fileName += timebuf;
+    // 按照大小滚动时同一秒内可能产生多个分段
+    mSegmentIndex = (now == mLastSegmentTime) ? mSegmentIndex + 1 : 0;
+    mLastSegmentTime = now;
+    if (mSegmentIndex > 0)
+    {
+        fileName += '.';
+        fileName += std::to_string(mSegmentIndex);
+    }
+    fileName += (mOptions.Format == RecordFormat::Avi) ? ".avi" : ".mjpeg";
+    return fileName;
+}
+
+NAMESPACE_END
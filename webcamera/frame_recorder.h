@@ -0,0 +1,238 @@
+/**
+ * @file frame_recorder.h
+ * @brief 编码帧异步分段录像
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 16:31:52
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 16:31:52 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 独立IO线程写入MJPEG AVI/JPEG序列分段文件 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <condition_variable>
+#include <sys/uio.h>
+#include "base_error.h"
+#include "base_thread.h"
+#include "avi_writer.h"
+
+NAMESPACE_START
+
+struct JpegFrame;
+class EncodedFrame;
+typedef std::shared_ptr<const JpegFrame> JpegFramePtr;
+
+/**
+ * @brief 默认的录像队列长度(帧)，磁盘跟不上时丢弃新的帧
+ */
+#define FRAME_RECORDER_QUEUE_SIZE (64)
+/**
+ * @brief 默认的分段大小
+ */
+#define FRAME_RECORDER_ROLL_SIZE (256 * 1024 * 1024)
+/**
+ * @brief 默认的分段时长(秒)
+ */
+#define FRAME_RECORDER_ROLL_SECONDS (10 * 60)
+/**
+ * @brief 单次 pwritev 最多提交的数据块数量
+ */
+#define FRAME_RECORDER_MAX_IOV (256)
+/**
+ * @brief 每次释放页缓存的最小数据量
+ */
+#define FRAME_RECORDER_SYNC_SIZE (8 * 1024 * 1024)
+/**
+ * @brief AVI分段的最大字节数，超出后部分播放器无法识别
+ */
+#define FRAME_RECORDER_AVI_MAX_SIZE (1024 * 1024 * 1024)
+
+/**
+ * @brief 录像文件格式
+ */
+enum class RecordFormat
+{
+    Avi,     ///< MJPEG AVI
+    RawJpeg, ///< 连续的jpeg数据(.mjpeg)，没有时间信息
+};
+
+/**
+ * @brief 录像参数
+ */
+struct FrameRecorderOptions
+{
+    FrameRecorderOptions() : Directory("."),
+                             BaseName("record"),
+                             Format(RecordFormat::Avi),
+                             RollSize(FRAME_RECORDER_ROLL_SIZE),
+                             RollSeconds(FRAME_RECORDER_ROLL_SECONDS),
+                             QueueSize(FRAME_RECORDER_QUEUE_SIZE),
+                             Preallocate(true)
+    {
+    }
+
+    std::string Directory; ///< 录像目录
+    std::string BaseName;  ///< 文件名前缀，文件名为 前缀.时间.avi
+    RecordFormat Format;   ///< 文件格式
+    off_t RollSize;        ///< 单个分段的最大字节数
+    uint32_t RollSeconds;  ///< 单个分段的最长时间，按照时间对齐
+    uint32_t QueueSize;    ///< 等待写入的最大帧数
+    bool Preallocate;      ///< 是否使用 fallocate 预分配分段空间
+};
+
+/**
+ * @brief 录像统计信息
+ */
+struct FrameRecorderStats
+{
+    uint64_t FramesWritten; ///< 写入的帧数
+    uint64_t FramesDropped; ///< 队列已满丢弃的帧数
+    uint64_t BytesWritten;  ///< 写入的字节数
+    uint64_t Segments;      ///< 创建的分段数量
+    uint64_t WriteErrors;   ///< 写入失败的次数
+};
+
+/**
+ * @brief 编码帧录像
+ * @details
+ *  Push 只把帧的引用放入固定长度的队列，不会阻塞调用线程，队列已满时丢弃并计数；
+ *  独立的IO线程批量取出帧，使用 pwritev 一次写入多个块头部和jpeg数据，
+ *  分段文件按照大小和时间滚动(与 LogFile 相同的规则)，创建时使用 fallocate 预分配，
+ *  关闭时写入索引和头部并截断到实际大小。写入之后通过 sync_file_range 提前回写，
+ *  并释放已经落盘的页缓存，避免录像占满内存
+ */
+class FrameRecorder : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Frame Recorder object
+     * @param  options          录像参数
+     */
+    explicit FrameRecorder(const FrameRecorderOptions &options);
+    ~FrameRecorder();
+    /**
+     * @brief  启动IO线程
+     * @return Error            录像目录不可写时返回 IOError
+     */
+    Error Start();
+    /**
+     * @brief 停止IO线程，写完队列中的帧并关闭当前分段
+     */
+    void Stop();
+    /**
+     * @brief 添加需要录像的帧，不阻塞
+     * @param  frame            编码帧
+     * @return true  已经加入队列
+     * @return false 队列已满，帧被丢弃
+     */
+    bool Push(const JpegFramePtr &frame);
+    /**
+     * @brief  获取统计信息
+     * @return FrameRecorderStats 统计信息
+     */
+    FrameRecorderStats Stats() const;
+    /**
+     * @brief  当前分段的文件名
+     * @return std::string 文件名，没有打开的分段时为空
+     */
+    std::string CurrentFile() const;
+
+private:
+    /**
+     * @brief 等待写入的帧
+     */
+    struct QueuedFrame
+    {
+        JpegFramePtr Frame; ///< 编码帧
+        int64_t Time;       ///< 加入队列的时间(微秒)
+    };
+
+    /**
+     * @brief IO线程
+     */
+    void ThreadFunc();
+    /**
+     * @brief 批量写入帧
+     */
+    void WriteBatch(std::vector<QueuedFrame> &batch);
+    /**
+     * @brief 提交累积的数据块，并启动回写
+     */
+    bool FlushIov();
+    /**
+     * @brief 打开新的分段
+     */
+    bool OpenSegment(const QueuedFrame &first);
+    /**
+     * @brief 关闭当前分段
+     * @param  finalize         是否写入索引和头部，写入失败时直接关闭
+     */
+    void CloseSegment(bool finalize);
+    /**
+     * @brief 当前分段是否需要滚动
+     */
+    bool NeedRoll(int64_t now) const;
+    /**
+     * @brief 生成分段文件名，同一秒内的多个分段添加序号
+     */
+    std::string SegmentFileName(time_t now);
+
+private:
+    const FrameRecorderOptions mOptions; ///< 录像参数
+    const off_t mRollSize;               ///< 分段大小，AVI格式不超过 FRAME_RECORDER_AVI_MAX_SIZE
+    Thread mThread;                      ///< IO线程
+    std::atomic<bool> mRunning;          ///< 是否正在运行
+
+    mutable std::mutex mGuard;          ///< 队列锁
+    std::condition_variable mCondition; ///< 新帧通知
+    std::vector<QueuedFrame> mQueue;    ///< 固定长度的环形队列
+    size_t mQueueHead;                  ///< 队列头
+    size_t mQueueCount;                 ///< 队列中的帧数
+    std::string mCurrentFile;           ///< 当前分段文件名
+
+    // 以下成员只在IO线程中使用
+    int mFd;                                  ///< 当前分段文件
+    off_t mOffset;                            ///< 当前写入位置
+    off_t mSyncedOffset;                      ///< 已经开始回写的位置
+    off_t mDroppedOffset;                     ///< 已经释放页缓存的位置
+    int64_t mPeriodStart;                     ///< 分段所在时间周期的开始(秒)
+    int64_t mFirstFrameTime;                  ///< 分段第一帧的时间
+    int64_t mLastFrameTime;                   ///< 分段最后一帧的时间
+    std::shared_ptr<const EncodedFrame> mLastBuffer; ///< 上一帧的jpeg数据，持有引用避免缓冲池在同一地址复用；重复的帧写入空数据块
+    time_t mLastSegmentTime;                  ///< 上一个分段的创建时间(秒)
+    uint32_t mSegmentIndex;                   ///< 同一秒内的分段序号
+    AviWriter mAvi;                           ///< AVI格式信息
+    std::vector<struct iovec> mIov;           ///< 等待提交的数据块
+    off_t mPendingBytes;                      ///< mIov 中等待提交的字节数
+    std::vector<uint8_t> mChunkHeaders;       ///< 数据块头部存储，与 mIov 一一对应
+
+    std::atomic<uint64_t> mFramesWritten; ///< 写入的帧数
+    std::atomic<uint64_t> mFramesDropped; ///< 丢弃的帧数
+    std::atomic<uint64_t> mBytesWritten;  ///< 写入的字节数
+    std::atomic<uint64_t> mSegments;      ///< 分段数量
+    std::atomic<uint64_t> mWriteErrors;   ///< 写入失败次数
+};
+
+NAMESPACE_END
+
+#endif // FRAME_RECORDER_H
@@ -0,0 +1,98 @@
+#include "stream_tick_groups.h"
+#include "net_event_loop.h"
+#include "time_stamp.h"
+
+NAMESPACE_START
+
+StreamTickGroups::StreamTickGroups()
+{
+}
+
+StreamTickGroups::~StreamTickGroups()
+{
+}
+
+void StreamTickGroups::Add(net::EventLoop *loop, uint32_t interval, const TickCallback &callback)
+{
+    GroupPtr group;
+    bool created = false;
+
+    loop->assertInLoopThread();
+    {
+        std::lock_guard<std::mutex> lock(mGuard);
+        GroupPtr &item = mGroups[GroupKey(loop, interval)];
+        if (!item)
+        {
+            item = std::make_shared<Group>();
+            item->Loop = loop;
+            item->Interval = interval;
+            item->Ticking = false;
+            created = true;
+        }
+        group = item;
+    }
+    // 分组的成员只在loop线程中修改，不需要持有锁；触发过程中加入的成员在本次处理完成之后追加
+    if (group->Ticking)
+    {
+        group->Added.push_back(callback);
+    }
+    else
+    {
+        group->Members.push_back(callback);
+    }
+    if (created)
+    {
+        loop->runAfter(interval / 1000.0, std::bind(&StreamTickGroups::Tick, this, group));
+    }
+}
+
+size_t StreamTickGroups::GroupCount()
+{
+    std::lock_guard<std::mutex> lock(mGuard);
+    return mGroups.size();
+}
+
+void StreamTickGroups::Tick(const GroupPtr &group)
+{
+    Timestamp startTime = Timestamp::now();
+
+    std::vector<TickCallback> &members = group->Members;
+    size_t kept = 0;
+
+    // 原地删除结束的成员；回调中加入的成员(例如修改帧率的连接重新加入分组)暂存在 Added 中，
+    // 处理过程中 Members 不会重新分配
+    group->Ticking = true;
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        if (members[i]())
+        {
+            if (kept != i)
+            {
+                members[kept] = std::move(members[i]);
+            }
+            kept++;
+        }
+    }
+    members.erase(members.begin() + kept, members.end());
+    group->Ticking = false;
+    for (size_t i = 0; i < group->Added.size(); i++)
+    {
+        members.push_back(std::move(group->Added[i]));
+    }
+    group->Added.clear();
+
+    if (members.empty())
+    {
+        // 同一个loop的 Add 也在本线程中，删除之后再加入时重新创建分组
+        std::lock_guard<std::mutex> lock(mGuard);
+        mGroups.erase(GroupKey(group->Loop, group->Interval));
+        return;
+    }
+
+    int64_t handlingTime = Timestamp::now().microSecondsSinceEpoch() - startTime.microSecondsSinceEpoch();
+    int64_t interval = static_cast<int64_t>(group->Interval) * 1000;
+    int64_t nextTimespace = (handlingTime >= interval) ? 1000 : interval - handlingTime;
+    group->Loop->runAfter(static_cast<double>(nextTimespace) / 1000000.0, std::bind(&StreamTickGroups::Tick, this, group));
+}
+
+NAMESPACE_END
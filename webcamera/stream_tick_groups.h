@@ -0,0 +1,101 @@
+/**
+ * @file stream_tick_groups.h
+ * @brief 按照事件循环和发送间隔分组的流连接定时发送
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 23:48:16
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 23:48:16 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 相同帧率的订阅者共享一个定时器 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef STREAM_TICK_GROUPS_H
+#define STREAM_TICK_GROUPS_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include "uncopyable.h"
+#include "base_define.h"
+
+NAMESPACE_START
+
+namespace net
+{
+    class EventLoop;
+}
+
+/**
+ * @brief 流连接的定时发送分组
+ * @details
+ *  同一个事件循环中发送间隔相同的连接属于同一组，每组只有一个定时器，
+ *  每次触发时依次处理组内的所有连接；例如2fps的大屏和30fps的操作台各自只有一个定时器，
+ *  它们订阅的编码档位相同时共享同一份编码结果。
+ *  每组的成员只在所属事件循环的线程中访问，分组表由锁保护
+ */
+class StreamTickGroups : private Uncopyable
+{
+public:
+    /**
+     * @brief 成员的定时回调，返回 false 时从分组中移除
+     */
+    typedef std::function<bool()> TickCallback;
+
+    StreamTickGroups();
+    ~StreamTickGroups();
+    /**
+     * @brief  加入分组，需要在 loop 的线程中调用；分组不存在时创建并在一个间隔之后开始触发
+     * @param  loop             连接所在的事件循环
+     * @param  interval         发送间隔(毫秒)
+     * @param  callback         每次触发时调用
+     */
+    void Add(net::EventLoop *loop, uint32_t interval, const TickCallback &callback);
+    /**
+     * @brief  当前的分组数量
+     * @return size_t 数量
+     */
+    size_t GroupCount();
+
+private:
+    /**
+     * @brief 一个事件循环中相同发送间隔的连接
+     */
+    struct Group
+    {
+        net::EventLoop *Loop;              ///< 所在的事件循环
+        uint32_t Interval;                 ///< 发送间隔(毫秒)
+        std::vector<TickCallback> Members; ///< 成员的回调
+        std::vector<TickCallback> Added;   ///< 触发过程中加入的成员
+        bool Ticking;                      ///< 是否正在处理成员
+    };
+    typedef std::shared_ptr<Group> GroupPtr;
+    typedef std::pair<net::EventLoop *, uint32_t> GroupKey;
+
+    /**
+     * @brief  处理组内的所有成员，并按照处理时间设置下一次触发
+     * @param  group            分组
+     */
+    void Tick(const GroupPtr &group);
+
+    std::mutex mGuard;                   ///< 分组表的锁
+    std::map<GroupKey, GroupPtr> mGroups; ///< 分组表
+};
+
+NAMESPACE_END
+
+#endif // STREAM_TICK_GROUPS_H
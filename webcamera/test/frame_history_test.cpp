@@ -0,0 +1,190 @@
+#include "frame_history.h"
+#include "video_source_to_webdata.h"
+#include "encoded_frame.h"
+#include "test_check.h"
+
+#include <string.h>
+
+using namespace MY_NAME_SPACE;
+
+static const int64_t kSecond = 1000 * 1000;
+static const int64_t kBaseTime = 1700000000LL * kSecond;
+
+/* 生成指定大小和采集时间(微秒)的压缩帧 */
+static std::shared_ptr<EncodedFrame> MakeBuffer(uint32_t size, int64_t time)
+{
+    std::shared_ptr<EncodedFrame> buffer = EncodedFrame::Allocate(size, FrameCodec::JPEG);
+    struct timeval timeStamp;
+
+    memset(buffer->Data(), 0, size);
+    buffer->SetSize(size);
+    timeStamp.tv_sec = time / kSecond;
+    timeStamp.tv_usec = time % kSecond;
+    buffer->SetTimeStamp(timeStamp);
+    return buffer;
+}
+
+static JpegFramePtr MakeFrame(const std::shared_ptr<EncodedFrame> &buffer, uint64_t sequence)
+{
+    return std::make_shared<JpegFrame>(buffer, sequence);
+}
+
+static JpegFramePtr MakeFrame(uint32_t size, int64_t time, uint64_t sequence)
+{
+    return MakeFrame(MakeBuffer(size, time), sequence);
+}
+
+/* 帧的时间使用采集时间，而不是添加时间 */
+static void TestCaptureTime()
+{
+    FrameHistory history;
+    std::vector<JpegFramePtr> frames;
+    std::vector<int64_t> times;
+    size_t count = 0;
+    size_t bytes = 0;
+    int64_t oldest = 0;
+    int64_t newest = 0;
+
+    history.SetLimits(60, 1024 * 1024);
+    history.Push(MakeFrame(100, kBaseTime, 1));
+    history.Push(MakeFrame(100, kBaseTime + kSecond / 10, 2));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check(count == 2, "two frames cached");
+    Check(oldest == kBaseTime, "oldest time is the capture time");
+    Check(newest == kBaseTime + kSecond / 10, "newest time is the capture time");
+
+    // 时间向回调整时保持时间顺序
+    history.Push(MakeFrame(100, kBaseTime, 3));
+    history.Range(kBaseTime, kBaseTime + kSecond, frames, &times);
+    Check((times.size() == 3) && (times[2] == times[1]), "time does not go backwards");
+}
+
+/* 超出时长时按照时间顺序淘汰最旧的帧 */
+static void TestEvictionOrder()
+{
+    FrameHistory history;
+    std::vector<JpegFramePtr> frames;
+    std::vector<int64_t> times;
+
+    history.SetLimits(2, 1024 * 1024);
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        history.Push(MakeFrame(100, kBaseTime + static_cast<int64_t>(i) * kSecond / 2, i));
+    }
+    // 最新帧时间为4.5秒，2秒窗口内保留2.5秒之后的帧
+    history.Range(0, kBaseTime + 10 * kSecond, frames, &times);
+    Check(frames.size() == 5, "frames outside the window are evicted");
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        Check(frames[i]->Sequence == 5 + i, "remaining frames keep the push order");
+    }
+
+    // 超过初始容量之后环形存储扩展，顺序不变
+    history.SetLimits(3600, 1024 * 1024 * 1024);
+    history.Clear();
+    for (uint64_t i = 0; i < 200; i++)
+    {
+        history.Push(MakeFrame(10, kBaseTime + static_cast<int64_t>(i) * 1000, i));
+    }
+    history.Range(0, kBaseTime + 10 * kSecond, frames, nullptr);
+    Check(frames.size() == 200, "ring grows beyond the initial capacity");
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        Check(frames[i]->Sequence == i, "grown ring keeps the push order");
+    }
+}
+
+/* 字节数限制：超出时淘汰最旧的帧，单独超出限制的帧至少保留一帧 */
+static void TestByteBudget()
+{
+    FrameHistory history;
+    std::vector<JpegFramePtr> frames;
+    size_t count = 0;
+    size_t bytes = 0;
+    int64_t oldest = 0;
+    int64_t newest = 0;
+
+    history.SetLimits(3600, 1000);
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        history.Push(MakeFrame(300, kBaseTime + static_cast<int64_t>(i) * 1000, i));
+        history.Status(&count, &bytes, &oldest, &newest);
+        Check(bytes <= 1000, "bytes never exceed the budget");
+    }
+    Check((count == 3) && (bytes == 900), "three frames fit in the budget");
+    history.Range(0, kBaseTime + kSecond, frames, nullptr);
+    Check((frames.size() == 3) && (frames[0]->Sequence == 7), "oldest frames are evicted first");
+
+    history.Push(MakeFrame(5000, kBaseTime + kSecond, 10));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 1) && (bytes == 5000), "an oversized frame is kept alone");
+
+    // 修改限制之后按照新的限制淘汰
+    history.SetLimits(3600, 2000);
+    history.Push(MakeFrame(500, kBaseTime + kSecond + 1, 11));
+    history.Push(MakeFrame(500, kBaseTime + kSecond + 2, 12));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 2) && (bytes == 1000), "budget applies after the limit changes");
+    history.SetLimits(3600, 600);
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 1) && (bytes == 500), "shrinking the budget evicts immediately");
+}
+
+/* 相邻帧复用同一份jpeg数据时只计算一次，淘汰时由下一帧继续计入 */
+static void TestSharedBuffer()
+{
+    FrameHistory history;
+    std::shared_ptr<EncodedFrame> buffer = MakeBuffer(400, kBaseTime);
+    size_t count = 0;
+    size_t bytes = 0;
+    int64_t oldest = 0;
+    int64_t newest = 0;
+
+    history.SetLimits(3600, 1000);
+    history.Push(MakeFrame(buffer, 1));
+    history.Push(MakeFrame(buffer, 2));
+    history.Push(MakeFrame(buffer, 3));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 3) && (bytes == 400), "shared data is charged once");
+
+    history.Push(MakeFrame(400, kBaseTime + 1, 4));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 4) && (bytes == 800), "second buffer fits in the budget");
+
+    // 淘汰最旧的帧时共享数据的大小转移给下一帧，直到最后一个引用被淘汰
+    history.Push(MakeFrame(400, kBaseTime + 2, 5));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 2) && (bytes == 800), "shared data is released with its last reference");
+}
+
+/* 关闭缓存时清空并且不再添加 */
+static void TestDisabled()
+{
+    FrameHistory history;
+    size_t count = 0;
+    size_t bytes = 0;
+    int64_t oldest = 0;
+    int64_t newest = 0;
+
+    Check(!history.IsEnabled(), "history is disabled by default");
+    history.Push(MakeFrame(100, kBaseTime, 1));
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check(count == 0, "disabled history keeps no frames");
+
+    history.SetLimits(60, 1000);
+    history.Push(MakeFrame(100, kBaseTime, 1));
+    history.SetLimits(0, 1000);
+    history.Status(&count, &bytes, &oldest, &newest);
+    Check((count == 0) && (bytes == 0), "disabling clears the history");
+}
+
+int main()
+{
+    TestCaptureTime();
+    TestEvictionOrder();
+    TestByteBudget();
+    TestSharedBuffer();
+    TestDisabled();
+
+    return TestResult();
+}
@@ -0,0 +1,184 @@
+#include "frame_recorder.h"
+#include "video_source_to_webdata.h"
+#include "image_pool.h"
+#include "encoded_frame.h"
+#include "test_check.h"
+
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace MY_NAME_SPACE;
+
+static const uint32_t kFrameSize = 1000;
+
+/* 从池中获取压缩帧，数据为jpeg开始标记加上fill */
+static std::shared_ptr<EncodedFrame> AcquireBuffer(ImagePool &pool, uint8_t fill)
+{
+    std::shared_ptr<EncodedFrame> buffer = pool.AcquireEncoded(kFrameSize, FrameCodec::JPEG);
+
+    memset(buffer->Data(), fill, kFrameSize);
+    buffer->Data()[0] = 0xFF;
+    buffer->Data()[1] = 0xD8;
+    buffer->SetSize(kFrameSize);
+    return buffer;
+}
+
+/* 等待IO线程写入指定数量的帧 */
+static bool WaitWritten(FrameRecorder &recorder, uint64_t frames)
+{
+    for (int i = 0; i < 200; i++)
+    {
+        if (recorder.Stats().FramesWritten >= frames)
+        {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+/* 读取AVI文件 movi 列表中每个数据块的大小和第一个数据字节 */
+static bool ReadChunks(const std::string &fileName, std::vector<uint32_t> &sizes, std::vector<uint8_t> &firstBytes)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t pos = AVI_HEADER_SIZE;
+
+    if (data.size() < AVI_HEADER_SIZE)
+    {
+        return false;
+    }
+    while ((pos + AVI_CHUNK_HEADER_SIZE <= data.size()) && (memcmp(&data[pos], "00dc", 4) == 0))
+    {
+        uint32_t size = data[pos + 4] | (data[pos + 5] << 8) | (data[pos + 6] << 16) | (static_cast<uint32_t>(data[pos + 7]) << 24);
+        pos += AVI_CHUNK_HEADER_SIZE;
+        if (pos + size > data.size())
+        {
+            return false;
+        }
+        sizes.push_back(size);
+        firstBytes.push_back((size > 2) ? data[pos + 2] : 0);
+        pos += size + (size & 1);
+    }
+    return true;
+}
+
+/* 缓冲池在同一地址复用的不同帧都写入数据，同一份数据的重复帧写入空数据块 */
+static void TestRecycledBuffer()
+{
+    char directory[] = "/tmp/frame_recorder_test.XXXXXX";
+    ImagePool pool;
+    FrameRecorderOptions options;
+    std::vector<uint32_t> sizes;
+    std::vector<uint8_t> firstBytes;
+    std::string fileName;
+
+    // 池会在同一地址复用刚刚释放的压缩帧
+    std::shared_ptr<EncodedFrame> probe = AcquireBuffer(pool, 0);
+    const EncodedFrame *slot = probe.get();
+    probe.reset();
+    probe = AcquireBuffer(pool, 0);
+    Check(probe.get() == slot, "pool recycles the released slot");
+    probe.reset();
+
+    Check(mkdtemp(directory) != nullptr, "create record directory");
+    options.Directory = directory;
+    options.Preallocate = false;
+    FrameRecorder recorder(options);
+    Check(recorder.Start() == Error::Success, "recorder starts");
+
+    {
+        std::shared_ptr<EncodedFrame> first = AcquireBuffer(pool, 0x11);
+        Check(recorder.Push(std::make_shared<JpegFrame>(first, 1)), "push first frame");
+    }
+    // 第一帧写入并且释放引用之后再获取第二帧，旧的实现中第二帧会复用同一个缓冲区
+    Check(WaitWritten(recorder, 1), "first frame written");
+    std::shared_ptr<EncodedFrame> second = AcquireBuffer(pool, 0x22);
+    Check(recorder.Push(std::make_shared<JpegFrame>(second, 2)), "push second frame");
+    Check(recorder.Push(std::make_shared<JpegFrame>(second, 3)), "push repeated frame");
+    Check(WaitWritten(recorder, 3), "all frames written");
+    fileName = recorder.CurrentFile();
+    recorder.Stop();
+
+    Check(ReadChunks(fileName, sizes, firstBytes), "read avi chunks");
+    Check(sizes.size() == 3, "three chunks recorded");
+    if (sizes.size() == 3)
+    {
+        Check((sizes[0] == kFrameSize) && (firstBytes[0] == 0x11), "first frame data is recorded");
+        Check((sizes[1] == kFrameSize) && (firstBytes[1] == 0x22), "distinct frame in a recycled slot is recorded");
+        Check(sizes[2] == 0, "repeated frame is an empty chunk");
+    }
+
+    unlink(fileName.c_str());
+    rmdir(directory);
+}
+
+/* 一次写入多帧时，等待提交的帧也计入分段大小，分段最多超出一帧 */
+static void TestRollSize()
+{
+    char directory[] = "/tmp/frame_recorder_test.XXXXXX";
+    ImagePool pool;
+    FrameRecorderOptions options;
+    std::vector<std::shared_ptr<EncodedFrame> > buffers;
+    const uint64_t frames = 40;
+    const off_t chunkSize = AVI_CHUNK_HEADER_SIZE + kFrameSize;
+    size_t segments = 0;
+    size_t chunks = 0;
+
+    Check(mkdtemp(directory) != nullptr, "create record directory");
+    options.Directory = directory;
+    options.Preallocate = false;
+    options.RollSize = AVI_HEADER_SIZE + 4 * chunkSize;
+    FrameRecorder recorder(options);
+    Check(recorder.Start() == Error::Success, "recorder starts");
+
+    // 连续提交，IO线程一次取出多帧
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        buffers.push_back(AcquireBuffer(pool, static_cast<uint8_t>(i)));
+        Check(recorder.Push(std::make_shared<JpegFrame>(buffers.back(), i + 1)), "push frame");
+    }
+    Check(WaitWritten(recorder, frames), "all frames written");
+    recorder.Stop();
+
+    DIR *dir = opendir(directory);
+    struct dirent *entry = nullptr;
+    while ((dir != nullptr) && ((entry = readdir(dir)) != nullptr))
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        std::string fileName = std::string(directory) + "/" + entry->d_name;
+        std::vector<uint32_t> sizes;
+        std::vector<uint8_t> firstBytes;
+
+        Check(ReadChunks(fileName, sizes, firstBytes), "read avi chunks");
+        off_t moviEnd = AVI_HEADER_SIZE + static_cast<off_t>(sizes.size()) * chunkSize;
+        Check(moviEnd < options.RollSize + chunkSize, "segment exceeds the roll size by at most one frame");
+        segments++;
+        chunks += sizes.size();
+        unlink(fileName.c_str());
+    }
+    if (dir != nullptr)
+    {
+        closedir(dir);
+    }
+    rmdir(directory);
+
+    Check(chunks == frames, "every frame is recorded");
+    Check(segments >= frames / 5, "segments roll by size");
+}
+
+int main()
+{
+    TestRecycledBuffer();
+    TestRollSize();
+
+    return TestResult();
+}
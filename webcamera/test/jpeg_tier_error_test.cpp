@@ -0,0 +1,126 @@
+#include "video_source_to_webdata.h"
+#include "jpeg_encoder.h"
+#include "image_pool.h"
+#include "encoded_frame.h"
+#include "test_check.h"
+
+#include <string.h>
+
+using namespace MY_NAME_SPACE;
+
+/* 彩色渐变图像的jpeg帧 */
+static std::shared_ptr<EncodedFrame> EncodeGradient(ImagePool &pool, int32_t width, int32_t height)
+{
+    std::shared_ptr<Image> image = Image::Allocate(width, height, PixelFormat::RGB24);
+    std::shared_ptr<EncodedFrame> frame;
+    JpegEncoder encoder(90);
+
+    for (int32_t y = 0; y < height; y++)
+    {
+        uint8_t *row = image->Data() + y * image->Stride();
+        for (int32_t x = 0; x < width; x++)
+        {
+            row[x * 3] = static_cast<uint8_t>(x * 255 / width);
+            row[x * 3 + 1] = static_cast<uint8_t>(y * 255 / height);
+            row[x * 3 + 2] = 128;
+        }
+    }
+    encoder.EncodeToFrame(image, pool, frame);
+    return frame;
+}
+
+/* 复制jpeg帧的前size字节，模拟视频源输出的不完整帧 */
+static std::shared_ptr<EncodedFrame> Truncate(const std::shared_ptr<EncodedFrame> &frame, uint32_t size)
+{
+    std::shared_ptr<EncodedFrame> truncated = EncodedFrame::Allocate(size, FrameCodec::JPEG);
+    memcpy(truncated->Data(), frame->Data(), size);
+    truncated->SetSize(size);
+    return truncated;
+}
+
+/* 扫描数据开始(SOS)的位置，在此截断时可以读取尺寸但无法解码 */
+static uint32_t ScanOffset(const std::shared_ptr<EncodedFrame> &frame)
+{
+    for (uint32_t i = 2; i + 1 < frame->Size(); i++)
+    {
+        if ((frame->Data()[i] == 0xFF) && (frame->Data()[i + 1] == 0xDA))
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/* 不完整的jpeg帧只让缩小档位跳过这一帧，原始分辨率档位的连接不受影响 */
+static void TestTruncatedFrame()
+{
+    ImagePool pool(8);
+    // 编码线程数为0时在调用 OnNewEncodedFrame 的线程中直接处理
+    VideoSourceToWebData data(85, 0);
+    JpegTier &full = data.Tier(0);
+    JpegTier &scaled = data.Tier(1);
+    std::shared_ptr<EncodedFrame> valid = EncodeGradient(pool, 640, 480);
+    uint32_t scanOffset = ScanOffset(valid);
+
+    Check(scaled.Scale > 1, "tier 1 is a scaled tier");
+    Check(scanOffset > 0, "jpeg has a scan");
+    uint64_t decodeFailed = scaled.DecodeFailedMetric->Value();
+    uint64_t encodeFailed = scaled.FailedMetric->Value();
+
+    // 模拟两个档位各有一个连接订阅，订阅时的帧序号用于判断之后的错误
+    full.Subscribers++;
+    scaled.Subscribers++;
+    data.VideoSourceListener.OnNewEncodedFrame(valid);
+    uint64_t subscribed = data.FrameSequence;
+    Check((full.Frame()) && (full.Frame()->Sequence == subscribed), "full tier publishes the frame");
+    Check((scaled.Frame()) && (scaled.Frame()->Sequence == subscribed), "scaled tier publishes the frame");
+
+    // 尺寸可以读取但扫描数据缺失，以及连尺寸都无法读取的两种不完整帧
+    const uint32_t sizes[] = {scanOffset, 16};
+    for (uint32_t size : sizes)
+    {
+        data.VideoSourceListener.OnNewEncodedFrame(Truncate(valid, size));
+        uint64_t sequence = data.FrameSequence;
+
+        // mjpeg/WebSocket 连接在 IsError 或者 IsTierFailed 时关闭
+        Check(!data.IsError(), "truncated frame does not set the global error");
+        Check(!data.IsTierFailed(0, subscribed), "full tier clients stay connected");
+        Check(!data.IsTierFailed(1, subscribed), "scaled tier clients stay connected");
+        Check((full.Frame()) && (full.Frame()->Sequence == sequence), "full tier keeps forwarding frames");
+        Check((scaled.Frame()) && (scaled.Frame()->Sequence == subscribed), "scaled tier skips the truncated frame");
+        Check(scaled.EncodedSequence == sequence, "truncated frame is not retried");
+    }
+    Check(scaled.DecodeFailedMetric->Value() == decodeFailed + 2, "skipped frames are counted");
+    Check(scaled.FailedMetric->Value() == encodeFailed, "skipped frames are not encoding failures");
+
+    // 之后的完整帧正常解码
+    data.VideoSourceListener.OnNewEncodedFrame(valid);
+    Check((scaled.Frame()) && (scaled.Frame()->Sequence == data.FrameSequence), "scaled tier recovers on the next frame");
+
+    full.Subscribers--;
+    scaled.Subscribers--;
+}
+
+/* 不是jpeg的压缩帧只影响订阅的档位 */
+static void TestUnsupportedCodec()
+{
+    VideoSourceToWebData data(85, 0);
+    JpegTier &full = data.Tier(0);
+    std::shared_ptr<EncodedFrame> frame = EncodedFrame::Allocate(64, FrameCodec::Unknown);
+
+    frame->SetSize(64);
+    full.Subscribers++;
+    data.VideoSourceListener.OnNewEncodedFrame(frame);
+    Check(!data.IsError(), "unsupported frame does not set the global error");
+    Check(data.IsTierFailed(0, 0), "unsupported frame fails the subscribed tier");
+    Check(!data.IsTierFailed(1, 0), "other tiers are not affected");
+    full.Subscribers--;
+}
+
+int main()
+{
+    TestTruncatedFrame();
+    TestUnsupportedCodec();
+
+    return TestResult();
+}
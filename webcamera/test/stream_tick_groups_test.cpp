@@ -0,0 +1,68 @@
+#include "stream_tick_groups.h"
+#include "net_event_loop.h"
+#include "test_check.h"
+
+using namespace MY_NAME_SPACE;
+
+/* 相同事件循环和间隔的成员共享一个分组，返回 false 的成员被移除，其他成员继续触发 */
+static void TestGrouping()
+{
+    net::EventLoop loop;
+    StreamTickGroups groups;
+    int fast[3] = {0, 0, 0};
+    int slow = 0;
+    size_t groupCount = 0;
+
+    groups.Add(&loop, 10, [&fast]() { return ++fast[0] > 0; });
+    // 第二个成员触发3次之后结束，位于两个继续运行的成员之间
+    groups.Add(&loop, 10, [&fast]() { return ++fast[1] < 3; });
+    groups.Add(&loop, 10, [&fast]() { return ++fast[2] > 0; });
+    groups.Add(&loop, 40, [&slow]() { return ++slow > 0; });
+    groupCount = groups.GroupCount();
+
+    loop.runAfter(0.3, [&loop]() { loop.quit(); });
+    loop.loop();
+
+    Check(groupCount == 2, "members with the same interval share a group");
+    Check(fast[1] == 3, "finished member is removed");
+    Check((fast[0] > 10) && (fast[0] == fast[2]), "remaining members keep ticking in the same group");
+    Check((slow > 2) && (slow < fast[0]), "slower group ticks at its own interval");
+}
+
+/* 回调中加入同一个分组的成员从下一次触发开始处理；所有成员结束之后删除分组 */
+static void TestAddWhileTicking()
+{
+    net::EventLoop loop;
+    StreamTickGroups groups;
+    int parent = 0;
+    int children = 0;
+    size_t finalGroups = 1;
+
+    groups.Add(&loop, 10, [&]() {
+        parent++;
+        // 每次触发都加入新的成员，迫使成员列表扩容
+        groups.Add(&loop, 10, [&children]() {
+            children++;
+            return false;
+        });
+        return parent < 5;
+    });
+
+    loop.runAfter(0.2, [&]() {
+        finalGroups = groups.GroupCount();
+        loop.quit();
+    });
+    loop.loop();
+
+    Check(parent == 5, "member runs until it returns false");
+    Check(children == 5, "members added while ticking run once on the next tick");
+    Check(finalGroups == 0, "empty group is removed");
+}
+
+int main()
+{
+    TestGrouping();
+    TestAddWhileTicking();
+
+    return TestResult();
+}
@@ -0,0 +1,134 @@
+#include "tier_ladder.h"
+#include "test_check.h"
+
+using namespace MY_NAME_SPACE;
+
+static const uint32_t kScales[] = {1, 2, 4};
+static const size_t kTierCount = sizeof(kScales) / sizeof(kScales[0]);
+static const uint32_t kInterval = 33;
+static const uint32_t kFrameSize = 10000;
+
+/* 模拟一次发送：写入 sent 字节之后，经过 elapsed 微秒缓冲区中还剩 queued 字节 */
+static void Tick(TierLadder &ladder, size_t sent, size_t queued, int64_t elapsed)
+{
+    ladder.OnSent(sent);
+    ladder.Measure(queued, elapsed);
+}
+
+/* 连续拥塞最多 ticks 次，返回第一次切换之后的档位 */
+static size_t Congest(TierLadder &ladder, size_t tier, uint32_t ticks)
+{
+    size_t next = tier;
+    for (uint32_t i = 0; (i < ticks) && (next == tier); i++)
+    {
+        next = ladder.Select(2 * kFrameSize, kFrameSize, kInterval, tier, kScales, kTierCount);
+    }
+    return next;
+}
+
+/* 吞吐量只在输出缓冲区减少时计入，按照 3:1 平滑 */
+static void TestThroughput()
+{
+    TierLadder ladder;
+
+    ladder.Reset(kInterval);
+    Tick(ladder, 100000, 0, 1000000);
+    Check(ladder.Throughput() == 100000, "first sample sets the throughput");
+    Tick(ladder, 100000, 100000, 1000000);
+    Check(ladder.Throughput() == 75000, "nothing drained lowers the smoothed throughput");
+    Tick(ladder, 0, 0, 0);
+    Check(ladder.Throughput() == 75000, "zero elapsed time is ignored");
+}
+
+/* 连续拥塞 TIER_LADDER_DOWN_TICKS 次之后降档，吞吐量足够时只降一档，不足时跳过中间的档位 */
+static void TestStepDown()
+{
+    TierLadder ladder;
+
+    ladder.Reset(kInterval);
+    Tick(ladder, 1000000, 0, 1000000);
+    for (uint32_t i = 1; i < TIER_LADDER_DOWN_TICKS; i++)
+    {
+        Check(ladder.Select(2 * kFrameSize, kFrameSize, kInterval, 0, kScales, kTierCount) == 0, "short congestion keeps the tier");
+    }
+    // 中间有一次没有积压，重新计数
+    Check(ladder.Select(0, kFrameSize, kInterval, 0, kScales, kTierCount) == 0, "drained buffer keeps the tier");
+    Check(Congest(ladder, 0, TIER_LADDER_DOWN_TICKS - 1) == 0, "congestion count restarts after a drained tick");
+    Check(ladder.Select(2 * kFrameSize, kFrameSize, kInterval, 0, kScales, kTierCount) == 1,
+          "enough throughput for the next tier steps down one tier");
+
+    // 1/2 分辨率每秒约 75KB，吞吐量只有 10KB/s 时直接降到最低档
+    ladder.Reset(kInterval);
+    Tick(ladder, 10000, 0, 1000000);
+    Check(Congest(ladder, 0, TIER_LADDER_DOWN_TICKS) == 2, "low throughput skips the middle tier");
+
+    // 已经是最低档时不再降档
+    Check(Congest(ladder, 2, 2 * TIER_LADDER_DOWN_TICKS) == 2, "lowest tier stays");
+    // 还没有编码的档位不判断拥塞
+    Check(ladder.Select(1000000, 0, kInterval, 0, kScales, kTierCount) == 0, "unknown frame size keeps the tier");
+}
+
+/* 每次降档之后升档需要的稳定次数加倍，最多为 TIER_LADDER_UP_MAX_SECONDS */
+static void TestHoldDoubling()
+{
+    TierLadder ladder;
+    const uint32_t minHold = TIER_LADDER_UP_MIN_SECONDS * 1000 / kInterval;
+    const uint32_t maxHold = TIER_LADDER_UP_MAX_SECONDS * 1000 / kInterval;
+    uint32_t expected = minHold;
+
+    ladder.Reset(kInterval);
+    Tick(ladder, 1000000, 0, 1000000);
+    Check(ladder.UpgradeHoldTicks() == minHold, "hold starts at the minimum");
+    for (int i = 0; i < 6; i++)
+    {
+        Check(Congest(ladder, 0, TIER_LADDER_DOWN_TICKS) == 1, "congestion steps down");
+        expected = (expected * 2 < maxHold) ? expected * 2 : maxHold;
+        Check(ladder.UpgradeHoldTicks() == expected, "hold doubles after each step down");
+    }
+    Check(ladder.UpgradeHoldTicks() == maxHold, "hold is capped");
+
+    ladder.Reset(kInterval);
+    Check(ladder.UpgradeHoldTicks() == minHold, "reset restores the minimum hold");
+}
+
+/* 积压少于半帧的次数达到稳定次数之后升一档，中间出现拥塞时重新计数 */
+static void TestStepUp()
+{
+    TierLadder ladder;
+    const uint32_t hold = TIER_LADDER_UP_MIN_SECONDS * 1000 / kInterval;
+    uint32_t ticks = 0;
+
+    ladder.Reset(kInterval);
+    Check(ladder.Select(0, kFrameSize, kInterval, 0, kScales, kTierCount) == 0, "top tier stays");
+
+    for (uint32_t i = 1; i < hold; i++)
+    {
+        Check(ladder.Select(0, kFrameSize, kInterval, 2, kScales, kTierCount) == 2, "hold before stepping up");
+    }
+    // 半帧以上的积压不计入稳定次数
+    Check(ladder.Select(kFrameSize, kFrameSize, kInterval, 2, kScales, kTierCount) == 2, "partial backlog keeps the tier");
+    Check(ladder.Select(2 * kFrameSize, kFrameSize, kInterval, 2, kScales, kTierCount) == 2, "single congested tick keeps the tier");
+    while ((ladder.Select(0, kFrameSize, kInterval, 2, kScales, kTierCount) == 2) && (ticks < 10 * hold))
+    {
+        ticks++;
+    }
+    Check(ticks + 1 == hold, "stable count restarts after congestion");
+
+    // 升档之后重新计数，每次只升一档
+    ticks = 0;
+    while ((ladder.Select(0, kFrameSize, kInterval, 1, kScales, kTierCount) == 1) && (ticks < 10 * hold))
+    {
+        ticks++;
+    }
+    Check(ticks + 1 == hold, "next step up needs a full hold again");
+}
+
+int main()
+{
+    TestThroughput();
+    TestStepDown();
+    TestHoldDoubling();
+    TestStepUp();
+
+    return TestResult();
+}
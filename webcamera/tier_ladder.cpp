@@ -0,0 +1,84 @@
+#include "tier_ladder.h"
+#include <algorithm>
+
+NAMESPACE_START
+
+TierLadder::TierLadder() : mLastQueued(0),
+                           mLastSent(0),
+                           mThroughput(0),
+                           mCongestedTicks(0),
+                           mStableTicks(0),
+                           mUpgradeHoldTicks(0)
+{
+}
+
+void TierLadder::Reset(uint32_t frameInterval)
+{
+    mLastQueued = 0;
+    mLastSent = 0;
+    mThroughput = 0;
+    mCongestedTicks = 0;
+    mStableTicks = 0;
+    mUpgradeHoldTicks = TIER_LADDER_UP_MIN_SECONDS * 1000 / frameInterval;
+}
+
+void TierLadder::OnSent(size_t bytes)
+{
+    mLastSent = bytes;
+}
+
+void TierLadder::Measure(size_t queued, int64_t elapsed)
+{
+    // 上一次之后真正写入socket的数据量
+    size_t drained = (mLastQueued + mLastSent > queued) ? mLastQueued + mLastSent - queued : 0;
+
+    if (elapsed > 0)
+    {
+        double rate = static_cast<double>(drained) * 1000000.0 / static_cast<double>(elapsed);
+        mThroughput = (mThroughput == 0) ? rate : mThroughput * 0.75 + rate * 0.25;
+    }
+    mLastQueued = queued;
+    mLastSent = 0;
+}
+
+size_t TierLadder::Select(size_t queued, uint32_t frameSize, uint32_t frameInterval, size_t tier, const uint32_t *scales, size_t tierCount)
+{
+    size_t lowestTier = tierCount - 1;
+
+    if ((frameSize != 0) && (queued >= 2 * frameSize))
+    {
+        mStableTicks = 0;
+        if ((++mCongestedTicks < TIER_LADDER_DOWN_TICKS) || (tier >= lowestTier))
+        {
+            return tier;
+        }
+        // 根据测量到的吞吐量估计可以承受的档位，至少降低一档
+        double budget = mThroughput * 0.9;
+        size_t next = tier + 1;
+
+        while (next < lowestTier)
+        {
+            double ratio = static_cast<double>(scales[tier]) / scales[next];
+            double estimated = frameSize * ratio * ratio * (1000.0 / frameInterval);
+            if (estimated <= budget)
+            {
+                break;
+            }
+            next++;
+        }
+        mCongestedTicks = 0;
+        // 降档之后需要更长的稳定时间才能升档，避免来回切换
+        mUpgradeHoldTicks = std::min<uint32_t>(mUpgradeHoldTicks * 2, TIER_LADDER_UP_MAX_SECONDS * 1000 / frameInterval);
+        return next;
+    }
+
+    mCongestedTicks = 0;
+    if ((queued < frameSize / 2) && (tier > 0) && (++mStableTicks >= mUpgradeHoldTicks))
+    {
+        mStableTicks = 0;
+        return tier - 1;
+    }
+    return tier;
+}
+
+NAMESPACE_END
@@ -0,0 +1,108 @@
+/**
+ * @file tier_ladder.h
+ * @brief 流连接按照吞吐量自适应选择编码档位
+ * @author wangpengcheng  (wangpengcheng2018@gmail.com)
+ * @version 1.0
+ * @date 2026-10-19 23:48:16
+ * @copyright Copyright (c) 2026  IRLSCU
+ *
+ * @par 修改日志:
+ * <table>
+ * <tr>
+ *    <th> Commit date</th>
+ *    <th> Version </th>
+ *    <th> Author </th>
+ *    <th> Description </th>
+ * </tr>
+ * <tr>
+ *    <td> 2026-10-19 23:48:16 </td>
+ *    <td> 1.0 </td>
+ *    <td> wangpengcheng </td>
+ *    <td> 从 MjpegRequestHandler 中分离档位选择策略 </td>
+ * </tr>
+ * </table>
+ */
+#ifndef TIER_LADDER_H
+#define TIER_LADDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "base_define.h"
+
+NAMESPACE_START
+
+/**
+ * @brief 连续拥塞多少次之后降档
+ */
+#define TIER_LADDER_DOWN_TICKS (3)
+/**
+ * @brief 升档前最少需要保持稳定的秒数
+ */
+#define TIER_LADDER_UP_MIN_SECONDS (2)
+/**
+ * @brief 升档前最多需要保持稳定的秒数，每次降档之后加倍直到该值
+ */
+#define TIER_LADDER_UP_MAX_SECONDS (30)
+
+/**
+ * @brief 单个连接的档位选择策略
+ * @details
+ *  每次定时发送之前根据输出缓冲区的积压情况测量吞吐量：积压超过两帧的次数达到 TIER_LADDER_DOWN_TICKS 时，
+ *  按照吞吐量估计可以承受的档位，至少降低一档；积压少于半帧并且保持足够长的时间之后升高一档。
+ *  每次降档之后升档需要的稳定时间加倍，避免在两个档位之间来回切换。
+ *  不依赖网络连接和编码器，档位只通过缩小倍数描述
+ */
+class TierLadder
+{
+public:
+    TierLadder();
+    /**
+     * @brief  连接开始发送时重置状态
+     * @param  frameInterval    发送间隔(毫秒)
+     */
+    void Reset(uint32_t frameInterval);
+    /**
+     * @brief  记录本次发送写入输出缓冲区的字节数，用于下一次计算吞吐量
+     * @param  bytes            字节数
+     */
+    void OnSent(size_t bytes);
+    /**
+     * @brief  根据上一次之后真正写入socket的数据量更新平滑之后的吞吐量
+     * @param  queued           输出缓冲区中积压的字节数
+     * @param  elapsed          距离上一次更新的时间(微秒)
+     */
+    void Measure(size_t queued, int64_t elapsed);
+    /**
+     * @brief  选择连接的编码档位
+     * @param  queued           输出缓冲区中积压的字节数
+     * @param  frameSize        当前档位最新一帧的大小，0 表示还没有编码
+     * @param  frameInterval    发送间隔(毫秒)
+     * @param  tier             当前档位
+     * @param  scales           各个档位的缩小倍数，按分辨率从高到低排列
+     * @param  tierCount        档位数量
+     * @return size_t           新的档位，与 tier 相同时不切换
+     */
+    size_t Select(size_t queued, uint32_t frameSize, uint32_t frameInterval, size_t tier, const uint32_t *scales, size_t tierCount);
+    /**
+     * @brief  平滑之后的吞吐量
+     * @return double           bytes/s
+     */
+    double Throughput() const { return mThroughput; }
+    /**
+     * @brief  升档之前需要保持稳定的次数
+     * @return uint32_t         次数
+     */
+    uint32_t UpgradeHoldTicks() const { return mUpgradeHoldTicks; }
+
+private:
+    size_t mLastQueued;         ///< 上次发送后输出缓冲区中的字节数
+    size_t mLastSent;           ///< 上次写入的字节数
+    double mThroughput;         ///< 平滑之后的吞吐量 bytes/s
+    uint32_t mCongestedTicks;   ///< 连续拥塞次数
+    uint32_t mStableTicks;      ///< 连续无积压次数
+    uint32_t mUpgradeHoldTicks; ///< 升档之前需要保持稳定的次数，降档后加倍
+};
+
+NAMESPACE_END
+
+#endif // TIER_LADDER_H
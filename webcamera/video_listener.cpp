@@ -1,5 +1,6 @@
 #include "video_listener.h"
 #include "video_source_to_webdata.h"
+#include "base_trace.h"
 
 #include <string.h>
 #include <mutex>
@@ -16,18 +17,65 @@ VideoListener::~VideoListener()
 /* 将图片写入owner_ */
 void VideoListener::OnNewImage(const std::shared_ptr<const Image> &image)
 {
-    /* 注意这里的锁 */
-    std::lock_guard<std::mutex> lock(owner_->ImageGuard);
-    /* 将数据拷贝过来 */
-    owner_->InternalError = image->CopyDataOrClone(owner_->CameraImage);
-    if (owner_->InternalError == Error::Success)
     {
-        owner_->NewImageAvailable = true;
+        int64_t traceBegin = FrameTrace::Begin();
+        /* 注意这里的锁，只保护图片的拷贝 */
+        std::lock_guard<std::mutex> lock(owner_->ImageGuard);
+        if (traceBegin != 0)
+        {
+            FrameTrace::Record("image_lock_wait", image->FrameId(), traceBegin, FrameTrace::Now());
+        }
+        TraceSpan span("copy", image->FrameId());
+        /* 编码线程仍然持有上一帧时重新分配，避免覆盖正在编码的数据 */
+        if (owner_->CameraImage.use_count() > 1)
+        {
+            owner_->CameraImage.reset();
+        }
+        /* 将数据拷贝过来，尺寸变化时从图像池获取 */
+        owner_->CameraFrame.reset();
+        owner_->InternalError = image->CopyDataOrClone(owner_->CameraImage, owner_->Pool);
+        if (owner_->InternalError == Error::Success)
+        {
+            // 新的帧序号，各个档位据此判断是否需要重新编码
+            owner_->FrameSequence++;
+            owner_->SourceIdle = false;
+        }
+
+        // since we got an image from video source, clear any error reported by it
+        owner_->VideoSourceErrorMessage.clear();
+        owner_->VideoSourceError = false;
     }
+    /* 释放锁之后再提交编码任务 */
+    owner_->ScheduleEncoding(true);
+}
+/* 将压缩帧写入owner_，每一帧的大小不同，容量足够时不会重新分配 */
+void VideoListener::OnNewEncodedFrame(const std::shared_ptr<const EncodedFrame> &frame)
+{
+    {
+        int64_t traceBegin = FrameTrace::Begin();
+        std::lock_guard<std::mutex> lock(owner_->ImageGuard);
+        if (traceBegin != 0)
+        {
+            FrameTrace::Record("image_lock_wait", frame->Sequence(), traceBegin, FrameTrace::Now());
+        }
+        TraceSpan span("copy", frame->Sequence());
+        /* 上一帧已经发布或者正在被编码线程引用时重新获取，避免覆盖正在发送的数据 */
+        if (owner_->CameraFrame.use_count() > 1)
+        {
+            owner_->CameraFrame.reset();
+        }
+        owner_->CameraImage.reset();
+        owner_->InternalError = frame->CopyTo(owner_->CameraFrame, owner_->Pool);
+        if (owner_->InternalError == Error::Success)
+        {
+            owner_->FrameSequence++;
+            owner_->SourceIdle = false;
+        }
 
-    // since we got an image from video source, clear any error reported by it
-    owner_->VideoSourceErrorMessage.clear();
-    owner_->VideoSourceError = false;
+        owner_->VideoSourceErrorMessage.clear();
+        owner_->VideoSourceError = false;
+    }
+    owner_->ScheduleEncoding(true);
 }
 // An error coming from video source
 void VideoListener::OnError(const string &errorMessage, bool /* fatal */)
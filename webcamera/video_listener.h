@@ -47,6 +47,11 @@ public:
      * @param  image           图像共享指针
      */
     void OnNewImage(const std::shared_ptr<const Image> &image);
+    /**
+     * @brief 重载压缩帧接收函数
+     * @param  frame           压缩帧共享指针
+     */
+    void OnNewEncodedFrame(const std::shared_ptr<const EncodedFrame> &frame);
     /**
      * @brief  错误类处理接口类
      * @param  errorMessage     错误信息
@@ -5,7 +5,7 @@
 #include <memory>
 using namespace MY_NAME_SPACE;
 
-VideoSourceToWeb::VideoSourceToWeb(uint16_t jpegQuality) : mData(new VideoSourceToWebData(jpegQuality))
+VideoSourceToWeb::VideoSourceToWeb(uint16_t jpegQuality, uint32_t encoderThreads) : mData(new VideoSourceToWebData(jpegQuality, encoderThreads))
 {
 }
 
@@ -32,12 +32,168 @@ std::shared_ptr<WebRequestHandlerInterface> VideoSourceToWeb::CreateMjpegHandler
     return std::make_shared<MjpegRequestHandler>(uri, frameRate, mData);
 }
 
+// Create web request handler to stream frames over WebSocket
+std::shared_ptr<WebRequestHandlerInterface> VideoSourceToWeb::CreateWebSocketHandler(const string &uri, uint32_t frameRate) const
+{
+    return std::make_shared<WebSocketRequestHandler>(uri, frameRate, mData);
+}
+
+// Create web request handler to export recently encoded frames
+std::shared_ptr<WebRequestHandlerInterface> VideoSourceToWeb::CreateFrameHistoryHandler(const string &uri) const
+{
+    return std::make_shared<FrameHistoryRequestHandler>(uri, mData);
+}
+
 // Get/Set JPEG quality (valid only if camera provides uncompressed images)
 uint16_t VideoSourceToWeb::JpegQuality() const
 {
-    return mData->jpeg_encoder.Quality();
+    return mData->Tier(0).Quality();
 }
 void VideoSourceToWeb::SetJpegQuality(uint16_t quality)
 {
-    mData->jpeg_encoder.SetQuality(quality);
-}
\ No newline at end of file
+    mData->SetBaseQuality(quality);
+}
+
+// Get/Set quality of a single encoding tier
+size_t VideoSourceToWeb::JpegTierCount() const
+{
+    return mData->Tiers.size();
+}
+uint16_t VideoSourceToWeb::JpegTierQuality(size_t tier) const
+{
+    return mData->Tier(tier).Quality();
+}
+void VideoSourceToWeb::SetJpegTierQuality(size_t tier, uint16_t quality)
+{
+    mData->Tier(tier).SetQuality(quality);
+}
+
+// Get/Set JPEG encoding backend of all tiers
+JpegBackend VideoSourceToWeb::JpegEncoderBackend() const
+{
+    JpegTier &tier = mData->Tier(0);
+    std::lock_guard<std::mutex> encoderLock(tier.EncoderGuard);
+    return tier.Encoder.Backend();
+}
+Error VideoSourceToWeb::SetJpegEncoderBackend(JpegBackend backend)
+{
+    return mData->SetEncoderBackend(backend);
+}
+
+// Get/Set target bitrate of rate controlled JPEG encoding
+uint64_t VideoSourceToWeb::JpegBitrate() const
+{
+    return mData->Bitrate;
+}
+Error VideoSourceToWeb::SetJpegBitrate(uint64_t bitsPerSecond, uint32_t frameRate)
+{
+    return mData->SetBitrate(bitsPerSecond, frameRate);
+}
+
+// Enable/Disable per-client tier switching for MJPEG streams
+bool VideoSourceToWeb::IsAdaptiveTiersEnabled() const
+{
+    return mData->AdaptiveTiers;
+}
+void VideoSourceToWeb::EnableAdaptiveTiers(bool enable)
+{
+    mData->AdaptiveTiers = enable;
+}
+
+// Get/Set number of JPEG encoding threads
+uint32_t VideoSourceToWeb::EncoderThreadCount() const
+{
+    return mData->EncoderThreads;
+}
+void VideoSourceToWeb::SetEncoderThreadCount(uint32_t threads)
+{
+    mData->StartEncoders(threads);
+}
+
+// Set how frame buffers are allocated (huge pages, NUMA node)
+void VideoSourceToWeb::SetFrameMemory(bool hugePages, int numaNode)
+{
+    mData->SetFrameMemory(ImageMemoryOptions(hugePages, numaNode));
+}
+void VideoSourceToWeb::SetEncoderAffinity(const std::vector<uint32_t> &cpus)
+{
+    mData->SetEncoderAffinity(cpus);
+}
+
+void VideoSourceToWeb::SetMetricsLabel(const std::string &camera)
+{
+    mData->SetMetricsLabel(camera);
+}
+
+// Demand tracking used to start/stop the video source on request
+void VideoSourceToWeb::SetDemandCallback(const std::function<void()> &callback)
+{
+    mData->DemandCallback = callback;
+}
+bool VideoSourceToWeb::HasDemand() const
+{
+    return mData->HasDemand();
+}
+void VideoSourceToWeb::MarkSourceIdle()
+{
+    mData->SourceIdle = true;
+}
+
+// Get/Set threshold of the unchanged-frame detection
+uint32_t VideoSourceToWeb::ChangeThreshold() const
+{
+    return mData->ChangeThreshold;
+}
+void VideoSourceToWeb::SetChangeThreshold(uint32_t threshold)
+{
+    mData->ChangeThreshold = threshold;
+}
+uint32_t VideoSourceToWeb::LastChangeScore() const
+{
+    return mData->LastChangeScore;
+}
+
+// Enable/Disable the in-memory ring of recently encoded frames
+void VideoSourceToWeb::EnableFrameHistory(uint32_t seconds, size_t maxBytes)
+{
+    mData->History.SetLimits(seconds, maxBytes);
+    mData->ScheduleEncoding();
+}
+void VideoSourceToWeb::SetMotionThreshold(uint32_t threshold)
+{
+    mData->History.SetMotionThreshold(threshold);
+}
+
+// Record the full resolution tier to rolling segment files
+Error VideoSourceToWeb::StartRecording(const FrameRecorderOptions &options)
+{
+    StopRecording();
+
+    std::shared_ptr<FrameRecorder> recorder = std::make_shared<FrameRecorder>(options);
+    Error error = recorder->Start();
+    if (error != Error::Success)
+    {
+        return error;
+    }
+    std::atomic_store(&mData->Recorder, recorder);
+    mData->ScheduleEncoding();
+    return Error::Success;
+}
+void VideoSourceToWeb::StopRecording()
+{
+    // 编码线程可能仍然持有录像对象，停止之后的帧不再加入队列
+    std::shared_ptr<FrameRecorder> recorder = std::atomic_exchange(&mData->Recorder, std::shared_ptr<FrameRecorder>());
+    if (recorder)
+    {
+        recorder->Stop();
+    }
+}
+bool VideoSourceToWeb::IsRecording() const
+{
+    return static_cast<bool>(std::atomic_load(&mData->Recorder));
+}
+FrameRecorderStats VideoSourceToWeb::RecordingStats() const
+{
+    std::shared_ptr<FrameRecorder> recorder = std::atomic_load(&mData->Recorder);
+    return (recorder) ? recorder->Stats() : FrameRecorderStats();
+}
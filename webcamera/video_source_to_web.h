@@ -24,8 +24,11 @@
 
 #ifndef VIDEO_SOURCE_TO_WEB_H
 #define VIDEO_SOURCE_TO_WEB_H
+#include <functional>
 #include "uncopyable.h"
 #include "video_source_listener_interface.h"
+#include "frame_recorder.h"
+#include "jpeg_encoder.h"
 
 NAMESPACE_START
 
@@ -37,7 +40,12 @@ class WebRequestHandlerInterface;
 class VideoSourceToWeb : private Uncopyable
 {
 public:
-    VideoSourceToWeb(uint16_t jpegQuality = 85);
+    /**
+     * @brief Construct a new Video Source To Web object
+     * @param  jpegQuality      图片压缩质量
+     * @param  encoderThreads   jpeg编码线程数量，0 表示在视频采集线程中直接编码
+     */
+    VideoSourceToWeb(uint16_t jpegQuality = 85, uint32_t encoderThreads = 1);
     ~VideoSourceToWeb();
 
     // Get video source listener, which could be fed to some video source
@@ -58,6 +66,21 @@ public:
      */
     std::shared_ptr<WebRequestHandlerInterface> CreateMjpegHandler(const std::string &uri, uint32_t frameRate) const;
 
+    /**
+     * @brief 创建WebSocket推流句柄，二进制消息带有帧序号、采集时间和档位，客户端通过确认控制发送
+     * @param  uri              句柄对应url
+     * @param  frameRate        最高帧率
+     * @return std::shared_ptr<WebRequestHandlerInterface> 处理句柄函数对象
+     */
+    std::shared_ptr<WebRequestHandlerInterface> CreateWebSocketHandler(const std::string &uri, uint32_t frameRate) const;
+
+    /**
+     * @brief 创建历史帧导出句柄，需要先通过 EnableFrameHistory 开启缓存
+     * @param  uri              句柄对应url
+     * @return std::shared_ptr<WebRequestHandlerInterface> 处理句柄函数对象
+     */
+    std::shared_ptr<WebRequestHandlerInterface> CreateFrameHistoryHandler(const std::string &uri) const;
+
     /**
      * @brief  获取JPEG编码质量
      * @return uint16_t  质量参数
@@ -65,9 +88,169 @@ public:
     uint16_t JpegQuality() const;
     /**
      * @brief 设置图片的压缩质量
+     * @details 设置原始分辨率档位的质量，低分辨率档位依次降低 JPEG_TIER_QUALITY_STEP
      * @param  quality          目标质量
      */
     void SetJpegQuality(uint16_t quality);
+    /**
+     * @brief  获取编码档位数量
+     * @return size_t 档位数量
+     */
+    size_t JpegTierCount() const;
+    /**
+     * @brief  获取指定档位的压缩质量
+     * @param  tier             档位编号，0 为原始分辨率
+     * @return uint16_t         质量参数
+     */
+    uint16_t JpegTierQuality(size_t tier) const;
+    /**
+     * @brief 单独设置指定档位的压缩质量
+     * @param  tier             档位编号，0 为原始分辨率
+     * @param  quality          目标质量
+     */
+    void SetJpegTierQuality(size_t tier, uint16_t quality);
+    /**
+     * @brief  获取jpeg编码后端
+     * @return JpegBackend 编码后端
+     */
+    JpegBackend JpegEncoderBackend() const;
+    /**
+     * @brief 设置所有档位的jpeg编码后端
+     * @details 需要在视频源启动之前调用；之后创建的缩放和裁剪档位使用相同的后端
+     * @param  backend          编码后端
+     * @return Error            编译时没有找到对应的库时返回 ConfigurationNotSupported
+     */
+    Error SetJpegEncoderBackend(JpegBackend backend);
+    /**
+     * @brief  获取每个jpeg流的目标码率
+     * @return uint64_t 码率(bit/s)，0 表示使用固定质量
+     */
+    uint64_t JpegBitrate() const;
+    /**
+     * @brief 开启码率控制，每帧按照帧大小模型调整压缩质量，使每个流的码率接近目标
+     * @details
+     *  低分辨率档位的目标按照像素数减少，拥塞时降档仍然可以降低码率；
+     *  关闭之后保持当前的质量，需要时重新调用 SetJpegQuality。视频源直接输出jpeg时原始分辨率档位不重新编码，不受码率控制
+     * @param  bitsPerSecond    目标码率(bit/s)，0 表示关闭
+     * @param  frameRate        发送帧率，用于计算每帧的字节数
+     * @return Error            帧率为0时返回 InvalidPropertyValue
+     */
+    Error SetJpegBitrate(uint64_t bitsPerSecond, uint32_t frameRate);
+    /**
+     * @brief  MJPEG连接是否根据吞吐量自动切换档位
+     * @return true  开启
+     * @return false 关闭，所有连接使用原始分辨率
+     */
+    bool IsAdaptiveTiersEnabled() const;
+    /**
+     * @brief 开启/关闭MJPEG连接的自动档位切换
+     * @param  enable           是否开启
+     */
+    void EnableAdaptiveTiers(bool enable);
+    /**
+     * @brief  获取jpeg编码线程数量
+     * @return uint32_t 线程数量
+     */
+    uint32_t EncoderThreadCount() const;
+    /**
+     * @brief 重新设置jpeg编码线程数量，编码线程与网络IO线程相互独立
+     * @details 运行时调用会等待正在编码的帧完成，期间到达的帧不编码；每个档位同一时刻只在一个线程中编码，线程数量超过档位数量没有意义
+     * @param  threads          线程数量，0 表示在视频采集线程中直接编码
+     */
+    void SetEncoderThreadCount(uint32_t threads);
+    /**
+     * @brief 设置帧内存的分配方式
+     * @details
+     *  最好在视频源启动之前调用，运行时调用与 SetEncoderThreadCount 相同。大尺寸图像(例如4K RGB24每帧约25MB)使用大页可以减少
+     *  颜色转换和编码时的TLB缺失；指定NUMA节点时帧内存优先分配在该节点上，
+     *  编码线程同时绑定到该节点的CPU上
+     * @param  hugePages        是否使用大页(MAP_HUGETLB，失败时使用透明大页)
+     * @param  numaNode         NUMA节点，-1 表示不绑定
+     */
+    void SetFrameMemory(bool hugePages, int numaNode = -1);
+    /**
+     * @brief 设置编码线程绑定的CPU，运行时调用与 SetEncoderThreadCount 相同
+     * @details 编码线程数为0时不绑定，采集线程的绑定由视频源设置
+     * @param  cpus             CPU编号，为空时不绑定
+     */
+    void SetEncoderAffinity(const std::vector<uint32_t> &cpus);
+    /**
+     * @brief 设置 /metrics 中编码和推流指标的 camera 标签，默认为 "0"，需要在服务开始之前设置
+     * @param  camera           摄像头名称
+     */
+    void SetMetricsLabel(const std::string &camera);
+    /**
+     * @brief 设置有新请求时的回调，用于按需启动视频源
+     * @details 只在调用 MarkSourceIdle 之后、收到新的帧之前触发，需要在服务开始之前设置
+     * @param  callback         回调函数，在网络线程中执行，不能阻塞
+     */
+    void SetDemandCallback(const std::function<void()> &callback);
+    /**
+     * @brief  是否有请求需要视频源的画面
+     * @return true  有连接订阅、最近有单张图片请求，或者开启了历史缓存/录像
+     * @return false 视频源可以暂停
+     */
+    bool HasDemand() const;
+    /**
+     * @brief 标记视频源已经暂停，之前编码的帧不再发送给新的请求
+     */
+    void MarkSourceIdle();
+    /**
+     * @brief  获取画面变化阈值
+     * @return uint32_t 变化阈值
+     */
+    uint32_t ChangeThreshold() const;
+    /**
+     * @brief 设置画面变化阈值
+     * @details
+     *  每帧图像缩小为亮度缩略图后按块与上一次编码的画面比较，分数为块内最大的平均亮度差(0-255)；
+     *  分数小于阈值时不再编码，直接复用上一次的jpeg数据。静止的摄像头可以节省绝大部分编码开销
+     * @param  threshold        变化阈值，0 表示关闭检测，每帧都编码
+     */
+    void SetChangeThreshold(uint32_t threshold);
+    /**
+     * @brief  最近一帧图像的变化分数
+     * @return uint32_t 变化分数(0-255)，没有进行检测时为255
+     */
+    uint32_t LastChangeScore() const;
+    /**
+     * @brief 开启/关闭原始分辨率编码帧的内存缓存
+     * @details
+     *  缓存只保存编码帧的引用，超出时长或者字节数时淘汰最旧的帧；
+     *  开启之后原始分辨率档位会持续编码，画面没有变化的帧复用上一次的编码结果
+     * @param  seconds          最多保存的时长(秒)，0 表示关闭
+     * @param  maxBytes         最多占用的jpeg数据字节数，0 表示关闭
+     */
+    void EnableFrameHistory(uint32_t seconds, size_t maxBytes);
+    /**
+     * @brief 设置运动事件的变化分数阈值，需要同时开启画面变化检测
+     * @param  threshold        变化分数阈值，0 表示不记录运动事件
+     */
+    void SetMotionThreshold(uint32_t threshold);
+    /**
+     * @brief 开始录像，已经在录像时先停止之前的录像
+     * @details
+     *  录像使用原始分辨率档位的编码结果，在独立的IO线程中写入分段文件；
+     *  磁盘写入跟不上时丢弃帧，不会影响采集和推流
+     * @param  options          录像参数
+     * @return Error            录像目录不可写时返回 IOError
+     */
+    Error StartRecording(const FrameRecorderOptions &options);
+    /**
+     * @brief 停止录像，写完队列中的帧并关闭文件
+     */
+    void StopRecording();
+    /**
+     * @brief  是否正在录像
+     * @return true  正在录像
+     * @return false 没有录像
+     */
+    bool IsRecording() const;
+    /**
+     * @brief  获取录像统计信息
+     * @return FrameRecorderStats 统计信息，没有录像时全部为0
+     */
+    FrameRecorderStats RecordingStats() const;
 
 private:
     VideoSourceToWebData *mData; ///< 视频转向web的关键数据结构
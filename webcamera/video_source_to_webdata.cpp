@@ -1,10 +1,155 @@
 #include "video_source_to_webdata.h"
+#include "image_scaler.h"
+#include <algorithm>
 #include <mutex>
 #include <thread>
+#include "time_stamp.h"
+#include "base_trace.h"
 
 using namespace MY_NAME_SPACE;
 using namespace MY_NAME_SPACE::net;
 
+/* 计算档位的压缩质量，档位越低质量越低 */
+static uint16_t TierQuality(uint16_t baseQuality, size_t tierIndex)
+{
+    int quality = static_cast<int>(baseQuality) - static_cast<int>(tierIndex) * JPEG_TIER_QUALITY_STEP;
+    return static_cast<uint16_t>((quality < 1) ? 1 : quality);
+}
+
+JpegFrame::JpegFrame(const std::shared_ptr<const EncodedFrame> &buffer, uint64_t sequence, uint32_t changeScore) : Buffer(buffer),
+                                                                                                                   Data(buffer->Data()),
+                                                                                                                   Size(buffer->Size()),
+                                                                                                                   Sequence(sequence),
+                                                                                                                   ChangeScore(changeScore),
+                                                                                                                   TimeStamp(buffer->TimeStamp()),
+                                                                                                                   FrameId(buffer->Sequence())
+{
+}
+
+JpegTier::JpegTier(uint32_t scale, uint16_t quality, const JpegVariant &variant) : Scale(scale),
+                                                                                    Variant(variant),
+                                                                                    Encoder(quality, true),
+                                                                                    ScaledImage(),
+                                                                                    BoxImage(),
+                                                       EncodedSequence(0),
+                                                       ContentVersion(0),
+                                                       ContentQuality(0),
+                                                       LastFrameSize(JPEG_BUFFER_SIZE / (scale * scale)),
+                                                       EncodedFrames(0),
+                                                       ReusedFrames(0),
+                                                       Subscribers(0),
+                                                       Pending(false),
+                                                       SnapshotDemand(0),
+                                                       FailedSequence(0),
+                                                       LastError(Error::Success),
+                                                       EncoderGuard(),
+                                                       FrameGuard(),
+                                                       LatestFrame(),
+                                                       ScaleMetric(nullptr),
+                                                       EncodeMetric(nullptr),
+                                                       FrameBytesMetric(nullptr),
+                                                       ReusedMetric(nullptr),
+                                                       QualityMetric(nullptr),
+                                                       FailedMetric(nullptr),
+                                                       DecodeFailedMetric(nullptr)
+{
+}
+
+JpegFramePtr JpegTier::Frame()
+{
+    std::lock_guard<std::mutex> frameLock(FrameGuard);
+    return LatestFrame;
+}
+
+void JpegTier::Publish(const JpegFramePtr &frame)
+{
+    std::lock_guard<std::mutex> frameLock(FrameGuard);
+    if ((!LatestFrame) || (LatestFrame->Sequence < frame->Sequence))
+    {
+        LatestFrame = frame;
+    }
+}
+
+uint16_t JpegTier::Quality()
+{
+    std::lock_guard<std::mutex> encoderLock(EncoderGuard);
+    return Encoder.Quality();
+}
+
+void JpegTier::SetQuality(uint16_t quality)
+{
+    std::lock_guard<std::mutex> encoderLock(EncoderGuard);
+    Encoder.SetQuality(quality);
+}
+
+VideoSourceToWebData::VideoSourceToWebData(uint16_t jpegQuality, uint32_t encoderThreads) : VideoSourceError(false),
+                                                                                             InternalError(Error::Success),
+                                                                                             FrameSequence(0),
+                                                                                             AdaptiveTiers(true),
+                                                                                             RequestDemand(0),
+                                                                                             SourceIdle(false),
+                                                                                             DemandCallback(),
+                                                                                             EncoderThreads(0),
+                                                                                             EncoderNumaNode(-1),
+                                                                                             EncoderCpus(),
+                                                                                             ChangeThreshold(FRAME_CHANGE_THRESHOLD),
+                                                                                             LastChangeScore(FRAME_CHANGE_MAX_SCORE),
+                                                                                             VideoSourceListener(this),
+                                                                                             Pool(IMAGE_POOL_FREE_COUNT),
+                                                                                             CameraImage(),
+                                                                                             CameraFrame(),
+                                                                                             VideoSourceErrorMessage(),
+                                                                                             ImageGuard(),
+                                                                                             ChangeGuard(),
+                                                                                             ChangeDetector(),
+                                                                                             ChangeSequence(0),
+                                                                                             ChangeScore(FRAME_CHANGE_MAX_SCORE),
+                                                                                             ContentVersion(0),
+                                                                                             History(),
+                                                                                             Recorder(),
+                                                                                             MjpegSendMetric(nullptr),
+                                                                                             OutputBufferMetric(nullptr),
+                                                                                             DroppedFramesMetric(nullptr),
+                                                                                             ClientDropsMetric(nullptr),
+                                                                                             WebSocketAckMetric(nullptr),
+                                                                                             MetricsCamera(),
+                                                                                             Bitrate(0),
+                                                                                             Tiers(),
+                                                                                             Variants(JPEG_VARIANT_COUNT),
+                                                                                             VariantCount(0),
+                                                                                             VariantGuard(),
+                                                                                             StreamGroups(),
+                                                                                             EncoderSetupGuard(),
+                                                                                             EncoderPoolGuard(),
+                                                                                             EncodersStopping(false),
+                                                                                             EncodeInline(false),
+                                                                                             InlineEncodeGuard(),
+                                                                                             EncoderPool()
+{
+    /* 创建 1, 1/2, 1/4 ... 分辨率的档位 */
+    for (size_t i = 0; i < JPEG_TIER_COUNT; i++)
+    {
+        Tiers.emplace_back(new JpegTier(1u << i, TierQuality(jpegQuality, i)));
+    }
+    SetMetricsLabel("0");
+    StartEncoders(encoderThreads);
+}
+
+VideoSourceToWebData::~VideoSourceToWebData()
+{
+    /* 先停止编码线程，保证没有任务再访问档位 */
+    std::unique_ptr<ThreadPool> pool;
+    {
+        std::lock_guard<std::mutex> poolLock(EncoderPoolGuard);
+        pool.swap(EncoderPool);
+        EncodeInline = false;
+    }
+    EncodersStopping = true;
+    pool.reset();
+    // 没有编码线程时等待采集线程中的直接编码完成
+    std::lock_guard<std::mutex> inlineLock(InlineEncodeGuard);
+}
+
 // Check if any errors happened
 bool VideoSourceToWebData::IsError()
 {
@@ -16,7 +161,7 @@ void VideoSourceToWebData::ReportError(net::HttpResponse &response)
 {
     if (InternalError != Error::Success)
     {
-        response.SendFast(HttpResponse::k500ServerError, InternalError.ToString().c_str());
+        response.SendFast(HttpResponse::k500ServerError, Error(InternalError).ToString().c_str());
     }
     else if (VideoSourceError)
     {
@@ -26,66 +171,679 @@ void VideoSourceToWebData::ReportError(net::HttpResponse &response)
     }
 }
 
-// Encode current camera image as JPEG
-void VideoSourceToWebData::EncodeCameraImage()
+bool VideoSourceToWebData::IsTierFailed(size_t tierIndex, uint64_t sinceSequence)
+{
+    return (Tier(tierIndex).FailedSequence > sinceSequence);
+}
+
+JpegTier &VideoSourceToWebData::Tier(size_t tierIndex)
+{
+    if (tierIndex < Tiers.size())
+    {
+        return *Tiers[tierIndex];
+    }
+    // 变体档位在增加数量之前已经创建，之后不再改变
+    if (tierIndex - Tiers.size() < VariantCount.load(std::memory_order_acquire))
+    {
+        return *Variants[tierIndex - Tiers.size()];
+    }
+    return *Tiers.back();
+}
+
+size_t VideoSourceToWebData::TierCount() const
+{
+    return Tiers.size() + VariantCount.load(std::memory_order_acquire);
+}
+
+Error VideoSourceToWebData::AcquireVariant(const JpegVariant &variant, size_t *tierIndex)
 {
-    if (NewImageAvailable)
+    if (variant.IsDefault())
     {
-        // 图片加锁
-        std::lock_guard<std::mutex> imageLock(ImageGuard);
-        // 缓冲区加锁
-        std::lock_guard<std::mutex> bufferLock(BufferGuard);
+        *tierIndex = 0;
+        return Error::Success;
+    }
+
+    std::lock_guard<std::mutex> variantLock(VariantGuard);
+    size_t count = VariantCount.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (Variants[i]->Variant == variant)
+        {
+            *tierIndex = Tiers.size() + i;
+            return Error::Success;
+        }
+    }
+    if (count >= Variants.size())
+    {
+        return Error::OutOfMemory;
+    }
+
+    // 变体使用原始分辨率档位的压缩质量
+    {
+        std::lock_guard<std::mutex> encoderLock(Tiers[0]->EncoderGuard);
+        Variants[count].reset(new JpegTier(1, Tiers[0]->Encoder.Quality(), variant));
+        Variants[count]->Encoder.SetBackend(Tiers[0]->Encoder.Backend());
+        Variants[count]->Encoder.SetRateControl(Tiers[0]->Encoder.RateControl());
+    }
+    RegisterTierMetrics(*Variants[count], Tiers.size() + count);
+    VariantCount.store(count + 1, std::memory_order_release);
+    *tierIndex = Tiers.size() + count;
+    return Error::Success;
+}
+
+void VideoSourceToWebData::SetBaseQuality(uint16_t quality)
+{
+    size_t count = TierCount();
+    for (size_t i = 0; i < count; i++)
+    {
+        Tier(i).SetQuality((i < Tiers.size()) ? TierQuality(quality, i) : quality);
+    }
+}
 
-        if (JpegBuffer == nullptr)
+Error VideoSourceToWebData::SetEncoderBackend(JpegBackend backend)
+{
+    if (!JpegEncoder::IsBackendAvailable(backend))
+    {
+        return Error::ConfigurationNotSupported;
+    }
+    std::lock_guard<std::mutex> variantLock(VariantGuard);
+    for (size_t i = 0, count = TierCount(); i < count; i++)
+    {
+        std::lock_guard<std::mutex> encoderLock(Tier(i).EncoderGuard);
+        Tier(i).Encoder.SetBackend(backend);
+    }
+    return Error::Success;
+}
+
+Error VideoSourceToWebData::SetBitrate(uint64_t bitsPerSecond, uint32_t frameRate)
+{
+    if (frameRate == 0)
+    {
+        return Error::InvalidPropertyValue;
+    }
+    uint64_t frameBytes = bitsPerSecond / 8 / frameRate;
+    frameBytes = std::min<uint64_t>(frameBytes, UINT32_MAX);
+
+    std::lock_guard<std::mutex> variantLock(VariantGuard);
+    Bitrate = bitsPerSecond;
+    for (size_t i = 0, count = TierCount(); i < count; i++)
+    {
+        JpegTier &tier = Tier(i);
+        std::lock_guard<std::mutex> encoderLock(tier.EncoderGuard);
+        JpegRateControl control = tier.Encoder.RateControl();
+        // 拥塞时切换到低分辨率档位需要真正减少码率
+        control.TargetBytes = static_cast<uint32_t>(frameBytes / (tier.Scale * tier.Scale));
+        if ((frameBytes > 0) && (control.TargetBytes == 0))
+        {
+            control.TargetBytes = 1;
+        }
+        tier.Encoder.SetRateControl(control);
+    }
+    return Error::Success;
+}
+
+void VideoSourceToWebData::StartEncoders(uint32_t threads)
+{
+    std::lock_guard<std::mutex> setupLock(EncoderSetupGuard);
+    EncoderThreads = threads;
+    RestartEncoders();
+}
+
+// 采集线程和IO线程可能正在通过 ScheduleEncoding 提交任务，线程池只在持有 EncoderPoolGuard 时替换
+void VideoSourceToWebData::RestartEncoders()
+{
+    std::unique_ptr<ThreadPool> pool;
+    {
+        std::lock_guard<std::mutex> poolLock(EncoderPoolGuard);
+        pool.swap(EncoderPool);
+        EncodeInline = false;
+    }
+    /* 在锁外停止旧的线程池，等待正在编码的帧完成，未执行的任务直接丢弃 */
+    EncodersStopping = true;
+    pool.reset();
+    {
+        // 等待采集线程中正在进行的直接编码
+        std::lock_guard<std::mutex> inlineLock(InlineEncodeGuard);
+    }
+    EncodersStopping = false;
+    for (size_t i = 0, count = TierCount(); i < count; i++)
+    {
+        Tier(i).Pending = false;
+    }
+
+    /* 线程数为0时不创建线程池，由采集线程在 ScheduleEncoding 中直接编码 */
+    uint32_t threads = EncoderThreads;
+    if (threads > 0)
+    {
+        pool.reset(new ThreadPool("JpegEncoder"));
+        if (!EncoderCpus.empty())
+        {
+            std::vector<uint32_t> cpus = EncoderCpus;
+            pool->setThreadInitCallback([cpus]() { ImageMemory::RunOnCpus(cpus.data(), cpus.size()); });
+        }
+        else if (EncoderNumaNode >= 0)
+        {
+            // 编码线程运行在帧内存所在的节点上，避免跨节点访问
+            int node = EncoderNumaNode;
+            pool->setThreadInitCallback([node]() { ImageMemory::RunOnNumaNode(node); });
+        }
+        pool->start(static_cast<int>(threads));
+    }
+    {
+        std::lock_guard<std::mutex> poolLock(EncoderPoolGuard);
+        EncoderPool.swap(pool);
+        EncodeInline = (threads == 0);
+    }
+}
+
+void VideoSourceToWebData::SetFrameMemory(const ImageMemoryOptions &options)
+{
+    Pool.SetMemoryOptions(options);
+    std::lock_guard<std::mutex> setupLock(EncoderSetupGuard);
+    EncoderNumaNode = options.NumaNode;
+    // 重新创建编码线程，使线程绑定生效
+    RestartEncoders();
+}
+
+void VideoSourceToWebData::SetEncoderAffinity(const std::vector<uint32_t> &cpus)
+{
+    std::lock_guard<std::mutex> setupLock(EncoderSetupGuard);
+    EncoderCpus = cpus;
+    RestartEncoders();
+}
+
+void VideoSourceToWebData::SetMetricsLabel(const std::string &camera)
+{
+    MetricsRegistry &registry = MetricsRegistry::Instance();
+    std::string labels = MetricsRegistry::Label("camera", camera);
+
+    MjpegSendMetric = registry.Histogram("mjpeg_send_seconds", "Time spent sending one MJPEG part",
+                                         MetricLatencyBuckets(), 1e-6, labels);
+    OutputBufferMetric = registry.Histogram("mjpeg_output_buffer_bytes", "Bytes queued in the connection output buffer at each MJPEG tick",
+                                            MetricSizeBuckets(), 1, labels);
+    DroppedFramesMetric = registry.Counter("mjpeg_dropped_frames_total", "Frames skipped because the client output buffer was full", labels);
+    WebSocketAckMetric = registry.Histogram("websocket_ack_seconds", "Time from sending a WebSocket frame to the client acknowledging it",
+                                            MetricLatencyBuckets(), 1e-6, labels);
+    {
+        static const uint64_t bounds[] = {0, 1, 5, 10, 50, 100, 500, 1000, 5000};
+        ClientDropsMetric = registry.Histogram("mjpeg_client_dropped_frames", "Frames dropped per MJPEG client over its connection",
+                                               std::vector<uint64_t>(bounds, bounds + sizeof(bounds) / sizeof(bounds[0])), 1, labels);
+    }
+    for (size_t i = 0; i < JPEG_DECODE_SCALES; i++)
+    {
+        DecodeSlots[i].DecodeMetric = registry.Histogram("jpeg_decode_seconds", "Scaled decoding time of JPEG frames from the video source",
+                                                         MetricLatencyBuckets(), 1e-6,
+                                                         labels + "," + MetricsRegistry::Label("scale", std::to_string(1u << i)));
+    }
+    std::lock_guard<std::mutex> variantLock(VariantGuard);
+    MetricsCamera = camera;
+    for (size_t i = 0, count = TierCount(); i < count; i++)
+    {
+        RegisterTierMetrics(Tier(i), i);
+    }
+}
+
+void VideoSourceToWebData::RegisterTierMetrics(JpegTier &tier, size_t tierIndex)
+{
+    MetricsRegistry &registry = MetricsRegistry::Instance();
+    std::string tierLabels = MetricsRegistry::Label("camera", MetricsCamera) + "," + MetricsRegistry::Label("tier", std::to_string(tierIndex));
+
+    tier.ScaleMetric = registry.Histogram("jpeg_scale_seconds", "Crop and scale time before encoding",
+                                          MetricLatencyBuckets(), 1e-6, tierLabels);
+    tier.EncodeMetric = registry.Histogram("jpeg_encode_seconds", "JPEG encoding time",
+                                           MetricLatencyBuckets(), 1e-6, tierLabels);
+    tier.FrameBytesMetric = registry.Histogram("jpeg_frame_bytes", "Encoded JPEG frame size",
+                                               MetricSizeBuckets(), 1, tierLabels);
+    tier.QualityMetric = registry.Gauge("jpeg_quality", "Quality of the last encoded frame", tierLabels);
+    tier.ReusedMetric = registry.Counter("jpeg_reused_frames_total", "Frames published without encoding because the image did not change", tierLabels);
+    tier.FailedMetric = registry.Counter("jpeg_failed_frames_total", "Frames skipped because cropping, scaling or encoding failed", tierLabels);
+    tier.DecodeFailedMetric = registry.Counter("jpeg_decode_failed_frames_total", "JPEG frames from the video source skipped because they could not be decoded", tierLabels);
+}
+
+void VideoSourceToWebData::TouchSnapshotDemand(size_t tierIndex)
+{
+    Tier(tierIndex).SnapshotDemand = Timestamp::now().microSecondsSinceEpoch();
+}
+
+bool VideoSourceToWebData::HasDemand()
+{
+    for (size_t i = 0, count = TierCount(); i < count; i++)
+    {
+        if (IsTierWanted(i))
+        {
+            return true;
+        }
+    }
+    // 视频源出错时请求不会订阅档位，仍然需要启动视频源
+    return (Timestamp::now().microSecondsSinceEpoch() - RequestDemand < SNAPSHOT_DEMAND_TIMEOUT);
+}
+
+void VideoSourceToWebData::NotifyDemand()
+{
+    RequestDemand = Timestamp::now().microSecondsSinceEpoch();
+    if ((SourceIdle) && (DemandCallback))
+    {
+        DemandCallback();
+    }
+}
+
+bool VideoSourceToWebData::IsTierWanted(size_t tierIndex)
+{
+    JpegTier &tier = Tier(tierIndex);
+    if ((tier.Subscribers > 0) || (Timestamp::now().microSecondsSinceEpoch() - tier.SnapshotDemand < SNAPSHOT_DEMAND_TIMEOUT))
+    {
+        return true;
+    }
+    // 历史缓存和录像只使用原始分辨率档位
+    return ((tierIndex == 0) && ((History.IsEnabled()) || (std::atomic_load(&Recorder))));
+}
+
+// 为需要的档位提交编码任务，每个档位同一时刻最多一个任务
+void VideoSourceToWebData::ScheduleEncoding(bool captureThread)
+{
+    std::unique_lock<std::mutex> inlineLock(InlineEncodeGuard, std::defer_lock);
+    {
+        std::lock_guard<std::mutex> poolLock(EncoderPoolGuard);
+        if (FrameSequence == 0)
         {
-            InternalError = Error::OutOfMemory;
+            return;
         }
-        else
+        if (EncoderPool)
         {
-            // jpeg格式直接复制
-            if (CameraImage->Format() == PixelFormat::JPEG)
+            for (size_t i = 0, count = TierCount(); i < count; i++)
             {
-                // check allocated buffer size
-                if (JpegBufferSize < static_cast<uint32_t>(CameraImage->Width()))
+                if ((IsTierWanted(i)) && (!Tier(i).Pending.exchange(true)))
                 {
-                    // make new size 10% bigger than needed
-                    uint32_t newSize = CameraImage->Width() + CameraImage->Width() / 10;
-
-                    JpegBuffer = (uint8_t *)realloc(JpegBuffer, newSize);
-                    if (JpegBuffer != nullptr)
-                    {
-                        JpegBufferSize = newSize;
-                    }
-                    else
-                    {
-                        InternalError = Error::OutOfMemory;
-                    }
+                    // 只把任务加入队列；只捕获指针和下标，不会产生额外的堆分配
+                    EncoderPool->run([this, i]() { EncodeTierLoop(i); });
                 }
+            }
+            return;
+        }
+        // 线程池正在重新创建时不编码；没有编码线程时IO线程不编码，新订阅的档位由采集线程在下一帧编码
+        if ((!EncodeInline) || (!captureThread))
+        {
+            return;
+        }
+        // 释放 EncoderPoolGuard 之前加锁，RestartEncoders 可以等待这次编码完成
+        inlineLock.lock();
+    }
+
+    for (size_t i = 0, count = TierCount(); i < count; i++)
+    {
+        if ((IsTierWanted(i)) && (!Tier(i).Pending.exchange(true)))
+        {
+            EncodeTierLoop(i);
+        }
+    }
+}
+
+// 编码线程任务；编码期间到达的帧只保留最新的一帧
+void VideoSourceToWebData::EncodeTierLoop(size_t tierIndex)
+{
+    JpegTier &tier = Tier(tierIndex);
 
-                if (JpegBuffer != nullptr)
+    for (;;)
+    {
+        std::shared_ptr<const Image> image;
+        std::shared_ptr<const EncodedFrame> encoded;
+        uint64_t sequence = 0;
+        int64_t traceBegin = FrameTrace::Begin();
+        {
+            std::lock_guard<std::mutex> imageLock(ImageGuard);
+            image = CameraImage;
+            encoded = CameraFrame;
+            sequence = FrameSequence;
+        }
+        uint64_t frameId = (image) ? image->FrameId() : ((encoded) ? encoded->Sequence() : 0);
+        if ((traceBegin != 0) && ((image) || (encoded)))
+        {
+            FrameTrace::Record("encode_lock_wait", frameId, traceBegin, FrameTrace::Now(), "tier", static_cast<int64_t>(tierIndex));
+        }
+
+        // 线程池停止时不再处理新的帧，重新创建线程池之后 Pending 被清除
+        if (EncodersStopping)
+        {
+            return;
+        }
+        if (((image) || (encoded)) && (sequence != tier.EncodedSequence) && (IsTierWanted(tierIndex)))
+        {
+            {
+                TraceSpan span("encode", frameId, "tier", static_cast<int64_t>(tierIndex));
+                // 修改编码参数的线程等待这一帧完成
+                std::lock_guard<std::mutex> encoderLock(tier.EncoderGuard);
+                if (image)
                 {
-                    // just copy JPEG data if we got already encoded image
-                    memcpy(JpegBuffer, CameraImage->Data(), CameraImage->Width());
-                    JpegSize = CameraImage->Width();
+                    EncodeTier(tier, image, sequence);
+                }
+                else
+                {
+                    PublishEncodedFrame(tier, encoded, sequence);
                 }
             }
-            else
+            if (tierIndex == 0)
             {
-                // 获取旧数据指针，因为libjpeg会主动分配内存，需要更新buffer
-                uint8_t *oldJpegBuffer = JpegBuffer;
-                // encode image as JPEG (buffer is re-allocated if too small by encoder)
-                JpegSize = JpegBufferSize;
-                // 将图片压缩之后拷贝到JpegBuffer中
-                InternalError = jpeg_encoder.EncodeToMemory(CameraImage, &JpegBuffer, &JpegSize);
-                // 检查是否需要扩展内存
-                if (JpegSize > JpegBufferSize)
+                JpegFramePtr frame = tier.Frame();
+                if ((frame) && (frame->Sequence == sequence))
                 {
-                    JpegBufferSize = JpegSize;
-                    free(oldJpegBuffer);
+                    History.Push(frame);
+                    std::shared_ptr<FrameRecorder> recorder = std::atomic_load(&Recorder);
+                    if (recorder)
+                    {
+                        recorder->Push(frame);
+                    }
                 }
             }
+            continue;
+        }
+
+        tier.Pending = false;
+        // 清除标志之前可能有新的帧到达，而采集线程看到标志后没有提交任务
+        if ((FrameSequence == sequence) || (tier.Pending.exchange(true)))
+        {
+            return;
         }
+    }
+}
+
+// 所有档位共享同一个检测结果，避免每个档位重复计算
+uint64_t VideoSourceToWebData::EvaluateChange(const std::shared_ptr<const Image> &image, uint64_t sequence, uint32_t *score)
+{
+    std::lock_guard<std::mutex> changeLock(ChangeGuard);
+    uint32_t threshold = ChangeThreshold;
+
+    // 比已经检测过的帧更旧的帧，无法与参考帧对应，直接编码
+    if ((threshold == 0) || (sequence < ChangeSequence))
+    {
+        *score = FRAME_CHANGE_MAX_SCORE;
+        return 0;
+    }
+
+    if (sequence != ChangeSequence)
+    {
+        uint32_t current = FRAME_CHANGE_MAX_SCORE;
+
+        if (ChangeDetector.Compare(image, &current) != Error::Success)
+        {
+            current = FRAME_CHANGE_MAX_SCORE;
+        }
+        // 只有变化足够大时才更新参考帧，缓慢的变化会逐渐累积并最终触发编码
+        if (current >= threshold)
+        {
+            ContentVersion++;
+            ChangeDetector.UpdateReference();
+        }
+        ChangeSequence = sequence;
+        ChangeScore = current;
+        LastChangeScore = current;
+    }
+
+    *score = ChangeScore;
+    return ContentVersion;
+}
+
+// Encode camera image as JPEG and publish it for the tier
+void VideoSourceToWebData::EncodeTier(JpegTier &tier, const std::shared_ptr<const Image> &image, uint64_t sequence)
+{
+    uint32_t score = FRAME_CHANGE_MAX_SCORE;
+    uint64_t version = EvaluateChange(image, sequence, &score);
+    JpegFramePtr previous = tier.Frame();
+
+    // 画面和档位上一次编码的内容相同，使用新的帧序号重新发布上一次的jpeg数据；压缩质量改变之后需要重新编码
+    if ((version != 0) && (version == tier.ContentVersion) && (tier.ContentQuality == tier.Encoder.Quality()) && (previous))
+    {
+        std::shared_ptr<JpegFrame> frame = Pool.MakeShared<JpegFrame>(previous->Buffer, sequence, score);
+        frame->TimeStamp = image->TimeStamp();
+        frame->FrameId = image->FrameId();
+        RecordTierResult(tier, Error::Success, sequence);
+        tier.ReusedFrames++;
+        tier.ReusedMetric->Add();
+        tier.Publish(frame);
+        return;
+    }
+
+    EncodeScaled(tier, image, 1, sequence, score, version);
+}
+
+// 错误只记录在本档位，其他档位的连接不受影响
+void VideoSourceToWebData::RecordTierResult(JpegTier &tier, Error ret, uint64_t sequence)
+{
+    tier.EncodedSequence = sequence;
+    tier.LastError = ret;
+    tier.FailedSequence = (ret == Error::Success) ? 0 : sequence;
+    if (ret != Error::Success)
+    {
+        tier.FailedMetric->Add();
+    }
+}
+
+void VideoSourceToWebData::EncodeScaled(JpegTier &tier, const std::shared_ptr<const Image> &image, uint32_t decodeScale, uint64_t sequence,
+                                        uint32_t score, uint64_t version)
+{
+    std::shared_ptr<const EncodedFrame> jpeg;
+    std::shared_ptr<const Image> source = image;
+
+    // 低分辨率档位和变体档位，先进行裁剪和缩小
+    Error ret = ScaleForTier(tier, image, decodeScale, source);
 
-        NewImageAvailable = false;
+    if (ret == Error::Success)
+    {
+        // 按照上一帧大小多预留10%，不足时编码器原地扩大，扩大的容量随压缩帧归还到池中
+        std::shared_ptr<EncodedFrame> output = Pool.AcquireEncoded(tier.LastFrameSize + tier.LastFrameSize / 10, FrameCodec::JPEG);
+        int64_t encodeStart = Timestamp::now().microSecondsSinceEpoch();
+        ret = tier.Encoder.EncodeToFrame(source, Pool, output);
+        if (ret == Error::Success)
+        {
+            tier.EncodeMetric->Observe(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch() - encodeStart));
+            tier.FrameBytesMetric->Observe(static_cast<uint64_t>(output->Size()));
+            tier.QualityMetric->Set(tier.Encoder.Quality());
+            output->SetTimeStamp(image->TimeStamp());
+            output->SetSequence(image->FrameId());
+            tier.EncodedFrames++;
+        }
+        jpeg = output;
     }
-}
\ No newline at end of file
+
+    RecordTierResult(tier, ret, sequence);
+    if (ret == Error::Success)
+    {
+        JpegFramePtr frame = Pool.MakeShared<JpegFrame>(jpeg, sequence, score);
+        tier.LastFrameSize = frame->Size;
+        tier.ContentVersion = version;
+        tier.ContentQuality = tier.Encoder.Quality();
+        tier.Publish(frame);
+    }
+}
+
+/* 尺寸或者格式改变时从池中重新获取档位的缓存图像 */
+static bool PrepareTierImage(ImagePool &pool, std::shared_ptr<Image> &image, int32_t width, int32_t height, PixelFormat format)
+{
+    if ((!image) || (image->Width() != width) || (image->Height() != height) || (image->Format() != format))
+    {
+        image.reset();
+        image = pool.Acquire(width, height, format);
+    }
+    return static_cast<bool>(image);
+}
+
+// 裁剪只创建视图；整数倍缩小直接均值缩小，其他尺寸先均值缩小到目标尺寸的2倍以内再双线性缩放
+Error VideoSourceToWebData::ScaleForTier(JpegTier &tier, const std::shared_ptr<const Image> &image, uint32_t decodeScale,
+                                         std::shared_ptr<const Image> &source)
+{
+    const JpegVariant &variant = tier.Variant;
+    std::shared_ptr<const Image> input = image;
+    int32_t divisor = static_cast<int32_t>(decodeScale);
+    // 解码时已经缩小的部分不再缩小；输出宽度是绝对值，不需要换算
+    uint32_t scale = std::max<uint32_t>(1, tier.Scale / decodeScale);
+    Error ret = Error::Success;
+
+    if (variant.Width > 0)
+    {
+        // 裁剪区域在请求时无法检查，超出图像的部分被裁掉，至少保留一个像素；YUYV 的水平坐标对齐到偶数，
+        // NV12/I420 的两个坐标都对齐到偶数
+        int32_t x = std::min(variant.X / divisor, image->Width() - 1);
+        int32_t y = std::min(variant.Y / divisor, image->Height() - 1);
+        int32_t cropWidth = std::max(variant.Width / divisor, 1);
+        int32_t cropHeight = std::max(variant.Height / divisor, 1);
+        if ((image->Format() == PixelFormat::YUYV) || (ImageIsPlanar(image->Format())))
+        {
+            x &= ~1;
+        }
+        if (ImageIsPlanar(image->Format()))
+        {
+            y &= ~1;
+        }
+        input = Image::CreateView(image, x, y, std::min(cropWidth, image->Width() - x), std::min(cropHeight, image->Height() - y));
+        if (!input)
+        {
+            return Error::ImageParametersMismatch;
+        }
+    }
+
+    int32_t width = ImageScaler::ScaledSize(input->Width(), scale);
+    int32_t height = ImageScaler::ScaledSize(input->Height(), scale);
+    if ((variant.TargetWidth > 0) && (variant.TargetWidth < input->Width()))
+    {
+        width = variant.TargetWidth;
+        height = static_cast<int32_t>((static_cast<int64_t>(input->Height()) * width + input->Width() / 2) / input->Width());
+        height = std::max(height, 1);
+    }
+    if ((width == input->Width()) && (height == input->Height()))
+    {
+        source = input;
+        return Error::Success;
+    }
+    if (!PrepareTierImage(Pool, tier.ScaledImage, width, height, input->Format()))
+    {
+        return Error::OutOfMemory;
+    }
+
+    int64_t scaleStart = Timestamp::now().microSecondsSinceEpoch();
+    uint32_t factor = static_cast<uint32_t>(input->Width() / width);
+    if ((input->Width() % width == 0) && (ImageScaler::ScaledSize(input->Height(), factor) == height))
+    {
+        ret = ImageScaler::Downscale(input, tier.ScaledImage, factor);
+    }
+    else
+    {
+        std::shared_ptr<const Image> resizeSource = input;
+        uint32_t box = ImageScaler::BoxFactor(input->Width(), input->Height(), width, height);
+        if (box > 1)
+        {
+            if (!PrepareTierImage(Pool, tier.BoxImage, ImageScaler::ScaledSize(input->Width(), box),
+                                  ImageScaler::ScaledSize(input->Height(), box), input->Format()))
+            {
+                return Error::OutOfMemory;
+            }
+            ret = ImageScaler::Downscale(input, tier.BoxImage, box);
+            resizeSource = tier.BoxImage;
+        }
+        if (ret == Error::Success)
+        {
+            ret = ImageScaler::Resize(resizeSource, tier.ScaledImage);
+        }
+    }
+    tier.ScaleMetric->Observe(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch() - scaleStart));
+    source = tier.ScaledImage;
+    return ret;
+}
+
+// 视频源直接输出jpeg时，原始分辨率档位引用采集到的数据，其他档位缩小解码之后重新编码
+void VideoSourceToWebData::PublishEncodedFrame(JpegTier &tier, const std::shared_ptr<const EncodedFrame> &frame, uint64_t sequence)
+{
+    if (frame->Codec() != FrameCodec::JPEG)
+    {
+        RecordTierResult(tier, Error::UnsupportedPixelFormat, sequence);
+        return;
+    }
+    if ((tier.Scale > 1) || (!tier.Variant.IsDefault()))
+    {
+        std::shared_ptr<const Image> image;
+        uint32_t scale = 1;
+        Error ret = DecodeForTier(tier, frame, sequence, image, &scale);
+        if (ret != Error::Success)
+        {
+            // 视频源偶尔输出不完整的帧，本档位只跳过这一帧，不关闭订阅的连接
+            tier.EncodedSequence = sequence;
+            tier.DecodeFailedMetric->Add();
+            return;
+        }
+        // 没有解码之前的画面用于变化检测，每一帧都重新编码
+        EncodeScaled(tier, image, scale, sequence, FRAME_CHANGE_MAX_SCORE, 0);
+        return;
+    }
+    RecordTierResult(tier, Error::Success, sequence);
+    JpegFramePtr published = Pool.MakeShared<JpegFrame>(frame, sequence);
+    tier.LastFrameSize = published->Size;
+    tier.ContentVersion = 0;
+    tier.Publish(published);
+}
+
+/* 按照档位的输出宽度选择解码时的缩小倍数，解码之后的宽度不小于输出宽度的2倍，保证后续缩放的质量 */
+static uint32_t TierDecodeScale(const JpegTier &tier, int32_t width)
+{
+    const JpegVariant &variant = tier.Variant;
+    int32_t sourceWidth = width;
+    if (variant.Width > 0)
+    {
+        int32_t x = std::min(variant.X, width - 1);
+        sourceWidth = std::min(variant.Width, width - x);
+    }
+    int32_t targetWidth = ImageScaler::ScaledSize(sourceWidth, tier.Scale);
+    if ((variant.TargetWidth > 0) && (variant.TargetWidth < sourceWidth))
+    {
+        targetWidth = variant.TargetWidth;
+    }
+
+    uint32_t scale = 1;
+    while ((scale < 8) && (sourceWidth / static_cast<int32_t>(scale * 2) >= targetWidth))
+    {
+        scale *= 2;
+    }
+    return scale;
+}
+
+// 同一倍数的档位共享解码结果，先到达的档位解码，其他档位等待之后直接使用
+Error VideoSourceToWebData::DecodeForTier(JpegTier &tier, const std::shared_ptr<const EncodedFrame> &frame, uint64_t sequence,
+                                          std::shared_ptr<const Image> &image, uint32_t *scale)
+{
+    int32_t width = 0;
+    int32_t height = 0;
+    Error ret = JpegDecoder::ReadSize(frame->Data(), frame->Size(), &width, &height);
+    if (ret != Error::Success)
+    {
+        return ret;
+    }
+
+    *scale = TierDecodeScale(tier, width);
+    size_t slotIndex = 0;
+    while ((1u << slotIndex) < *scale)
+    {
+        slotIndex++;
+    }
+    JpegDecodeSlot &slot = DecodeSlots[slotIndex];
+    std::lock_guard<std::mutex> decodeLock(slot.Guard);
+    if (slot.Sequence != sequence)
+    {
+        std::shared_ptr<Image> decoded;
+        // 先释放上一帧，其他档位编码完成之后图像可以被池重新使用
+        slot.Image.reset();
+        slot.Decoder.SetScale(*scale);
+        int64_t decodeStart = Timestamp::now().microSecondsSinceEpoch();
+        ret = slot.Decoder.DecodeFrame(frame, Pool, decoded);
+        if (ret == Error::Success)
+        {
+            slot.DecodeMetric->Observe(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch() - decodeStart));
+            slot.Image = decoded;
+        }
+        // 解码失败的结果同样保存，同一倍数的其他档位不再重复解码损坏的帧
+        slot.Sequence = sequence;
+        slot.Result = ret;
+    }
+    if (slot.Result != Error::Success)
+    {
+        return slot.Result;
+    }
+    image = slot.Image;
+    return Error::Success;
+}
@@ -28,21 +28,210 @@
 
 #include "video_listener.h"
 #include "jpeg_encoder.h"
+#include "jpeg_decoder.h"
+#include "image_pool.h"
+#include "frame_change_detector.h"
+#include "frame_history.h"
+#include "frame_recorder.h"
+#include "stream_tick_groups.h"
 #include "net_http_response.h"
+#include "thread_pool.h"
+#include "base_metrics.h"
+#include "uncopyable.h"
 
 #include <mutex>
+#include <atomic>
+#include <vector>
+#include <functional>
 NAMESPACE_START
 
 /**
  * @brief 定义结构体的数据类
  */
 #define JPEG_BUFFER_SIZE (1024 * 1024)
+/**
+ * @brief 默认编码档位数量: 原始分辨率、1/2、1/4
+ */
+#define JPEG_TIER_COUNT (3)
+/**
+ * @brief 相邻档位之间默认的压缩质量差值
+ */
+#define JPEG_TIER_QUALITY_STEP (10)
+/**
+ * @brief 最多同时存在的裁剪/缩放变体档位数量
+ */
+#define JPEG_VARIANT_COUNT (8)
+/**
+ * @brief 视频源输出jpeg时解码的缩小倍数种类: 1、1/2、1/4、1/8
+ */
+#define JPEG_DECODE_SCALES (4)
+/**
+ * @brief 单张图片请求之后，持续编码原始分辨率档位的时间(微秒)
+ */
+#define SNAPSHOT_DEMAND_TIMEOUT (5 * 1000 * 1000)
+/**
+ * @brief 图像池中每种尺寸最多缓存的空闲图像数量
+ */
+#define IMAGE_POOL_FREE_COUNT (16)
+/**
+ * @brief 默认的画面变化阈值，变化分数小于该值时复用上一次的编码结果，0 表示每帧都编码
+ */
+#define FRAME_CHANGE_THRESHOLD (4)
+
+/**
+ * @brief 编码完成的jpeg帧
+ * @details 由编码线程创建，发布之后只读，所有订阅该档位的连接共享同一份数据；
+ *          数据保存在图像池的压缩帧中，最后一个引用释放后归还到池中
+ */
+struct JpegFrame : private Uncopyable
+{
+public:
+    /**
+     * @brief Construct a new Jpeg Frame object
+     * @param  buffer           保存jpeg数据的压缩帧
+     * @param  sequence         对应的图像帧序号
+     * @param  changeScore      图像相对上一次编码内容的变化分数
+     */
+    JpegFrame(const std::shared_ptr<const EncodedFrame> &buffer, uint64_t sequence, uint32_t changeScore = FRAME_CHANGE_MAX_SCORE);
+
+public:
+    std::shared_ptr<const EncodedFrame> Buffer; ///< jpeg数据所在的压缩帧
+    const uint8_t *Data;                 ///< jpeg数据
+    uint32_t Size;                       ///< jpeg数据大小
+    uint64_t Sequence;                   ///< 对应的图像帧序号
+    uint32_t ChangeScore;                ///< 图像的变化分数(0-255)
+    struct timeval TimeStamp;            ///< 图像采集时间戳
+    uint64_t FrameId;                    ///< 采集时分配的帧编号，用于跟踪
+};
+typedef std::shared_ptr<const JpegFrame> JpegFramePtr;
+
+/**
+ * @brief 请求参数指定的画面变体：裁剪区域和输出宽度
+ */
+struct JpegVariant
+{
+public:
+    JpegVariant() : X(0), Y(0), Width(0), Height(0), TargetWidth(0)
+    {
+    }
+    /**
+     * @brief  是否为原始画面
+     * @return true  没有裁剪也没有指定宽度
+     * @return false 需要裁剪或者缩放
+     */
+    bool IsDefault() const { return (Width == 0) && (TargetWidth == 0); }
+    bool operator==(const JpegVariant &other) const
+    {
+        return (X == other.X) && (Y == other.Y) && (Width == other.Width) && (Height == other.Height) &&
+               (TargetWidth == other.TargetWidth);
+    }
+
+public:
+    int32_t X;           ///< 裁剪区域左上角的水平坐标
+    int32_t Y;           ///< 裁剪区域左上角的垂直坐标
+    int32_t Width;       ///< 裁剪区域宽度，0 表示不裁剪
+    int32_t Height;      ///< 裁剪区域高度
+    int32_t TargetWidth; ///< 输出宽度，高度按比例计算；0 表示不缩放，不会放大
+};
+
+/**
+ * @brief JPEG编码档位
+ * @details
+ *  每个档位对应一种缩小倍数和压缩质量，所有订阅同一档位的连接共享编码结果；
+ *  每一帧图像在每个档位上最多编码一次，并且只有在有连接请求时才会编码。
+ *  同一时刻每个档位最多只有一个编码任务，编码跟不上时直接跳到最新的帧
+ */
+struct JpegTier
+{
+public:
+    /**
+     * @brief Construct a new Jpeg Tier object
+     * @param  scale            缩小倍数，1 表示原始分辨率
+     * @param  quality          压缩质量
+     * @param  variant          裁剪和缩放参数，默认为原始画面
+     */
+    JpegTier(uint32_t scale, uint16_t quality, const JpegVariant &variant = JpegVariant());
+    /**
+     * @brief  获取最新发布的编码帧
+     * @return JpegFramePtr     编码帧，没有时为空
+     */
+    JpegFramePtr Frame();
+    /**
+     * @brief 发布新的编码帧，旧的帧不会覆盖新的帧
+     * @param  frame            编码帧
+     */
+    void Publish(const JpegFramePtr &frame);
+    /**
+     * @brief  当前的压缩质量，码率控制开启时为最近一次编码使用的质量
+     * @return uint16_t         压缩质量
+     */
+    uint16_t Quality();
+    /**
+     * @brief 设置压缩质量，正在编码时等待当前帧完成，从下一帧开始生效
+     * @param  quality          压缩质量
+     */
+    void SetQuality(uint16_t quality);
+
+public:
+    uint32_t Scale;                     ///< 缩小倍数
+    JpegVariant Variant;                ///< 裁剪和缩放参数，创建之后不再改变
+    JpegEncoder Encoder;                ///< 档位独立的编码器，编码和修改参数时都需要持有 EncoderGuard
+    std::shared_ptr<Image> ScaledImage; ///< 缩小之后的图像缓存
+    std::shared_ptr<Image> BoxImage;    ///< 双线性缩放之前均值缩小的中间图像
+    uint64_t EncodedSequence;           ///< 已经编码的帧序号
+    uint64_t ContentVersion;            ///< 最近一次实际编码的画面内容版本，0 表示未知
+    uint16_t ContentQuality;            ///< 最近一次实际编码使用的压缩质量
+    uint32_t LastFrameSize;             ///< 上一帧的大小，用于估计缓冲区大小
+    std::atomic<uint64_t> EncodedFrames; ///< 实际编码的帧数
+    std::atomic<uint64_t> ReusedFrames;  ///< 画面没有变化，复用编码结果的帧数
+    std::atomic<uint32_t> Subscribers;  ///< 订阅该档位的连接数量
+    std::atomic<bool> Pending;          ///< 是否已经有编码任务在执行
+    std::atomic<int64_t> SnapshotDemand; ///< 最近一次单张图片请求该档位的时间(微秒)
+    std::atomic<uint64_t> FailedSequence; ///< 最近一次编码失败的帧序号，编码成功之后为0
+    std::atomic<Error::BaseErrorCode> LastError; ///< 最近一次编码的结果，只在编码线程中写入
+    std::mutex EncoderGuard;            ///< 编码器的锁，编码线程处理每一帧时持有，参数只在两帧之间修改
+    std::mutex FrameGuard;              ///< 发布帧的锁，只保护指针交换
+    JpegFramePtr LatestFrame;           ///< 最新发布的编码帧
+    MetricHistogram *ScaleMetric;       ///< 缩小耗时
+    MetricHistogram *EncodeMetric;      ///< 编码耗时
+    MetricHistogram *FrameBytesMetric;  ///< 编码之后的帧大小
+    MetricCounter *ReusedMetric;        ///< 复用编码结果的帧数
+    MetricGauge *QualityMetric;         ///< 最近一次编码使用的压缩质量
+    MetricCounter *FailedMetric;        ///< 裁剪、缩放或者编码失败而跳过的帧数
+    MetricCounter *DecodeFailedMetric;  ///< 视频源输出的jpeg帧无法解码而跳过的帧数
+};
+
+/**
+ * @brief 视频源输出jpeg时，一种缩小倍数的解码结果
+ * @details 需要同一倍数的档位共享解码结果，每一帧在每种倍数上最多解码一次
+ */
+struct JpegDecodeSlot : private Uncopyable
+{
+public:
+    JpegDecodeSlot() : Decoder(1, true),
+                       Sequence(0),
+                       Result(Error::Success),
+                       Image(),
+                       Guard(),
+                       DecodeMetric(nullptr)
+    {
+    }
+
+public:
+    JpegDecoder Decoder;                   ///< 复用的解码器，只在持有锁时使用
+    uint64_t Sequence;                     ///< 已经解码的帧序号
+    Error::BaseErrorCode Result;           ///< 该帧的解码结果，失败时其他档位直接跳过
+    std::shared_ptr<const MY_NAME_SPACE::Image> Image; ///< 解码之后的图像
+    std::mutex Guard;                      ///< 解码锁，其他档位等待解码完成之后直接使用结果
+    MetricHistogram *DecodeMetric;         ///< 解码耗时
+};
 
 /**
  * @brief 摄像头camera转换为web的关键函数类
  * @details
  *  主要用于存储数据，连接摄像头和网络服务器
- *  创建buffer进行网络服务器的图片暂存封装
+ *  采集线程通过监听者写入图片，编码线程池负责jpeg编码，
+ *  网络IO线程只发送已经编码好的帧
  */
 struct VideoSourceToWebData
 {
@@ -50,36 +239,11 @@ public:
     /**
      * @brief Construct a new Video Source To Web Data object
      * @param  jpegQuality      图片压缩质量
+     * @param  encoderThreads   编码线程数量
      */
-    VideoSourceToWebData(uint16_t jpegQuality) : NewImageAvailable(false),
-                                                 VideoSourceError(false),
-                                                 InternalError(Error::Success),
-                                                 JpegBuffer(nullptr),
-                                                 JpegBufferSize(0),
-                                                 JpegSize(0),
-                                                 VideoSourceListener(this),
-                                                 CameraImage(),
-                                                 VideoSourceErrorMessage(),
-                                                 ImageGuard(),
-                                                 BufferGuard(),
-                                                 jpeg_encoder(jpegQuality, true)
-    {
-        /* 为jpeg分配buffer */
-        JpegBuffer = (uint8_t *)malloc(JPEG_BUFFER_SIZE);
-        if (JpegBuffer != nullptr)
-        {
-            JpegBufferSize = JPEG_BUFFER_SIZE;
-        }
-    }
+    VideoSourceToWebData(uint16_t jpegQuality, uint32_t encoderThreads);
 
-    ~VideoSourceToWebData()
-    {
-        if (JpegBuffer != nullptr)
-        {
-            free(JpegBuffer);
-            JpegBuffer = nullptr;
-        }
-    }
+    ~VideoSourceToWebData();
     /**
      * @brief  是否错误
      * @return true  错误
@@ -92,25 +256,227 @@ public:
      */
     void ReportError(net::HttpResponse &response);
     /**
-     * @brief 将图片进行编码
+     * @brief  档位在指定的帧之后是否编码失败
+     * @details 编码错误只影响订阅该档位的连接，之后编码成功时自动恢复
+     * @param  tierIndex        档位编号
+     * @param  sinceSequence    连接订阅该档位时的帧序号，之前的错误不计入
+     * @return true  最近一次编码失败，并且失败的帧在 sinceSequence 之后
+     * @return false 正常
+     */
+    bool IsTierFailed(size_t tierIndex, uint64_t sinceSequence);
+    /**
+     * @brief 为所有需要的档位提交编码任务，已经在编码的档位会在完成后自动处理最新帧
+     * @details 编码线程数为0时只有采集线程直接编码，IO线程调用时不编码，由采集线程在下一帧处理新需要的档位
+     * @param  captureThread    是否由视频采集线程调用
+     */
+    void ScheduleEncoding(bool captureThread = false);
+    /**
+     * @brief 记录单张图片的请求，之后一段时间内持续编码该档位
+     * @param  tierIndex        档位编号
+     */
+    void TouchSnapshotDemand(size_t tierIndex = 0);
+    /**
+     * @brief  是否有请求需要视频源的画面
+     * @return true  有连接订阅、最近有单张图片请求，或者开启了历史缓存/录像
+     * @return false 没有任何需求，视频源可以暂停
+     */
+    bool HasDemand();
+    /**
+     * @brief 记录新的请求，视频源已经暂停时通过 DemandCallback 通知
+     */
+    void NotifyDemand();
+    /**
+     * @brief  获取档位
+     * @param  tierIndex        档位编号，固定档位之后为变体档位，超出范围时使用最低的固定档位
+     * @return JpegTier&        档位对象
+     */
+    JpegTier &Tier(size_t tierIndex);
+    /**
+     * @brief  档位总数，包括已经创建的变体档位
+     * @return size_t           档位数量
+     */
+    size_t TierCount() const;
+    /**
+     * @brief  查找或者创建画面变体对应的档位
+     * @details 参数相同的请求共享同一个档位，每一帧只裁剪、缩放和编码一次；
+     *          变体档位创建之后不会删除，没有订阅时不再编码
+     * @param  variant          裁剪和缩放参数
+     * @param  tierIndex        输出档位编号
+     * @return Error            错误信息，变体数量达到 JPEG_VARIANT_COUNT 时返回 OutOfMemory
+     */
+    Error AcquireVariant(const JpegVariant &variant, size_t *tierIndex);
+    /**
+     * @brief 按照基础质量重新设置各个档位的压缩质量
+     * @param  quality          原始分辨率档位的压缩质量
+     */
+    void SetBaseQuality(uint16_t quality);
+    /**
+     * @brief 设置所有档位的编码后端，之后创建的变体档位使用相同的后端
+     * @param  backend          编码后端
+     * @return Error            后端不可用时返回 ConfigurationNotSupported
+     */
+    Error SetEncoderBackend(JpegBackend backend);
+    /**
+     * @brief 按照目标码率设置各个档位的码率控制
+     * @details 原始分辨率档位和变体档位每帧的目标字节数为 码率/8/帧率，低分辨率档位按照像素数减少
+     * @param  bitsPerSecond    每个流的目标码率(bit/s)，0 表示关闭码率控制
+     * @param  frameRate        发送帧率
+     * @return Error            帧率为0时返回 InvalidPropertyValue
+     */
+    Error SetBitrate(uint64_t bitsPerSecond, uint32_t frameRate);
+    /**
+     * @brief 重新创建编码线程池，可以在运行时调用
+     * @details 先停止旧的线程池并等待正在执行的任务完成，期间到达的帧不提交编码任务，
+     *          新的线程池启动之后从下一帧开始编码
+     * @param  threads          编码线程数量，0 表示在采集线程中直接编码
+     */
+    void StartEncoders(uint32_t threads);
+    /**
+     * @brief 设置帧内存的分配方式，并将编码线程绑定到内存所在的NUMA节点
+     * @param  options          内存分配选项
+     */
+    void SetFrameMemory(const ImageMemoryOptions &options);
+    /**
+     * @brief 设置编码线程绑定的CPU，优先于NUMA节点绑定
+     * @param  cpus             CPU编号，为空时不绑定
+     */
+    void SetEncoderAffinity(const std::vector<uint32_t> &cpus);
+    /**
+     * @brief 设置指标的 camera 标签并重新获取指标，需要在视频源和服务开始之前设置
+     * @param  camera           摄像头名称
+     */
+    void SetMetricsLabel(const std::string &camera);
+
+private:
+    /**
+     * @brief  计算图片相对上一次编码内容的变化，每一帧只计算一次
+     * @details 变化分数不小于阈值时画面内容版本加一，并将该帧作为新的参考帧
+     * @param  image            源图片
+     * @param  sequence         图片帧序号
+     * @param  score            输出变化分数
+     * @return uint64_t         图片对应的画面内容版本，0 表示无法判断
+     */
+    uint64_t EvaluateChange(const std::shared_ptr<const Image> &image, uint64_t sequence, uint32_t *score);
+    /**
+     * @brief  档位当前是否需要编码
+     * @param  tierIndex        档位编号
+     * @return true  有订阅者、最近有单张图片请求或者开启了历史缓存
+     * @return false 不需要编码
+     */
+    bool IsTierWanted(size_t tierIndex);
+    /**
+     * @brief 编码线程任务，持续编码档位的最新帧直到没有新的帧
+     * @param  tierIndex        档位编号
+     */
+    void EncodeTierLoop(size_t tierIndex);
+    /**
+     * @brief 将图片按照档位参数编码并发布
+     * @param  tier             档位
+     * @param  image            源图片
+     * @param  sequence         图片帧序号
+     */
+    void EncodeTier(JpegTier &tier, const std::shared_ptr<const Image> &image, uint64_t sequence);
+    /**
+     * @brief 裁剪、缩放并编码图片，然后发布
+     * @param  tier             档位
+     * @param  image            源图片
+     * @param  decodeScale      源图片相对视频源画面已经缩小的倍数
+     * @param  sequence         图片帧序号
+     * @param  score            图片的变化分数
+     * @param  version          图片对应的画面内容版本，0 表示未知
+     */
+    void EncodeScaled(JpegTier &tier, const std::shared_ptr<const Image> &image, uint32_t decodeScale, uint64_t sequence,
+                      uint32_t score, uint64_t version);
+    /**
+     * @brief 记录档位处理一帧的结果，失败只影响订阅该档位的连接
+     * @param  tier             档位
+     * @param  ret              编码结果
+     * @param  sequence         图片帧序号
+     */
+    void RecordTierResult(JpegTier &tier, Error ret, uint64_t sequence);
+    /**
+     * @brief  按照档位需要的分辨率缩小解码视频源输出的jpeg帧
+     * @param  tier             档位
+     * @param  frame            压缩帧
+     * @param  sequence         图片帧序号
+     * @param  image            输出解码之后的图片，与同一倍数的其他档位共享
+     * @param  scale            输出缩小倍数
+     * @return Error            错误信息
+     */
+    Error DecodeForTier(JpegTier &tier, const std::shared_ptr<const EncodedFrame> &frame, uint64_t sequence,
+                        std::shared_ptr<const Image> &image, uint32_t *scale);
+    /**
+     * @brief 直接发布视频源输出的压缩帧，不进行编码
+     * @param  tier             档位
+     * @param  frame            压缩帧
+     * @param  sequence         图片帧序号
+     */
+    void PublishEncodedFrame(JpegTier &tier, const std::shared_ptr<const EncodedFrame> &frame, uint64_t sequence);
+    /**
+     * @brief  按照档位参数裁剪和缩放图片
+     * @param  tier             档位
+     * @param  image            源图片
+     * @param  decodeScale      源图片相对视频源画面已经缩小的倍数，裁剪区域和档位的缩小倍数按照该倍数换算
+     * @param  source           输出需要编码的图片，可能是源图片、裁剪视图或者档位的缓存图像
+     * @return Error            错误信息
+     */
+    Error ScaleForTier(JpegTier &tier, const std::shared_ptr<const Image> &image, uint32_t decodeScale, std::shared_ptr<const Image> &source);
+    /**
+     * @brief 按照当前的线程数量和绑定参数重新创建编码线程池，需要持有 EncoderSetupGuard
+     */
+    void RestartEncoders();
+    /**
+     * @brief 注册档位的指标
+     * @param  tier             档位
+     * @param  tierIndex        档位编号，作为 tier 标签
      */
-    void EncodeCameraImage();
+    void RegisterTierMetrics(JpegTier &tier, size_t tierIndex);
 
 public:
-    volatile bool NewImageAvailable; ///< 是否存在新图片
-    volatile bool VideoSourceError;  ///< 视频源错误
-    Error InternalError;             ///< 网络错误信息
-    /* jpegbuffer相关类;主要是是用来执行jpeg压缩 */
-    uint8_t *JpegBuffer;     ///< jpegbuffer缓冲
-    uint32_t JpegBufferSize; ///< 压缩图片大小
-    /* 图片类 */
-    uint32_t JpegSize;                   ///< jpeg 数据大小
+    volatile bool VideoSourceError;      ///< 视频源错误
+    std::atomic<Error::BaseErrorCode> InternalError; ///< 采集线程复制视频源数据的错误，档位的编码错误记录在 JpegTier 中
+    std::atomic<uint64_t> FrameSequence; ///< 当前图片的帧序号，0 表示还没有图片
+    volatile bool AdaptiveTiers;         ///< 是否根据连接吞吐量自动切换档位
+    std::atomic<int64_t> RequestDemand;  ///< 最近一次图片或者视频流请求的时间(微秒)
+    std::atomic<bool> SourceIdle;        ///< 视频源因为没有请求而暂停，收到新的帧之前已有的帧都已经过时
+    std::function<void()> DemandCallback; ///< 视频源暂停时有新请求的回调，需要在服务开始之前设置
+    std::atomic<uint32_t> EncoderThreads; ///< 编码线程数量
+    int EncoderNumaNode;                 ///< 编码线程绑定的NUMA节点，-1 表示不绑定
+    std::vector<uint32_t> EncoderCpus;   ///< 编码线程绑定的CPU，为空时不绑定
+    std::atomic<uint32_t> ChangeThreshold; ///< 画面变化阈值，0 表示关闭变化检测
+    std::atomic<uint32_t> LastChangeScore; ///< 最近一帧的变化分数
     VideoListener VideoSourceListener;   ///< 视频监听者
-    std::shared_ptr<Image> CameraImage;  ///< 图片指向source的img
+    ImagePool Pool;                      ///< 图像和jpeg缓冲区池，稳定之后每帧不再分配内存
+    std::shared_ptr<Image> CameraImage;  ///< 图片指向source的img，编码线程持有时不会被覆盖
+    std::shared_ptr<EncodedFrame> CameraFrame; ///< 视频源输出的压缩帧，与 CameraImage 只有一个有效
     std::string VideoSourceErrorMessage; ///< 视频源错误信息
     std::mutex ImageGuard;               ///< 图片锁
-    std::mutex BufferGuard;              ///< buffer锁
-    JpegEncoder jpeg_encoder;            ///< jpeg编码器
+    std::mutex ChangeGuard;              ///< 变化检测锁
+    FrameChangeDetector ChangeDetector;  ///< 变化检测，参考帧为最近一次编码的画面
+    uint64_t ChangeSequence;             ///< 最近一次检测的帧序号
+    uint32_t ChangeScore;                ///< 最近一次检测的变化分数
+    uint64_t ContentVersion;             ///< 当前参考帧的画面内容版本
+    FrameHistory History;                ///< 原始分辨率档位的历史帧缓存
+    std::shared_ptr<FrameRecorder> Recorder; ///< 录像，通过 std::atomic_load/atomic_store 访问
+    MetricHistogram *MjpegSendMetric;    ///< mjpeg 定时发送的处理时间
+    MetricHistogram *OutputBufferMetric; ///< mjpeg 连接输出缓冲区积压的字节数
+    MetricCounter *DroppedFramesMetric;  ///< mjpeg 连接因为积压丢弃的帧数
+    MetricHistogram *ClientDropsMetric;  ///< 每个mjpeg连接断开时累计丢弃的帧数
+    MetricHistogram *WebSocketAckMetric; ///< WebSocket 帧从发送到客户端确认的时间
+    std::string MetricsCamera;           ///< 指标的 camera 标签
+    std::atomic<uint64_t> Bitrate;       ///< 每个流的目标码率(bit/s)，0 表示使用固定质量；在 VariantGuard 内修改，读取不加锁
+    JpegDecodeSlot DecodeSlots[JPEG_DECODE_SCALES]; ///< 视频源输出jpeg时各个缩小倍数的解码结果
+    std::vector<std::unique_ptr<JpegTier> > Tiers; ///< 编码档位，按分辨率从高到低排列
+    std::vector<std::unique_ptr<JpegTier> > Variants; ///< 变体档位，大小固定为 JPEG_VARIANT_COUNT，只追加
+    std::atomic<size_t> VariantCount;    ///< 已经创建的变体档位数量，先创建档位再增加
+    std::mutex VariantGuard;             ///< 创建变体档位的锁
+    StreamTickGroups StreamGroups;       ///< mjpeg/WebSocket 连接按照事件循环和帧率分组的定时发送
+    std::mutex EncoderSetupGuard;        ///< 修改编码线程参数和重新创建线程池的锁
+    std::mutex EncoderPoolGuard;         ///< 线程池指针的锁，提交任务和替换线程池时持有
+    std::atomic<bool> EncodersStopping;  ///< 旧的线程池正在停止，编码任务完成当前帧之后退出
+    bool EncodeInline;                   ///< 编码线程数为0，由采集线程直接编码，EncoderPoolGuard 保护
+    std::mutex InlineEncodeGuard;        ///< 采集线程直接编码期间持有，重新创建线程池时等待编码完成
+    std::unique_ptr<ThreadPool> EncoderPool;       ///< 编码线程池，最先析构
 };
 
 NAMESPACE_END
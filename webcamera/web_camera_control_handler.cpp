@@ -13,7 +13,8 @@ const static char *StatusPropertyFailed = "Failed setting property";
 /* 内部函数 */
 // Get all or the list of specified variables
 
-static void HandleGetRequest(const std::shared_ptr<V4L2CameraConfig> &infoObject, const std::string &varsToGet, WebResponse &response)
+static void HandleGetRequest(const std::shared_ptr<V4L2CameraConfig> &infoObject, const std::string &varsToGet, WebResponse &response,
+                             const std::string &extraFields = std::string())
 {
     std::map<string, string> values;
     string reply = "{\"status\":\"OK\",\"config\":{";
@@ -89,13 +90,16 @@ static void HandleGetRequest(const std::shared_ptr<V4L2CameraConfig> &infoObject
         first = false;
     }
 
-    reply += "}}";
+    reply += "}";
+    reply += extraFields;
+    reply += "}";
     response.setStatusCode(WebResponse::k200Ok);
     response.setStatusMessage("OK");
     response.setContentType("application/json");
     response.addHeader("Cache-Control", "no-store, must-revalidate");
     response.addHeader("Pragma", "no-cache");
     response.addHeader("Expires", "0");
+    response.addHeader("Content-Length", std::to_string(reply.size()));
     response.setBody(reply);
 }
 
@@ -154,19 +158,55 @@ void HandlePostRequest(const std::shared_ptr<V4L2CameraConfig> &objectToConfig,
 
 CameraInfoHandler::CameraInfoHandler(
     const std::shared_ptr<V4L2Camera> &camera,
-    const std::string &url) : WebRequestHandlerInterface(url, false)
+    const std::string &url) : WebRequestHandlerInterface(url, false), camera_(camera)
 {
     camera_data_ = std::make_shared<V4L2CameraConfig>(camera);
 }
 
-void CameraInfoHandler::HandleHttpRequest(const WebRequest &request, WebResponse &response)
+static const char *PixelFormatName(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::Grayscale8:
+        return "GREY";
+    case PixelFormat::RGB24:
+        return "RGB24";
+    case PixelFormat::RGBA32:
+        return "RGBA32";
+    case PixelFormat::JPEG:
+        return "JPEG";
+    case PixelFormat::YUYV:
+        return "YUYV";
+    case PixelFormat::NV12:
+        return "NV12";
+    case PixelFormat::I420:
+        return "I420";
+    default:
+        return "Unknown";
+    }
+}
+
+void CameraInfoHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
 {
     if (request.method() == WebRequest::kGet)
     {
         /* 检查数据指针是否正常 */
         if (camera_data_)
         {
-            HandleGetRequest(this->camera_data_, "" /* request.GetVariable( "vars" ) */, response);
+            // 设备能力在第一次打开设备时枚举或者从缓存读取，之前为null
+            std::shared_ptr<const V4L2DeviceCapabilities> capabilities = camera_->Capabilities();
+            std::string extra = ",\"capabilities\":";
+            extra += (capabilities) ? capabilities->ToJson() : std::string("null");
+            if (capabilities)
+            {
+                V4L2CaptureMode mode = camera_->CaptureMode();
+                char item[192];
+                snprintf(item, sizeof(item), ",\"mode\":{\"capture\":\"%s\",\"output\":\"%s\",\"width\":%u,\"height\":%u,\"interval\":\"%u/%u\"}",
+                         PixelFormatName(mode.Format), PixelFormatName(mode.Converted), camera_->Width(), camera_->Height(),
+                         mode.Interval.Numerator, mode.Interval.Denominator);
+                extra += item;
+            }
+            HandleGetRequest(this->camera_data_, "" /* request.GetVariable( "vars" ) */, response, extra);
         }
         else
         {
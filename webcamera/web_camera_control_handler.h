@@ -43,13 +43,15 @@ public:
      */
     CameraInfoHandler(const std::shared_ptr<V4L2Camera> &camera, const std::string &url);
     /**
-     * @brief 响应函数
+     * @brief 响应函数，返回摄像头属性、设备能力(capabilities)和选择的采集模式(mode)
+     * @param  conn             连接
      * @param  request          请求头部
      * @param  response         响应
      */
-    void HandleHttpRequest(const WebRequest &request, WebResponse &response);
+    void HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response);
 
 private:
+    std::shared_ptr<V4L2Camera> camera_;            ///< 摄像头
     std::shared_ptr<V4L2CameraConfig> camera_data_; ///< data
 };
 
@@ -30,6 +30,10 @@ void WebCameraServer::Start()
     // 主事件开始循环
     loop_.loop();
 }
+void WebCameraServer::Stop()
+{
+    loop_.quit();
+}
 void WebCameraServer::AddHandler(const string &hander_name, const std::shared_ptr<WebRequestHandlerInterface> handler)
 {
     function_map_[hander_name] = handler;
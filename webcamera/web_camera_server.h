@@ -63,6 +63,10 @@ public:
      * @brief 服务器开始
      */
     void Start();
+    /**
+     * @brief 结束事件循环，Start 随之返回；可以在其它线程中调用
+     */
+    void Stop();
     /**
      * @brief Get the Root Path object
      * @return std::string 根目录位置
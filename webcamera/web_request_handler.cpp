@@ -2,8 +2,14 @@
 #include "logging.h"
 #include "time_stamp.h"
 #include "net_buffer.h"
+#include "avi_writer.h"
+#include "base_trace.h"
 #include <functional>
+#include <algorithm>
 #include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 NAMESPACE_START
 
@@ -27,59 +33,249 @@ WebRequestHandlerInterface::WebRequestHandlerInterface(
 WebRequestHandlerInterface::~WebRequestHandlerInterface()
 {
 }
-//
-void JpegRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+
+/* 获取查询参数的值，query 以 '?' 开始 */
+static bool QueryValue(const std::string &query, const char *name, std::string *value)
 {
-    if (!Owner->IsError())
+    size_t nameLength = strlen(name);
+    size_t start = 0;
+
+    while (start < query.length())
     {
-        Owner->EncodeCameraImage();
+        if ((query[start] == '?') || (query[start] == '&'))
+        {
+            start++;
+            continue;
+        }
+        size_t end = query.find('&', start);
+        if (end == std::string::npos)
+        {
+            end = query.length();
+        }
+        if ((end - start > nameLength) && (query.compare(start, nameLength, name) == 0) && (query[start + nameLength] == '='))
+        {
+            *value = query.substr(start + nameLength + 1, end - start - nameLength - 1);
+            return true;
+        }
+        start = end;
     }
-    if (Owner->IsError())
+    return false;
+}
+
+/* 获取整数查询参数，不存在或者格式错误时返回false */
+static bool QueryInteger(const std::string &query, const char *name, int64_t *value)
+{
+    std::string text;
+    char *end = nullptr;
+
+    if (!QueryValue(query, name, &text) || text.empty())
     {
-        Owner->ReportError(response);
+        return false;
     }
-    else
+    long long result = strtoll(text.c_str(), &end, 10);
+    if (*end != '\0')
     {
-        /* 这里对图像数据加锁，避免竞争访问 */
-        std::lock_guard<std::mutex> lock(Owner->BufferGuard);
-        if (Owner == nullptr)
+        return false;
+    }
+    *value = static_cast<int64_t>(result);
+    return true;
+}
+
+/* 画面变体坐标和宽度的上限 */
+static const int kMaxVariantSize = 65535;
+
+/* 解析画面变体参数 ?w=宽度 和 ?roi=x,y,w,h，参数格式错误时返回false */
+static bool ParseVariant(const std::string &query, JpegVariant *variant)
+{
+    std::string text;
+    int64_t width = 0;
+
+    if (QueryValue(query, "w", &text))
+    {
+        if ((!QueryInteger(query, "w", &width)) || (width <= 0) || (width > kMaxVariantSize))
         {
-            response.SendFast(WebResponse::k500ServerError, "No image from video source");
+            return false;
         }
-        else
+        variant->TargetWidth = static_cast<int32_t>(width);
+    }
+    if (QueryValue(query, "roi", &text))
+    {
+        int x = 0, y = 0, w = 0, h = 0;
+        char tail = 0;
+        if ((sscanf(text.c_str(), "%d,%d,%d,%d%c", &x, &y, &w, &h, &tail) != 4) ||
+            (x < 0) || (y < 0) || (w <= 0) || (h <= 0) ||
+            (x > kMaxVariantSize) || (y > kMaxVariantSize) || (w > kMaxVariantSize) || (h > kMaxVariantSize))
         {
-            response.setStatusCode(WebResponse::k200Ok);
-            response.setStatusMessage("OK");
-            response.setContentType("image/png");
-            /* 注意这里取消缓存 */
-            response.addHeader("Cache-Control", "no-store, must-revalidate");
-            response.addHeader("Pragma", "no-cache");
-            response.addHeader("Expires", "0");
-            response.setBody(std::string((char *)Owner->JpegBuffer, Owner->JpegSize));
-            /* 输入主体长度 */
-            response.addHeader("Content-Length", std::to_string(Owner->JpegSize));
+            return false;
         }
+        variant->X = x;
+        variant->Y = y;
+        variant->Width = w;
+        variant->Height = h;
+    }
+    return true;
+}
+
+/* 解析帧率参数 ?fps=n，没有参数时使用最短间隔，不是正整数时返回false */
+static bool ParseFrameInterval(const std::string &query, uint32_t minInterval, uint32_t *interval)
+{
+    std::string text;
+    int64_t fps = 0;
+
+    *interval = minInterval;
+    if (!QueryValue(query, "fps", &text))
+    {
+        return true;
+    }
+    if ((!QueryInteger(query, "fps", &fps)) || (fps <= 0))
+    {
+        return false;
+    }
+    *interval = std::max(static_cast<uint32_t>(1000 / std::min<int64_t>(fps, 1000)), minInterval);
+    return true;
+}
+
+/* 根据请求参数选择档位，参数错误或者变体数量已满时写入错误响应并返回false */
+static bool SelectRequestTier(VideoSourceToWebData *owner, const WebRequest &request, WebResponse &response, size_t *tierIndex, bool *fixed)
+{
+    JpegVariant variant;
+
+    if (!ParseVariant(request.query(), &variant))
+    {
+        response.SendFast(WebResponse::k400BadRequest, "Invalid w or roi parameter");
+        return false;
+    }
+    if (owner->AcquireVariant(variant, tierIndex) != Error::Success)
+    {
+        response.SendFast(WebResponse::k503ServiceUnavailable, "Too many image variants");
+        return false;
+    }
+    *fixed = !variant.IsDefault();
+    return true;
+}
+
+/* 切换连接订阅的档位，维护各档位的订阅数量 */
+static void SwitchClientTier(VideoSourceToWebData *owner, const MjpegClientStatePtr &client, size_t tier, bool subscribe)
+{
+    if (client->Subscribed)
+    {
+        owner->Tier(client->Tier).Subscribers--;
+    }
+    client->Tier = tier;
+    client->Subscribed = subscribe;
+    client->TierSequence = owner->FrameSequence;
+    if (client->Subscribed)
+    {
+        owner->Tier(client->Tier).Subscribers++;
+    }
+}
+
+/* 连接结束，不再订阅档位，记录连接期间丢弃的帧数 */
+static void FinishClient(VideoSourceToWebData *owner, const MjpegClientStatePtr &client)
+{
+    SwitchClientTier(owner, client, client->Tier, false);
+    owner->ClientDropsMetric->Observe(client->DroppedFrames);
+}
+
+/* 已经发布的帧是否足够新，编码中的帧允许落后一帧；视频源暂停之前的帧不再发送 */
+static bool IsFrameFresh(VideoSourceToWebData *owner, const JpegFramePtr &frame)
+{
+    return (frame) && (!owner->SourceIdle) && (frame->Sequence + 1 >= owner->FrameSequence);
+}
+
+/* 帧的采集时间(毫秒，保留到微秒)，整数部分与历史帧导出的 X-Timestamp 相同 */
+static int FormatFrameTimestamp(char *buf, size_t size, const JpegFramePtr &frame)
+{
+    return snprintf(buf, size, "%lld.%03d", static_cast<long long>(frame->TimeStamp.tv_sec) * 1000 + frame->TimeStamp.tv_usec / 1000,
+                    static_cast<int>(frame->TimeStamp.tv_usec % 1000));
+}
+
+/* 将multipart的分段头部和jpeg数据写入缓冲区，头部在栈上格式化 */
+static void AppendMjpegPart(net::Buffer *buf, const JpegFramePtr &frame)
+{
+    char header[128];
+    char timestamp[32];
+    FormatFrameTimestamp(timestamp, sizeof(timestamp), frame);
+    int length = snprintf(header, sizeof(header), "\r\n--myboundary\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %s\r\n\r\n",
+                          frame->Size, timestamp);
+    buf->append(header, static_cast<size_t>(length));
+    buf->append(frame->Data, frame->Size);
+}
+
+// 只发送编码线程已经发布的帧，IO线程中不进行编码
+void JpegRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+{
+    Owner->NotifyDemand();
+    if (Owner->IsError())
+    {
+        Owner->ReportError(response);
+        return;
+    }
+
+    size_t tierIndex = 0;
+    bool fixed = false;
+    if (!SelectRequestTier(Owner, request, response, &tierIndex, &fixed))
+    {
+        return;
+    }
+
+    Owner->TouchSnapshotDemand(tierIndex);
+    JpegFramePtr frame = Owner->Tier(tierIndex).Frame();
+    if (Owner->IsTierFailed(tierIndex, 0))
+    {
+        // 档位最近一次编码失败，重新编码当前帧，成功之后的请求正常返回
+        Owner->ScheduleEncoding();
+        response.SendFast(WebResponse::k500ServerError, Error(Owner->Tier(tierIndex).LastError).ToString().c_str());
+    }
+    else if (!IsFrameFresh(Owner, frame))
+    {
+        // 第一次请求或者长时间没有请求，通知编码线程编码当前帧，客户端稍后重试
+        Owner->ScheduleEncoding();
+        response.SendFast(WebResponse::k503ServiceUnavailable, "No image from video source");
+        response.addHeader("Retry-After", "1");
+    }
+    else
+    {
+        response.setStatusCode(WebResponse::k200Ok);
+        response.setStatusMessage("OK");
+        response.setContentType("image/png");
+        /* 注意这里取消缓存 */
+        response.addHeader("Cache-Control", "no-store, must-revalidate");
+        response.addHeader("Pragma", "no-cache");
+        response.addHeader("Expires", "0");
+        response.setBody(std::string((char *)frame->Data, frame->Size));
+        /* 输入主体长度 */
+        response.addHeader("Content-Length", std::to_string(frame->Size));
+        response.addHeader("X-Change-Score", std::to_string(frame->ChangeScore));
+        char timestamp[32];
+        FormatFrameTimestamp(timestamp, sizeof(timestamp), frame);
+        response.addHeader("X-Timestamp", timestamp);
     }
 }
 
 void MjpegRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
 {
-    // 统计处理时间
-    uint32_t handlingTime = 0;
-    if (!Owner->IsError())
+    MjpegClientStatePtr client = std::make_shared<MjpegClientState>();
+    if (Owner != nullptr)
     {
-        Timestamp startTime = Timestamp::now();
-        Owner->EncodeCameraImage();
-        Timestamp endTime = Timestamp::now();
-        handlingTime = static_cast<uint32_t>(endTime.microSecondsSinceEpoch() - startTime.microSecondsSinceEpoch());
+        Owner->NotifyDemand();
     }
     if (Owner == nullptr || Owner->IsError())
     {
         Owner->ReportError(response);
     }
-    else
+    else if (!ParseFrameInterval(request.query(), FrameInterval, &client->FrameInterval))
+    {
+        // 在选择档位之前检查，避免参数错误时占用变体档位
+        response.SendFast(WebResponse::k400BadRequest, "Invalid fps parameter");
+    }
+    else if (SelectRequestTier(Owner, request, response, &client->Tier, &client->FixedTier))
     {
-        std::lock_guard<std::mutex> lock(Owner->BufferGuard);
+        // 记录连接状态，计入档位订阅；之后的帧由编码线程持续编码
+        SwitchClientTier(Owner, client, client->Tier, true);
+        client->Ladder.Reset(client->FrameInterval);
+        JpegFramePtr frame = Owner->Tier(client->Tier).Frame();
+
         response.setStatusCode(WebResponse::k200Ok);
         response.setStatusMessage("OK");
         /* 注意这里取消缓存 */
@@ -89,79 +285,603 @@ void MjpegRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, c
         // 设置上下文类型
         response.addHeader("Content-Type", "multipart/x-mixed-replace; boundary=--myboundary");
 
-        string extenHeader = "\r\n--myboundary\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(Owner->JpegSize) + "\r\n\r\n";
-        extenHeader += std::string((char *)Owner->JpegBuffer, Owner->JpegSize);
-        response.setBody(extenHeader);
-        // response.setExternalHeader(extenHeader);
-        //  设置connect 主动时间回调用
-        conn->setTimerCallback(std::bind(&MjpegRequestHandler::HandleTimer, this, conn));
-        Timestamp nextTime = addTime(Timestamp::now(), FrameInterval * 1000);
-        conn->setTimer(nextTime);
-        LOG_DEBUG << "Mjpeg Stream connect name is " << conn->name() << "handle next time:" << nextTime.toFormattedString();
+        if (IsFrameFresh(Owner, frame))
+        {
+            AppendMjpegPart(&client->SendBuffer, frame);
+            client->Ladder.OnSent(client->SendBuffer.readableBytes());
+            response.setBody(client->SendBuffer.retrieveAllAsString());
+            client->LastSequence = frame->Sequence;
+        }
+        else
+        {
+            // 档位刚开始订阅，立即编码当前帧，第一帧在定时器中发送
+            Owner->ScheduleEncoding();
+        }
+        client->LastTick = Timestamp::now();
+        // 加入相同帧率的定时分组，之后的帧在分组的定时中发送
+        Schedule(conn, client);
+        LOG_DEBUG << "Mjpeg Stream connect name is " << conn->name() << " frame interval " << client->FrameInterval << "ms";
     }
 }
 
-void MjpegRequestHandler::HandleTimer(const net::TcpConnectionPtr &conn)
+void MjpegRequestHandler::Schedule(const net::TcpConnectionPtr &conn, const MjpegClientStatePtr &client)
 {
-    uint32_t handlingTime = 0;
-    Timestamp startTime = Timestamp::now();
+    // 分组只持有连接的弱引用，连接释放之后在下一次定时中移除
+    std::weak_ptr<net::TcpConnection> weakConn(conn);
+    Owner->StreamGroups.Add(conn->getLoop(), client->FrameInterval, [this, weakConn, client]() {
+        net::TcpConnectionPtr conn = weakConn.lock();
+        if (!conn)
+        {
+            FinishClient(Owner, client);
+            return false;
+        }
+        return HandleTimer(conn, client);
+    });
+}
+
+void MjpegRequestHandler::UpdateClientTier(const net::TcpConnectionPtr &conn, const MjpegClientStatePtr &client)
+{
+    Timestamp now = Timestamp::now();
+    size_t queued = conn->outputBuffer()->readableBytes();
+
+    client->Ladder.Measure(queued, now.microSecondsSinceEpoch() - client->LastTick.microSecondsSinceEpoch());
+    client->LastTick = now;
 
-    // 创建数据
-    WebResponse response(false);
-    if (!Owner->IsError())
+    // 请求指定了画面变体，只有一个档位可用
+    if (client->FixedTier)
+    {
+        return;
+    }
+    if (!Owner->AdaptiveTiers)
+    {
+        if (client->Tier != 0)
+        {
+            SwitchClientTier(Owner, client, 0, true);
+        }
+        return;
+    }
+
+    JpegFramePtr current = Owner->Tier(client->Tier).Frame();
+    uint32_t frameSize = (current) ? current->Size : 0;
+    uint32_t scales[JPEG_TIER_COUNT];
+    size_t tierCount = std::min<size_t>(Owner->Tiers.size(), JPEG_TIER_COUNT);
+
+    for (size_t i = 0; i < tierCount; i++)
+    {
+        scales[i] = Owner->Tier(i).Scale;
+    }
+    size_t tier = client->Ladder.Select(queued, frameSize, client->FrameInterval, client->Tier, scales, tierCount);
+    if (tier > client->Tier)
+    {
+        LOG_INFO << conn->name() << " congested, throughput " << static_cast<int64_t>(client->Ladder.Throughput())
+                 << " B/s, switch tier " << client->Tier << " -> " << tier;
+        SwitchClientTier(Owner, client, tier, true);
+    }
+    else if (tier < client->Tier)
     {
+        LOG_INFO << conn->name() << " stable, switch tier " << client->Tier << " -> " << tier;
+        SwitchClientTier(Owner, client, tier, true);
+    }
+}
 
-        Owner->EncodeCameraImage();
+bool MjpegRequestHandler::HandleTimer(const net::TcpConnectionPtr &conn, const MjpegClientStatePtr &client)
+{
+    Timestamp startTime = Timestamp::now();
+
+    if (!conn->connected())
+    {
+        // 连接已经断开，不再订阅档位
+        FinishClient(Owner, client);
+        LOG_INFO << conn->name() << "is closed,No Next Frame";
+        return false;
     }
 
-    if ((Owner == nullptr) || (Owner->IsError()) || (Owner->JpegSize == 0))
+    UpdateClientTier(conn, client);
+
+    // 视频源错误关闭所有连接，档位的编码错误只关闭订阅该档位的连接
+    if ((Owner->IsError()) || (Owner->IsTierFailed(client->Tier, client->TierSequence)))
     {
-        response.setCloseConnection(true);
+        FinishClient(Owner, client);
         // 注意这里是直接执行函数，需要主动关闭连接
         conn->shutdown();
         LOG_INFO << conn->name() << "is closed";
+        return false;
     }
-    else
-    {
-        std::lock_guard<std::mutex> lock(Owner->BufferGuard);
 
+    JpegFramePtr frame = Owner->Tier(client->Tier).Frame();
+    Owner->OutputBufferMetric->Observe(conn->outputBuffer()->readableBytes());
+
+    // 切换档位之后该档位可能还没有编码，或者没有新的帧，本次不发送；
+    // 低帧率的连接只发送定时时最新的帧，中间的帧直接跳过
+    if ((IsFrameFresh(Owner, frame)) && (frame->Sequence != client->LastSequence))
+    {
         // don't try sending too much on slow connections - it will only create video lag
         // 限制缓冲队列大小
-        if (conn->outputBuffer()->readableBytes() < 2 * Owner->JpegSize)
+        if (conn->outputBuffer()->readableBytes() < 2 * frame->Size)
         {
-            net::Buffer buf;
-            // 注意这里的开头和结尾界定符号
-            string extenHeader = "\r\n--myboundary\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(Owner->JpegSize) + "\r\n\r\n";
-            buf.append(extenHeader);
-            buf.append(std::string((char *)Owner->JpegBuffer, Owner->JpegSize));
-            conn->send(&buf);
+            // 注意这里的开头和结尾界定符号；缓冲区在连接内复用，发送后容量保留
+            AppendMjpegPart(&client->SendBuffer, frame);
+            client->Ladder.OnSent(client->SendBuffer.readableBytes());
+            client->LastSequence = frame->Sequence;
+            conn->setTraceId(frame->FrameId);
+            conn->send(&client->SendBuffer);
+            conn->setTraceId(0);
         }
         else
         {
+            // 跳过这一帧，之后发送最新的帧
+            client->LastSequence = frame->Sequence;
+            client->DroppedFrames++;
+            Owner->DroppedFramesMetric->Add();
             LOG_INFO << conn->name() << "buffer is full";
         }
+    }
+
+    if (!conn->connected())
+    {
+        FinishClient(Owner, client);
+        LOG_INFO << conn->name() << "is closed,No Next Frame";
+        return false;
+    }
+    // get final request handling time
+    Owner->MjpegSendMetric->Observe(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch() - startTime.microSecondsSinceEpoch()));
+    return true;
+}
+
+/* WebSocket 连接结束，只处理一次 */
+static void FinishWebSocketClient(VideoSourceToWebData *owner, const WebSocketClientStatePtr &client)
+{
+    if (!client->Closed)
+    {
+        client->Closed = true;
+        FinishClient(owner, client);
+    }
+}
+
+/* 二进制消息：帧头部和jpeg数据，头部字段为网络字节序 */
+static void AppendWebSocketFrame(net::Buffer *buf, const JpegFramePtr &frame, size_t tier)
+{
+    net::websocket::appendFrameHeader(buf, net::websocket::kBinary, WEBSOCKET_FRAME_HEADER + frame->Size);
+    buf->appendInt8(1);
+    buf->appendInt8(static_cast<int8_t>(tier));
+    buf->appendInt16(WEBSOCKET_FRAME_HEADER);
+    buf->appendInt32(static_cast<int32_t>(frame->Size));
+    buf->appendInt64(static_cast<int64_t>(frame->Sequence));
+    buf->appendInt64(static_cast<int64_t>(frame->TimeStamp.tv_sec) * 1000000 + frame->TimeStamp.tv_usec);
+    buf->append(frame->Data, frame->Size);
+}
+
+void WebSocketRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+{
+    WebSocketClientStatePtr client = std::make_shared<WebSocketClientState>();
+
+    Owner->NotifyDemand();
+    if (Owner->IsError())
+    {
+        Owner->ReportError(response);
+        response.setCloseConnection(true);
+        return;
+    }
+    if (!ParseFrameInterval(request.query(), FrameInterval, &client->FrameInterval))
+    {
+        response.SendFast(WebResponse::k400BadRequest, "Invalid fps parameter");
+        response.setCloseConnection(true);
+        return;
+    }
+    if (!SelectRequestTier(Owner, request, response, &client->Tier, &client->FixedTier))
+    {
+        response.setCloseConnection(true);
+        return;
+    }
+    if (!net::websocket::accept(request, &response,
+                                std::bind(&WebSocketRequestHandler::HandleMessage, this, _1, _2, _3, client)))
+    {
+        return;
+    }
+
+    // 与mjpeg连接相同，计入档位订阅，第一帧在定时器中发送
+    SwitchClientTier(Owner, client, client->Tier, true);
+    if (!IsFrameFresh(Owner, Owner->Tier(client->Tier).Frame()))
+    {
+        Owner->ScheduleEncoding();
+    }
+    Schedule(conn, client);
+    LOG_DEBUG << "WebSocket stream connect name is " << conn->name();
+}
+
+void WebSocketRequestHandler::Schedule(const net::TcpConnectionPtr &conn, const WebSocketClientStatePtr &client)
+{
+    std::weak_ptr<net::TcpConnection> weakConn(conn);
+    uint32_t interval = client->FrameInterval;
+    Owner->StreamGroups.Add(conn->getLoop(), interval, [this, weakConn, client, interval]() {
+        net::TcpConnectionPtr conn = weakConn.lock();
+        if (!conn)
+        {
+            FinishWebSocketClient(Owner, client);
+            return false;
+        }
+        if ((client->FrameInterval != interval) && (!client->Closed))
+        {
+            // fps 命令修改了帧率，移动到新的分组
+            Schedule(conn, client);
+            return false;
+        }
+        return HandleTimer(conn, client);
+    });
+}
 
-        // 检查是否需要设置下一个
-        if (conn->connected() && (!response.closeConnection()))
+void WebSocketRequestHandler::HandleMessage(const net::TcpConnectionPtr &conn, net::websocket::Opcode opcode,
+                                            const std::string &message, const WebSocketClientStatePtr &client)
+{
+    char command[16] = {0};
+    unsigned long long value = 0;
+
+    if (opcode == net::websocket::kClose)
+    {
+        FinishWebSocketClient(Owner, client);
+        return;
+    }
+    if ((opcode != net::websocket::kText) || (sscanf(message.c_str(), "%15s %llu", command, &value) != 2))
+    {
+        LOG_INFO << conn->name() << " unknown websocket command";
+        return;
+    }
+
+    if (strcmp(command, "ack") == 0)
+    {
+        // 确认是累计的，之前没有确认的帧视为已经跳过
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        while ((!client->InFlight.empty()) && (client->InFlight.front().first <= value))
         {
-            // 获取现在时间
-            Timestamp endTime = Timestamp::now();
-            // get final request handling time
-            handlingTime = static_cast<uint32_t>(endTime.microSecondsSinceEpoch() - startTime.microSecondsSinceEpoch());
-            uint32_t nextTimespace = ((handlingTime >= FrameInterval * 1000) ? 1000 : FrameInterval * 1000 - handlingTime);
-            // set new timer for further images
-            Timestamp next_time = addTime(Timestamp::now(), nextTimespace);
-            conn->setTimer(next_time);
+            if (client->InFlight.front().first == value)
+            {
+                Owner->WebSocketAckMetric->Observe(static_cast<uint64_t>(now - client->InFlight.front().second));
+            }
+            client->InFlight.pop_front();
         }
-        else
+    }
+    else if (strcmp(command, "window") == 0)
+    {
+        client->Window = static_cast<uint32_t>(std::min<unsigned long long>(value, WEBSOCKET_MAX_WINDOW));
+        if (client->Window == 0)
         {
-            LOG_INFO << conn->name() << "is closed,No Next Frame";
+            client->InFlight.clear();
         }
     }
-    if (response.closeConnection())
+    else if (strcmp(command, "fps") == 0)
+    {
+        uint32_t interval = (value == 0) ? FrameInterval : static_cast<uint32_t>(1000 / std::min<unsigned long long>(value, 1000));
+        client->FrameInterval = std::max(interval, FrameInterval);
+    }
+    else if (strcmp(command, "tier") == 0)
+    {
+        if ((value < Owner->Tiers.size()) && (value != client->Tier) && (!client->Closed))
+        {
+            SwitchClientTier(Owner, client, static_cast<size_t>(value), true);
+            client->FixedTier = false;
+        }
+    }
+    else
+    {
+        LOG_INFO << conn->name() << " unknown websocket command " << command;
+    }
+}
+
+bool WebSocketRequestHandler::HandleTimer(const net::TcpConnectionPtr &conn, const WebSocketClientStatePtr &client)
+{
+    Timestamp startTime = Timestamp::now();
+
+    if ((!conn->connected()) || (client->Closed))
+    {
+        FinishWebSocketClient(Owner, client);
+        return false;
+    }
+    // 视频源错误或者档位编码错误时发送关闭帧通知客户端，并且主动关闭连接
+    if ((Owner->IsError()) || (Owner->IsTierFailed(client->Tier, client->TierSequence)))
     {
+        net::Buffer close;
+        FinishWebSocketClient(Owner, client);
+        net::websocket::appendClose(&close, net::websocket::kInternalError);
+        conn->send(&close);
         conn->shutdown();
+        LOG_INFO << conn->name() << " websocket stream is closed";
+        return false;
+    }
+
+    JpegFramePtr frame = Owner->Tier(client->Tier).Frame();
+    if ((IsFrameFresh(Owner, frame)) && (frame->Sequence != client->LastSequence))
+    {
+        // 客户端开启确认控制时按照没有确认的帧数发送，否则按照输出缓冲区的积压情况发送
+        bool hasCredit = (client->Window == 0) || (client->InFlight.size() < client->Window);
+        if (!hasCredit)
+        {
+            // 等待确认，确认之后发送最新的帧
+        }
+        else if (conn->outputBuffer()->readableBytes() < 2 * frame->Size)
+        {
+            AppendWebSocketFrame(&client->SendBuffer, frame, client->Tier);
+            client->LastSequence = frame->Sequence;
+            if (client->Window != 0)
+            {
+                client->InFlight.push_back(std::make_pair(frame->Sequence, startTime.microSecondsSinceEpoch()));
+            }
+            conn->setTraceId(frame->FrameId);
+            conn->send(&client->SendBuffer);
+            conn->setTraceId(0);
+        }
+        else
+        {
+            client->LastSequence = frame->Sequence;
+            client->DroppedFrames++;
+            Owner->DroppedFramesMetric->Add();
+        }
+    }
+    return true;
+}
+
+void MetricsRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+{
+    std::string body;
+
+    MetricsRegistry::Instance().Expose(&body);
+    response.setStatusCode(WebResponse::k200Ok);
+    response.setStatusMessage("OK");
+    response.setContentType("text/plain; version=0.0.4");
+    response.addHeader("Cache-Control", "no-store, must-revalidate");
+    response.addHeader("Content-Length", std::to_string(body.size()));
+    response.getBody().swap(body);
+}
+
+/* 运动事件导出时默认包含事件前后的秒数 */
+static const int64_t kEventMarginSeconds = 5;
+
+/* 缓存状态和运动事件 */
+static void SendHistoryStatus(FrameHistory &history, WebResponse &response)
+{
+    size_t frames = 0;
+    size_t bytes = 0;
+    int64_t oldest = 0;
+    int64_t newest = 0;
+    std::vector<MotionEvent> events = history.Events();
+    char item[160];
+
+    history.Status(&frames, &bytes, &oldest, &newest);
+    snprintf(item, sizeof(item), "{\"status\":\"OK\",\"frames\":%zu,\"bytes\":%zu,\"from\":%lld,\"to\":%lld,\"events\":[",
+             frames, bytes, static_cast<long long>(oldest / 1000), static_cast<long long>(newest / 1000));
+    std::string reply(item);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        snprintf(item, sizeof(item), "%s{\"id\":%zu,\"start\":%lld,\"end\":%lld,\"peak\":%u}", (i == 0) ? "" : ",",
+                 i, static_cast<long long>(events[i].Start / 1000), static_cast<long long>(events[i].End / 1000), events[i].PeakScore);
+        reply += item;
+    }
+    reply += "]}";
+
+    response.setStatusCode(WebResponse::k200Ok);
+    response.setStatusMessage("OK");
+    response.setContentType("application/json");
+    response.addHeader("Cache-Control", "no-store, must-revalidate");
+    response.addHeader("Content-Length", std::to_string(reply.size()));
+    response.setBody(reply);
+}
+
+/* 导出的定时发送间隔(毫秒) */
+static const uint32_t kExportInterval = 10;
+/* 输出缓冲区积压超过该大小时等待下一次定时 */
+static const size_t kExportChunkBytes = 1024 * 1024;
+
+/* 每一帧作为multipart的一个分段，分段头部带有帧的时间 */
+static void PrepareMultipartExport(const std::vector<int64_t> &times, HistoryExportState *state)
+{
+    char header[128];
+
+    state->Prefixes.resize(state->Frames.size());
+    for (size_t i = 0; i < state->Frames.size(); i++)
+    {
+        int length = snprintf(header, sizeof(header), "\r\n--myboundary\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %lld\r\n\r\n",
+                              state->Frames[i]->Size, static_cast<long long>(times[i] / 1000));
+        state->Prefixes[i].assign(header, static_cast<size_t>(length));
+    }
+}
+
+/* 所有帧写入MJPEG AVI文件，帧率按照平均帧间隔计算；文件头部放在第一帧之前 */
+static bool PrepareAviExport(const std::vector<int64_t> &times, HistoryExportState *state)
+{
+    const std::vector<JpegFramePtr> &frames = state->Frames;
+    AviWriter writer;
+    int32_t width = 0;
+    int32_t height = 0;
+    uint8_t header[AVI_HEADER_SIZE];
+    uint8_t chunkHeader[AVI_CHUNK_HEADER_SIZE];
+    int64_t duration = times.back() - times.front();
+    uint32_t interval = (frames.size() > 1) ? static_cast<uint32_t>(duration / static_cast<int64_t>(frames.size() - 1)) : 100000;
+    uint32_t padding = 0;
+
+    if (!AviWriter::JpegImageSize(frames[0]->Data, frames[0]->Size, &width, &height))
+    {
+        return false;
+    }
+
+    writer.Reset(width, height, (interval == 0) ? 1 : interval);
+    state->Prefixes.resize(frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        state->Prefixes[i].assign(padding, '\0');
+        padding = writer.AddFrame(frames[i]->Size, chunkHeader);
+        state->Prefixes[i].append(reinterpret_cast<const char *>(chunkHeader), AVI_CHUNK_HEADER_SIZE);
+    }
+    state->Trailer.assign(padding, '\0');
+    writer.BuildIndex(&state->Trailer);
+    writer.BuildHeader(header);
+    state->Prefixes[0].insert(0, reinterpret_cast<const char *>(header), AVI_HEADER_SIZE);
+    return true;
+}
+
+/* 写入剩余的帧直到积压超过分块大小，全部写入之后追加结尾；返回是否还有数据 */
+static bool AppendExportChunk(HistoryExportState *state, size_t queued)
+{
+    while ((state->Next < state->Frames.size()) && (queued + state->SendBuffer.readableBytes() < kExportChunkBytes))
+    {
+        JpegFramePtr &frame = state->Frames[state->Next];
+        state->SendBuffer.append(state->Prefixes[state->Next]);
+        state->SendBuffer.append(frame->Data, frame->Size);
+        // 发送之后释放帧引用，缓存可以继续淘汰
+        frame.reset();
+        state->Next++;
+    }
+    if (state->Next < state->Frames.size())
+    {
+        return true;
+    }
+    state->SendBuffer.append(state->Trailer);
+    return false;
+}
+
+void FrameHistoryRequestHandler::Schedule(const net::TcpConnectionPtr &conn, const HistoryExportStatePtr &state)
+{
+    std::weak_ptr<net::TcpConnection> weakConn(conn);
+    Owner->StreamGroups.Add(conn->getLoop(), kExportInterval, [weakConn, state]() {
+        net::TcpConnectionPtr conn = weakConn.lock();
+        if (!conn || !conn->connected())
+        {
+            return false;
+        }
+        bool more = AppendExportChunk(state.get(), conn->outputBuffer()->readableBytes());
+        if (state->SendBuffer.readableBytes() > 0)
+        {
+            conn->send(&state->SendBuffer);
+        }
+        return more;
+    });
+}
+
+// 导出历史帧，数据只引用缓存中的帧，不阻塞编码线程
+void FrameHistoryRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+{
+    FrameHistory &history = Owner->History;
+    const std::string &query = request.query();
+    std::string format = "mjpeg";
+    std::string eventName;
+    size_t frameCount = 0;
+    size_t bytes = 0;
+    int64_t from = 0;
+    int64_t to = 0;
+    int64_t value = 0;
+
+    if (!history.IsEnabled())
+    {
+        response.SendFast(WebResponse::k404NotFound, "Frame history is disabled");
+        return;
+    }
+    QueryValue(query, "format", &format);
+    if (format == "json")
+    {
+        SendHistoryStatus(history, response);
+        return;
+    }
+
+    history.Status(&frameCount, &bytes, &from, &to);
+    if (QueryInteger(query, "last", &value))
+    {
+        from = to - value * 1000 * 1000;
+    }
+    if (QueryInteger(query, "from", &value))
+    {
+        from = value * 1000;
+    }
+    if (QueryInteger(query, "to", &value))
+    {
+        to = value * 1000;
+    }
+    if (QueryValue(query, "event", &eventName))
+    {
+        std::vector<MotionEvent> events = history.Events();
+        int64_t pre = kEventMarginSeconds;
+        int64_t post = kEventMarginSeconds;
+        size_t index = events.size();
+
+        if (eventName == "latest")
+        {
+            index = events.size() - 1;
+        }
+        else if (QueryInteger(query, "event", &value) && (value >= 0))
+        {
+            index = static_cast<size_t>(value);
+        }
+        if (index >= events.size())
+        {
+            response.SendFast(WebResponse::k404NotFound, "Motion event not found");
+            return;
+        }
+        QueryInteger(query, "pre", &pre);
+        QueryInteger(query, "post", &post);
+        from = events[index].Start - pre * 1000 * 1000;
+        to = events[index].End + post * 1000 * 1000;
+    }
+
+    HistoryExportStatePtr state = std::make_shared<HistoryExportState>();
+    std::vector<int64_t> times;
+    if (history.Range(from, to, state->Frames, &times) == 0)
+    {
+        response.SendFast(WebResponse::k404NotFound, "No frames in range");
+        return;
+    }
+
+    if (format == "avi")
+    {
+        if (!PrepareAviExport(times, state.get()))
+        {
+            response.SendFast(WebResponse::k500ServerError, "Invalid jpeg frame");
+            return;
+        }
+        response.setContentType("video/x-msvideo");
+        response.addHeader("Content-Disposition", "attachment; filename=\"history-" + std::to_string(times.front() / 1000) + ".avi\"");
+    }
+    else
+    {
+        PrepareMultipartExport(times, state.get());
+        response.addHeader("Content-Type", "multipart/x-mixed-replace; boundary=--myboundary");
+    }
+
+    size_t total = state->Trailer.size();
+    for (size_t i = 0; i < state->Frames.size(); i++)
+    {
+        total += state->Prefixes[i].size() + state->Frames[i]->Size;
+    }
+
+    response.setStatusCode(WebResponse::k200Ok);
+    response.setStatusMessage("OK");
+    response.addHeader("Cache-Control", "no-store, must-revalidate");
+    response.addHeader("Content-Length", std::to_string(total));
+    // 第一块随响应头部发送，剩余的帧在定时分组中按照输出缓冲区的积压继续发送
+    if (AppendExportChunk(state.get(), conn->outputBuffer()->readableBytes()))
+    {
+        Schedule(conn, state);
+    }
+    response.setBody(state->SendBuffer.retrieveAllAsString());
+}
+
+/* 开关跟踪或者导出已经记录的事件 */
+void TraceRequestHandler::HandleHttpRequest(const net::TcpConnectionPtr &conn, const WebRequest &request, WebResponse &response)
+{
+    std::string enable;
+    std::string body;
+
+    if (QueryValue(request.query(), "enable", &enable))
+    {
+        FrameTrace::SetEnabled(enable != "0");
+        body = FrameTrace::IsEnabled() ? "{\"status\":\"OK\",\"enabled\":true}" : "{\"status\":\"OK\",\"enabled\":false}";
+    }
+    else
+    {
+        FrameTrace::ExportChromeTrace(&body);
     }
+    response.setStatusCode(WebResponse::k200Ok);
+    response.setStatusMessage("OK");
+    response.setContentType("application/json");
+    response.addHeader("Cache-Control", "no-store, must-revalidate");
+    response.addHeader("Content-Length", std::to_string(body.size()));
+    response.getBody().swap(body);
 }
 
 NAMESPACE_END
\ No newline at end of file
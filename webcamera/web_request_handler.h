@@ -28,8 +28,21 @@
 #include "net_http_request.h"
 #include "video_source_to_webdata.h"
 #include "net_tcp_connection.h"
+#include "net_buffer.h"
+#include "net_websocket.h"
+#include "tier_ladder.h"
+#include <deque>
 NAMESPACE_START
 
+/**
+ * @brief WebSocket 二进制消息中帧头部的字节数
+ */
+#define WEBSOCKET_FRAME_HEADER (24)
+/**
+ * @brief WebSocket 客户端最多允许没有确认的帧数
+ */
+#define WEBSOCKET_MAX_WINDOW (16)
+
 /**
  * @brief 请求响应控制句柄函数，主要是方便添加reposens函数;对于不同的reques和Response进行处理
  */
@@ -72,6 +85,8 @@ private:
 
 /**
  * @brief jpeg图片请求，对网络请求进行再次封装,每次请求输出单张图片
+ * @details 图片、MJPEG和WebSocket请求都支持 ?w=宽度 缩放和 ?roi=x,y,w,h 裁剪，
+ *          参数相同的请求共享同一个编码档位
  */
 class JpegRequestHandler : public WebRequestHandlerInterface
 {
@@ -91,8 +106,42 @@ private:
     VideoSourceToWebData *Owner; ///< 关键操作处理函数
 };
 
+/**
+ * @brief 单个MJPEG连接的发送状态，用于测量吞吐量并选择编码档位
+ */
+struct MjpegClientState
+{
+    MjpegClientState() : Tier(0),
+                         FixedTier(false),
+                         Subscribed(false),
+                         TierSequence(0),
+                         FrameInterval(0),
+                         LastTick(Timestamp::now()),
+                         Ladder(),
+                         LastSequence(0),
+                         DroppedFrames(0),
+                         SendBuffer()
+    {
+    }
+
+    size_t Tier;               ///< 当前使用的档位
+    bool FixedTier;            ///< 请求指定了裁剪或者缩放参数，不自动切换档位
+    bool Subscribed;           ///< 是否已经计入档位订阅数
+    uint64_t TierSequence;     ///< 订阅当前档位时的帧序号，之前的编码错误不影响该连接
+    uint32_t FrameInterval;    ///< 发送间隔(毫秒)，请求可以通过 fps 参数降低帧率
+    Timestamp LastTick;        ///< 上次发送时间
+    TierLadder Ladder;         ///< 吞吐量测量和档位选择
+    uint64_t LastSequence;     ///< 上次发送的帧序号，同一帧不重复发送
+    uint64_t DroppedFrames;    ///< 输出缓冲区积压而没有发送的帧数
+    net::Buffer SendBuffer;    ///< 复用的发送缓冲区，避免每帧分配内存
+};
+typedef std::shared_ptr<MjpegClientState> MjpegClientStatePtr;
+
 /**
  * @brief MJPEG stream 流发送
+ * @details
+ *  请求参数 fps 降低发送帧率，从共享的编码帧中抽取发送，不增加编码量；
+ *  同一个事件循环中帧率相同的连接通过 StreamTickGroups 在同一次定时中依次发送
  */
 class MjpegRequestHandler : public WebRequestHandlerInterface
 {
@@ -124,12 +173,206 @@ public:
     /**
      * @brief  定义唤醒处理函数，用来定时主动请求
      * @param  conn             TCP连接对象
+     * @param  client           连接的发送状态
+     * @return true             继续发送
+     * @return false            连接已经结束
+     */
+    bool HandleTimer(const net::TcpConnectionPtr &conn, const MjpegClientStatePtr &client);
+
+private:
+    /**
+     * @brief  按照连接的发送间隔加入定时分组
+     * @param  conn             TCP连接对象
+     * @param  client           连接的发送状态
+     */
+    void Schedule(const net::TcpConnectionPtr &conn, const MjpegClientStatePtr &client);
+    /**
+     * @brief  根据输出缓冲区的积压情况更新吞吐量，并选择连接的编码档位
+     * @param  conn             TCP连接对象
+     * @param  client           连接的发送状态
+     */
+    void UpdateClientTier(const net::TcpConnectionPtr &conn, const MjpegClientStatePtr &client);
+
+    VideoSourceToWebData *Owner; ///< 数据函数封装类
+    uint32_t FrameInterval;      ///< 最短的发送间隔(毫秒)
+};
+
+/**
+ * @brief 单个WebSocket连接的发送状态
+ * @details 客户端发送 window 命令之后按照确认控制发送，没有确认的帧最多 Window 个
+ */
+struct WebSocketClientState : public MjpegClientState
+{
+    WebSocketClientState() : MjpegClientState(),
+                             Window(0),
+                             Closed(false),
+                             InFlight()
+    {
+    }
+
+    uint32_t Window;                                    ///< 最多没有确认的帧数，0 表示不使用确认控制
+    bool Closed;                                        ///< 连接已经关闭，不再订阅档位
+    std::deque<std::pair<uint64_t, int64_t> > InFlight; ///< 已经发送、没有确认的帧序号和发送时间(微秒)
+};
+typedef std::shared_ptr<WebSocketClientState> WebSocketClientStatePtr;
+
+/**
+ * @brief WebSocket 二进制帧推流
+ * @details
+ *  每个二进制消息为 WEBSOCKET_FRAME_HEADER 字节的头部加上jpeg数据，头部为网络字节序：
+ *  - 0: 版本(1)，1: 档位，2-3: 头部长度，4-7: jpeg字节数
+ *  - 8-15: 帧序号，16-23: 采集时间(微秒)
+ *  客户端发送文本命令，每条消息一个命令：
+ *  - ack <帧序号>: 该帧以及之前的帧已经显示
+ *  - window <n>: 开启确认控制，最多 n 帧没有确认，0 表示关闭
+ *  - fps <n>: 降低发送帧率，与请求参数 fps 相同
+ *  - tier <n>: 选择编码档位，0 为原始分辨率
+ */
+class WebSocketRequestHandler : public WebRequestHandlerInterface
+{
+public:
+    /**
+     * @brief Construct a new Web Socket Request Handler object
+     * @param  uri              请求url
+     * @param  frameRate        最高发送帧率
+     * @param  owner            拥有者
+     */
+    WebSocketRequestHandler(
+        const string &uri,
+        uint32_t frameRate,
+        VideoSourceToWebData *owner) : WebRequestHandlerInterface(uri, false),
+                                       Owner(owner),
+                                       FrameInterval(1000 / frameRate)
+    {
+    }
+    void HandleHttpRequest(
+        const net::TcpConnectionPtr &conn,
+        const WebRequest &request,
+        WebResponse &response);
+    /**
+     * @brief  处理客户端的命令，连接关闭时 opcode 为 kClose
+     * @param  conn             TCP连接对象
+     * @param  opcode           消息类型
+     * @param  message          消息内容
+     * @param  client           连接的发送状态
+     */
+    void HandleMessage(const net::TcpConnectionPtr &conn, net::websocket::Opcode opcode,
+                       const std::string &message, const WebSocketClientStatePtr &client);
+    /**
+     * @brief  定时发送最新的帧
+     * @param  conn             TCP连接对象
+     * @param  client           连接的发送状态
+     * @return true             继续发送
+     * @return false            连接已经结束
+     */
+    bool HandleTimer(const net::TcpConnectionPtr &conn, const WebSocketClientStatePtr &client);
+
+private:
+    /**
+     * @brief  按照连接的发送间隔加入定时分组，客户端修改帧率之后重新加入
+     * @param  conn             TCP连接对象
+     * @param  client           连接的发送状态
+     */
+    void Schedule(const net::TcpConnectionPtr &conn, const WebSocketClientStatePtr &client);
+
+    VideoSourceToWebData *Owner; ///< 数据函数封装类
+    uint32_t FrameInterval;      ///< 最短的发送间隔(毫秒)
+};
+
+/**
+ * @brief 历史帧导出的发送状态
+ * @details
+ *  每一帧之前的数据(multipart分段头部，或者AVI的上一帧填充和块头部)预先生成，
+ *  帧数据在发送时才复制到输出缓冲区
+ */
+struct HistoryExportState
+{
+    HistoryExportState() : Frames(),
+                           Prefixes(),
+                           Trailer(),
+                           Next(0),
+                           SendBuffer()
+    {
+    }
+
+    std::vector<JpegFramePtr> Frames;  ///< 导出的帧，发送之后释放引用
+    std::vector<std::string> Prefixes; ///< 每一帧之前的数据
+    std::string Trailer;               ///< 最后一帧之后的数据(AVI索引)
+    size_t Next;                       ///< 下一个发送的帧
+    net::Buffer SendBuffer;            ///< 复用的发送缓冲区
+};
+typedef std::shared_ptr<HistoryExportState> HistoryExportStatePtr;
+
+/**
+ * @brief 历史帧导出请求
+ * @details
+ *  导出内存中缓存的编码帧，请求参数:
+ *  - format: mjpeg(默认，multipart流)、avi(MJPEG AVI文件) 或 json(缓存状态和运动事件)
+ *  - from/to: 时间范围，UTC毫秒
+ *  - last: 最近的秒数
+ *  - event: 运动事件，latest 或者事件编号，pre/post 为事件前后的秒数
+ *  响应长度预先计算，帧数据在 StreamTickGroups 的定时中按照输出缓冲区的积压分块发送，
+ *  不在IO线程中一次性生成整个导出内容
+ */
+class FrameHistoryRequestHandler : public WebRequestHandlerInterface
+{
+public:
+    /**
+     * @brief Construct a new Frame History Request Handler object
+     * @param  uri              请求url
+     * @param  owner            拥有者
      */
-    void HandleTimer(const net::TcpConnectionPtr &conn);
+    FrameHistoryRequestHandler(
+        const string &uri,
+        VideoSourceToWebData *owner) : WebRequestHandlerInterface(uri, false),
+                                       Owner(owner)
+    {
+    }
+    void HandleHttpRequest(
+        const net::TcpConnectionPtr &conn,
+        const WebRequest &request,
+        WebResponse &response);
 
 private:
+    /**
+     * @brief  加入定时分组，继续发送剩余的帧
+     * @param  conn             TCP连接对象
+     * @param  state            导出的发送状态
+     */
+    void Schedule(const net::TcpConnectionPtr &conn, const HistoryExportStatePtr &state);
+
     VideoSourceToWebData *Owner; ///< 数据函数封装类
-    uint32_t FrameInterval;      ///< 图像的帧率
+};
+
+/**
+ * @brief 运行指标，Prometheus 文本格式
+ */
+class MetricsRequestHandler : public WebRequestHandlerInterface
+{
+public:
+    explicit MetricsRequestHandler(const string &uri) : WebRequestHandlerInterface(uri, false)
+    {
+    }
+    void HandleHttpRequest(
+        const net::TcpConnectionPtr &conn,
+        const WebRequest &request,
+        WebResponse &response);
+};
+
+/**
+ * @brief 逐帧跟踪，导出Chrome trace_event格式的json
+ * @details 查询参数 enable=1 开启跟踪并清除之前的事件，enable=0 关闭；没有参数时返回已经记录的事件
+ */
+class TraceRequestHandler : public WebRequestHandlerInterface
+{
+public:
+    explicit TraceRequestHandler(const string &uri) : WebRequestHandlerInterface(uri, false)
+    {
+    }
+    void HandleHttpRequest(
+        const net::TcpConnectionPtr &conn,
+        const WebRequest &request,
+        WebResponse &response);
 };
 
 NAMESPACE_END